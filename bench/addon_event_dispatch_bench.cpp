@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/addon_event_list.hpp"
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+// Test and benchmark of invoking add-on events through immutable callback lists while other threads register and unregister callbacks, and of how long replaced lists are kept alive
+// The publisher is the one the add-on manager uses, but since the rest of it needs the Windows loader, this copies the dispatch loop of 'invoke_addon_event' (see 'source/addon_manager.hpp') (e.g. "g++ -std=c++17 -O2 -pthread addon_event_dispatch_bench.cpp -o addon_event_dispatch_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::addon_event_stats;
+using reshade::addon_event_callback_list;
+using reshade::addon_event_list_publisher;
+
+constexpr size_t num_events = 64;
+constexpr size_t num_callbacks = 3;
+
+static std::atomic<const addon_event_callback_list *> addon_event_list[num_events];
+static addon_event_list_publisher s_event_list_publisher;
+
+static void register_event(size_t ev, void *callback, addon_event_stats *stats)
+{
+	s_event_list_publisher.update(addon_event_list[ev], [callback, stats](addon_event_callback_list &event_list) {
+		event_list.callbacks.push_back(callback);
+		event_list.stats.push_back(stats);
+	});
+}
+static void unregister_event(size_t ev, void *callback)
+{
+	s_event_list_publisher.update(addon_event_list[ev], [callback](addon_event_callback_list &event_list) {
+		for (size_t cb = 0; cb < event_list.callbacks.size();)
+		{
+			if (event_list.callbacks[cb] == callback)
+			{
+				event_list.callbacks.erase(event_list.callbacks.begin() + cb);
+				event_list.stats.erase(event_list.stats.begin() + cb);
+			}
+			else
+			{
+				++cb;
+			}
+		}
+	});
+}
+
+static void callback_a(int *value) { *value += 1; }
+static void callback_b(int *value) { *value += 2; }
+static void callback_c(int *value) { *value += 3; }
+static void *const s_callbacks[num_callbacks] = { reinterpret_cast<void *>(&callback_a), reinterpret_cast<void *>(&callback_b), reinterpret_cast<void *>(&callback_c) };
+static addon_event_stats s_stats[num_callbacks];
+
+template <size_t ev>
+static inline void invoke_addon_event(int *value)
+{
+	const addon_event_callback_list *const event_list = addon_event_list[ev].load(std::memory_order_acquire);
+	if (event_list == nullptr)
+		return;
+	for (size_t cb = 0, count = event_list->callbacks.size(); cb < count; ++cb)
+		reinterpret_cast<void(*)(int *)>(event_list->callbacks[cb])(value);
+}
+
+// Previous design, with one vector per event that registration modified in place
+static std::vector<void *> s_old_event_list[num_events];
+
+template <size_t ev>
+static inline void invoke_addon_event_old(int *value)
+{
+	std::vector<void *> &event_list = s_old_event_list[ev];
+	for (size_t cb = 0, count = event_list.size(); cb < count; ++cb)
+		reinterpret_cast<void(*)(int *)>(event_list[cb])(value);
+}
+
+static void test_concurrent_registration()
+{
+	std::atomic<bool> done = false;
+	std::atomic<uint64_t> num_invocations = 0, num_registrations = 0, num_inconsistent = 0;
+	std::vector<std::thread> threads;
+
+	// Invoking threads check that every list they see is consistent, with each callback paired with its own statistics
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&]() {
+			int value = 0;
+			uint64_t invocations = 0;
+			while (!done)
+			{
+				for (size_t ev = 0; ev < num_events; ++ev, ++invocations)
+				{
+					const addon_event_callback_list *const event_list = addon_event_list[ev].load(std::memory_order_acquire);
+					if (event_list == nullptr)
+						continue;
+
+					if (event_list->callbacks.size() != event_list->stats.size())
+					{
+						num_inconsistent++;
+						continue;
+					}
+
+					for (size_t cb = 0; cb < event_list->callbacks.size(); ++cb)
+					{
+						const size_t index = std::find(s_callbacks, s_callbacks + num_callbacks, event_list->callbacks[cb]) - s_callbacks;
+						if (index >= num_callbacks || event_list->stats[cb] != &s_stats[index])
+							num_inconsistent++;
+						reinterpret_cast<void(*)(int *)>(event_list->callbacks[cb])(&value);
+					}
+				}
+			}
+			num_invocations += invocations;
+		});
+	}
+
+	// Registering threads each own half of the events and track what their lists should contain
+	std::vector<std::vector<void *>> expected(num_events);
+	for (size_t t = 0; t < 2; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			uint32_t random = 1234 + static_cast<uint32_t>(t);
+			uint64_t registrations = 0;
+			while (!done)
+			{
+				random = random * 1664525 + 1013904223;
+				const size_t ev = ((random >> 8) % (num_events / 2)) * 2 + t;
+				const size_t index = (random >> 20) % num_callbacks;
+
+				if ((random >> 16) & 1)
+				{
+					register_event(ev, s_callbacks[index], &s_stats[index]);
+					expected[ev].push_back(s_callbacks[index]);
+				}
+				else
+				{
+					unregister_event(ev, s_callbacks[index]);
+					expected[ev].erase(std::remove(expected[ev].begin(), expected[ev].end(), s_callbacks[index]), expected[ev].end());
+				}
+
+				registrations++;
+			}
+			num_registrations += registrations;
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	done = true;
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(num_inconsistent == 0);
+	for (size_t ev = 0; ev < num_events; ++ev)
+	{
+		const addon_event_callback_list *const event_list = addon_event_list[ev].load();
+		CHECK(event_list == nullptr ? expected[ev].empty() : event_list->callbacks == expected[ev]);
+	}
+
+	// Nothing was replaced longer ago than the grace period yet, so all replaced lists are still alive (unregistering from an empty event does not replace a list)
+	CHECK(s_event_list_publisher.num_retired() > addon_event_list_publisher::max_retired && s_event_list_publisher.num_retired() <= num_registrations);
+
+	std::printf("%llu event invocations while %llu callbacks were registered or unregistered, %zu lists retired\n",
+		static_cast<unsigned long long>(num_invocations.load()), static_cast<unsigned long long>(num_registrations.load()), s_event_list_publisher.num_retired());
+
+	// Same as 'unload_addons', which frees the retired lists once no more events can be in flight
+	for (size_t ev = 0; ev < num_events; ++ev)
+		s_event_list_publisher.update(addon_event_list[ev], [](addon_event_callback_list &event_list) { event_list = {}; });
+	s_event_list_publisher.clear();
+	CHECK(s_event_list_publisher.num_retired() == 0);
+}
+
+// Replaced objects are only freed once there are more than the maximum number of them and they were replaced longer ago than the grace period
+static void test_retire()
+{
+	addon_event_list_publisher publisher;
+	std::vector<std::weak_ptr<int>> objects;
+
+	const addon_event_list_publisher::clock::time_point start = addon_event_list_publisher::clock::now();
+	const auto retire = [&](addon_event_list_publisher::clock::time_point now) {
+		const std::shared_ptr<int> object = std::make_shared<int>(static_cast<int>(objects.size()));
+		objects.push_back(object);
+		publisher.retire(object, now);
+	};
+
+	// Many objects within the grace period are all kept, regardless of the maximum
+	for (size_t i = 0; i < 4 * addon_event_list_publisher::max_retired; ++i)
+		retire(start + std::chrono::milliseconds(i));
+	CHECK(publisher.num_retired() == objects.size());
+	CHECK(std::none_of(objects.begin(), objects.end(), [](const std::weak_ptr<int> &object) { return object.expired(); }));
+
+	// Once the grace period elapsed, the oldest are freed down to the maximum
+	retire(start + addon_event_list_publisher::grace_period + std::chrono::hours(1));
+	CHECK(publisher.num_retired() == addon_event_list_publisher::max_retired);
+	for (size_t i = 0; i < objects.size(); ++i)
+		CHECK(objects[i].expired() == (i < objects.size() - addon_event_list_publisher::max_retired));
+
+	// Only objects older than the grace period are freed, even when there are more than the maximum
+	const addon_event_list_publisher::clock::time_point later = start + std::chrono::hours(2);
+	for (size_t i = 0; i < 2 * addon_event_list_publisher::max_retired; ++i)
+		retire(later + std::chrono::milliseconds(i));
+	CHECK(publisher.num_retired() == 2 * addon_event_list_publisher::max_retired);
+
+	publisher.clear();
+	CHECK(std::all_of(objects.begin(), objects.end(), [](const std::weak_ptr<int> &object) { return object.expired(); }));
+
+	// Replaced lists are freed the same way, while the published one stays alive
+	std::atomic<const addon_event_callback_list *> event_list = nullptr;
+	for (size_t i = 0; i < 8; ++i)
+		publisher.update(event_list, [](addon_event_callback_list &event_list) { event_list.callbacks.push_back(nullptr); event_list.stats.push_back(nullptr); });
+	CHECK(publisher.num_retired() == 7);
+	CHECK(event_list.load()->callbacks.size() == 8);
+	publisher.update(event_list, [](addon_event_callback_list &event_list) { event_list = {}; });
+	CHECK(event_list.load() == nullptr);
+	CHECK(publisher.num_retired() == 8);
+}
+
+template <typename F>
+static void benchmark(const char *name, F invoke)
+{
+	constexpr int iterations = 100000000;
+
+	int value = 0;
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		invoke(&value);
+	const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+	std::printf("%-28s %.2f ns per invocation (%d)\n", name, elapsed / iterations, value & 1);
+}
+
+int main()
+{
+	test_concurrent_registration();
+	test_retire();
+
+	benchmark("in place, no callbacks", invoke_addon_event_old<1>);
+	benchmark("copy on write, no callbacks", invoke_addon_event<1>);
+
+	s_old_event_list[2] = { s_callbacks[0] };
+	register_event(2, s_callbacks[0], &s_stats[0]);
+	benchmark("in place, 1 callback", invoke_addon_event_old<2>);
+	benchmark("copy on write, 1 callback", invoke_addon_event<2>);
+
+	s_old_event_list[3] = { s_callbacks[0], s_callbacks[1], s_callbacks[2], s_callbacks[0] };
+	for (const size_t index : { 0, 1, 2, 0 })
+		register_event(3, s_callbacks[index], &s_stats[index]);
+	benchmark("in place, 4 callbacks", invoke_addon_event_old<3>);
+	benchmark("copy on write, 4 callbacks", invoke_addon_event<3>);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All add-on event dispatch tests passed");
+	return 0;
+}
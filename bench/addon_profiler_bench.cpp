@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/addon_event_list.hpp"
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+// Test and benchmark of the sampling profiler for add-on event callbacks
+// The profiled dispatch, 'record_addon_event_sample' and 'get_addon_event_percentile' are the ones the add-on manager uses, but since the rest of it needs the Windows loader, this copies the dispatch of 'invoke_addon_event' (see 'source/addon_manager.hpp') (e.g. "g++ -std=c++17 -O2 -pthread addon_profiler_bench.cpp -o addon_profiler_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::addon_event_stats;
+using reshade::addon_event_callback_list;
+using reshade::record_addon_event_sample;
+using reshade::get_addon_event_percentile;
+
+static std::atomic<const addon_event_callback_list *> s_event_list;
+static std::atomic<uint32_t> s_profiling_interval = 0;
+
+// Same as 'reshade::invoke_addon_event_profiled', which is kept out of line
+static __attribute__((noinline)) void invoke_addon_event_profiled(uint32_t interval, const addon_event_callback_list &event_list, int value)
+{
+	static thread_local uint32_t invocation_index = 0;
+
+	reshade::invoke_addon_event_callbacks_profiled<void, void(*)(int)>(interval, invocation_index, event_list, value);
+}
+
+static void invoke_addon_event(int value)
+{
+	const addon_event_callback_list *const event_list = s_event_list.load(std::memory_order_acquire);
+	if (event_list == nullptr)
+		return;
+	if (const uint32_t interval = s_profiling_interval.load(std::memory_order_relaxed); interval != 0)
+		return invoke_addon_event_profiled(interval, *event_list, value);
+	for (size_t cb = 0, count = event_list->callbacks.size(); cb < count; ++cb)
+		reinterpret_cast<void(*)(int)>(event_list->callbacks[cb])(value);
+}
+
+// Dispatch before the profiler was added
+static void invoke_addon_event_unprofiled(int value)
+{
+	const addon_event_callback_list *const event_list = s_event_list.load(std::memory_order_acquire);
+	if (event_list == nullptr)
+		return;
+	for (size_t cb = 0, count = event_list->callbacks.size(); cb < count; ++cb)
+		reinterpret_cast<void(*)(int)>(event_list->callbacks[cb])(value);
+}
+
+static int s_sink = 0;
+static __attribute__((noinline)) void callback(int value) { s_sink += value; }
+
+static void test_histogram()
+{
+	addon_event_stats stats;
+
+	// Bucket i holds durations below 2^i nanoseconds and at least 2^(i-1)
+	record_addon_event_sample(stats, std::chrono::nanoseconds(0));
+	record_addon_event_sample(stats, std::chrono::nanoseconds(1));
+	record_addon_event_sample(stats, std::chrono::nanoseconds(1000));
+	record_addon_event_sample(stats, std::chrono::nanoseconds(1023));
+	record_addon_event_sample(stats, std::chrono::nanoseconds(1024));
+	record_addon_event_sample(stats, std::chrono::hours(1000)); // Larger than the last bucket
+	CHECK(stats.sample_histogram[0] == 1);
+	CHECK(stats.sample_histogram[1] == 1);
+	CHECK(stats.sample_histogram[10] == 2);
+	CHECK(stats.sample_histogram[11] == 1);
+	CHECK(stats.sample_histogram[31] == 1);
+	CHECK(stats.sample_count == 6);
+
+	// Estimated percentiles are the upper bound of the bucket the true percentile falls into, so at most twice the true value
+	addon_event_stats distribution;
+	std::vector<uint64_t> durations;
+	std::mt19937 rng(42);
+	std::lognormal_distribution<double> lognormal(7.0, 1.0);
+	for (int i = 0; i < 100000; ++i)
+	{
+		const uint64_t duration = static_cast<uint64_t>(lognormal(rng));
+		durations.push_back(duration);
+		record_addon_event_sample(distribution, std::chrono::nanoseconds(duration));
+	}
+	std::sort(durations.begin(), durations.end());
+
+	for (const double percentile : { 0.5, 0.99 })
+	{
+		const uint64_t exact = durations[static_cast<size_t>(std::ceil(durations.size() * percentile)) - 1];
+		const uint64_t estimate = get_addon_event_percentile(distribution, percentile);
+		CHECK(estimate >= exact && estimate <= 2 * exact + 1);
+		std::printf("p%.0f of a lognormal distribution: exact %llu ns, estimated %llu ns\n", percentile * 100, static_cast<unsigned long long>(exact), static_cast<unsigned long long>(estimate));
+	}
+
+	CHECK(get_addon_event_percentile(addon_event_stats(), 0.5) == 0);
+}
+
+static void test_sampling()
+{
+	addon_event_stats stats;
+	addon_event_callback_list event_list;
+	event_list.callbacks.push_back(reinterpret_cast<void *>(&callback));
+	event_list.stats.push_back(&stats);
+	s_event_list = &event_list;
+	s_profiling_interval = 8;
+
+	// Every call is counted, but only every 8th call per thread is timed
+	constexpr int num_threads = 4, calls_per_thread = 80000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+		threads.emplace_back([]() {
+			for (int i = 0; i < calls_per_thread; ++i)
+				invoke_addon_event(i);
+		});
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(stats.call_count == num_threads * calls_per_thread);
+	CHECK(stats.sample_count == num_threads * calls_per_thread / 8);
+
+	uint64_t histogram_count = 0;
+	for (const std::atomic<uint32_t> &count : stats.sample_histogram)
+		histogram_count += count;
+	CHECK(histogram_count == stats.sample_count);
+
+	s_profiling_interval = 0;
+	s_event_list = nullptr;
+}
+
+static bool callback_unhandled(int) { return false; }
+static bool callback_handled(int) { return true; }
+
+// Callbacks that return whether they handled the event stop the invocation at the first one that did, and later callbacks are not counted
+static void test_handled()
+{
+	addon_event_stats stats[3];
+	addon_event_callback_list event_list;
+	event_list.callbacks = { reinterpret_cast<void *>(&callback_unhandled), reinterpret_cast<void *>(&callback_handled), reinterpret_cast<void *>(&callback_unhandled) };
+	event_list.stats = { &stats[0], &stats[1], &stats[2] };
+
+	uint32_t invocation_index = 0;
+	for (int i = 0; i < 10; ++i)
+		CHECK((reshade::invoke_addon_event_callbacks_profiled<bool, bool(*)(int)>(2, invocation_index, event_list, i)));
+	CHECK(invocation_index == 10);
+	CHECK(stats[0].call_count == 10 && stats[1].call_count == 10 && stats[2].call_count == 0);
+	CHECK(stats[0].sample_count == 5 && stats[1].sample_count == 5 && stats[2].sample_count == 0);
+
+	event_list.callbacks.pop_back();
+	event_list.callbacks.erase(event_list.callbacks.begin() + 1);
+	event_list.stats.resize(1);
+	CHECK(!(reshade::invoke_addon_event_callbacks_profiled<bool, bool(*)(int)>(1, invocation_index, event_list, 0)));
+	CHECK(stats[0].call_count == 11 && stats[0].sample_count == 6);
+}
+
+template <typename F>
+static double time_per_call(F invoke)
+{
+	constexpr int iterations = 50000000;
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		invoke(i);
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count() / iterations;
+}
+
+static void bench_dispatch()
+{
+	static addon_event_stats stats;
+	static addon_event_callback_list event_list;
+	event_list.callbacks = { reinterpret_cast<void *>(&callback) };
+	event_list.stats = { &stats };
+	s_event_list = &event_list;
+
+	for (int run = 0; run < 3; ++run)
+	{
+		s_profiling_interval = 0;
+		const double unprofiled = time_per_call(invoke_addon_event_unprofiled);
+		const double disabled = time_per_call(invoke_addon_event);
+		s_profiling_interval = 8;
+		const double every_8th = time_per_call(invoke_addon_event);
+		s_profiling_interval = 1;
+		const double every_call = time_per_call(invoke_addon_event);
+
+		std::printf("One callback: %.2f ns before, %.2f ns with profiling disabled, %.2f ns timing every 8th call, %.2f ns timing every call\n", unprofiled, disabled, every_8th, every_call);
+	}
+
+	s_profiling_interval = 0;
+	s_event_list = nullptr;
+}
+
+int main()
+{
+	test_histogram();
+	test_sampling();
+	test_handled();
+	bench_dispatch();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All add-on profiler tests passed");
+	return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../examples/01-api_trace/trace_recorder.cpp"
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+
+// Test and benchmark of recording API traces from many threads into per-thread ring buffers, compared to formatting text into a shared log under a mutex
+// The recorder and binary format of the API trace example do not depend on ReShade, so this builds them directly and feeds them synthetic records (e.g. "g++ -std=c++17 -O2 -pthread api_trace_recorder_test.cpp -o api_trace_recorder_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static std::vector<uint8_t> read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(data.data()), data.size());
+	return data;
+}
+
+// Every record that was not dropped has to arrive intact and in order per thread, across several recordings with threads racing the start and stop
+static void test_concurrent_recording(const std::filesystem::path &path)
+{
+	trace_recorder recorder;
+
+	for (int round = 0; round < 5; ++round)
+	{
+		CHECK(recorder.start(path));
+
+		std::atomic<bool> quit = false;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&]() {
+				uint64_t values[40];
+				for (uint64_t i = 0; !quit; ++i)
+				{
+					// Vary the size so records wrap around the end of the ring buffer at different offsets
+					const size_t count = 1 + (i % 37);
+					for (size_t k = 0; k < count; ++k)
+						values[k] = i * 1000 + k;
+					recorder.record_array(trace_event::push_constants, values, count);
+				}
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		recorder.stop(); // Threads keep recording across the stop
+		quit = true;
+		for (std::thread &thread : threads)
+			thread.join();
+
+		const std::vector<uint8_t> data = read_file(path);
+		trace_reader reader(data.data(), data.size());
+		CHECK(reader.valid());
+
+		std::map<uint32_t, uint64_t> last_index, last_timestamp;
+		uint64_t num_records = 0, num_dropped = 0, num_corrupted = 0;
+
+		trace_record_header record;
+		const uint64_t *args = nullptr;
+		while (reader.next(record, args))
+		{
+			if (record.event == trace_event::dropped)
+			{
+				num_dropped += args[0];
+				continue;
+			}
+
+			num_records++;
+
+			const uint64_t i = args[0] / 1000;
+			if (record.arg_count != 1 + (i % 37))
+				num_corrupted++;
+			for (size_t k = 0; k < record.arg_count; ++k)
+				if (args[k] != i * 1000 + k)
+					num_corrupted++;
+			if (last_index.count(record.thread_index) && i <= last_index[record.thread_index])
+				num_corrupted++;
+			if (last_timestamp.count(record.thread_index) && record.timestamp < last_timestamp[record.thread_index])
+				num_corrupted++;
+			if (record.timestamp < reader.header().start_time)
+				num_corrupted++;
+
+			last_index[record.thread_index] = i;
+			last_timestamp[record.thread_index] = record.timestamp;
+		}
+
+		const trace_recorder::statistics stats = recorder.get_statistics();
+		CHECK(!reader.truncated());
+		CHECK(num_corrupted == 0);
+		CHECK(data.size() == stats.bytes_written);
+
+		std::printf("Round %d: %llu records read, %llu dropped, %zu bytes\n", round,
+			static_cast<unsigned long long>(num_records), static_cast<unsigned long long>(num_dropped), data.size());
+	}
+}
+
+// Previous design, which formatted every call to text and appended it to a shared log under a mutex
+static std::mutex s_capture_mutex;
+static std::vector<std::string> s_capture_log;
+
+static void bench_recording(const std::filesystem::path &path, int num_threads, int records_per_thread, int pace)
+{
+	trace_recorder recorder;
+
+	for (const bool old_path : { true, false })
+	{
+		if (old_path)
+			s_capture_log.reserve(static_cast<size_t>(num_threads) * records_per_thread);
+		else
+			recorder.start(path);
+
+		std::vector<std::thread> threads;
+		std::vector<double> time_per_call(num_threads);
+		for (int t = 0; t < num_threads; ++t)
+		{
+			threads.emplace_back([&, t]() {
+				const auto start_time = std::chrono::steady_clock::now();
+				double sleep_time = 0;
+
+				for (int i = 0; i < records_per_thread; ++i)
+				{
+					// Sleep after every few records to model a realistic call rate, without counting the sleep
+					if (pace != 0 && i % pace == 0)
+					{
+						const auto sleep_start_time = std::chrono::steady_clock::now();
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						sleep_time += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - sleep_start_time).count();
+					}
+
+					if (old_path)
+					{
+						std::stringstream s;
+						s << "draw(" << i << ", " << 1 << ", " << t << ", " << 0 << ")";
+						const std::unique_lock<std::mutex> lock(s_capture_mutex);
+						s_capture_log.push_back(s.str());
+					}
+					else
+					{
+						recorder.record(trace_event::draw, i, 1, t, 0);
+					}
+				}
+
+				time_per_call[t] = (std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count() - sleep_time) / records_per_thread;
+			});
+		}
+
+		for (std::thread &thread : threads)
+			thread.join();
+
+		double average_time_per_call = 0;
+		for (const double time : time_per_call)
+			average_time_per_call += time / num_threads;
+
+		if (old_path)
+		{
+			std::printf("%2d threads, %s: text under a mutex %6.0f ns per call\n", num_threads, pace != 0 ? "paced" : "unpaced", average_time_per_call);
+			s_capture_log.clear();
+			s_capture_log.shrink_to_fit();
+		}
+		else
+		{
+			recorder.stop();
+
+			const trace_recorder::statistics stats = recorder.get_statistics();
+			std::printf("%2d threads, %s: ring buffers      %6.0f ns per call, %llu records written, %llu dropped, %llu bytes\n", num_threads, pace != 0 ? "paced" : "unpaced", average_time_per_call,
+				static_cast<unsigned long long>(stats.records_written), static_cast<unsigned long long>(stats.records_dropped), static_cast<unsigned long long>(stats.bytes_written));
+		}
+	}
+}
+
+int main()
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "reshade_api_trace_test.bin";
+
+	test_concurrent_recording(path);
+
+	bench_recording(path, 16, 100000, 1000);
+	bench_recording(path, 16, 100000, 0);
+
+	std::filesystem::remove(path);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All API trace recorder tests passed");
+	return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../examples/crc32_hash.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Test and benchmark of the slice-by-8 CRC-32 shared by the shader and texture dump/replace examples
+// Dumped files are named after this checksum, so it is compared against the plain byte-at-a-time algorithm for every alignment and tail length (e.g. "g++ -std=c++17 -O2 crc32_hash_test.cpp -o crc32_hash_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static uint32_t compute_crc32_bytewise(const uint8_t *data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; ++i)
+		crc = (crc >> 8) ^ crc32_detail::crc32_tables.data[0][(crc ^ data[i]) & 0xFF];
+	return ~crc;
+}
+
+template <typename F>
+static void benchmark(const char *name, const std::vector<uint8_t> &buffer, F func)
+{
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	volatile uint32_t result = func(buffer.data(), buffer.size());
+	const double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+	std::printf("%-24s %6.2f GB/s (%08x)\n", name, buffer.size() / elapsed / 1e9, static_cast<uint32_t>(result));
+}
+
+int main()
+{
+	// Check value from the CRC catalogue
+	CHECK(compute_crc32(reinterpret_cast<const uint8_t *>("123456789"), 9) == 0xCBF43926);
+	CHECK(compute_crc32(nullptr, 0) == 0);
+
+	std::vector<uint8_t> buffer(64 * 1024 * 1024);
+	std::mt19937 rng(1);
+	for (uint8_t &value : buffer)
+		value = static_cast<uint8_t>(rng());
+
+	for (size_t offset = 0; offset < 9; ++offset)
+		for (size_t size = 0; size < 300; ++size)
+			CHECK(compute_crc32(buffer.data() + offset, size) == compute_crc32_bytewise(buffer.data() + offset, size));
+
+	benchmark("crc32 byte-at-a-time", buffer, compute_crc32_bytewise);
+	benchmark("crc32 slice-by-8", buffer, compute_crc32);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All CRC-32 tests passed");
+	return 0;
+}
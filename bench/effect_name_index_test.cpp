@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The API headers use Microsoft extensions that the name index does not need, so stub them out to build with other compilers
+// The effect object headers rely on the standard headers MSVC includes with Windows.h, so include those first too
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <filesystem>
+#include <unordered_map>
+#define __declspec(x)
+#define __uuidof(x) x::uuid
+#define RESHADE_FX 1
+
+#include "../source/effect_name_index.cpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+// Test and benchmark of the name index behind 'runtime::find_uniform_variable', 'runtime::find_texture_variable' and 'runtime::find_technique', which compares every lookup against the linear searches the index replaced
+// Also checks that a lock held from before a generation change keeps the rebuild waiting, and that lookups from many threads stay consistent while the generation keeps changing (e.g. "g++ -std=c++17 -O2 -pthread -fpermissive -w -I../include -I../source effect_name_index_test.cpp -o effect_name_index_test", add -fsanitize=thread to check for races)
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+// The objects the runtime owns, with some uniform and technique names repeated across effects and two effects that share a file name
+struct scene
+{
+	std::vector<reshade::effect> effects;
+	std::vector<reshade::texture> textures;
+	std::vector<reshade::technique> techniques;
+	std::atomic<uint32_t> generation = 1;
+	reshade::effect_name_index index;
+};
+
+static void make_scene(scene &scene, size_t num_effects, size_t num_uniforms)
+{
+	scene.effects.resize(num_effects);
+	for (size_t e = 0; e < num_effects; ++e)
+	{
+		// The last effect is in a different directory, but has the same file name as the first
+		if (e == num_effects - 1)
+			scene.effects[e].source_file = "D:/Other/Shaders/Effect0.fx";
+		else
+			scene.effects[e].source_file = "C:/Games/reshade-shaders/Shaders/Effect" + std::to_string(e) + ".fx";
+
+		for (size_t u = 0; u < num_uniforms; ++u)
+		{
+			reshadefx::uniform_info info;
+			info.name = (u % 5 == 0) ? "Shared" + std::to_string(u) : "Uniform" + std::to_string(e) + '_' + std::to_string(u);
+			reshade::uniform &variable = scene.effects[e].uniforms.emplace_back(info);
+			variable.effect_index = e;
+		}
+	}
+
+	for (size_t t = 0; t < num_effects; ++t)
+	{
+		reshadefx::texture_info info;
+		info.name = (t % 3 == 0) ? "BackBufferTex" : "Texture" + std::to_string(t);
+		info.unique_name = "V_" + info.name + '_' + std::to_string(t);
+		reshade::texture &texture = scene.textures.emplace_back(info);
+		texture.effect_index = t;
+		texture.shared.push_back(t);
+		if (t + 7 < num_effects)
+			texture.shared.push_back(t + 7);
+	}
+
+	for (size_t e = 0; e < num_effects; ++e)
+	{
+		for (size_t t = 0; t < 3; ++t)
+		{
+			reshadefx::technique_info info;
+			info.name = (t == 0) ? "Main" : "Technique" + std::to_string(e) + '_' + std::to_string(t);
+			scene.techniques.emplace_back(info).effect_index = e;
+		}
+	}
+}
+
+// Linear searches like the runtime did before it had the name index
+static const reshade::uniform *find_uniform_linear(const scene &scene, const char *effect_name, const char *variable_name)
+{
+	for (const reshade::effect &effect : scene.effects)
+	{
+		if (effect_name != nullptr && effect.source_file.filename() != effect_name)
+			continue;
+		for (const reshade::uniform &variable : effect.uniforms)
+			if (variable.name == variable_name)
+				return &variable;
+		if (effect_name != nullptr)
+			break;
+	}
+	return nullptr;
+}
+static const reshade::texture *find_texture_linear(const scene &scene, const char *effect_name, const char *variable_name)
+{
+	for (const reshade::texture &variable : scene.textures)
+	{
+		if (effect_name != nullptr &&
+			std::find_if(variable.shared.begin(), variable.shared.end(),
+				[&scene, effect_name](size_t effect_index) { return scene.effects[effect_index].source_file.filename() == effect_name; }) == variable.shared.end())
+			continue;
+		if (variable.name == variable_name || variable.unique_name == variable_name)
+			return &variable;
+	}
+	return nullptr;
+}
+static const reshade::technique *find_technique_linear(const scene &scene, const char *effect_name, const char *technique_name)
+{
+	for (const reshade::technique &tech : scene.techniques)
+	{
+		if (effect_name != nullptr && scene.effects[tech.effect_index].source_file.filename() != effect_name)
+			continue;
+		if (tech.name == technique_name)
+			return &tech;
+	}
+	return nullptr;
+}
+
+static void check_against_linear(scene &scene, uint32_t seed)
+{
+	uint32_t random = seed;
+	const auto next = [&random]() { random = random * 1664525 + 1013904223; return random >> 8; };
+
+	const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		// Pick names of existing objects most of the time, but also names that do not exist in the effect or at all
+		std::string effect_name = "Effect" + std::to_string(next() % (scene.effects.size() + 2)) + ".fx";
+		const char *const effect_name_or_all = (next() % 4 == 0) ? nullptr : effect_name.c_str();
+
+		const size_t e = next() % scene.effects.size();
+		const size_t u = next() % (scene.effects[e].uniforms.size() + 1);
+		const std::string uniform_name = u < scene.effects[e].uniforms.size() ? scene.effects[e].uniforms[u].name : "Missing";
+		CHECK(scene.index.find_uniform(effect_name_or_all, uniform_name.c_str()) == find_uniform_linear(scene, effect_name_or_all, uniform_name.c_str()));
+
+		const reshade::texture &texture = scene.textures[next() % scene.textures.size()];
+		const std::string texture_name = (next() % 2) ? texture.name : texture.unique_name;
+		CHECK(scene.index.find_texture(effect_name_or_all, texture_name.c_str()) == find_texture_linear(scene, effect_name_or_all, texture_name.c_str()));
+
+		const reshade::technique &tech = scene.techniques[next() % scene.techniques.size()];
+		CHECK(scene.index.find_technique(effect_name_or_all, tech.name.c_str()) == find_technique_linear(scene, effect_name_or_all, tech.name.c_str()));
+	}
+}
+
+static void test_against_linear()
+{
+	scene scene;
+	make_scene(scene, 40, 12);
+
+	for (uint32_t seed = 1; seed <= 20; ++seed)
+		check_against_linear(scene, seed);
+
+	// Only the first effect with a file name is searched for uniform variables, but textures and techniques of both are found
+	{
+		const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+		CHECK(scene.index.find_uniform("Effect0.fx", "Uniform0_1") == &scene.effects[0].uniforms[1]);
+		CHECK(scene.index.find_uniform("Effect0.fx", "Uniform39_1") == nullptr);
+		CHECK(scene.index.find_uniform(nullptr, "Uniform39_1") == &scene.effects[39].uniforms[1]);
+		CHECK(scene.index.find_technique("Effect0.fx", "Technique39_1") == &scene.techniques[39 * 3 + 1]);
+		CHECK(scene.index.find_uniform(nullptr, "Shared5") == &scene.effects[0].uniforms[5]);
+	}
+}
+
+// Objects are replaced, reordered and removed between lookups like reloading effects and reordering techniques does, which has to rebuild the tables once the generation changed
+static void test_rebuild()
+{
+	scene scene;
+	make_scene(scene, 40, 12);
+
+	{
+		const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+		CHECK(scene.index.find_technique("Effect3.fx", "Technique3_1") == &scene.techniques[3 * 3 + 1]);
+	}
+
+	std::swap(scene.techniques[3 * 3 + 1], scene.techniques[0]);
+	scene.effects[5].uniforms[1].name = "Renamed";
+	scene.effects.pop_back();
+	scene.textures.pop_back();
+	for (reshade::texture &texture : scene.textures)
+		texture.shared.erase(std::remove(texture.shared.begin(), texture.shared.end(), scene.effects.size()), texture.shared.end());
+	scene.techniques.erase(std::remove_if(scene.techniques.begin(), scene.techniques.end(), [&scene](const reshade::technique &tech) { return tech.effect_index >= scene.effects.size(); }), scene.techniques.end());
+	scene.generation++;
+
+	{
+		const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+		CHECK(scene.index.find_technique("Effect3.fx", "Technique3_1") == &scene.techniques[0]);
+		CHECK(scene.index.find_uniform("Effect5.fx", "Renamed") == &scene.effects[5].uniforms[1]);
+		CHECK(scene.index.find_uniform("Effect5.fx", "Uniform5_1") == nullptr);
+		CHECK(scene.index.find_uniform(nullptr, "Uniform39_2") == nullptr);
+		CHECK(scene.index.find_texture(nullptr, "Texture38") == &scene.textures[38]);
+		CHECK(scene.index.find_texture(nullptr, "Texture39") == nullptr);
+	}
+
+	for (uint32_t seed = 1; seed <= 5; ++seed)
+		check_against_linear(scene, seed);
+}
+
+// A lookup that still holds its shared lock from before the generation changed keeps the rebuild waiting, since upgrading to the exclusive lock has to wait for all shared ones
+static void test_upgrade_waits_for_readers()
+{
+	scene scene;
+	make_scene(scene, 40, 12);
+
+	// Make room for the technique added below up front, so that adding it does not move the objects the reader may still look at
+	scene.techniques.reserve(scene.techniques.size() + 1);
+
+	std::shared_lock<std::shared_mutex> reader_lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+	CHECK(scene.index.find_technique("Effect7.fx", "Technique7_1") == &scene.techniques[7 * 3 + 1]);
+
+	reshadefx::technique_info info;
+	info.name = "Added";
+	scene.techniques.emplace_back(info).effect_index = 7;
+	scene.generation++;
+
+	std::atomic<bool> locked = false;
+	const reshade::technique *added = nullptr;
+	std::thread writer([&]() {
+		const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+		locked = true;
+		added = scene.index.find_technique("Effect7.fx", "Added");
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CHECK(!locked);
+	// The reader still sees the tables from before the change
+	CHECK(scene.index.find_technique("Effect7.fx", "Added") == nullptr);
+	CHECK(scene.index.find_technique("Effect7.fx", "Technique7_1") == &scene.techniques[7 * 3 + 1]);
+
+	reader_lock.unlock();
+	writer.join();
+	CHECK(locked);
+	CHECK(added == &scene.techniques.back());
+}
+
+// Many threads look up names while the generation keeps changing (without the objects changing, like reordering techniques back and forth), so they race to rebuild the tables
+static void test_concurrent_lookups()
+{
+	scene scene;
+	make_scene(scene, 40, 12);
+
+	std::atomic<bool> stop = false;
+	std::atomic<size_t> num_lookups = 0, num_mismatches = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t)
+	{
+		threads.emplace_back([&scene, &stop, &num_lookups, &num_mismatches, t]() {
+			size_t thread_lookups = 0, thread_mismatches = 0;
+			for (size_t i = t; !stop || thread_lookups < 1000; ++i)
+			{
+				const size_t e = i % scene.effects.size(), u = (i / 7) % scene.effects[e].uniforms.size();
+				const std::string effect_name = "Effect" + std::to_string(e) + ".fx";
+
+				const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+				// The last effect shares its file name with the first, so its variables are only found when searching all effects
+				const reshade::uniform *const expected = &scene.effects[e].uniforms[u];
+				thread_mismatches += scene.index.find_uniform(e == scene.effects.size() - 1 ? nullptr : effect_name.c_str(), expected->name.c_str()) != find_uniform_linear(scene, e == scene.effects.size() - 1 ? nullptr : effect_name.c_str(), expected->name.c_str());
+				thread_lookups++;
+			}
+			num_lookups += thread_lookups;
+			num_mismatches += thread_mismatches;
+		});
+	}
+
+	for (int i = 0; i < 200; ++i)
+	{
+		scene.generation++;
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	stop = true;
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(num_mismatches == 0);
+	CHECK(num_lookups >= 8 * 1000);
+}
+
+static void bench_lookups()
+{
+	scene scene;
+	make_scene(scene, 300, 20);
+
+	std::vector<std::pair<std::string, std::string>> queries;
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		const size_t e = (i * 37) % (scene.effects.size() - 1);
+		queries.emplace_back("Effect" + std::to_string(e) + ".fx", scene.effects[e].uniforms[i % 20].name);
+	}
+
+	auto start_time = std::chrono::high_resolution_clock::now();
+	size_t num_found = 0;
+	for (const auto &[effect_name, variable_name] : queries)
+		num_found += find_uniform_linear(scene, effect_name.c_str(), variable_name.c_str()) != nullptr;
+	const double linear_time = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count() / queries.size();
+	CHECK(num_found == queries.size());
+
+	start_time = std::chrono::high_resolution_clock::now();
+	scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+	const double build_time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+	start_time = std::chrono::high_resolution_clock::now();
+	num_found = 0;
+	for (const auto &[effect_name, variable_name] : queries)
+	{
+		// Same as 'runtime::find_uniform_variable', which takes the lock for every lookup
+		const std::shared_lock<std::shared_mutex> lock = scene.index.lock(scene.generation, scene.effects, scene.textures, scene.techniques);
+		num_found += scene.index.find_uniform(effect_name.c_str(), variable_name.c_str()) != nullptr;
+	}
+	const double index_time = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count() / queries.size();
+	CHECK(num_found == queries.size());
+
+	std::printf("%zu effects with %zu variables each: linear search %8.0f ns per lookup, name index %5.0f ns per lookup (including the shared lock), building the index %6.0f us\n",
+		scene.effects.size(), scene.effects[0].uniforms.size(), linear_time, index_time, build_time);
+}
+
+int main()
+{
+	test_against_linear();
+	test_rebuild();
+	test_upgrade_waits_for_readers();
+	test_concurrent_lookups();
+	bench_lookups();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All name index tests passed");
+	return 0;
+}
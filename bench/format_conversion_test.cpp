@@ -0,0 +1,966 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/format_conversion.cpp"
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Test and benchmark of the pixel format conversion library, which compares every format against plain scalar reference code written from the format specifications, at widths that cover both the vectorized rows and their scalar tails
+// Builds the library into the test, so that the reference block decoders can share its BC7 partition tables (e.g. "g++ -std=c++17 -O2 -I../include format_conversion_test.cpp -o format_conversion_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+struct format_info
+{
+	reshade::api::format format;
+	const char *name;
+	// Largest difference to the reference that is accepted per channel (non-zero where the library uses integer or table approximations)
+	int tolerance;
+};
+
+static const format_info s_to_rgba8_formats[] = {
+	{ format::r8_unorm, "r8", 0 },
+	{ format::l8_unorm, "l8", 0 },
+	{ format::a8_unorm, "a8", 0 },
+	{ format::r8g8_unorm, "rg8", 0 },
+	{ format::l8a8_unorm, "l8a8", 0 },
+	{ format::r8g8b8a8_unorm, "rgba8", 0 },
+	{ format::r8g8b8x8_unorm, "rgbx8", 0 },
+	{ format::b8g8r8a8_unorm, "bgra8", 0 },
+	{ format::b8g8r8x8_unorm, "bgrx8", 0 },
+	{ format::r10g10b10a2_unorm, "rgb10a2", 0 },
+	{ format::b10g10r10a2_unorm, "bgr10a2", 0 },
+	{ format::r16_unorm, "r16", 0 },
+	{ format::l16_unorm, "l16", 0 },
+	{ format::r16g16_unorm, "rg16", 0 },
+	{ format::l16a16_unorm, "l16a16", 0 },
+	{ format::r16g16b16a16_unorm, "rgba16", 0 },
+	// Linear floating-point values are quantized to 12 bits before they are sRGB encoded
+	{ format::r16_float, "r16f", 1 },
+	{ format::r16g16_float, "rg16f", 1 },
+	{ format::r16g16b16a16_float, "rgba16f", 1 },
+	{ format::r32_float, "r32f", 1 },
+	{ format::r32g32_float, "rg32f", 1 },
+	{ format::r32g32b32_float, "rgb32f", 1 },
+	{ format::r32g32b32a32_float, "rgba32f", 1 },
+	{ format::r11g11b10_float, "r11g11b10f", 1 },
+	{ format::r9g9b9e5, "rgb9e5", 1 },
+	{ format::b5g6r5_unorm, "b5g6r5", 0 },
+	{ format::b5g5r5a1_unorm, "b5g5r5a1", 0 },
+	{ format::b5g5r5x1_unorm, "b5g5r5x1", 0 },
+	{ format::b4g4r4a4_unorm, "b4g4r4a4", 0 },
+	// Interpolated colors are computed with integer division instead of rounding
+	{ format::bc1_unorm, "bc1", 1 },
+	{ format::bc2_unorm, "bc2", 1 },
+	{ format::bc3_unorm, "bc3", 1 },
+	{ format::bc4_unorm, "bc4", 1 },
+	{ format::bc4_snorm, "bc4s", 1 },
+	{ format::bc5_unorm, "bc5", 1 },
+	{ format::bc5_snorm, "bc5s", 1 },
+	{ format::bc6h_ufloat, "bc6h", 1 },
+	{ format::bc6h_sfloat, "bc6hs", 1 },
+	{ format::bc7_unorm, "bc7", 0 },
+};
+
+static const format_info s_from_rgba8_formats[] = {
+	{ format::r8_unorm, "r8", 0 },
+	{ format::r8g8_unorm, "rg8", 0 },
+	{ format::r8g8b8a8_unorm, "rgba8", 0 },
+	{ format::b8g8r8a8_unorm, "bgra8", 0 },
+	{ format::r10g10b10a2_unorm, "rgb10a2", 0 },
+	{ format::b10g10r10a2_unorm, "bgr10a2", 0 },
+	{ format::r16_unorm, "r16", 0 },
+	{ format::r16g16_unorm, "rg16", 0 },
+	{ format::r16g16b16a16_unorm, "rgba16", 0 },
+	{ format::r16_float, "r16f", 0 },
+	{ format::r16g16_float, "rg16f", 0 },
+	{ format::r16g16b16a16_float, "rgba16f", 0 },
+	{ format::r32_float, "r32f", 0 },
+	{ format::r32g32_float, "rg32f", 0 },
+	{ format::r32g32b32_float, "rgb32f", 0 },
+	{ format::r32g32b32a32_float, "rgba32f", 0 },
+};
+
+static bool is_block_compressed(format format)
+{
+	// Block compressed formats are not contiguous in the format enumeration, since it follows DXGI
+	return (format >= format::bc1_typeless && format <= format::bc5_snorm) || (format >= format::bc6h_typeless && format <= format::bc7_unorm_srgb);
+}
+static bool is_floating_point(format format)
+{
+	return format == format::r16_float || format == format::r16g16_float || format == format::r16g16b16a16_float ||
+		format == format::r32_float || format == format::r32g32_float || format == format::r32g32b32_float || format == format::r32g32b32a32_float;
+}
+
+#pragma region Reference Code
+
+static uint8_t reference_unorm(uint32_t value, uint32_t bits)
+{
+	return static_cast<uint8_t>(std::lround(value * 255.0 / ((1u << bits) - 1)));
+}
+static uint8_t reference_unorm8(double value)
+{
+	if (!(value > 0.0)) // Also catches NaN
+		return 0;
+	if (value >= 1.0)
+		return 255;
+	return static_cast<uint8_t>(std::lround(value * 255.0));
+}
+static uint8_t reference_srgb8(double value)
+{
+	if (!(value > 0.0))
+		return 0;
+	if (value >= 1.0)
+		return 255;
+	return reference_unorm8(value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055);
+}
+
+// Small floating-point formats without sign bit and a five bit exponent (11-bit, 10-bit and the magnitude of half-precision)
+static double reference_small_float(uint32_t value, uint32_t mantissa_bits)
+{
+	const uint32_t exponent = value >> mantissa_bits;
+	const uint32_t mantissa = value & ((1u << mantissa_bits) - 1);
+	if (exponent == 0)
+		return std::ldexp(static_cast<double>(mantissa), -14 - static_cast<int>(mantissa_bits));
+	if (exponent == 31)
+		return mantissa != 0 ? NAN : INFINITY;
+	return std::ldexp(static_cast<double>((1u << mantissa_bits) + mantissa), static_cast<int>(exponent) - 15 - static_cast<int>(mantissa_bits));
+}
+static double reference_half(uint16_t value)
+{
+	const double magnitude = reference_small_float(value & 0x7FFF, 10);
+	return (value & 0x8000) ? -magnitude : magnitude;
+}
+// Rounds to the nearest half-precision value, with ties to even
+static uint16_t reference_to_half(double value)
+{
+	uint16_t best = 0;
+	for (uint16_t candidate = 1; candidate < 0x7C00; ++candidate)
+	{
+		const double best_error = std::abs(reference_half(best) - value);
+		const double error = std::abs(reference_half(candidate) - value);
+		if (error < best_error || (error == best_error && (candidate & 1) == 0))
+			best = candidate;
+		if (reference_half(candidate) > value)
+			break;
+	}
+	return best;
+}
+
+template <typename T>
+static T read_value(const uint8_t *src, size_t index)
+{
+	T value;
+	std::memcpy(&value, src + index * sizeof(T), sizeof(T));
+	return value;
+}
+
+static void reference_to_rgba8(format format, const uint8_t *src, uint8_t dst[4])
+{
+	dst[0] = dst[1] = dst[2] = 0;
+	dst[3] = 255;
+
+	switch (format)
+	{
+	case format::r8_unorm:
+		dst[0] = src[0];
+		break;
+	case format::l8_unorm:
+		dst[0] = dst[1] = dst[2] = src[0];
+		break;
+	case format::a8_unorm:
+		dst[3] = src[0];
+		break;
+	case format::r8g8_unorm:
+		dst[0] = src[0];
+		dst[1] = src[1];
+		break;
+	case format::l8a8_unorm:
+		dst[0] = dst[1] = dst[2] = src[0];
+		dst[3] = src[1];
+		break;
+	case format::r8g8b8a8_unorm:
+	case format::r8g8b8x8_unorm:
+	case format::b8g8r8a8_unorm:
+	case format::b8g8r8x8_unorm:
+	{
+		const bool bgr = format == format::b8g8r8a8_unorm || format == format::b8g8r8x8_unorm;
+		dst[0] = src[bgr ? 2 : 0];
+		dst[1] = src[1];
+		dst[2] = src[bgr ? 0 : 2];
+		if (format == format::r8g8b8a8_unorm || format == format::b8g8r8a8_unorm)
+			dst[3] = src[3];
+		break;
+	}
+	case format::r10g10b10a2_unorm:
+	case format::b10g10r10a2_unorm:
+	{
+		const uint32_t value = read_value<uint32_t>(src, 0);
+		const bool bgr = format == format::b10g10r10a2_unorm;
+		dst[bgr ? 2 : 0] = reference_unorm(value & 0x3FF, 10);
+		dst[1] = reference_unorm((value >> 10) & 0x3FF, 10);
+		dst[bgr ? 0 : 2] = reference_unorm((value >> 20) & 0x3FF, 10);
+		dst[3] = reference_unorm(value >> 30, 2);
+		break;
+	}
+	case format::r16_unorm:
+	case format::r16g16_unorm:
+	case format::r16g16b16a16_unorm:
+	{
+		const uint32_t channels = format == format::r16_unorm ? 1 : format == format::r16g16_unorm ? 2 : 4;
+		for (uint32_t c = 0; c < channels; ++c)
+			dst[c] = reference_unorm(read_value<uint16_t>(src, c), 16);
+		break;
+	}
+	case format::l16_unorm:
+		dst[0] = dst[1] = dst[2] = reference_unorm(read_value<uint16_t>(src, 0), 16);
+		break;
+	case format::l16a16_unorm:
+		dst[0] = dst[1] = dst[2] = reference_unorm(read_value<uint16_t>(src, 0), 16);
+		dst[3] = reference_unorm(read_value<uint16_t>(src, 1), 16);
+		break;
+	case format::r16_float:
+	case format::r16g16_float:
+	case format::r16g16b16a16_float:
+	{
+		const uint32_t channels = format == format::r16_float ? 1 : format == format::r16g16_float ? 2 : 4;
+		for (uint32_t c = 0; c < std::min(channels, 3u); ++c)
+			dst[c] = reference_srgb8(reference_half(read_value<uint16_t>(src, c)));
+		if (channels == 4)
+			dst[3] = reference_unorm8(reference_half(read_value<uint16_t>(src, 3)));
+		break;
+	}
+	case format::r32_float:
+	case format::r32g32_float:
+	case format::r32g32b32_float:
+	case format::r32g32b32a32_float:
+	{
+		const uint32_t channels = format == format::r32_float ? 1 : format == format::r32g32_float ? 2 : format == format::r32g32b32_float ? 3 : 4;
+		for (uint32_t c = 0; c < std::min(channels, 3u); ++c)
+			dst[c] = reference_srgb8(read_value<float>(src, c));
+		if (channels == 4)
+			dst[3] = reference_unorm8(read_value<float>(src, 3));
+		break;
+	}
+	case format::r11g11b10_float:
+	{
+		const uint32_t value = read_value<uint32_t>(src, 0);
+		dst[0] = reference_srgb8(reference_small_float(value & 0x7FF, 6));
+		dst[1] = reference_srgb8(reference_small_float((value >> 11) & 0x7FF, 6));
+		dst[2] = reference_srgb8(reference_small_float(value >> 22, 5));
+		break;
+	}
+	case format::r9g9b9e5:
+	{
+		// Shared exponent with a bias of 15 and no implied leading one
+		const uint32_t value = read_value<uint32_t>(src, 0);
+		for (uint32_t c = 0; c < 3; ++c)
+			dst[c] = reference_srgb8(std::ldexp(static_cast<double>((value >> (9 * c)) & 0x1FF), static_cast<int>(value >> 27) - 15 - 9));
+		break;
+	}
+	case format::b5g6r5_unorm:
+	{
+		const uint32_t value = read_value<uint16_t>(src, 0);
+		dst[0] = reference_unorm(value >> 11, 5);
+		dst[1] = reference_unorm((value >> 5) & 0x3F, 6);
+		dst[2] = reference_unorm(value & 0x1F, 5);
+		break;
+	}
+	case format::b5g5r5a1_unorm:
+	case format::b5g5r5x1_unorm:
+	{
+		const uint32_t value = read_value<uint16_t>(src, 0);
+		dst[0] = reference_unorm((value >> 10) & 0x1F, 5);
+		dst[1] = reference_unorm((value >> 5) & 0x1F, 5);
+		dst[2] = reference_unorm(value & 0x1F, 5);
+		if (format == format::b5g5r5a1_unorm)
+			dst[3] = reference_unorm(value >> 15, 1);
+		break;
+	}
+	case format::b4g4r4a4_unorm:
+	{
+		const uint32_t value = read_value<uint16_t>(src, 0);
+		dst[0] = reference_unorm((value >> 8) & 0xF, 4);
+		dst[1] = reference_unorm((value >> 4) & 0xF, 4);
+		dst[2] = reference_unorm(value & 0xF, 4);
+		dst[3] = reference_unorm(value >> 12, 4);
+		break;
+	}
+	default:
+		assert(false);
+		break;
+	}
+}
+
+static void reference_from_rgba8(format format, const uint8_t src[4], uint8_t *dst)
+{
+	switch (format)
+	{
+	case format::r8_unorm:
+		dst[0] = src[0];
+		break;
+	case format::r8g8_unorm:
+		dst[0] = src[0];
+		dst[1] = src[1];
+		break;
+	case format::r8g8b8a8_unorm:
+		std::memcpy(dst, src, 4);
+		break;
+	case format::b8g8r8a8_unorm:
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		dst[3] = src[3];
+		break;
+	case format::r10g10b10a2_unorm:
+	case format::b10g10r10a2_unorm:
+	{
+		const bool bgr = format == format::b10g10r10a2_unorm;
+		const auto to_unorm = [](uint8_t value, uint32_t bits) { return static_cast<uint32_t>(std::lround(value * ((1u << bits) - 1) / 255.0)); };
+		const uint32_t value =
+			to_unorm(src[bgr ? 2 : 0], 10) | (to_unorm(src[1], 10) << 10) | (to_unorm(src[bgr ? 0 : 2], 10) << 20) | (to_unorm(src[3], 2) << 30);
+		std::memcpy(dst, &value, 4);
+		break;
+	}
+	case format::r16_unorm:
+	case format::r16g16_unorm:
+	case format::r16g16b16a16_unorm:
+	{
+		const uint32_t channels = format == format::r16_unorm ? 1 : format == format::r16g16_unorm ? 2 : 4;
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			const uint16_t value = static_cast<uint16_t>(src[c] * 65535 / 255);
+			std::memcpy(dst + c * 2, &value, 2);
+		}
+		break;
+	}
+	case format::r16_float:
+	case format::r16g16_float:
+	case format::r16g16b16a16_float:
+	{
+		const uint32_t channels = format == format::r16_float ? 1 : format == format::r16g16_float ? 2 : 4;
+		static const std::vector<uint16_t> table = []() {
+			std::vector<uint16_t> values(256);
+			for (uint32_t i = 0; i < 256; ++i)
+				values[i] = reference_to_half(i / 255.0);
+			return values;
+		}();
+
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			const uint16_t value = table[src[c]];
+			std::memcpy(dst + c * 2, &value, 2);
+		}
+		break;
+	}
+	case format::r32_float:
+	case format::r32g32_float:
+	case format::r32g32b32_float:
+	case format::r32g32b32a32_float:
+	{
+		const uint32_t channels = format == format::r32_float ? 1 : format == format::r32g32_float ? 2 : format == format::r32g32b32_float ? 3 : 4;
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			const float value = static_cast<float>(src[c] / 255.0);
+			std::memcpy(dst + c * 4, &value, 4);
+		}
+		break;
+	}
+	default:
+		assert(false);
+		break;
+	}
+}
+
+// Reads bits in the order the block compression specifications list them, one at a time starting at the least significant bit of the first byte
+struct reference_bit_reader
+{
+	uint32_t read(uint32_t num_bits)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < num_bits; ++i, ++position)
+			value |= ((block[position / 8] >> (position % 8)) & 1u) << i;
+		return value;
+	}
+
+	const uint8_t *block;
+	uint32_t position = 0;
+};
+
+static void reference_decode_bc1_color(const uint8_t *src, bool allow_transparent, uint8_t dst[16 * 4])
+{
+	const uint32_t color_0 = src[0] | (src[1] << 8);
+	const uint32_t color_1 = src[2] | (src[3] << 8);
+	const double rgb_0[3] = { (color_0 >> 11) * 255.0 / 31, ((color_0 >> 5) & 0x3F) * 255.0 / 63, (color_0 & 0x1F) * 255.0 / 31 };
+	const double rgb_1[3] = { (color_1 >> 11) * 255.0 / 31, ((color_1 >> 5) & 0x3F) * 255.0 / 63, (color_1 & 0x1F) * 255.0 / 31 };
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t index = (src[4 + i / 4] >> (2 * (i % 4))) & 0x3;
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			double value = 0.0;
+			if (index == 0)
+				value = rgb_0[c];
+			else if (index == 1)
+				value = rgb_1[c];
+			else if (color_0 > color_1 || !allow_transparent)
+				value = index == 2 ? (2 * rgb_0[c] + rgb_1[c]) / 3 : (rgb_0[c] + 2 * rgb_1[c]) / 3;
+			else
+				value = index == 2 ? (rgb_0[c] + rgb_1[c]) / 2 : 0.0;
+			dst[i * 4 + c] = static_cast<uint8_t>(std::lround(value));
+		}
+		dst[i * 4 + 3] = (color_0 <= color_1 && allow_transparent && index == 3) ? 0 : 255;
+	}
+}
+static void reference_decode_bc4_channel(const uint8_t *src, bool is_signed, uint8_t *dst, uint32_t dst_stride)
+{
+	// Signed endpoints are in the range [-127, 127], with -128 clamped to -127
+	const double value_0 = is_signed ? std::max(static_cast<int8_t>(src[0]), static_cast<int8_t>(-127)) / 127.0 : src[0] / 255.0;
+	const double value_1 = is_signed ? std::max(static_cast<int8_t>(src[1]), static_cast<int8_t>(-127)) / 127.0 : src[1] / 255.0;
+	const bool eight_values = is_signed ? static_cast<int8_t>(src[0]) > static_cast<int8_t>(src[1]) : src[0] > src[1];
+
+	reference_bit_reader bits = { src + 2 };
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t index = bits.read(3);
+
+		double value = 0.0;
+		if (index < 2)
+			value = index == 0 ? value_0 : value_1;
+		else if (eight_values)
+			value = ((8 - index) * value_0 + (index - 1) * value_1) / 7;
+		else if (index < 6)
+			value = ((6 - index) * value_0 + (index - 1) * value_1) / 5;
+		else
+			value = index == 6 ? (is_signed ? -1.0 : 0.0) : 1.0;
+
+		dst[i * dst_stride] = static_cast<uint8_t>(std::lround(is_signed ? (value + 1.0) * 127.5 : value * 255.0));
+	}
+}
+
+// See https://docs.microsoft.com/windows/win32/direct3d11/bc7-format-mode-reference
+static void reference_decode_bc7(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	struct mode_info { uint32_t subsets, partition_bits, rotation_bits, index_selection_bits, color_bits, alpha_bits, endpoint_pbits, shared_pbits, index_bits, index_bits2; };
+	static const mode_info modes[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 }, { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 }, { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 }, { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 }, { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 }, { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 }, { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+	};
+	static const uint32_t weights[5][16] = { {}, {}, { 0, 21, 43, 64 }, { 0, 9, 18, 27, 37, 46, 55, 64 }, { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 } };
+
+	reference_bit_reader bits = { src };
+	uint32_t mode_index = 0;
+	while (mode_index < 8 && bits.read(1) == 0)
+		++mode_index;
+	if (mode_index == 8)
+	{
+		std::memset(dst, 0, 16 * 4);
+		return;
+	}
+
+	const mode_info &mode = modes[mode_index];
+	const uint32_t partition = bits.read(mode.partition_bits);
+	const uint32_t rotation = bits.read(mode.rotation_bits);
+	const uint32_t index_selection = bits.read(mode.index_selection_bits);
+
+	// Endpoints are listed per channel, then per subset, then per endpoint
+	uint32_t endpoints[3][2][4] = {};
+	for (uint32_t c = 0; c < 4; ++c)
+		for (uint32_t s = 0; s < mode.subsets; ++s)
+			for (uint32_t e = 0; e < 2; ++e)
+				endpoints[s][e][c] = bits.read(c < 3 ? mode.color_bits : mode.alpha_bits);
+
+	uint32_t pbits[3][2] = {};
+	for (uint32_t s = 0; s < mode.subsets; ++s)
+		for (uint32_t e = 0; e < 2; ++e)
+			pbits[s][e] = mode.endpoint_pbits ? bits.read(1) : mode.shared_pbits ? (e == 0 ? bits.read(1) : pbits[s][0]) : 0;
+
+	for (uint32_t s = 0; s < mode.subsets; ++s)
+	{
+		for (uint32_t e = 0; e < 2; ++e)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t num_bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+				if (num_bits == 0)
+				{
+					endpoints[s][e][c] = 255;
+					continue;
+				}
+
+				uint32_t value = endpoints[s][e][c];
+				if (mode.endpoint_pbits || mode.shared_pbits)
+					value = (value << 1) | pbits[s][e], num_bits += 1;
+				// Unquantize by shifting into the high bits and replicating them into the low bits
+				value <<= 8 - num_bits;
+				endpoints[s][e][c] = value | (value >> num_bits);
+			}
+		}
+	}
+
+	const auto subset_of = [&](uint32_t i) -> uint32_t {
+		return mode.subsets == 1 ? 0 : mode.subsets == 2 ? (s_bc7_partitions2[partition] >> i) & 1 : s_bc7_partitions3[partition][i];
+	};
+	const auto is_anchor = [&](uint32_t i) {
+		return i == 0 ||
+			(mode.subsets == 2 && i == s_bc7_anchors2[partition]) ||
+			(mode.subsets == 3 && (i == s_bc7_anchors3[0][partition] || i == s_bc7_anchors3[1][partition]));
+	};
+
+	uint32_t indices[2][16] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+		indices[0][i] = bits.read(mode.index_bits - is_anchor(i));
+	for (uint32_t i = 0; i < 16 && mode.index_bits2 != 0; ++i)
+		indices[1][i] = bits.read(mode.index_bits2 - (i == 0));
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t s = subset_of(i);
+		const uint32_t color_weight = mode.index_bits2 != 0 && index_selection ? weights[mode.index_bits2][indices[1][i]] : weights[mode.index_bits][indices[0][i]];
+		const uint32_t alpha_weight = mode.index_bits2 != 0 && !index_selection ? weights[mode.index_bits2][indices[1][i]] : weights[mode.index_bits][indices[0][i]];
+
+		uint8_t pixel[4];
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			const uint32_t weight = c < 3 ? color_weight : alpha_weight;
+			pixel[c] = static_cast<uint8_t>((endpoints[s][0][c] * (64 - weight) + endpoints[s][1][c] * weight + 32) >> 6);
+		}
+		if (rotation != 0)
+			std::swap(pixel[3], pixel[rotation - 1]);
+
+		std::memcpy(dst + i * 4, pixel, 4);
+	}
+}
+
+// See https://docs.microsoft.com/windows/win32/direct3d11/bc6h-format
+// Header bits of each mode after the mode bits, as listed in the specification (endpoints 0 to 3 are w, x, y and z, first bit read goes to the right-hand bit of a range)
+static const char *const s_reference_bc6h_layouts[14] = {
+	"g2[4] b2[4] b3[4] r0[9:0] g0[9:0] b0[9:0] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]",
+	"g2[5] g3[4] g3[5] r0[6:0] b3[0] b3[1] b2[4] g0[6:0] b2[5] b3[2] g2[4] b0[6:0] b3[3] b3[5] b3[4] r1[5:0] g2[3:0] g1[5:0] g3[3:0] b1[5:0] b2[3:0] r2[5:0] r3[5:0] d[4:0]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[4:0] r0[10] g2[3:0] g1[3:0] g0[10] b3[0] g3[3:0] b1[3:0] b0[10] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10] g3[4] g2[3:0] g1[4:0] g0[10] g3[3:0] b1[3:0] b0[10] b3[1] b2[3:0] r2[3:0] b3[0] b3[2] r3[3:0] g2[4] b3[3] d[4:0]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10] b2[4] g2[3:0] g1[3:0] g0[10] b3[0] g3[3:0] b1[4:0] b0[10] b2[3:0] r2[3:0] b3[1] b3[2] r3[3:0] b3[4] b3[3] d[4:0]",
+	"r0[8:0] b2[4] g0[8:0] g2[4] b0[8:0] b3[4] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]",
+	"r0[7:0] g3[4] b2[4] g0[7:0] b3[2] g2[4] b0[7:0] b3[3] b3[4] r1[5:0] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[5:0] r3[5:0] d[4:0]",
+	"r0[7:0] b3[0] b2[4] g0[7:0] g2[5] g2[4] b0[7:0] g3[5] b3[4] r1[4:0] g3[4] g2[3:0] g1[5:0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]",
+	"r0[7:0] b3[1] b2[4] g0[7:0] b2[5] g2[4] b0[7:0] b3[5] b3[4] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[5:0] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]",
+	"r0[5:0] g3[4] b3[0] b3[1] b2[4] g0[5:0] g2[5] b2[5] b3[2] g2[4] b0[5:0] g3[5] b3[3] b3[5] b3[4] r1[5:0] g2[3:0] g1[5:0] g3[3:0] b1[5:0] b2[3:0] r2[5:0] r3[5:0] d[4:0]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[9:0] g1[9:0] b1[9:0]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[8:0] r0[10] g1[8:0] g0[10] b1[8:0] b0[10]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[7:0] r0[10:11] g1[7:0] g0[10:11] b1[7:0] b0[10:11]",
+	"r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10:15] g1[3:0] g0[10:15] b1[3:0] b0[10:15]",
+};
+
+static int32_t reference_bc6h_unquantize(int32_t value, uint32_t bits, bool is_signed)
+{
+	if (!is_signed)
+	{
+		if (bits >= 15)
+			return value;
+		if (value == 0)
+			return 0;
+		if (value == (1 << bits) - 1)
+			return 0xFFFF;
+		return ((value << 16) + 0x8000) >> bits;
+	}
+
+	if (bits >= 16)
+		return value;
+	const int32_t sign = value < 0 ? -1 : 1;
+	value *= sign;
+	if (value == 0)
+		return 0;
+	if (value >= (1 << (bits - 1)) - 1)
+		return sign * 0x7FFF;
+	return sign * (((value << 15) + 0x4000) >> (bits - 1));
+}
+
+static void reference_decode_bc6h(const uint8_t *src, bool is_signed, uint8_t dst[16 * 4])
+{
+	// Two-bit mode values are 0 and 1, five-bit mode values are listed in the order of the layouts above
+	static const uint32_t mode_values[14] = { 0x00, 0x01, 0x02, 0x06, 0x0A, 0x0E, 0x12, 0x16, 0x1A, 0x1E, 0x03, 0x07, 0x0B, 0x0F };
+
+	reference_bit_reader bits = { src };
+	uint32_t mode_value = bits.read(2);
+	if (mode_value > 1)
+		mode_value |= bits.read(3) << 2;
+
+	uint32_t mode_index = 0;
+	while (mode_index < 14 && mode_values[mode_index] != mode_value)
+		++mode_index;
+	if (mode_index == 14)
+	{
+		// Reserved modes decode to zero
+		for (uint32_t i = 0; i < 16; ++i)
+			dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = 0, dst[i * 4 + 3] = 255;
+		return;
+	}
+
+	// Parse the layout, which also gives the number of bits of each endpoint and delta
+	int32_t values[4][3] = {};
+	uint32_t value_bits[4][3] = {};
+	uint32_t partition = 0;
+	for (const char *token = s_reference_bc6h_layouts[mode_index]; *token != '\0';)
+	{
+		const char field = token[0];
+		const uint32_t endpoint = field == 'd' ? 0 : token[1] - '0';
+		const char *range = std::strchr(token, '[') + 1;
+		char *end = nullptr;
+		const uint32_t first = std::strtoul(range, &end, 10);
+		const uint32_t last = *end == ':' ? std::strtoul(end + 1, &end, 10) : first;
+
+		for (uint32_t bit = last; ; bit = first > last ? bit + 1 : bit - 1)
+		{
+			const uint32_t value = bits.read(1);
+			if (field == 'd')
+				partition |= value << bit;
+			else
+				values[endpoint][field == 'r' ? 0 : field == 'g' ? 1 : 2] |= value << bit,
+				value_bits[endpoint][field == 'r' ? 0 : field == 'g' ? 1 : 2] = std::max(value_bits[endpoint][field == 'r' ? 0 : field == 'g' ? 1 : 2], bit + 1);
+			if (bit == first)
+				break;
+		}
+
+		token = end + 1;
+		while (*token == ' ')
+			++token;
+	}
+
+	const uint32_t num_subsets = mode_index < 10 ? 2 : 1;
+	// Only the modes that store all endpoints at full precision do not store deltas to the first endpoint
+	const bool transformed = mode_index != 9 && mode_index != 10;
+
+	int32_t endpoints[4][3];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		const uint32_t endpoint_bits = value_bits[0][c];
+		const auto sign_extend = [](int32_t value, uint32_t num_bits) { return (value & (1 << (num_bits - 1))) ? value - (1 << num_bits) : value; };
+
+		endpoints[0][c] = is_signed ? sign_extend(values[0][c], endpoint_bits) : values[0][c];
+		for (uint32_t e = 1; e < num_subsets * 2; ++e)
+		{
+			if (transformed)
+			{
+				// Deltas are always signed and wrap around within the endpoint precision
+				int32_t value = (values[0][c] + sign_extend(values[e][c], value_bits[e][c])) & ((1 << endpoint_bits) - 1);
+				endpoints[e][c] = is_signed ? sign_extend(value, endpoint_bits) : value;
+			}
+			else
+			{
+				endpoints[e][c] = is_signed ? sign_extend(values[e][c], endpoint_bits) : values[e][c];
+			}
+		}
+
+		for (uint32_t e = 0; e < num_subsets * 2; ++e)
+			endpoints[e][c] = reference_bc6h_unquantize(endpoints[e][c], endpoint_bits, is_signed);
+	}
+
+	static const int32_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	static const int32_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t subset = num_subsets == 2 ? (s_bc7_partitions2[partition] >> i) & 1 : 0;
+		const bool anchor = i == 0 || (num_subsets == 2 && i == s_bc7_anchors2[partition]);
+		const uint32_t index = bits.read((num_subsets == 2 ? 3 : 4) - anchor);
+		const int32_t weight = num_subsets == 2 ? weights3[index] : weights4[index];
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			const int32_t value = (endpoints[subset * 2][c] * (64 - weight) + endpoints[subset * 2 + 1][c] * weight + 32) >> 6;
+
+			// Scale to the range of half-precision floating-point values and convert from two's complement to sign and magnitude
+			uint16_t half;
+			if (!is_signed)
+				half = static_cast<uint16_t>((value * 31) >> 6);
+			else
+				half = static_cast<uint16_t>(value < 0 ? 0x8000 | ((-value * 31) >> 5) : (value * 31) >> 5);
+
+			dst[i * 4 + c] = reference_srgb8(reference_half(half));
+		}
+		dst[i * 4 + 3] = 255;
+	}
+}
+
+static void reference_decode_block(format format, const uint8_t *src, uint8_t dst[16 * 4])
+{
+	switch (format)
+	{
+	case format::bc1_unorm:
+		reference_decode_bc1_color(src, true, dst);
+		break;
+	case format::bc2_unorm:
+		reference_decode_bc1_color(src + 8, false, dst);
+		for (uint32_t i = 0; i < 16; ++i)
+			dst[i * 4 + 3] = reference_unorm((src[i / 2] >> (4 * (i % 2))) & 0xF, 4);
+		break;
+	case format::bc3_unorm:
+		reference_decode_bc1_color(src + 8, false, dst);
+		reference_decode_bc4_channel(src, false, dst + 3, 4);
+		break;
+	case format::bc4_unorm:
+	case format::bc4_snorm:
+		reference_decode_bc4_channel(src, format == format::bc4_snorm, dst, 4);
+		for (uint32_t i = 0; i < 16; ++i)
+			dst[i * 4 + 1] = dst[i * 4 + 2] = dst[i * 4 + 0], dst[i * 4 + 3] = 255;
+		break;
+	case format::bc5_unorm:
+	case format::bc5_snorm:
+		reference_decode_bc4_channel(src + 0, format == format::bc5_snorm, dst + 0, 4);
+		reference_decode_bc4_channel(src + 8, format == format::bc5_snorm, dst + 1, 4);
+		for (uint32_t i = 0; i < 16; ++i)
+			dst[i * 4 + 2] = 0, dst[i * 4 + 3] = 255;
+		break;
+	case format::bc6h_ufloat:
+	case format::bc6h_sfloat:
+		reference_decode_bc6h(src, format == format::bc6h_sfloat, dst);
+		break;
+	case format::bc7_unorm:
+		reference_decode_bc7(src, dst);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
+// Converts a whole image one pixel or block at a time with the reference code
+static void reference_convert_to_rgba8(format format, uint32_t width, uint32_t height, const uint8_t *src, uint32_t src_row_pitch, uint8_t *dst, uint32_t dst_row_pitch)
+{
+	if (is_block_compressed(format))
+	{
+		const uint32_t block_size = format_row_pitch(format, 1);
+		for (uint32_t block_y = 0; block_y < height; block_y += 4)
+		{
+			for (uint32_t block_x = 0; block_x < width; block_x += 4)
+			{
+				uint8_t pixels[16 * 4];
+				reference_decode_block(format, src + (block_y / 4) * src_row_pitch + (block_x / 4) * block_size, pixels);
+
+				for (uint32_t y = block_y; y < std::min(block_y + 4, height); ++y)
+					for (uint32_t x = block_x; x < std::min(block_x + 4, width); ++x)
+						std::memcpy(dst + y * dst_row_pitch + x * 4, pixels + ((y - block_y) * 4 + (x - block_x)) * 4, 4);
+			}
+		}
+	}
+	else
+	{
+		const uint32_t pixel_size = format_row_pitch(format, 1);
+		for (uint32_t y = 0; y < height; ++y)
+			for (uint32_t x = 0; x < width; ++x)
+				reference_to_rgba8(format, src + y * src_row_pitch + x * pixel_size, dst + y * dst_row_pitch + x * 4);
+	}
+}
+
+#pragma endregion
+
+// Random source data, with a mix of values in the displayable range and arbitrary bit patterns (infinity, NaN, denormals, negative) for floating-point formats
+static void fill_source(format format, std::vector<uint8_t> &data, std::mt19937 &random)
+{
+	for (uint8_t &value : data)
+		value = static_cast<uint8_t>(random());
+
+	if (format == format::r32_float || format == format::r32g32_float || format == format::r32g32b32_float || format == format::r32g32b32a32_float)
+	{
+		std::uniform_real_distribution<float> distribution(-0.1f, 1.1f);
+		for (size_t i = 0; i + 4 <= data.size(); i += 4)
+		{
+			if (random() % 4 == 0)
+				continue;
+			const float value = distribution(random);
+			std::memcpy(data.data() + i, &value, 4);
+		}
+	}
+
+	if (format == format::bc6h_ufloat || format == format::bc6h_sfloat || format == format::bc7_unorm)
+	{
+		// Random bits mostly select the first few modes, so give every mode (and the reserved ones) the same share of blocks
+		static const uint8_t bc6h_modes[] = { 0x00, 0x01, 0x02, 0x06, 0x0A, 0x0E, 0x12, 0x16, 0x1A, 0x1E, 0x03, 0x07, 0x0B, 0x0F, 0x13 };
+		for (size_t i = 0, block = 0; i + 16 <= data.size(); i += 16, ++block)
+		{
+			if (format == format::bc7_unorm)
+			{
+				const uint32_t mode = block % 9;
+				data[i] = mode == 8 ? 0 : static_cast<uint8_t>((data[i] & ~((2u << mode) - 1)) | (1u << mode));
+			}
+			else
+			{
+				const uint8_t mode = bc6h_modes[block % std::size(bc6h_modes)];
+				data[i] = static_cast<uint8_t>((data[i] & (mode < 2 ? ~0x3u : ~0x1Fu)) | mode);
+			}
+		}
+	}
+}
+
+// Compares conversion of random data against the reference, with row pitches that leave the rows unaligned and padding after them that has to stay untouched
+static void test_to_rgba8(const format_info &info, uint32_t width, uint32_t height, std::mt19937 &random)
+{
+	const uint32_t src_row_pitch = format_row_pitch(info.format, width) + 13;
+	const uint32_t dst_row_pitch = width * 4 + 12;
+	const uint32_t src_rows = is_block_compressed(info.format) ? (height + 3) / 4 : height;
+
+	std::vector<uint8_t> src(static_cast<size_t>(src_row_pitch) * src_rows + 1);
+	fill_source(info.format, src, random);
+
+	std::vector<uint8_t> actual(static_cast<size_t>(dst_row_pitch) * height, 0xCD), expected(actual);
+	CHECK(reshade::is_convertible_to_rgba8(info.format));
+	CHECK(reshade::convert_to_rgba8(info.format, width, height, src.data() + 1, src_row_pitch, actual.data(), dst_row_pitch));
+	reference_convert_to_rgba8(info.format, width, height, src.data() + 1, src_row_pitch, expected.data(), dst_row_pitch);
+
+	int max_difference = 0;
+	for (size_t i = 0; i < actual.size(); ++i)
+		max_difference = std::max(max_difference, std::abs(actual[i] - expected[i]));
+	if (max_difference > info.tolerance)
+	{
+		std::fprintf(stderr, "%s %ux%u: differs from reference by %d\n", info.name, width, height, max_difference);
+		s_failures++;
+	}
+}
+
+// Compares conversion from RGBA8 against the reference, and checks that converting back gives the original pixels for formats with at least eight bits per channel
+static void test_from_rgba8(const format_info &info, uint32_t width, uint32_t height, std::mt19937 &random)
+{
+	const uint32_t pixel_size = format_row_pitch(info.format, 1);
+	const uint32_t src_row_pitch = width * 4 + 4;
+	const uint32_t dst_row_pitch = width * pixel_size + 13;
+
+	std::vector<uint8_t> src(static_cast<size_t>(src_row_pitch) * height + 1);
+	fill_source(format::r8g8b8a8_unorm, src, random);
+
+	std::vector<uint8_t> actual(static_cast<size_t>(dst_row_pitch) * height + 1, 0xCD), expected(actual);
+	CHECK(reshade::is_convertible_from_rgba8(info.format));
+	CHECK(reshade::convert_from_rgba8(info.format, width, height, src.data() + 1, src_row_pitch, actual.data() + 1, dst_row_pitch));
+	for (uint32_t y = 0; y < height; ++y)
+		for (uint32_t x = 0; x < width; ++x)
+			reference_from_rgba8(info.format, src.data() + 1 + y * src_row_pitch + x * 4, expected.data() + 1 + y * dst_row_pitch + x * pixel_size);
+
+	if (actual != expected)
+	{
+		std::fprintf(stderr, "%s %ux%u: differs from reference\n", info.name, width, height);
+		s_failures++;
+	}
+
+	if (is_floating_point(info.format))
+		return; // Converting back sRGB encodes, so does not give the original values
+
+	std::vector<uint8_t> round_trip(static_cast<size_t>(width) * height * 4);
+	CHECK(reshade::convert_to_rgba8(info.format, width, height, actual.data() + 1, dst_row_pitch, round_trip.data()));
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t original[4];
+			std::memcpy(original, src.data() + 1 + y * src_row_pitch + x * 4, 4);
+			if (info.format == format::r10g10b10a2_unorm || info.format == format::b10g10r10a2_unorm)
+				original[3] = reference_unorm(static_cast<uint32_t>(std::lround(original[3] * 3 / 255.0)), 2); // Alpha only has two bits
+			const uint32_t channels = info.format == format::r8_unorm || info.format == format::r16_unorm ? 1 : info.format == format::r8g8_unorm || info.format == format::r16g16_unorm ? 2 : 4;
+			for (uint32_t c = 0; c < channels; ++c)
+				CHECK(round_trip[(y * width + x) * 4 + c] == original[c]);
+		}
+	}
+}
+
+template <typename F>
+static double measure(F &&function, uint32_t iterations)
+{
+	function(); // Warm up caches and lookup tables
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i)
+		function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() / iterations;
+}
+
+static void bench_formats()
+{
+	constexpr uint32_t width = 3840, height = 2160;
+	constexpr double megapixels = width * height / 1000000.0;
+	std::mt19937 random(42);
+
+	std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+	fill_source(format::r8g8b8a8_unorm, rgba, random);
+
+	std::printf("%ux%u to RGBA8:\n", width, height);
+	for (const format_info &info : s_to_rgba8_formats)
+	{
+		const uint32_t row_pitch = format_row_pitch(info.format, width);
+		std::vector<uint8_t> src(static_cast<size_t>(row_pitch) * (is_block_compressed(info.format) ? height / 4 : height));
+		fill_source(info.format, src, random);
+
+		const double library_time = measure([&]() { reshade::convert_to_rgba8(info.format, width, height, src.data(), row_pitch, rgba.data()); }, 4);
+		const double reference_time = measure([&]() { reference_convert_to_rgba8(info.format, width, height, src.data(), row_pitch, rgba.data(), width * 4); }, 1);
+		std::printf("  %-10s %7.2f ms (%6.0f MP/s), reference %8.2f ms, %5.1fx faster\n", info.name, library_time, megapixels / (library_time / 1000.0), reference_time, reference_time / library_time);
+	}
+
+	std::printf("%ux%u from RGBA8:\n", width, height);
+	for (const format_info &info : s_from_rgba8_formats)
+	{
+		const uint32_t row_pitch = format_row_pitch(info.format, width);
+		std::vector<uint8_t> dst(static_cast<size_t>(row_pitch) * height);
+
+		const double library_time = measure([&]() { reshade::convert_from_rgba8(info.format, width, height, rgba.data(), 0, dst.data(), row_pitch); }, 4);
+		std::printf("  %-10s %7.2f ms (%6.0f MP/s)\n", info.name, library_time, megapixels / (library_time / 1000.0));
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+
+	// Widths around the 4, 8 and 16 pixel steps of the vectorized rows, and heights that are not a multiple of the block size
+	for (const format_info &info : s_to_rgba8_formats)
+	{
+		for (uint32_t width = 1; width <= 40; ++width)
+			test_to_rgba8(info, width, 7, random);
+		test_to_rgba8(info, 1021, 67, random);
+	}
+
+	// Every half-precision value, including infinity, NaN and denormals
+	{
+		std::vector<uint8_t> src(65536 * 2);
+		for (uint32_t i = 0; i < 65536; ++i)
+			std::memcpy(src.data() + i * 2, &i, 2);
+
+		std::vector<uint8_t> actual(65536 * 4), expected(65536 * 4);
+		CHECK(reshade::convert_to_rgba8(format::r16_float, 65536, 1, src.data(), 65536 * 2, actual.data()));
+		reference_convert_to_rgba8(format::r16_float, 65536, 1, src.data(), 65536 * 2, expected.data(), 65536 * 4);
+		for (size_t i = 0; i < actual.size(); ++i)
+			CHECK(std::abs(actual[i] - expected[i]) <= 1);
+		CHECK(reshade::convert_to_rgba8(format::r16g16b16a16_float, 16384, 1, src.data(), 65536 * 2, actual.data()));
+		reference_convert_to_rgba8(format::r16g16b16a16_float, 16384, 1, src.data(), 65536 * 2, expected.data(), 16384 * 4);
+		for (size_t i = 0; i < 16384 * 4; ++i)
+			CHECK(std::abs(actual[i] - expected[i]) <= 1);
+	}
+
+	for (const format_info &info : s_from_rgba8_formats)
+	{
+		for (uint32_t width = 1; width <= 40; ++width)
+			test_from_rgba8(info, width, 3, random);
+		test_from_rgba8(info, 1021, 17, random);
+	}
+
+	CHECK(!reshade::is_convertible_to_rgba8(format::d24_unorm_s8_uint));
+	CHECK(!reshade::is_convertible_from_rgba8(format::bc1_unorm));
+	CHECK(!reshade::convert_to_rgba8(format::unknown, 1, 1, nullptr, 0, nullptr));
+
+	bench_formats();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All format conversion tests passed");
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/frame_capture.hpp"
+#include "../source/image_encoder.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Headless test of the frame capture queue and stream encoders
+// This does not need a graphics device, so it can run on any platform (e.g. "g++ -std=c++17 -O2 -pthread frame_capture_test.cpp ../source/frame_capture.cpp -o frame_capture_test")
+// The PNG encoder is replaced with a stub below, so that the test does not depend on the image libraries
+
+void reshade::strip_alpha_channel(uint8_t *pixels, size_t num_pixels)
+{
+	for (size_t i = 0; i < num_pixels; ++i)
+		std::memmove(pixels + i * 3, pixels + i * 4, 3);
+}
+bool reshade::encode_png(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t comp, std::vector<uint8_t> &encoded_data, unsigned int)
+{
+	encoded_data.assign(pixels, pixels + static_cast<size_t>(width) * height * comp);
+	return true;
+}
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static std::vector<uint8_t> read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::vector<uint8_t> make_frame(uint32_t width, uint32_t height, uint8_t value)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < pixels.size(); i += 4)
+		pixels[i + 0] = pixels[i + 1] = pixels[i + 2] = value, pixels[i + 3] = 255;
+	return pixels;
+}
+
+static void test_stream_order(const std::filesystem::path &directory)
+{
+	constexpr uint32_t width = 64, height = 32, num_frames = 200;
+
+	// Many encoder threads and a small queue, so that frames finish encoding out of order
+	reshade::frame_capture capture;
+	CHECK(capture.start(directory / "order.rgba", reshade::frame_capture::output_format::raw, width, height, 60, 4, 8, true));
+	for (uint32_t i = 0; i < num_frames; ++i)
+		CHECK(capture.submit_frame(capture.session(), make_frame(width, height, static_cast<uint8_t>(i))));
+	capture.stop();
+
+	const reshade::frame_capture::statistics stats = capture.get_statistics();
+	CHECK(stats.frames_written == num_frames && stats.frames_dropped == 0);
+
+	const std::vector<uint8_t> data = read_file(directory / "order.rgba");
+	CHECK(data.size() == static_cast<size_t>(num_frames) * width * height * 4);
+	for (uint32_t i = 0; i < num_frames && (i + 1) * width * height * 4 <= data.size(); ++i)
+		CHECK(data[static_cast<size_t>(i) * width * height * 4] == static_cast<uint8_t>(i));
+}
+
+static void test_y4m(const std::filesystem::path &directory)
+{
+	constexpr uint32_t width = 16, height = 8;
+
+	reshade::frame_capture capture;
+	CHECK(capture.start(directory / "test.y4m", reshade::frame_capture::output_format::y4m, width, height, 30, 8, 2, true));
+	CHECK(capture.submit_frame(capture.session(), make_frame(width, height, 0)));
+	CHECK(capture.submit_frame(capture.session(), make_frame(width, height, 255)));
+	capture.stop();
+
+	const std::vector<uint8_t> data = read_file(directory / "test.y4m");
+	const std::string header = "YUV4MPEG2 W16 H8 F30:1 Ip A1:1 C444 XCOLORRANGE=LIMITED\n";
+	const size_t frame_size = 6 + width * height * 3;
+	CHECK(data.size() == header.size() + 2 * frame_size);
+	if (data.size() != header.size() + 2 * frame_size)
+		return;
+
+	CHECK(std::memcmp(data.data(), header.data(), header.size()) == 0);
+	CHECK(std::memcmp(data.data() + header.size(), "FRAME\n", 6) == 0);
+	// Black and white map to the limits of the limited range, with neutral chroma
+	const uint8_t *const black = data.data() + header.size() + 6;
+	const uint8_t *const white = black + frame_size;
+	CHECK(black[0] == 16 && black[width * height] == 128 && black[2 * width * height] == 128);
+	CHECK(white[0] == 235 && white[width * height] == 128 && white[2 * width * height] == 128);
+}
+
+static void test_drop_when_full(const std::filesystem::path &directory)
+{
+	constexpr uint32_t width = 256, height = 256, num_frames = 100;
+
+	reshade::frame_capture capture;
+	CHECK(capture.start(directory / "drop.rgba", reshade::frame_capture::output_format::raw, width, height, 60, 1, 1, false));
+	for (uint32_t i = 0; i < num_frames; ++i)
+		capture.submit_frame(capture.session(), make_frame(width, height, static_cast<uint8_t>(i)));
+	capture.skip_frame(capture.session());
+	capture.stop();
+
+	const reshade::frame_capture::statistics stats = capture.get_statistics();
+	CHECK(stats.frames_submitted == num_frames + 1);
+	CHECK(stats.frames_written + stats.frames_dropped == stats.frames_submitted);
+	CHECK(read_file(directory / "drop.rgba").size() == stats.frames_written * width * height * 4);
+}
+
+static void test_png_sequence(const std::filesystem::path &directory)
+{
+	constexpr uint32_t width = 4, height = 4;
+
+	reshade::frame_capture capture;
+	CHECK(capture.start(directory / "frame", reshade::frame_capture::output_format::png_sequence, width, height, 60, 4, 2, true));
+	for (uint32_t i = 0; i < 3; ++i)
+		CHECK(capture.submit_frame(capture.session(), make_frame(width, height, static_cast<uint8_t>(i))));
+	capture.stop();
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame %06u.png", i);
+		const std::vector<uint8_t> data = read_file(directory / name);
+		CHECK(data.size() == width * height * 3 && data[0] == i);
+	}
+}
+
+static void test_stale_session(const std::filesystem::path &directory)
+{
+	constexpr uint32_t width = 8, height = 8;
+
+	reshade::frame_capture capture;
+	CHECK(capture.start(directory / "first.rgba", reshade::frame_capture::output_format::raw, width, height, 60, 4, 1, true));
+	const uint64_t first_session = capture.session();
+	capture.stop();
+
+	// Readbacks requested during the first session may still complete after the second one started
+	CHECK(capture.start(directory / "second.rgba", reshade::frame_capture::output_format::raw, width, height, 60, 4, 1, true));
+	CHECK(capture.session() != first_session);
+	CHECK(!capture.submit_frame(first_session, make_frame(width, height, 1)));
+	capture.skip_frame(first_session);
+	CHECK(capture.submit_frame(capture.session(), make_frame(width, height, 2)));
+	capture.stop();
+
+	const reshade::frame_capture::statistics stats = capture.get_statistics();
+	CHECK(stats.frames_submitted == 1 && stats.frames_written == 1 && stats.frames_dropped == 0);
+	const std::vector<uint8_t> data = read_file(directory / "second.rgba");
+	CHECK(data.size() == width * height * 4 && data[0] == 2);
+}
+
+int main()
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "reshade_frame_capture_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	test_stream_order(directory);
+	test_y4m(directory);
+	test_drop_when_full(directory);
+	test_png_sequence(directory);
+	test_stale_session(directory);
+
+	std::filesystem::remove_all(directory);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All frame capture tests passed");
+	return 0;
+}
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <cstddef>
+#include <cstdint>
+#define __declspec(x)
+
+#include "../examples/07-generic_depth/state_tracking.hpp"
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Benchmark of the depth-stencil statistics of the generic depth add-on, replaying synthetic streams of draws, binds, executes, destroys and presents
+// This replays them through the state tracking of the add-on (see 'examples/07-generic_depth/state_tracking.hpp') and through a copy of the previous version, with the same locking as their event callbacks, and checks that both produce the same depth-stencil list every frame (e.g. "g++ -std=c++17 -O2 -fpermissive -w -I../include generic_depth_replay_bench.cpp -o generic_depth_replay_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::api::resource;
+using reshade::api::viewport;
+
+// Previous version, which looked up a hash map on every draw call and scanned a list of destroyed resources per depth-stencil at present
+namespace old_impl
+{
+static std::shared_mutex s_mutex;
+
+struct draw_stats
+{
+	uint32_t vertices = 0;
+	uint32_t drawcalls = 0;
+	uint32_t drawcalls_indirect = 0;
+	viewport last_viewport = {};
+};
+struct clear_stats : public draw_stats
+{
+	bool rect = false;
+};
+struct depth_stencil_info
+{
+	draw_stats total_stats;
+	draw_stats current_stats; // Stats since last clear operation
+	std::vector<clear_stats> clears;
+	bool copied_during_frame = false;
+};
+struct depth_stencil_hash
+{
+	inline size_t operator()(resource value) const
+	{
+		// Simply use the handle (which is usually a pointer) as hash value (with some bits shaved off due to pointer alignment)
+		return static_cast<size_t>(value.handle >> 4);
+	}
+};
+struct state_tracking
+{
+	draw_stats best_copy_stats;
+	bool first_empty_stats = true;
+	viewport current_viewport = {};
+	resource current_depth_stencil = { 0 };
+	std::unordered_map<resource, depth_stencil_info, depth_stencil_hash> counters_per_used_depth_stencil;
+
+	state_tracking()
+	{
+		// Reserve some space upfront to avoid rehashing during command recording
+		counters_per_used_depth_stencil.reserve(32);
+	}
+
+	void reset()
+	{
+		reset_on_present();
+		current_depth_stencil = { 0 };
+	}
+	void reset_on_present()
+	{
+		best_copy_stats = { 0, 0 };
+		first_empty_stats = true;
+		counters_per_used_depth_stencil.clear();
+	}
+
+	void merge(const state_tracking &source)
+	{
+		// Executing a command list in a different command list inherits state
+		current_depth_stencil = source.current_depth_stencil;
+
+		if (first_empty_stats)
+			first_empty_stats = source.first_empty_stats;
+
+		if (source.best_copy_stats.vertices > best_copy_stats.vertices)
+			best_copy_stats = source.best_copy_stats;
+
+		if (source.counters_per_used_depth_stencil.empty())
+			return;
+
+		counters_per_used_depth_stencil.reserve(source.counters_per_used_depth_stencil.size());
+		for (const auto &[depth_stencil_handle, snapshot] : source.counters_per_used_depth_stencil)
+		{
+			depth_stencil_info &target_snapshot = counters_per_used_depth_stencil[depth_stencil_handle];
+			target_snapshot.total_stats.vertices += snapshot.total_stats.vertices;
+			target_snapshot.total_stats.drawcalls += snapshot.total_stats.drawcalls;
+			target_snapshot.total_stats.drawcalls_indirect += snapshot.total_stats.drawcalls_indirect;
+			target_snapshot.current_stats.vertices += snapshot.current_stats.vertices;
+			target_snapshot.current_stats.drawcalls += snapshot.current_stats.drawcalls;
+			target_snapshot.current_stats.drawcalls_indirect += snapshot.current_stats.drawcalls_indirect;
+
+			target_snapshot.clears.insert(target_snapshot.clears.end(), snapshot.clears.begin(), snapshot.clears.end());
+
+			target_snapshot.copied_during_frame |= snapshot.copied_during_frame;
+		}
+	}
+};
+
+struct state_tracking_context
+{
+	std::vector<resource> destroyed_resources;
+	std::vector<std::pair<resource, depth_stencil_info>> current_depth_stencil_list;
+};
+
+static void on_draw(state_tracking &state, uint32_t vertices, uint32_t instances)
+{
+	if (state.current_depth_stencil == 0)
+		return;
+
+	depth_stencil_info &counters = state.counters_per_used_depth_stencil[state.current_depth_stencil];
+	counters.total_stats.vertices += vertices * instances;
+	counters.total_stats.drawcalls += 1;
+	counters.current_stats.vertices += vertices * instances;
+	counters.current_stats.drawcalls += 1;
+	counters.current_stats.last_viewport = state.current_viewport;
+}
+static void on_bind_depth_stencil(state_tracking &state, resource depth_stencil)
+{
+	state.current_depth_stencil = depth_stencil;
+}
+static void on_destroy_resource(state_tracking_context &device_state, resource resource)
+{
+	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+	device_state.destroyed_resources.push_back(resource);
+}
+static void on_present(state_tracking &queue_state, state_tracking_context &device_state)
+{
+	if (queue_state.counters_per_used_depth_stencil.empty())
+		return;
+	if (queue_state.counters_per_used_depth_stencil.size() == 1 && queue_state.counters_per_used_depth_stencil.begin()->second.total_stats.drawcalls <= 4)
+		return;
+
+	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+	device_state.current_depth_stencil_list.clear();
+	device_state.current_depth_stencil_list.reserve(queue_state.counters_per_used_depth_stencil.size());
+
+	for (const auto &[resource, snapshot] : queue_state.counters_per_used_depth_stencil)
+	{
+		if (snapshot.total_stats.drawcalls == 0)
+			continue;
+		if (std::find(device_state.destroyed_resources.begin(), device_state.destroyed_resources.end(), resource) != device_state.destroyed_resources.end())
+			continue;
+
+		device_state.current_depth_stencil_list.emplace_back(resource, snapshot);
+	}
+
+	queue_state.reset_on_present();
+	device_state.destroyed_resources.clear();
+}
+}
+
+// Current version, with the same locking as 'on_draw', 'on_bind_depth_stencil', 'on_destroy_resource' and 'on_present' in the add-on
+namespace new_impl
+{
+static std::shared_mutex s_mutex;
+
+using ::state_tracking;
+
+struct state_tracking_context
+{
+	resource_set destroyed_resources;
+	std::shared_mutex destroyed_resources_mutex;
+	std::vector<std::pair<resource, depth_stencil_info>> current_depth_stencil_list;
+};
+
+static void on_draw(state_tracking &state, uint32_t vertices, uint32_t instances)
+{
+	if (state.current_depth_stencil == 0)
+		return;
+
+	state.record_draw(vertices * instances);
+}
+static void on_bind_depth_stencil(state_tracking &state, resource depth_stencil)
+{
+	state.bind_depth_stencil(depth_stencil);
+}
+static void on_destroy_resource(state_tracking_context &device_state, resource resource)
+{
+	const std::unique_lock<std::shared_mutex> lock(device_state.destroyed_resources_mutex);
+
+	device_state.destroyed_resources.insert(resource);
+}
+static void on_present(state_tracking &queue_state, state_tracking_context &device_state)
+{
+	if (!queue_state.compact_for_present())
+		return;
+
+	{
+		const std::unique_lock<std::shared_mutex> lock(device_state.destroyed_resources_mutex);
+
+		queue_state.remove_unused_and_destroyed(device_state.destroyed_resources);
+
+		device_state.destroyed_resources.clear();
+	}
+
+	{
+		const std::unique_lock<std::shared_mutex> lock(s_mutex);
+
+		device_state.current_depth_stencil_list.swap(queue_state.counters_per_used_depth_stencil);
+	}
+
+	queue_state.reset_on_present();
+}
+}
+
+enum class event_type : uint8_t
+{
+	draw,
+	bind_depth_stencil,
+	bind_viewport,
+	execute,
+	reset,
+	destroy_resource,
+	present,
+};
+
+struct event
+{
+	event_type type;
+	uint32_t cmd_list;
+	uint64_t value;
+};
+
+// Vertex count, draw calls and draw calls since the last clear of every depth-stencil in the list at the end of a frame
+using frame_result = std::vector<std::tuple<uint64_t, uint32_t, uint32_t, uint32_t>>;
+
+template <typename state_tracking, typename state_tracking_context, typename D, typename B, typename X, typename P>
+static double replay(const std::vector<event> &events, size_t num_cmd_lists, std::vector<frame_result> &results, D on_draw, B on_bind_depth_stencil, X on_destroy_resource, P on_present)
+{
+	// The last state is that of the queue, which also records draw calls like an immediate context
+	std::vector<state_tracking> states(num_cmd_lists + 1);
+	state_tracking_context device_state;
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	for (const event &e : events)
+	{
+		state_tracking &state = states[e.cmd_list];
+
+		switch (e.type)
+		{
+		case event_type::draw:
+			on_draw(state, static_cast<uint32_t>(e.value), 1);
+			break;
+		case event_type::bind_depth_stencil:
+			on_bind_depth_stencil(state, resource { e.value });
+			break;
+		case event_type::bind_viewport:
+			state.current_viewport = { 0, 0, static_cast<float>(e.value), static_cast<float>(e.value) / 2, 0, 1 };
+			break;
+		case event_type::execute:
+			states[num_cmd_lists].merge(states[e.value]);
+			break;
+		case event_type::reset:
+			state.reset();
+			break;
+		case event_type::destroy_resource:
+			on_destroy_resource(device_state, resource { e.value });
+			break;
+		case event_type::present:
+			on_present(states[num_cmd_lists], device_state);
+
+			frame_result &result = results.emplace_back();
+			for (const auto &[depth_stencil, snapshot] : device_state.current_depth_stencil_list)
+				result.emplace_back(depth_stencil.handle, snapshot.total_stats.vertices, snapshot.total_stats.drawcalls, snapshot.current_stats.drawcalls);
+			std::sort(result.begin(), result.end());
+			break;
+		}
+	}
+
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+static void bench_replay(size_t num_frames, size_t num_cmd_lists, size_t draws_per_cmd_list, size_t destroys_per_frame)
+{
+	constexpr size_t num_depth_stencils = 12;
+
+	std::mt19937_64 rng(42);
+	std::vector<uint64_t> depth_stencils(num_depth_stencils);
+	for (uint64_t &depth_stencil : depth_stencils)
+		depth_stencil = 0x10000000 + (rng() % 0x100000) * 0x40;
+
+	std::vector<event> events;
+	size_t num_draws = 0, num_destroys = 0;
+	for (size_t frame = 0; frame < num_frames; ++frame)
+	{
+		for (uint32_t cmd_list = 0; cmd_list < num_cmd_lists; ++cmd_list)
+		{
+			events.push_back({ event_type::reset, cmd_list, 0 });
+
+			for (size_t draw = 0; draw < draws_per_cmd_list; ++draw)
+			{
+				// Switch depth-stencil every couple hundred draw calls, with a bias towards the first few
+				if (draw % 250 == 0)
+					events.push_back({ event_type::bind_depth_stencil, cmd_list, depth_stencils[std::min(rng() % num_depth_stencils, rng() % num_depth_stencils)] });
+				if (draw % 50 == 0)
+					events.push_back({ event_type::bind_viewport, cmd_list, uint64_t(1920) >> (rng() % 3) });
+
+				events.push_back({ event_type::draw, cmd_list, 3 + rng() % 3000 });
+				num_draws++;
+
+				// Streamed resources are destroyed in between
+				if (num_destroys * draws_per_cmd_list * num_cmd_lists < destroys_per_frame * num_draws)
+				{
+					events.push_back({ event_type::destroy_resource, cmd_list, 0x20000000 + (rng() % 0x1000000) * 0x40 });
+					num_destroys++;
+				}
+			}
+
+			events.push_back({ event_type::execute, cmd_list, cmd_list });
+		}
+
+		// Draw on the queue after executing the command lists, like an immediate context in D3D11 does
+		const uint32_t queue = static_cast<uint32_t>(num_cmd_lists);
+		events.push_back({ event_type::bind_depth_stencil, queue, depth_stencils[0] });
+		for (int draw = 0; draw < 100; ++draw)
+			events.push_back({ event_type::draw, queue, 6 });
+
+		// Occasionally the application recreates a depth-stencil
+		if (frame % 50 == 49)
+			events.push_back({ event_type::destroy_resource, queue, depth_stencils[frame % num_depth_stencils] });
+
+		events.push_back({ event_type::present, queue, 0 });
+	}
+
+	std::vector<frame_result> old_results, new_results;
+	double old_time = 1e9, new_time = 1e9;
+	for (int run = 0; run < 3; ++run)
+	{
+		old_results.clear();
+		new_results.clear();
+		old_time = std::min(old_time, replay<old_impl::state_tracking, old_impl::state_tracking_context>(events, num_cmd_lists, old_results, old_impl::on_draw, old_impl::on_bind_depth_stencil, old_impl::on_destroy_resource, old_impl::on_present));
+		new_time = std::min(new_time, replay<new_impl::state_tracking, new_impl::state_tracking_context>(events, num_cmd_lists, new_results, new_impl::on_draw, new_impl::on_bind_depth_stencil, new_impl::on_destroy_resource, new_impl::on_present));
+	}
+
+	CHECK(old_results.size() == num_frames);
+	CHECK(old_results == new_results);
+
+	std::printf("%4zu command lists with %4zu draws, %5zu destroys per frame: previous %6.1f ms, current %6.1f ms (%.2fx)\n", num_cmd_lists, draws_per_cmd_list, destroys_per_frame, old_time, new_time, old_time / new_time);
+}
+
+int main()
+{
+	bench_replay(200, 64, 2000, 2000);
+	bench_replay(200, 64, 2000, 0);
+	bench_replay(200, 64, 2000, 20000);
+	bench_replay(200, 2048, 64, 2000);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All generic depth replay tests passed");
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/hash_utils.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Test and benchmark of the stable hash used for texture cache file names
+// Checks against the XXH64 reference values, so that cache keys written by one build are still found by another (e.g. "g++ -std=c++17 -O2 hash_utils_test.cpp -o hash_utils_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static uint64_t hash_string(const std::string &value, uint64_t seed = 0)
+{
+	return reshade::compute_hash64(value.data(), value.size(), seed);
+}
+
+int main()
+{
+	// Reference values from the XXH64 specification test vectors
+	CHECK(hash_string("") == 0xEF46DB3751D8E999ull);
+	CHECK(hash_string("a") == 0xD24EC4F1A98C6E5Bull);
+	CHECK(hash_string("abc") == 0x44BC2CF5AD770999ull);
+	CHECK(hash_string("message digest") == 0x066ED728FCEEB3BEull);
+	CHECK(hash_string("abcdefghijklmnopqrstuvwxyz") == 0xCFE1F278FA89835Cull);
+	CHECK(hash_string("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789") == 0xAAA46907D3047814ull);
+	CHECK(hash_string("12345678901234567890123456789012345678901234567890123456789012345678901234567890") == 0xE04A477F19EE145Dull);
+
+	// Every tail length and the 32 byte stripe boundary must only depend on the data
+	std::string data;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		CHECK(hash_string(data) == hash_string(std::string(data)));
+		CHECK(hash_string(data) != hash_string(data + 'x'));
+		data += static_cast<char>('a' + i % 26);
+	}
+
+	CHECK(hash_string("abc", 1) != hash_string("abc"));
+
+	// Throughput on an image file sized buffer
+	std::vector<uint8_t> buffer(64 * 1024 * 1024);
+	for (size_t i = 0; i < buffer.size(); ++i)
+		buffer[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	const uint64_t hash = reshade::compute_hash64(buffer.data(), buffer.size());
+	const double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+	std::printf("Hashed %zu MiB in %.1f ms (%.2f GiB/s, %016llx)\n", buffer.size() / (1024 * 1024), elapsed * 1000.0, buffer.size() / elapsed / (1024.0 * 1024.0 * 1024.0), static_cast<unsigned long long>(hash));
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All hash tests passed");
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/image_encoder.hpp"
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <fpng.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <png.h>
+#include <zlib.h>
+#include <jpeglib.h>
+
+// Test and benchmark of the multi-threaded PNG and JPEG screenshot encoders on 8K images, which decodes every encoded image again with zlib, libpng and libjpeg as the reference decoders
+// Needs the fpng and stb submodules as well as the zlib, libpng and libjpeg development packages (e.g. "g++ -std=c++17 -O2 -pthread -I../deps/fpng/src -I../deps/stb image_encoder_test.cpp ../source/image_encoder.cpp ../deps/fpng/src/fpng.cpp -lpng -lz -ljpeg -o image_encoder_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+// Gradients with noise and hard edges, so that neither encoder can compress the image down to almost nothing
+static std::vector<uint8_t> make_image(uint32_t width, uint32_t height, uint32_t comp)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * comp);
+	uint32_t random = 1;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			random = random * 1664525 + 1013904223;
+			uint8_t *const pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * comp;
+			pixel[0] = static_cast<uint8_t>((x * 255) / width);
+			pixel[1] = static_cast<uint8_t>((y * 255) / height);
+			pixel[2] = ((x / 64 + y / 64) & 1) ? 200 : static_cast<uint8_t>((random >> 24) & 0x1F);
+			if (comp == 4)
+				pixel[3] = static_cast<uint8_t>(255 - (x & 0xF));
+		}
+	}
+	return pixels;
+}
+
+static uint32_t read_big_endian(const uint8_t *data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+// Walks the chunks of the PNG file and checks their checksums, then inflates the joined zlib stream with zlib, which also checks the combined Adler-32 checksum at its end
+static bool check_png_stream(const std::vector<uint8_t> &data, size_t expected_size, size_t &num_idat_chunks)
+{
+	num_idat_chunks = 0;
+	std::vector<uint8_t> stream;
+	for (size_t offset = 8; offset + 12 <= data.size();)
+	{
+		const uint32_t length = read_big_endian(data.data() + offset);
+		if (offset + 12 + length > data.size())
+			return false;
+
+		const uint8_t *const type = data.data() + offset + 4;
+		if (crc32(0, type, 4 + length) != read_big_endian(type + 4 + length))
+			return false;
+
+		if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			stream.insert(stream.end(), type + 4, type + 4 + length);
+			num_idat_chunks++;
+		}
+
+		offset += 12 + length;
+	}
+
+	std::vector<uint8_t> inflated(expected_size + 1);
+	z_stream z = {};
+	if (inflateInit(&z) != Z_OK)
+		return false;
+	z.next_in = stream.data();
+	z.avail_in = static_cast<uInt>(stream.size());
+	z.next_out = inflated.data();
+	z.avail_out = static_cast<uInt>(inflated.size());
+	const int result = inflate(&z, Z_FINISH);
+	const size_t inflated_size = z.total_out;
+	const size_t trailing_input = z.avail_in;
+	inflateEnd(&z);
+
+	return result == Z_STREAM_END && inflated_size == expected_size && trailing_input == 0;
+}
+
+static bool decode_png(const std::vector<uint8_t> &data, uint32_t width, uint32_t height, uint32_t comp, std::vector<uint8_t> &pixels)
+{
+	png_image image = {};
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_memory(&image, data.data(), data.size()))
+		return false;
+
+	image.format = comp == 4 ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB;
+	pixels.resize(PNG_IMAGE_SIZE(image));
+	const bool success = png_image_finish_read(&image, nullptr, pixels.data(), 0, nullptr) != 0 && image.warning_or_error == 0;
+	return success && image.width == width && image.height == height;
+}
+
+struct jpeg_error_handler
+{
+	jpeg_error_mgr base;
+	bool failed;
+};
+
+// Decodes the JPEG file with libjpeg, which warns about restart markers that are missing or out of sequence
+static bool decode_jpeg(const std::vector<uint8_t> &data, uint32_t width, uint32_t height, std::vector<uint8_t> &pixels)
+{
+	jpeg_decompress_struct cinfo = {};
+	jpeg_error_handler error = {};
+	cinfo.err = jpeg_std_error(&error.base);
+	error.base.error_exit = [](j_common_ptr cinfo) { reinterpret_cast<jpeg_error_handler *>(cinfo->err)->failed = true; };
+	error.base.emit_message = [](j_common_ptr cinfo, int level) { if (level < 0) reinterpret_cast<jpeg_error_handler *>(cinfo->err)->failed = true; };
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, data.data(), static_cast<unsigned long>(data.size()));
+
+	bool success = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK && !error.failed && cinfo.image_width == width && cinfo.image_height == height;
+	if (success)
+	{
+		cinfo.out_color_space = JCS_RGB;
+		jpeg_start_decompress(&cinfo);
+
+		pixels.resize(static_cast<size_t>(width) * height * 3);
+		while (!error.failed && cinfo.output_scanline < cinfo.output_height)
+		{
+			JSAMPROW row = pixels.data() + static_cast<size_t>(cinfo.output_scanline) * width * 3;
+			if (jpeg_read_scanlines(&cinfo, &row, 1) != 1)
+				break;
+		}
+
+		success = !error.failed && cinfo.output_scanline == cinfo.output_height;
+		if (success)
+			jpeg_finish_decompress(&cinfo);
+		success = success && !error.failed && error.base.num_warnings == 0;
+	}
+
+	jpeg_destroy_decompress(&cinfo);
+	return success;
+}
+
+static double compute_psnr(const std::vector<uint8_t> &pixels, uint32_t comp, const std::vector<uint8_t> &decoded_rgb)
+{
+	double squared_error = 0;
+	const size_t num_pixels = decoded_rgb.size() / 3;
+	for (size_t i = 0; i < num_pixels; ++i)
+		for (size_t c = 0; c < 3; ++c)
+			squared_error += std::pow(static_cast<double>(pixels[i * comp + c]) - decoded_rgb[i * 3 + c], 2);
+	return 10 * std::log10(255.0 * 255.0 / (squared_error / (num_pixels * 3)));
+}
+
+// Strips are joined with sync flushes and the combined Adler-32 checksum, which zlib and libpng have to accept and decode back to the exact input
+static void test_png(uint32_t width, uint32_t height, uint32_t comp, unsigned int max_threads)
+{
+	const std::vector<uint8_t> pixels = make_image(width, height, comp);
+
+	std::vector<uint8_t> encoded;
+	CHECK(reshade::encode_png(pixels.data(), width, height, comp, encoded, max_threads));
+
+	size_t num_idat_chunks = 0;
+	CHECK(check_png_stream(encoded, static_cast<size_t>(height) * (static_cast<size_t>(width) * comp + 1), num_idat_chunks));
+	// One chunk per strip, followed by one with the checksum
+	CHECK(num_idat_chunks == std::min(max_threads, (width * height) / (256 * 1024)) + 1);
+
+	std::vector<uint8_t> decoded;
+	CHECK(decode_png(encoded, width, height, comp, decoded));
+	CHECK(decoded == pixels);
+}
+
+// Strips are joined with restart markers, which libjpeg has to accept without warnings and decode to the same image as encoding it in one piece
+static void test_jpeg(uint32_t width, uint32_t height, uint32_t comp, int quality, unsigned int max_threads)
+{
+	const std::vector<uint8_t> pixels = make_image(width, height, comp);
+
+	std::vector<uint8_t> encoded, encoded_single;
+	CHECK(reshade::encode_jpeg(pixels.data(), width, height, comp, quality, encoded, max_threads));
+	CHECK(reshade::encode_jpeg(pixels.data(), width, height, comp, quality, encoded_single, 1));
+
+	std::vector<uint8_t> decoded, decoded_single;
+	CHECK(decode_jpeg(encoded, width, height, decoded));
+	CHECK(decode_jpeg(encoded_single, width, height, decoded_single));
+	CHECK(decoded == decoded_single);
+	CHECK(compute_psnr(pixels, comp, decoded) > 30.0);
+}
+
+static void bench_8k()
+{
+	constexpr uint32_t width = 7680, height = 4320;
+	// Use at least a few threads, so that the strip encoders are measured on machines with few cores too
+	const unsigned int num_threads = std::max(4u, std::thread::hardware_concurrency());
+
+	for (const uint32_t comp : { 3u, 4u })
+	{
+		const std::vector<uint8_t> pixels = make_image(width, height, comp);
+
+		for (const int quality : { 0, 85, 95 }) // Zero stands for PNG here
+		{
+			double time[2] = {};
+			size_t size[2] = {};
+			for (const unsigned int max_threads : { 1u, num_threads })
+			{
+				std::vector<uint8_t> encoded;
+				const auto start_time = std::chrono::high_resolution_clock::now();
+				const bool success = quality == 0 ?
+					reshade::encode_png(pixels.data(), width, height, comp, encoded, max_threads) :
+					reshade::encode_jpeg(pixels.data(), width, height, comp, quality, encoded, max_threads);
+				time[max_threads != 1] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+				size[max_threads != 1] = encoded.size();
+				CHECK(success);
+
+				// Every encoded image has to decode back to the source
+				std::vector<uint8_t> decoded;
+				if (quality == 0)
+				{
+					CHECK(decode_png(encoded, width, height, comp, decoded) && decoded == pixels);
+				}
+				else
+				{
+					CHECK(decode_jpeg(encoded, width, height, decoded) && compute_psnr(pixels, comp, decoded) > 30.0);
+				}
+			}
+
+			char format[16];
+			if (quality == 0)
+				std::snprintf(format, sizeof(format), "PNG");
+			else
+				std::snprintf(format, sizeof(format), "JPEG %d", quality);
+			std::printf("%ux%u %s %s: 1 thread %7.1f ms (%5.1f MiB), %2u threads %6.1f ms (%5.1f MiB), %.1fx faster\n", width, height, comp == 4 ? "RGBA" : "RGB ", format,
+				time[0], size[0] / (1024.0 * 1024.0), num_threads, time[1], size[1] / (1024.0 * 1024.0), time[0] / time[1]);
+		}
+	}
+}
+
+int main()
+{
+	fpng::fpng_init();
+
+	// Sizes that split into an uneven number of rows per strip, with partial blocks at the right and bottom edges
+	for (const uint32_t comp : { 3u, 4u })
+	{
+		for (const unsigned int max_threads : { 2u, 3u, 8u })
+		{
+			test_png(1920, 1080, comp, max_threads);
+			test_png(1021, 1543, comp, max_threads);
+			test_jpeg(1920, 1080, comp, 85, max_threads);
+			test_jpeg(1021, 1543, comp, 85, max_threads);
+			test_jpeg(1021, 1543, comp, 95, max_threads);
+		}
+	}
+
+	// Wide images have to limit the restart interval to 16 bits
+	test_jpeg(32768, 1024, 3, 95, 8);
+
+	bench_8k();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All image encoder tests passed");
+	return 0;
+}
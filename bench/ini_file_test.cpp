@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/ini_file_data.cpp"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Test and benchmark of the single pass INI parser and the formatting used to save INI files, which compares the parser against the previous line by line parser on random input
+// Also checks that formatted files parse back to the same values, and counts how often bursts of modifications are written to disk (e.g. "g++ -std=c++17 -O2 ini_file_test.cpp -o ini_file_test -pthread")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static inline void trim(std::string &str, const char chars[] = " \t")
+{
+	str.erase(0, str.find_first_not_of(chars));
+	str.erase(str.find_last_not_of(chars) + 1);
+}
+static inline std::string trim(const std::string &str, const char chars[] = " \t")
+{
+	std::string res(str);
+	trim(res, chars);
+	return res;
+}
+
+// Previous parser, reading the file through a stream line by line
+static void parse_line_by_line(const std::string &text, ini_sections &result)
+{
+	std::istringstream file(text);
+	if (file.get() != 0xef || file.get() != 0xbb || file.get() != 0xbf)
+	{
+		file.clear();
+		file.seekg(0, std::ios::beg);
+	}
+
+	std::string line, section;
+	while (std::getline(file, line))
+	{
+		trim(line);
+
+		if (line.empty() || line[0] == ';' || line[0] == '/' || line[0] == '#')
+			continue;
+
+		if (line[0] == '[')
+		{
+			section = trim(line.substr(0, line.find(']')), " \t[]");
+			continue;
+		}
+
+		const auto assign_index = line.find('=');
+		if (assign_index != std::string::npos)
+		{
+			const std::string key = trim(line.substr(0, assign_index));
+			const std::string value = trim(line.substr(assign_index + 1));
+
+			if (value.empty())
+			{
+				result[section].insert({ key, {} });
+				continue;
+			}
+
+			ini_value &elements = result[section][key];
+			for (size_t offset = 0, base = 0, len = value.size(); offset <= len;)
+			{
+				const size_t found = std::min(value.find_first_of(',', offset), len);
+				if (found + 1 < len && value[found + 1] == ',')
+				{
+					offset = found + 2;
+				}
+				else
+				{
+					std::string &element = elements.emplace_back();
+					element.reserve(found - base);
+
+					while (base < found)
+					{
+						const char c = value[base++];
+						element += c;
+
+						if (c == ',' && base < found && value[base] == ',')
+							base++;
+					}
+
+					offset = base = found + 1;
+				}
+			}
+		}
+		else
+		{
+			result[section].insert({ line, {} });
+		}
+	}
+}
+
+static void test_parse_fuzz()
+{
+	std::mt19937 rng(1234);
+	const char alphabet[] = "ab[]=,, \t;#/\r\n\n\xef";
+
+	size_t cases = 0, mismatches = 0;
+	for (int i = 0; i < 200000; ++i)
+	{
+		std::string text;
+		if (rng() % 4 == 0)
+			text = "\xef\xbb\xbf";
+		for (size_t k = 0, len = rng() % 64; k < len; ++k)
+			text += alphabet[rng() % (sizeof(alphabet) - 1)];
+
+		// A lone carriage return before the end of the file is not converted by a text mode stream either, so skip those
+		if (!text.empty() && text.back() == '\r')
+			continue;
+
+		// The previous parser read through a text mode stream, which already converted line endings
+		std::string text_mode;
+		for (size_t k = 0; k < text.size(); ++k)
+			if (text[k] != '\r' || k + 1 >= text.size() || text[k + 1] != '\n')
+				text_mode += text[k];
+
+		ini_sections a, b;
+		parse_line_by_line(text_mode, a);
+		parse_ini_data(text, b);
+
+		cases++;
+		if (a != b)
+			mismatches++;
+	}
+
+	CHECK(mismatches == 0);
+	std::printf("%zu random inputs, %zu parsed differently\n", cases, mismatches);
+}
+
+static void test_format_round_trip()
+{
+	std::mt19937 rng(5678);
+	// Elements may contain commas, but not start with one, since a file cannot tell those apart from an escaped comma after the separator
+	const auto random_name = [&rng](const char *alphabet, size_t alphabet_size, size_t max_length) {
+		std::string name(1 + rng() % max_length, ' ');
+		for (char &c : name)
+			c = alphabet[rng() % alphabet_size];
+		return name;
+	};
+
+	size_t mismatches = 0;
+	for (int i = 0; i < 2000; ++i)
+	{
+		ini_sections sections;
+		for (size_t s = 0, num_sections = 1 + rng() % 4; s < num_sections; ++s)
+		{
+			// Keys outside of any section go into the section with an empty name
+			ini_section &section = sections[(s == 0 && rng() % 2) ? std::string() : random_name("abAB_.", 6, 8)];
+			for (size_t k = 0, num_keys = 1 + rng() % 8; k < num_keys; ++k)
+			{
+				ini_value &value = section[random_name("abcAB_", 6, 8)];
+				value.clear();
+				for (size_t e = 0, num_elements = rng() % 4; e < num_elements; ++e)
+				{
+					std::string element = random_name("ab", 2, 1) + random_name("ab, ", 4, 6);
+					// Whitespace around the whole value is trimmed when parsing
+					if (e + 1 == num_elements)
+						element.back() = 'z';
+					value.push_back(std::move(element));
+				}
+			}
+		}
+
+		const std::string data = format_ini_data(sections);
+
+		ini_sections parsed;
+		parse_ini_data(data, parsed);
+		if (parsed != sections)
+			mismatches++;
+
+		// Formatting is stable, regardless of the order the sections were inserted in
+		CHECK(format_ini_data(parsed) == data);
+	}
+
+	CHECK(mismatches == 0);
+
+	// Sections and keys are sorted case-insensitively, with keys outside of any section first
+	ini_sections sections;
+	sections["b"]["Key"] = { "1" };
+	sections["A"]["key2"] = { "a,b", "c" };
+	sections["A"]["Key1"] = {};
+	sections[""]["Global"] = { "x" };
+	CHECK(format_ini_data(sections) == "Global=x\n\n[A]\nKey1=\nkey2=a,,b,c\n\n[b]\nKey=1\n\n");
+}
+
+// Sets values and saves them the same way 'ini_file' and its background thread do, but counts the writes to disk
+struct write_behind_file
+{
+	explicit write_behind_file(const std::filesystem::path &path, ini_write_behind::time_point(*clock)()) : path(path), clock(clock) {}
+
+	void set(const std::string &section, const std::string &key, std::string value)
+	{
+		const std::unique_lock<std::mutex> lock(mutex);
+
+		sections[section][key].assign(1, std::move(value));
+
+		// Only query the time once at the start of a batch of modifications
+		write_behind.modified();
+		if (!modified)
+		{
+			modified = true;
+			modified_at = clock();
+		}
+	}
+
+	void poll(ini_write_behind::time_point now)
+	{
+		const std::unique_lock<std::mutex> lock(mutex);
+
+		if (!modified || !write_behind.due(modified_at, now))
+			return;
+
+		modified = false;
+
+		const std::string data = format_ini_data(sections);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), data.size());
+		file.close();
+		CHECK(!file.fail());
+		writes++;
+	}
+
+	bool saved_values_match()
+	{
+		const std::unique_lock<std::mutex> lock(mutex);
+
+		std::ifstream file(path, std::ios::binary);
+		const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		ini_sections saved;
+		parse_ini_data(data, saved);
+		return saved == sections;
+	}
+
+	std::mutex mutex;
+	ini_sections sections;
+	bool modified = false;
+	ini_write_behind::time_point modified_at;
+	ini_write_behind write_behind;
+	const std::filesystem::path path;
+	ini_write_behind::time_point(*const clock)();
+	std::atomic<size_t> writes = 0;
+};
+
+static ini_write_behind::time_point s_simulated_time;
+
+// Runs a simulated timeline, in which 'set_value' is called at the given interval until 'set_duration' elapsed and the background thread polls at the interval it does in ReShade
+static size_t simulate_write_behind(const std::filesystem::path &path, std::chrono::microseconds set_interval, std::chrono::microseconds set_duration)
+{
+	write_behind_file file(path, []() { return s_simulated_time; });
+
+	const ini_write_behind::time_point start = ini_write_behind::time_point::clock::now();
+	const ini_write_behind::time_point end = start + set_duration + std::chrono::seconds(3);
+	ini_write_behind::time_point next_poll = start + ini_write_behind::poll_interval;
+
+	size_t num_sets = 0;
+	for (s_simulated_time = start; s_simulated_time < end; s_simulated_time += set_interval)
+	{
+		if (s_simulated_time < start + set_duration)
+		{
+			file.set("Effect.fx", "Key" + std::to_string(num_sets % 64), std::to_string(num_sets));
+			num_sets++;
+		}
+
+		for (; next_poll <= s_simulated_time; next_poll += ini_write_behind::poll_interval)
+			file.poll(next_poll);
+	}
+
+	CHECK(!file.modified);
+	CHECK(file.saved_values_match());
+	return file.writes;
+}
+
+static void test_write_behind()
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "reshade_ini_file_test.ini";
+
+	// A burst of 100000 modifications over 2.1 seconds (e.g. while dragging a slider) results in a single write once it stopped
+	const size_t burst_writes = simulate_write_behind(path, std::chrono::microseconds(21), std::chrono::microseconds(2100000));
+	CHECK(burst_writes == 1);
+	std::printf("100000 sets in a 2.1 s burst: %zu writes\n", burst_writes);
+
+	// Modifications that never stop are still written at the latest after the maximum delay, and once more after they stopped
+	const size_t continuous_writes = simulate_write_behind(path, std::chrono::microseconds(16667), std::chrono::seconds(12));
+	CHECK(continuous_writes == 3);
+	std::printf("Sets at 60 Hz for 12 s: %zu writes\n", continuous_writes);
+
+	// Same for a burst as fast as possible on the real clock, with a background thread polling the file
+	{
+		write_behind_file file(path, []() { return ini_write_behind::time_point::clock::now(); });
+
+		std::atomic<bool> stop = false;
+		std::thread background_thread([&file, &stop]() {
+			while (!stop)
+			{
+				std::this_thread::sleep_for(ini_write_behind::poll_interval);
+				file.poll(ini_write_behind::time_point::clock::now());
+			}
+		});
+
+		const auto t0 = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < 100000; ++i)
+			file.set("Effect.fx", "Key" + std::to_string(i % 64), std::to_string(i));
+		const auto t1 = std::chrono::steady_clock::now();
+
+		// Wait for the write, and a bit longer to make sure there is no second one
+		while (file.writes == 0 && std::chrono::steady_clock::now() - t1 < std::chrono::seconds(10))
+			std::this_thread::sleep_for(ini_write_behind::poll_interval);
+		std::this_thread::sleep_for(ini_write_behind::quiet_period);
+
+		stop = true;
+		background_thread.join();
+
+		CHECK(file.writes == 1);
+		CHECK(file.saved_values_match());
+		std::printf("100000 sets back to back: %.0f ns per set, %zu writes\n",
+			std::chrono::duration<double, std::nano>(t1 - t0).count() / 100000, file.writes.load());
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+}
+
+static void bench_parse()
+{
+	std::string preset;
+	for (int e = 0; e < 400; ++e)
+	{
+		preset += "[Effect" + std::to_string(e) + ".fx]\n";
+		for (int k = 0; k < 50; ++k)
+			preset += "Key" + std::to_string(k) + "=" + std::to_string(k * 0.125) + ",1.000000,0.500000\n";
+	}
+
+	for (int run = 0; run < 3; ++run)
+	{
+		const auto t0 = std::chrono::steady_clock::now();
+		ini_sections a;
+		parse_line_by_line(preset, a);
+		const auto t1 = std::chrono::steady_clock::now();
+		ini_sections b;
+		parse_ini_data(preset, b);
+		const auto t2 = std::chrono::steady_clock::now();
+
+		CHECK(a == b);
+		std::printf("20000 keys (%zu KiB): line by line %.2f ms, single pass %.2f ms\n", preset.size() / 1024,
+			std::chrono::duration<double, std::milli>(t1 - t0).count(),
+			std::chrono::duration<double, std::milli>(t2 - t1).count());
+	}
+}
+
+int main()
+{
+	test_parse_fuzz();
+	test_format_round_trip();
+	test_write_behind();
+	bench_parse();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All INI file tests passed");
+	return 0;
+}
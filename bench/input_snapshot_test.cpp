@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/input_state.hpp"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <algorithm>
+#include <shared_mutex>
+
+// Test of the per-frame input snapshots, which feeds synthetic key, wheel and character messages from a message thread while a render thread publishes snapshots as fast as it can, with the same locking as 'reshade::input'
+// Checks that every character and wheel step is reported in exactly one snapshot, every key press and release in at least one, and that held keys stay down across frames (e.g. "g++ -std=c++17 -O2 -pthread input_snapshot_test.cpp -o input_snapshot_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::input_state;
+
+static void test_single_frame()
+{
+	input_state pending, snapshot;
+
+	// Key tapped within a single frame is reported as pressed and released, but not as down
+	pending.key_down(65);
+	pending.key_up(65);
+	pending.publish(snapshot);
+	CHECK(snapshot.is_key_pressed(65) && snapshot.is_key_released(65) && !snapshot.is_key_down(65));
+	pending.publish(snapshot);
+	CHECK(!snapshot.is_key_pressed(65) && !snapshot.is_key_released(65) && !snapshot.is_key_down(65));
+
+	// Key held down across frames is only reported as pressed in the first one
+	pending.key_down(66);
+	pending.publish(snapshot);
+	CHECK(snapshot.is_key_pressed(66) && snapshot.is_key_down(66));
+	pending.publish(snapshot);
+	CHECK(!snapshot.is_key_pressed(66) && snapshot.is_key_down(66));
+
+	// Releasing and pressing it again within a frame reports both and leaves it down
+	pending.key_up(66);
+	pending.key_down(66);
+	pending.publish(snapshot);
+	CHECK(snapshot.is_key_pressed(66) && snapshot.is_key_released(66) && snapshot.is_key_down(66));
+
+	// Toggle and blocked bits are kept, but not reported as presses
+	pending.keys[20] |= 0x01;
+	pending.publish(snapshot);
+	CHECK((snapshot.keys[20] & 0x01) != 0 && !snapshot.is_key_pressed(20));
+	CHECK(!snapshot.is_key_pressed(0) && !snapshot.is_key_down(256));
+
+	// Wheel and text input are reported once, the mouse position carries over
+	pending.mouse_wheel_delta += 3;
+	pending.text_input += L"abc";
+	pending.mouse_position[0] = 10;
+	pending.mouse_position[1] = 20;
+	pending.publish(snapshot);
+	CHECK(snapshot.mouse_wheel_delta == 3 && snapshot.text_input == L"abc");
+	pending.publish(snapshot);
+	CHECK(snapshot.mouse_wheel_delta == 0 && snapshot.text_input.empty() && snapshot.mouse_position[0] == 10 && snapshot.mouse_position[1] == 20);
+}
+
+static void test_threaded()
+{
+	constexpr unsigned int num_messages = 200000;
+	constexpr unsigned int first_tapped_key = 8;
+	constexpr unsigned int num_tapped_keys = 200;
+	constexpr unsigned int held_key = 250;
+
+	// Same split as in 'reshade::input': messages go into the pending state under a mutex, and the render thread publishes it to the snapshot, which other threads read under a shared lock
+	std::mutex pending_mutex;
+	input_state pending;
+	std::shared_mutex snapshot_mutex;
+	input_state snapshot;
+
+	std::atomic<bool> messages_done = false, frames_done = false;
+	std::atomic<unsigned int> inconsistent_reads = 0;
+	std::wstring expected_text;
+	uint64_t longest_message_ns = 0;
+
+	std::thread message_thread([&]() {
+		const auto message = [&](auto &&update) {
+			const auto start_time = std::chrono::high_resolution_clock::now();
+			const std::unique_lock<std::mutex> lock(pending_mutex);
+			update();
+			longest_message_ns = std::max<uint64_t>(longest_message_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start_time).count());
+		};
+
+		message([&]() { pending.key_down(held_key); });
+
+		for (unsigned int i = 0; i < num_messages; ++i)
+		{
+			const unsigned int keycode = first_tapped_key + i % num_tapped_keys;
+			const wchar_t ch = static_cast<wchar_t>(L' ' + i % 95);
+			expected_text += ch;
+
+			message([&]() { pending.key_down(keycode); });
+			message([&]() { pending.key_up(keycode); });
+			message([&]() { pending.text_input += ch; });
+			message([&]() { pending.mouse_position[0] = i; });
+
+			// Wheel delta is a 16-bit value, so only scroll now and then to not overflow it when the render thread falls behind
+			if (i % 64 == 0)
+				message([&]() { pending.mouse_wheel_delta += 1; });
+		}
+
+		message([&]() { pending.key_up(held_key); });
+
+		messages_done = true;
+	});
+
+	// Thread that queries the snapshot like an add-on calling 'effect_runtime::is_key_down' from outside the render thread
+	// A key that is down after it was released in the same frame has to have been pressed again in that frame, which would not hold when reading a snapshot that is only partially published
+	std::thread addon_thread([&]() {
+		while (!frames_done)
+		{
+			const std::shared_lock<std::shared_mutex> lock(snapshot_mutex);
+			for (unsigned int keycode = first_tapped_key; keycode < first_tapped_key + num_tapped_keys; ++keycode)
+				if (snapshot.is_key_down(keycode) && snapshot.is_key_released(keycode) && !snapshot.is_key_pressed(keycode))
+					inconsistent_reads++;
+		}
+	});
+
+	std::wstring received_text;
+	int64_t received_wheel_delta = 0;
+	unsigned int pressed_frames[256] = {}, released_frames[256] = {};
+	unsigned int num_frames = 0, held_down_frames = 0, held_pressed_frame = 0, held_released_frame = 0;
+
+	for (bool last_frame = false; !last_frame; ++num_frames)
+	{
+		last_frame = messages_done;
+
+		{
+			const std::unique_lock<std::mutex> lock(pending_mutex);
+			const std::unique_lock<std::shared_mutex> snapshot_lock(snapshot_mutex);
+			pending.publish(snapshot);
+		}
+
+		// The render thread is the only writer of the snapshot, so it reads it without locking
+		received_text += snapshot.text_input;
+		received_wheel_delta += snapshot.mouse_wheel_delta;
+
+		for (unsigned int keycode = 0; keycode < 256; ++keycode)
+		{
+			pressed_frames[keycode] += snapshot.is_key_pressed(keycode);
+			released_frames[keycode] += snapshot.is_key_released(keycode);
+		}
+
+		if (snapshot.is_key_pressed(held_key))
+			held_pressed_frame = num_frames;
+		if (snapshot.is_key_released(held_key))
+			held_released_frame = num_frames;
+		if (snapshot.is_key_down(held_key))
+			held_down_frames++;
+
+		std::this_thread::yield();
+	}
+
+	frames_done = true;
+	message_thread.join();
+	addon_thread.join();
+
+	CHECK(received_text == expected_text);
+	CHECK(received_wheel_delta == (num_messages + 63) / 64);
+	CHECK(inconsistent_reads == 0);
+	CHECK(snapshot.mouse_position[0] == num_messages - 1);
+
+	// A key tapped several times within one frame is only reported once, but every key has to be reported pressed and released at least once, and never more often than it was tapped
+	for (unsigned int keycode = first_tapped_key; keycode < first_tapped_key + num_tapped_keys; ++keycode)
+	{
+		CHECK(pressed_frames[keycode] >= 1 && pressed_frames[keycode] <= num_messages / num_tapped_keys);
+		CHECK(released_frames[keycode] >= 1 && released_frames[keycode] <= num_messages / num_tapped_keys);
+		CHECK(!snapshot.is_key_down(keycode));
+	}
+
+	// Held key is pressed and released exactly once and reported as down in every frame in between
+	CHECK(pressed_frames[held_key] == 1 && released_frames[held_key] == 1);
+	CHECK(held_released_frame > held_pressed_frame && held_down_frames == held_released_frame - held_pressed_frame);
+
+	std::printf("%u messages in %u frames, longest time a message waited for and held the pending state lock %.1f us (including time the thread was not scheduled)\n", num_messages * 4 + (num_messages + 63) / 64 + 2, num_frames, longest_message_ns / 1000.0);
+}
+
+int main()
+{
+	test_single_frame();
+	test_threaded();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All input snapshot tests passed");
+	return 0;
+}
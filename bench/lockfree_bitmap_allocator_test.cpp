@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/lockfree_bitmap_allocator.hpp"
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <shared_mutex>
+
+// Test and benchmark of the lock-free allocator of CPU descriptors
+// Uses the same scheme as 'descriptor_heap_cpu' (see 'source/d3d12/descriptor_heap.hpp'), with address ranges standing in for descriptor heaps (e.g. "g++ -std=c++17 -O2 -pthread lockfree_bitmap_allocator_test.cpp -o lockfree_bitmap_allocator_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+constexpr uintptr_t first_heap_base = 0x10000000;
+constexpr uintptr_t heap_spacing = 0x100000;
+constexpr size_t descriptor_size = 32;
+
+// Same as 'descriptor_heap_cpu', which only locks to add a new heap once all existing ones are full
+struct descriptor_heap
+{
+	bool allocate(uintptr_t &address)
+	{
+		if (!allocator.allocate(address))
+		{
+			const std::unique_lock<std::mutex> lock(mutex);
+
+			if (!allocator.allocate(address) && (!allocate_heap() || !allocator.allocate(address)))
+				return false;
+		}
+
+		return true;
+	}
+	void free(uintptr_t address)
+	{
+		allocator.free(address);
+	}
+
+	bool allocate_heap()
+	{
+		allocator.add_block(next_heap_base);
+		next_heap_base += heap_spacing;
+		return true;
+	}
+
+	lockfree_bitmap_allocator allocator { descriptor_size };
+	std::mutex mutex;
+	uintptr_t next_heap_base = first_heap_base;
+};
+
+// Previous design, which searched the state of every heap under an exclusive lock
+struct descriptor_heap_locked
+{
+	struct heap_info
+	{
+		std::vector<bool> state;
+		uintptr_t base;
+	};
+
+	bool allocate(uintptr_t &address)
+	{
+		const std::unique_lock<std::shared_mutex> lock(mutex);
+
+		for (int attempt = 0; attempt < 2; ++attempt)
+		{
+			for (heap_info &info : heaps)
+			{
+				if (const auto it = std::find(info.state.begin(), info.state.end(), false); it != info.state.end())
+				{
+					*it = true;
+					address = info.base + (it - info.state.begin()) * descriptor_size;
+					return true;
+				}
+			}
+
+			heaps.push_back({ std::vector<bool>(lockfree_bitmap_allocator::BLOCK_SIZE), next_heap_base });
+			next_heap_base += heap_spacing;
+		}
+
+		return false;
+	}
+	void free(uintptr_t address)
+	{
+		const std::unique_lock<std::shared_mutex> lock(mutex);
+
+		for (heap_info &info : heaps)
+		{
+			if (address >= info.base && address < info.base + lockfree_bitmap_allocator::BLOCK_SIZE * descriptor_size)
+			{
+				info.state[(address - info.base) / descriptor_size] = false;
+				break;
+			}
+		}
+	}
+
+	std::vector<heap_info> heaps;
+	std::shared_mutex mutex;
+	uintptr_t next_heap_base = first_heap_base;
+};
+
+static void test_single_thread()
+{
+	descriptor_heap heap;
+
+	// Every address is unique and aligned to a descriptor within one of the heaps
+	std::set<uintptr_t> addresses;
+	for (int i = 0; i < 5000; ++i)
+	{
+		uintptr_t address = 0;
+		CHECK(heap.allocate(address));
+		CHECK(addresses.insert(address).second);
+		CHECK((address - first_heap_base) % heap_spacing < lockfree_bitmap_allocator::BLOCK_SIZE * descriptor_size);
+		CHECK((address - first_heap_base) % descriptor_size == 0);
+	}
+
+	// Addresses outside of any block are rejected
+	CHECK(!heap.allocator.free(0x1));
+	CHECK(!heap.allocator.free(first_heap_base + lockfree_bitmap_allocator::BLOCK_SIZE * descriptor_size));
+
+	for (const uintptr_t address : addresses)
+		CHECK(heap.allocator.free(address));
+
+	// Freed slots are used again without adding new blocks, until all existing ones are full
+	const uintptr_t num_blocks = (heap.next_heap_base - first_heap_base) / heap_spacing;
+	for (size_t i = 0; i < num_blocks * lockfree_bitmap_allocator::BLOCK_SIZE; ++i)
+	{
+		uintptr_t address = 0;
+		CHECK(heap.allocator.allocate(address));
+	}
+	uintptr_t address = 0;
+	CHECK(!heap.allocator.allocate(address));
+}
+
+static void test_concurrent()
+{
+	constexpr int num_threads = 8, operations_per_thread = 200000;
+
+	descriptor_heap heap;
+
+	// Each thread holds a changing set of descriptors, and ownership of every slot is tracked to detect handing out the same one twice
+	std::vector<std::atomic<int>> owner(1 << 20);
+	std::atomic<int> num_errors = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			std::vector<uintptr_t> held;
+			uint32_t random = t * 7919 + 1;
+
+			for (int i = 0; i < operations_per_thread; ++i)
+			{
+				random = random * 1664525 + 1013904223;
+
+				if (held.size() < 300 && (random >> 16) % 3 != 0)
+				{
+					uintptr_t address = 0;
+					if (!heap.allocate(address))
+					{
+						num_errors++;
+						continue;
+					}
+
+					if (owner[(address - first_heap_base) / descriptor_size].exchange(t + 1) != 0)
+						num_errors++;
+					held.push_back(address);
+				}
+				else if (!held.empty())
+				{
+					const size_t k = (random >> 8) % held.size();
+					const uintptr_t address = held[k];
+					held[k] = held.back();
+					held.pop_back();
+
+					if (owner[(address - first_heap_base) / descriptor_size].exchange(0) != t + 1)
+						num_errors++;
+					if (!heap.allocator.free(address))
+						num_errors++;
+				}
+			}
+
+			for (const uintptr_t address : held)
+			{
+				owner[(address - first_heap_base) / descriptor_size].store(0);
+				heap.free(address);
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(num_errors == 0);
+	std::printf("%d threads allocated and freed %d descriptors each, %d errors, %zu heaps\n", num_threads, operations_per_thread, num_errors.load(), static_cast<size_t>((heap.next_heap_base - first_heap_base) / heap_spacing));
+}
+
+template <typename H>
+static double allocate_free_time(int num_live, int num_threads)
+{
+	constexpr int operations_per_thread = 200000;
+
+	H heap;
+	std::vector<uintptr_t> live(num_live);
+	for (uintptr_t &address : live)
+		heap.allocate(address);
+	// Only the last heap has free slots, like after views were created over time and only the latest ones destroyed
+	for (int i = num_live - 512; i < num_live; ++i)
+		heap.free(live[i]);
+
+	std::vector<std::thread> threads;
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&heap]() {
+			std::vector<uintptr_t> addresses(16);
+			for (int i = 0; i < operations_per_thread / 16; ++i)
+			{
+				for (uintptr_t &address : addresses)
+					heap.allocate(address);
+				for (const uintptr_t address : addresses)
+					heap.free(address);
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count() / (static_cast<double>(operations_per_thread) * num_threads);
+}
+
+int main()
+{
+	test_single_thread();
+	test_concurrent();
+
+	for (const int num_live : { 1000, 10000, 100000 })
+		for (const int num_threads : { 1, 4 })
+			std::printf("%6d live descriptors, %d threads: locked search %8.1f ns, bitmap %5.1f ns per allocation and free\n", num_live, num_threads,
+				allocate_free_time<descriptor_heap_locked>(num_live, num_threads),
+				allocate_free_time<descriptor_heap>(num_live, num_threads));
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All descriptor allocator tests passed");
+	return 0;
+}
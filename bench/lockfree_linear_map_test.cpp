@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/lockfree_linear_map.hpp"
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test and benchmark of the lock-free hash table used for Vulkan object data
+// Uses integer keys, since the special pointer keys are only accepted as constant expressions by MSVC, which does not change any of the table logic (e.g. "g++ -std=c++17 -O2 -pthread lockfree_linear_map_test.cpp -o lockfree_linear_map_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+// Lookup of the previous version, which scanned the entries in order and had a fixed size
+template <uint32_t MAX_ENTRIES>
+class linear_scan_map
+{
+public:
+	int *at(uint64_t key) const
+	{
+		size_t start_index = 0;
+		if constexpr (MAX_ENTRIES > 512)
+			start_index = std::hash<uint64_t>()(key) % (MAX_ENTRIES / 2);
+
+		for (size_t i = start_index; i < MAX_ENTRIES; ++i)
+			if (_data[i].first.load(std::memory_order_acquire) == key)
+				return _data[i].second;
+
+		return nullptr;
+	}
+
+	bool emplace(uint64_t key, int *value)
+	{
+		size_t start_index = 0;
+		if constexpr (MAX_ENTRIES > 512)
+			start_index = std::hash<uint64_t>()(key) % (MAX_ENTRIES / 2);
+
+		for (size_t i = start_index; i < MAX_ENTRIES; ++i)
+		{
+			if (uint64_t test_key = _data[i].first.load(std::memory_order_relaxed);
+				test_key == 0 &&
+				_data[i].first.compare_exchange_strong(test_key, 1, std::memory_order_relaxed))
+			{
+				_data[i].second = value;
+				_data[i].first.store(key, std::memory_order_release);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	std::pair<std::atomic<uint64_t>, int *> _data[MAX_ENTRIES] = {};
+};
+
+static void test_single_thread()
+{
+	lockfree_linear_map<uint64_t, int *, 8> map;
+	std::vector<int> values(1000);
+
+	// Grows well past the initial size
+	for (uint64_t i = 0; i < values.size(); ++i)
+		CHECK(map.emplace(0x1000 + i * 0x40, &values[i]));
+	for (uint64_t i = 0; i < values.size(); ++i)
+		CHECK(map.at(0x1000 + i * 0x40) == &values[i]);
+	CHECK(map.at(0x1000 + values.size() * 0x40) == nullptr);
+
+	// Erased entries can no longer be found, but the keys probed past them still can
+	for (uint64_t i = 0; i < values.size(); i += 2)
+		CHECK(map.erase(0x1000 + i * 0x40) == &values[i]);
+	for (uint64_t i = 0; i < values.size(); ++i)
+		CHECK(map.at(0x1000 + i * 0x40) == (i % 2 ? &values[i] : nullptr));
+	CHECK(map.erase(0x1000) == nullptr);
+
+	// Re-inserting reuses the erased entries
+	for (uint64_t i = 0; i < values.size(); i += 2)
+		CHECK(map.emplace(0x1000 + i * 0x40, &values[i]));
+	for (uint64_t i = 0; i < values.size(); ++i)
+		CHECK(map.at(0x1000 + i * 0x40) == &values[i]);
+
+	// Values that are not pointers are owned by the table
+	lockfree_linear_map<uint64_t, std::string, 4> value_map;
+	for (uint64_t i = 3; i < 100; ++i)
+		value_map.emplace(i, std::to_string(i));
+	CHECK(value_map.at(42) == "42");
+	std::string value;
+	CHECK(value_map.erase(42, value) && value == "42");
+	CHECK(!value_map.erase(42));
+}
+
+static void test_concurrent()
+{
+	constexpr int num_threads = 8, num_rounds = 2000, keys_per_thread = 64, num_fixed_keys = 100;
+
+	static lockfree_linear_map<uint64_t, int *, 8> pointer_map;
+	static lockfree_linear_map<uint64_t, std::string, 4> value_map;
+
+	std::vector<int> values(num_threads * keys_per_thread + num_fixed_keys);
+	for (int i = 0; i < num_fixed_keys; ++i)
+		pointer_map.emplace((i + 1) * 0x1000, &values[num_threads * keys_per_thread + i]);
+
+	// Each thread inserts, looks up and erases its own keys, while the fixed keys have to stay visible throughout
+	std::atomic<int> num_errors = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			for (int r = 0; r < num_rounds; ++r)
+			{
+				for (int k = 0; k < keys_per_thread; ++k)
+				{
+					const int index = t * keys_per_thread + k;
+					if (!pointer_map.emplace(0x10000000 + index * 16, &values[index]))
+						num_errors++;
+					value_map.emplace(0x100 + index, std::to_string(index));
+				}
+				for (int k = 0; k < keys_per_thread; ++k)
+				{
+					const int index = t * keys_per_thread + k;
+					if (pointer_map.at(0x10000000 + index * 16) != &values[index])
+						num_errors++;
+					if (value_map.at(0x100 + index) != std::to_string(index))
+						num_errors++;
+					if (pointer_map.at(((k % num_fixed_keys) + 1) * 0x1000) != &values[num_threads * keys_per_thread + k % num_fixed_keys])
+						num_errors++;
+				}
+				for (int k = 0; k < keys_per_thread; ++k)
+				{
+					const int index = t * keys_per_thread + k;
+					if (pointer_map.erase(0x10000000 + index * 16) != &values[index])
+						num_errors++;
+					if (pointer_map.at(0x10000000 + index * 16) != nullptr)
+						num_errors++;
+					std::string value;
+					if (!value_map.erase(0x100 + index, value) || value != std::to_string(index))
+						num_errors++;
+				}
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	for (int i = 0; i < num_fixed_keys; ++i)
+		CHECK(pointer_map.at((i + 1) * 0x1000) == &values[num_threads * keys_per_thread + i]);
+
+	CHECK(num_errors == 0);
+	std::printf("%d threads inserted, looked up and erased %d keys each %d times, %d errors\n", num_threads, keys_per_thread, num_rounds, num_errors.load());
+}
+
+template <typename M>
+static double lookup_time(M &map, uint32_t num_keys, int num_threads)
+{
+	constexpr int lookups_per_thread = 2000000;
+
+	std::vector<uint64_t> keys;
+	for (uint32_t i = 0; i < num_keys; ++i)
+		keys.push_back(0x7ff600000000ull + i * 0x40);
+	for (const uint64_t key : keys)
+		map.emplace(key, reinterpret_cast<int *>(key));
+
+	std::atomic<uint64_t> sink = 0;
+	std::vector<std::thread> threads;
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			uint64_t sum = 0;
+			for (int i = 0; i < lookups_per_thread; ++i)
+				sum += reinterpret_cast<uintptr_t>(map.at(keys[(i * 7 + t) % num_keys]));
+			sink += sum;
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count() / (static_cast<double>(lookups_per_thread) * num_threads);
+}
+
+template <uint32_t MAX_ENTRIES>
+static void bench_lookup()
+{
+	for (const int num_threads : { 1, 8 })
+	{
+		const auto previous = std::make_unique<linear_scan_map<MAX_ENTRIES>>();
+		const auto sized = std::make_unique<lockfree_linear_map<uint64_t, int *, MAX_ENTRIES>>();
+		const auto grown = std::make_unique<lockfree_linear_map<uint64_t, int *, 8>>();
+
+		const uint32_t num_keys = MAX_ENTRIES * 3 / 4;
+		std::printf("%4u keys, %d threads: linear scan %7.1f ns, hashed %5.1f ns, hashed grown from 8 entries %6.1f ns\n", num_keys, num_threads,
+			lookup_time(*previous, num_keys, num_threads),
+			lookup_time(*sized, num_keys, num_threads),
+			lookup_time(*grown, num_keys, num_threads));
+	}
+}
+
+int main()
+{
+	test_single_thread();
+	test_concurrent();
+
+	bench_lookup<16>();
+	bench_lookup<64>();
+	bench_lookup<256>();
+	bench_lookup<1024>();
+	bench_lookup<4096>();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All lock-free map tests passed");
+	return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/log_history.hpp"
+#include "../source/log_message_queue.hpp"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+// Test and benchmark of showing the log in the overlay from the in-memory history of recent lines, compared to re-reading the log file whenever it grew
+// Uses the history and the incremental filtering of 'draw_gui_log' as is, with lines fed through the message queue to a single writer like 'write_queued_lines' does (e.g. "g++ -std=c++17 -O2 -pthread log_history_bench.cpp -o log_history_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::log::history;
+using reshade::log::history_view;
+
+constexpr size_t history_size = history::max_lines;
+
+// Same as in 'source/runtime_gui.cpp'
+static bool filter_text(const std::string_view &text, const std::string_view &filter)
+{
+	return filter.empty() ||
+		std::search(text.begin(), text.end(), filter.begin(), filter.end(),
+			[](const char c1, const char c2) { // Search case-insensitive
+				return (('a' <= c1 && c1 <= 'z') ? static_cast<char>(c1 - ' ') : c1) == (('a' <= c2 && c2 <= 'z') ? static_cast<char>(c2 - ' ') : c2);
+			}) != text.end();
+}
+
+// The history is too large for the stack, so tests share one and start over with a new one in place
+static history *s_history = new history();
+
+static void reset_history()
+{
+	delete s_history;
+	s_history = new history();
+}
+
+// Appends a line the way 'message::~message' formats it for the log file
+static void append_line(const std::string &line)
+{
+	std::string line_string;
+	for (const char c : line)
+	{
+		if (c == '\n')
+			line_string += '\r';
+		line_string += c;
+	}
+	line_string += "\r\n";
+
+	s_history->append(line_string);
+}
+
+static uint64_t read_history(uint64_t &next_sequence, std::vector<std::string> &lines)
+{
+	return s_history->read(next_sequence, lines);
+}
+
+// The filtered list has to contain exactly the kept lines that match the filter, in order
+static bool check_filtered_lines(const history_view &view)
+{
+	std::vector<uint64_t> expected;
+	for (size_t i = 0; i < view.lines().size(); ++i)
+		if (filter_text(view.lines()[i], view.filtered_text()))
+			expected.push_back(view.first_sequence() + i);
+	if (expected != view.filtered_sequences())
+		return false;
+
+	for (size_t i = 0; i < view.num_filtered_lines(); ++i)
+		if (view.filtered_line(i) != view.lines()[static_cast<size_t>(expected[i] - view.first_sequence())])
+			return false;
+	return true;
+}
+
+static std::string make_line(int index)
+{
+	char buffer[160];
+	std::snprintf(buffer, sizeof(buffer), "12:34:56:789 [ 1234] | %s | Message number %d with some payload text about resources and pipelines", index % 50 == 0 ? "WARN " : "INFO ", index);
+	return buffer;
+}
+
+static void test_history()
+{
+	reset_history();
+
+	// Multi-line messages are split into one entry per line, and a line is only added once it is terminated
+	append_line("first");
+	append_line("second\nthird\n");
+	s_history->append("fourth\nunterminated");
+	uint64_t next_sequence = 0;
+	std::vector<std::string> lines;
+	CHECK(read_history(next_sequence, lines) == 0);
+	CHECK(next_sequence == 5);
+	CHECK((lines == std::vector<std::string> { "first", "second", "third", "", "fourth" }));
+
+	// Reading again only returns the lines logged since
+	lines.clear();
+	append_line("fifth");
+	CHECK(read_history(next_sequence, lines) == 0);
+	CHECK((lines == std::vector<std::string> { "fifth" }));
+	lines.clear();
+	CHECK(read_history(next_sequence, lines) == 0 && lines.empty() && next_sequence == 6);
+
+	// Lines that were overwritten in the ring are reported as skipped, and the ones still kept are returned in order
+	for (size_t i = 0; i < history_size + 10; ++i)
+		append_line(std::to_string(i));
+	CHECK(read_history(next_sequence, lines) == 10);
+	CHECK(lines.size() == history_size);
+	CHECK(lines.front() == "10" && lines.back() == std::to_string(history_size + 9));
+
+	// Long lines use up the text storage before the maximum number of lines is reached, so fewer of them are kept, but those are complete
+	reset_history();
+	next_sequence = 0;
+	constexpr size_t long_line_length = 3000; // Multiple of the word size, so no space is lost to alignment
+	for (size_t i = 0; i < 1000; ++i)
+		append_line(std::string(long_line_length, static_cast<char>('a' + i % 26)));
+	lines.clear();
+	const uint64_t skipped = read_history(next_sequence, lines);
+	CHECK(skipped + lines.size() == 1000 && lines.size() == history::max_bytes / long_line_length);
+	CHECK(std::all_of(lines.begin(), lines.end(), [](const std::string &line) { return line.size() == long_line_length && line == std::string(long_line_length, line[0]); }));
+	CHECK(lines.back()[0] == 'a' + 999 % 26);
+
+	// A line larger than all of the text storage is cut off and replaces all other lines, until the next line overwrites its start
+	append_line(std::string(history::max_bytes + 100, 'x'));
+	lines.clear();
+	CHECK(read_history(next_sequence, lines) == 0 && lines.size() == 1 && lines[0] == std::string(history::max_bytes, 'x'));
+	append_line("after");
+	lines.clear();
+	CHECK(read_history(next_sequence, lines) == 0 && lines.size() == 1 && lines[0] == "after");
+	uint64_t first_sequence = 0;
+	lines.clear();
+	CHECK(read_history(first_sequence, lines) == 1001 && lines.size() == 1 && first_sequence == next_sequence);
+}
+
+static void test_view()
+{
+	reset_history();
+
+	history_view view;
+
+	// Change the filter now and then, both extending it (which only tests the lines still in the filtered list) and replacing it
+	const char *const filters[] = { "", "w", "wa", "warn", "message number 1", "message number 12", "info", "" };
+	int line_index = 0;
+	for (int frame = 0; frame < 400; ++frame)
+	{
+		// Occasionally log more lines in one frame than are kept in memory, so that the view has to start over
+		const int num_lines = frame % 97 == 96 ? static_cast<int>(history_size) + 100 : 100;
+		for (int k = 0; k < num_lines; ++k)
+			append_line(make_line(line_index++));
+
+		CHECK(view.update(read_history, filter_text, filters[(frame / 25) % std::size(filters)]) == std::min<size_t>(num_lines, history_size));
+		CHECK(check_filtered_lines(view));
+		CHECK(view.first_sequence() + view.lines().size() == view.next_sequence());
+		CHECK(view.lines().size() < 2 * history_size);
+	}
+
+	CHECK(view.next_sequence() == static_cast<uint64_t>(line_index));
+	CHECK(view.num_skipped_lines() != 0);
+	CHECK(view.lines().back() == make_line(line_index - 1));
+
+	// Clearing only keeps lines logged afterwards
+	view.clear();
+	CHECK(view.num_skipped_lines() == 0 && view.num_filtered_lines() == 0);
+	append_line(make_line(0));
+	CHECK(view.update(read_history, filter_text, "") == 1);
+	CHECK(view.num_filtered_lines() == 1 && view.filtered_line(0) == make_line(0));
+	CHECK(check_filtered_lines(view));
+}
+
+// Line of a logging thread, with a payload that depends on its index, so that a torn line that mixes text of different lines is detected
+static std::string make_thread_line(int thread_index, int index)
+{
+	return std::to_string(thread_index) + ' ' + std::to_string(index) + ' ' + std::string(static_cast<size_t>(index % 300), static_cast<char>('a' + (index + thread_index) % 26));
+}
+
+static void test_concurrent()
+{
+	reset_history();
+
+	constexpr int num_threads = 4, lines_per_thread = 50000;
+
+	// Same split as in 'source/dll_log.cpp': logging threads push to the queue, and only the thread holding the write mutex pops lines and appends them to the history
+	reshade::log::message_queue queue;
+	std::mutex write_mutex;
+	const auto write_queued_lines = [&]() {
+		std::string batch;
+		for (std::string line; queue.try_pop(line);)
+			batch += line;
+		s_history->append(batch);
+	};
+
+	std::atomic<int> num_threads_done = 0;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < lines_per_thread; ++i)
+			{
+				std::string line_string = make_thread_line(t, i) + "\r\n";
+				// Write queued lines in place of the writer thread when the queue is full, like 'message::~message' does
+				while (!queue.try_push(line_string))
+				{
+					const std::unique_lock<std::mutex> lock(write_mutex);
+					write_queued_lines();
+				}
+			}
+			num_threads_done++;
+		});
+
+	std::thread writer_thread([&]() {
+		while (num_threads_done != num_threads || !queue.empty())
+		{
+			{
+				const std::unique_lock<std::mutex> lock(write_mutex);
+				write_queued_lines();
+			}
+			std::this_thread::yield();
+		}
+	});
+
+	// Read without any locking while lines are appended, where lines of each thread have to arrive complete and in order, and every line is either read or reported as skipped
+	uint64_t next_sequence = 0, num_read = 0, num_skipped = 0;
+	int last_index[num_threads] = { -1, -1, -1, -1 };
+	bool in_order = true, complete = true;
+	while (num_read + num_skipped < static_cast<uint64_t>(num_threads) * lines_per_thread)
+	{
+		std::vector<std::string> lines;
+		const uint64_t skipped = read_history(next_sequence, lines);
+		num_skipped += skipped;
+		if (skipped != 0)
+			std::fill(std::begin(last_index), std::end(last_index), -1);
+
+		for (const std::string &line : lines)
+		{
+			int thread_index = 0, index = 0;
+			if (std::sscanf(line.c_str(), "%d %d", &thread_index, &index) != 2 || thread_index < 0 || thread_index >= num_threads || index < 0 || index >= lines_per_thread)
+			{
+				complete = false;
+				continue;
+			}
+			if (line != make_thread_line(thread_index, index))
+				complete = false;
+			if (index <= last_index[thread_index])
+				in_order = false;
+			last_index[thread_index] = index;
+		}
+		num_read += lines.size();
+
+		std::this_thread::yield();
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+	writer_thread.join();
+
+	CHECK(in_order);
+	CHECK(complete);
+	CHECK(num_read + num_skipped == static_cast<uint64_t>(num_threads) * lines_per_thread);
+	CHECK(next_sequence == static_cast<uint64_t>(num_threads) * lines_per_thread);
+
+	std::printf("Concurrent reader got %llu lines and skipped %llu while %d threads were logging\n", static_cast<unsigned long long>(num_read), static_cast<unsigned long long>(num_skipped), num_threads);
+}
+
+static void bench_viewer(const std::filesystem::path &path)
+{
+	constexpr int num_frames = 1000, lines_per_frame = 100;
+
+	// Previous version, which wrote to the log file and re-read up to 1000 matching lines from the start of it whenever it grew
+	{
+		std::ofstream file(path, std::ios::trunc);
+		double total_time = 0, worst_time = 0;
+		uintmax_t last_log_size = 0;
+		std::vector<std::string> log_lines;
+
+		for (int frame = 0; frame < num_frames; ++frame)
+		{
+			for (int k = 0; k < lines_per_frame; ++k)
+				file << make_line(frame * lines_per_frame + k) << "\r\n";
+			file.flush();
+
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			std::error_code ec;
+			const uintmax_t log_size = std::filesystem::file_size(path, ec);
+			if (log_size != last_log_size)
+			{
+				log_lines.clear();
+				std::ifstream log_file(path);
+				for (std::string line; std::getline(log_file, line) && log_lines.size() < 1000;)
+					if (filter_text(line, "warn"))
+						log_lines.push_back(line);
+				last_log_size = log_size;
+			}
+
+			const double time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start_time).count();
+			total_time += time;
+			worst_time = std::max(worst_time, time);
+		}
+
+		std::printf("Log file re-read: %7.1f us per frame on average, %7.1f us worst case\n", total_time / num_frames, worst_time);
+	}
+
+	// Current version, which appends to the history ring and only gets the new lines from it
+	{
+		reset_history();
+
+		history_view view;
+		double total_time = 0, worst_time = 0, append_time = 0;
+
+		for (int frame = 0; frame < num_frames; ++frame)
+		{
+			// The writer appends all lines it popped from the queue as one batch
+			std::string batch;
+			for (int k = 0; k < lines_per_frame; ++k)
+				batch += make_line(frame * lines_per_frame + k) + "\r\n";
+
+			const auto append_start_time = std::chrono::high_resolution_clock::now();
+			s_history->append(batch);
+			append_time += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - append_start_time).count();
+
+			const auto start_time = std::chrono::high_resolution_clock::now();
+			view.update(read_history, filter_text, "warn");
+
+			const double time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start_time).count();
+			total_time += time;
+			worst_time = std::max(worst_time, time);
+		}
+
+		CHECK(check_filtered_lines(view));
+		std::printf("History ring:     %7.1f us per frame on average, %7.1f us worst case, %.3f us for the writer to append a line\n", total_time / num_frames, worst_time, append_time / (num_frames * lines_per_frame));
+	}
+}
+
+int main()
+{
+	test_history();
+	test_view();
+	test_concurrent();
+
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "reshade_log_history_bench.log";
+	bench_viewer(path);
+	std::filesystem::remove(path);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All log history tests passed");
+	return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/log_message_queue.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <condition_variable>
+
+// Benchmark of logging from multiple threads through the lock-free queue and background writer, compared to formatting and writing every line under one global lock
+// The queue is the one the log backend uses, but since the rest of it uses Win32 file and event functions, this models the writer thread with a condition variable and writes to an unbuffered file in place of 'WriteFile' (e.g. "g++ -std=c++17 -O2 -pthread log_queue_bench.cpp -o log_queue_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static std::FILE *s_file = nullptr;
+
+static void write_to_file(const std::string &data)
+{
+	std::fwrite(data.data(), 1, data.size(), s_file);
+}
+
+static void format_line(std::ostringstream &stream, int thread_index, int message_index)
+{
+	stream.str(std::string());
+	stream.clear();
+	stream << std::right << std::setfill('0')
+		<< std::setw(2) << 12 << ':' << std::setw(2) << 34 << ':' << std::setw(2) << 56 << ':' << std::setw(3) << 789 << ' '
+		<< '[' << std::setw(5) << thread_index << ']' << std::setfill(' ') << " | " << "INFO " << " | " << std::left
+		<< "Message " << message_index << " from a hook thread";
+}
+
+// Previous design, which held one lock while formatting into a shared stream, converting line endings and writing the line
+static std::mutex s_old_mutex;
+static std::ostringstream s_old_stream;
+
+static void log_old(int thread_index, int message_index)
+{
+	const std::unique_lock<std::mutex> lock(s_old_mutex);
+
+	format_line(s_old_stream, thread_index, message_index);
+
+	std::string line = s_old_stream.str() + '\n';
+	for (size_t offset = 0; (offset = line.find('\n', offset)) != std::string::npos; offset += 2)
+		line.replace(offset, 1, "\r\n", 2);
+
+	write_to_file(line);
+}
+
+// Current design, see 'reshade::log::message::~message' and 'writer_thread'
+static reshade::log::message_queue s_message_queue;
+static std::mutex s_write_mutex;
+static std::mutex s_writer_event_mutex;
+static std::condition_variable s_writer_event;
+static bool s_writer_signaled = false;
+static std::atomic<bool> s_writer_sleeping = false;
+static std::atomic<bool> s_writer_exit = false;
+static std::atomic<size_t> s_queue_full_count = 0;
+thread_local std::ostringstream s_line_stream;
+
+static void write_queued_lines(std::string &batch, const std::string *last_line = nullptr)
+{
+	batch.clear();
+	for (std::string line; s_message_queue.try_pop(line);)
+		batch += line;
+	if (last_line != nullptr)
+		batch += *last_line;
+
+	if (!batch.empty())
+		write_to_file(batch);
+}
+
+static void writer_thread()
+{
+	std::string batch;
+
+	while (true)
+	{
+		{
+			const std::unique_lock<std::mutex> lock(s_write_mutex);
+
+			write_queued_lines(batch);
+		}
+
+		s_writer_sleeping.store(true);
+
+		if (s_message_queue.empty())
+		{
+			if (s_writer_exit)
+				break;
+
+			std::unique_lock<std::mutex> lock(s_writer_event_mutex);
+			s_writer_event.wait_for(lock, std::chrono::seconds(1), []() { return s_writer_signaled; });
+			s_writer_signaled = false;
+		}
+
+		s_writer_sleeping.store(false);
+	}
+}
+
+static void log_new(int thread_index, int message_index)
+{
+	format_line(s_line_stream, thread_index, message_index);
+
+	const std::string line = s_line_stream.str();
+
+	std::string line_string;
+	line_string.reserve(line.size() + 16);
+	for (const char c : line)
+	{
+		if (c == '\n')
+			line_string += '\r';
+		line_string += c;
+	}
+	line_string += "\r\n";
+
+	if (s_message_queue.try_push(line_string))
+	{
+		if (s_writer_sleeping.exchange(false))
+		{
+			{
+				const std::unique_lock<std::mutex> lock(s_writer_event_mutex);
+				s_writer_signaled = true;
+			}
+			s_writer_event.notify_one();
+		}
+		return;
+	}
+
+	s_queue_full_count++;
+
+	const std::unique_lock<std::mutex> lock(s_write_mutex);
+
+	std::string batch;
+	for (const auto start_time = std::chrono::steady_clock::now(); std::chrono::steady_clock::now() - start_time < std::chrono::seconds(1);)
+	{
+		write_queued_lines(batch);
+
+		if (s_message_queue.try_push(line_string))
+		{
+			write_queued_lines(batch);
+			return;
+		}
+
+		std::this_thread::yield();
+	}
+
+	write_queued_lines(batch, &line_string);
+}
+
+// Lines come out in the order they went in, a full queue rejects lines without losing them, and slots are reused after wrapping around
+static void test_queue()
+{
+	static reshade::log::message_queue queue;
+	CHECK(queue.empty());
+
+	for (size_t round = 0; round < 3; ++round)
+	{
+		size_t num_pushed = 0;
+		for (std::string line = "Line 0"; queue.try_push(line); line = "Line " + std::to_string(++num_pushed))
+			continue;
+		CHECK(num_pushed == reshade::log::message_queue::CAPACITY);
+		CHECK(!queue.empty());
+
+		size_t num_popped = 0;
+		for (std::string line; queue.try_pop(line); ++num_popped)
+			CHECK(line == "Line " + std::to_string(num_popped));
+		CHECK(num_popped == num_pushed);
+		CHECK(queue.empty());
+	}
+}
+
+template <typename F>
+static void run(const char *name, F log, int num_threads, int messages_per_thread)
+{
+	std::vector<std::thread> threads;
+	std::vector<std::vector<double>> latencies(num_threads);
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			latencies[t].reserve(messages_per_thread);
+			for (int i = 0; i < messages_per_thread; ++i)
+			{
+				const auto message_start_time = std::chrono::high_resolution_clock::now();
+				log(t, i);
+				latencies[t].push_back(std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - message_start_time).count());
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	const double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+	std::vector<double> all_latencies;
+	for (const std::vector<double> &thread_latencies : latencies)
+		all_latencies.insert(all_latencies.end(), thread_latencies.begin(), thread_latencies.end());
+	std::sort(all_latencies.begin(), all_latencies.end());
+
+	std::printf("%-24s %d threads: %8.0f lines/s, latency p50 %6.0f ns, p99 %7.0f ns, max %9.0f ns\n", name, num_threads,
+		num_threads * messages_per_thread / elapsed,
+		all_latencies[all_latencies.size() / 2],
+		all_latencies[all_latencies.size() * 99 / 100],
+		all_latencies.back());
+}
+
+// Every line has to be in the file exactly once, and the lines of each thread in the order they were logged
+static void check_log_file(const std::filesystem::path &path, int num_threads, int messages_per_thread)
+{
+	std::FILE *const file = std::fopen(path.string().c_str(), "rb");
+	CHECK(file != nullptr);
+	if (file == nullptr)
+		return;
+
+	std::vector<int> next_message(num_threads, 0);
+	size_t num_lines = 0, num_out_of_order = 0;
+
+	for (char buffer[256]; std::fgets(buffer, sizeof(buffer), file) != nullptr; ++num_lines)
+	{
+		int thread_index = -1, message_index = -1;
+		if (std::sscanf(buffer, "%*s [%d] | INFO  | Message %d", &thread_index, &message_index) != 2 || thread_index < 0 || thread_index >= num_threads)
+		{
+			num_out_of_order++;
+			continue;
+		}
+
+		if (message_index != next_message[thread_index])
+			num_out_of_order++;
+		next_message[thread_index] = message_index + 1;
+	}
+
+	std::fclose(file);
+
+	CHECK(num_lines == static_cast<size_t>(num_threads) * messages_per_thread);
+	CHECK(num_out_of_order == 0);
+	for (int t = 0; t < num_threads; ++t)
+		CHECK(next_message[t] == messages_per_thread);
+}
+
+int main()
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "reshade_log_queue_bench.log";
+	constexpr int messages_per_thread = 50000;
+
+	test_queue();
+
+	for (const int num_threads : { 1, 4, 8 })
+	{
+		s_file = std::fopen(path.string().c_str(), "wb");
+		std::setvbuf(s_file, nullptr, _IONBF, 0);
+		run("global lock", log_old, num_threads, messages_per_thread);
+		std::fclose(s_file);
+
+		s_file = std::fopen(path.string().c_str(), "wb");
+		std::setvbuf(s_file, nullptr, _IONBF, 0);
+		s_writer_exit = false;
+		std::thread writer(writer_thread);
+		run("queue and writer thread", log_new, num_threads, messages_per_thread);
+		s_writer_exit = true;
+		{
+			const std::unique_lock<std::mutex> lock(s_writer_event_mutex);
+			s_writer_signaled = true;
+		}
+		s_writer_event.notify_one();
+		writer.join();
+		std::fclose(s_file);
+
+		check_log_file(path, num_threads, messages_per_thread);
+	}
+
+	std::printf("Queue was full %zu times, in which case the logging thread wrote the lines itself\n", s_queue_full_count.load());
+
+	std::filesystem::remove(path);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All log queue tests passed");
+	return 0;
+}
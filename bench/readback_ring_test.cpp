@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The API headers use Microsoft extensions that the readback ring does not need, so stub them out to build with other compilers
+#include <cstddef>
+#define __declspec(x)
+#define __uuidof(x) x::uuid
+
+#include "../source/readback_ring.cpp"
+#include <deque>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Test of reading back screenshots through the ring of reusable intermediate resources against a mock device
+// The runtime needs a graphics device, so this runs the real 'readback_ring' (see 'source/readback_ring.cpp') on a device whose GPU executes submitted commands a configurable number of frames late (e.g. "g++ -std=c++17 -O2 -fpermissive -w -I../include readback_ring_test.cpp -o readback_ring_test")
+// The format conversion is replaced with a stub below, since the mock device only ever creates RGBA8 textures
+
+bool reshade::is_convertible_to_rgba8(api::format format)
+{
+	return format == api::format::r8g8b8a8_unorm;
+}
+bool reshade::convert_to_rgba8(api::format, uint32_t width, uint32_t height, const void *src, uint32_t src_row_pitch, uint8_t *dst, uint32_t)
+{
+	for (uint32_t y = 0; y < height; ++y)
+		std::memcpy(dst + static_cast<size_t>(y) * width * 4, static_cast<const uint8_t *>(src) + static_cast<size_t>(y) * src_row_pitch, static_cast<size_t>(width) * 4);
+	return true;
+}
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using namespace reshade;
+
+// Device with a single queue, whose GPU executes submitted commands 'gpu_latency' frames after they were submitted
+// Query results behave like on the different APIs: D3D9 to D3D11, OpenGL and Vulkan report whether they are available, D3D12 always returns what was last written to the readback buffer
+class mock_device : public api::device, public api::command_queue, public api::command_list
+{
+public:
+	enum class query_behavior
+	{
+		availability,
+		last_written,
+	};
+
+	struct resource
+	{
+		uint32_t width = 0, height = 0;
+		std::vector<uint8_t> data;
+		bool alive = false;
+	};
+
+	struct command
+	{
+		uint64_t dest;
+		uint32_t query_index; // Timestamp query written instead of copying a resource if 'dest' is zero
+		std::vector<uint8_t> data; // Content of the source resource at the time the copy was recorded, laid out like the destination
+	};
+
+	mock_device(api::device_api native_api, query_behavior queries, uint64_t gpu_latency, bool supports_queries = true) :
+		native_api(native_api), queries(queries), gpu_latency(gpu_latency), supports_queries(supports_queries) {}
+
+	api::device_api native_api;
+	query_behavior queries;
+	uint64_t gpu_latency;
+	bool supports_queries;
+
+	uint64_t frame = 0;
+	std::vector<resource> resources = std::vector<resource>(1); // Handle zero is invalid
+	std::vector<command> recorded;
+	std::deque<std::pair<uint64_t, std::vector<command>>> submitted;
+	std::vector<uint64_t> timestamps;
+	std::vector<bool> timestamps_available;
+	uint64_t gpu_time = 0;
+	// Intermediate resources the GPU has not finished copying into yet
+	std::vector<uint64_t> copies_in_flight;
+
+	size_t num_creates = 0;
+	size_t num_destroys = 0;
+	size_t num_wait_idle = 0;
+	size_t num_early_maps = 0;
+
+	uint64_t create_back_buffer(uint32_t width, uint32_t height, uint8_t fill)
+	{
+		resource &res = resources.emplace_back();
+		res.width = width;
+		res.height = height;
+		res.data.assign(static_cast<size_t>(width) * height * 4, fill);
+		res.alive = true;
+		return resources.size() - 1;
+	}
+
+	void execute(const std::vector<command> &commands)
+	{
+		for (const command &cmd : commands)
+		{
+			if (cmd.dest == 0)
+			{
+				timestamps[cmd.query_index] = ++gpu_time;
+				timestamps_available[cmd.query_index] = true;
+			}
+			else
+			{
+				resources[cmd.dest].data = cmd.data;
+				copies_in_flight.erase(std::find(copies_in_flight.begin(), copies_in_flight.end(), cmd.dest));
+			}
+		}
+	}
+
+	// Called at the end of every frame, like the swap chain does after the runtime processed it
+	void present(readback_ring &ring)
+	{
+		ring.process();
+		flush_immediate_command_list();
+
+		frame++;
+		while (!submitted.empty() && submitted.front().first + gpu_latency <= frame)
+		{
+			execute(submitted.front().second);
+			submitted.pop_front();
+		}
+	}
+
+	// api::api_object
+	uint64_t get_native() const override { return 0; }
+	void get_private_data(const uint8_t[16], uint64_t *data) const override { *data = 0; }
+	void set_private_data(const uint8_t[16], const uint64_t) override {}
+
+	// api::device
+	api::device_api get_api() const override { return native_api; }
+	bool check_capability(api::device_caps capability) const override { return capability == api::device_caps::copy_buffer_to_texture && native_api != api::device_api::d3d9 && native_api != api::device_api::d3d10 && native_api != api::device_api::d3d11; }
+	bool check_format_support(api::format, api::resource_usage) const override { return true; }
+	bool create_sampler(const api::sampler_desc &, api::sampler *out_handle) override { *out_handle = { 0 }; return false; }
+	void destroy_sampler(api::sampler) override {}
+	bool create_resource(const api::resource_desc &desc, const api::subresource_data *, api::resource_usage, api::resource *out_handle, void ** = nullptr) override
+	{
+		num_creates++;
+		resource &res = resources.emplace_back();
+		if (desc.type == api::resource_type::buffer)
+			res.data.resize(static_cast<size_t>(desc.buffer.size));
+		else
+			res.data.resize(static_cast<size_t>(desc.texture.width) * desc.texture.height * 4), res.width = desc.texture.width, res.height = desc.texture.height;
+		res.alive = true;
+		*out_handle = { resources.size() - 1 };
+		return true;
+	}
+	void destroy_resource(api::resource handle) override
+	{
+		if (handle.handle == 0)
+			return;
+		num_destroys++;
+		resources[handle.handle].alive = false;
+	}
+	api::resource_desc get_resource_desc(api::resource resource) const override
+	{
+		return api::resource_desc(resources[resource.handle].width, resources[resource.handle].height, 1, 1, api::format::r8g8b8a8_unorm, 1, api::memory_heap::gpu_only, api::resource_usage::render_target);
+	}
+	bool create_resource_view(api::resource, api::resource_usage, const api::resource_view_desc &, api::resource_view *out_handle) override { *out_handle = { 0 }; return false; }
+	void destroy_resource_view(api::resource_view) override {}
+	api::resource get_resource_from_view(api::resource_view) const override { return { 0 }; }
+	api::resource_view_desc get_resource_view_desc(api::resource_view) const override { return {}; }
+	bool map_buffer_region(api::resource resource, uint64_t, uint64_t, api::map_access, void **out_data) override
+	{
+		// Reading before the GPU finished the copy returns stale data on a real device
+		if (std::find(copies_in_flight.begin(), copies_in_flight.end(), resource.handle) != copies_in_flight.end())
+			num_early_maps++;
+		*out_data = resources[resource.handle].data.data();
+		return true;
+	}
+	void unmap_buffer_region(api::resource) override {}
+	bool map_texture_region(api::resource resource, uint32_t, const api::subresource_box *, api::map_access access, api::subresource_data *out_data) override
+	{
+		out_data->row_pitch = resources[resource.handle].width * 4;
+		out_data->slice_pitch = out_data->row_pitch * resources[resource.handle].height;
+		return map_buffer_region(resource, 0, 0, access, &out_data->data);
+	}
+	void unmap_texture_region(api::resource, uint32_t) override {}
+	void update_buffer_region(const void *, api::resource, uint64_t, uint64_t) override {}
+	void update_texture_region(const api::subresource_data &, api::resource, uint32_t, const api::subresource_box * = nullptr) override {}
+	bool create_pipeline(api::pipeline_layout, uint32_t, const api::pipeline_subobject *, api::pipeline *out_handle) override { *out_handle = { 0 }; return false; }
+	void destroy_pipeline(api::pipeline) override {}
+	bool create_pipeline_layout(uint32_t, const api::pipeline_layout_param *, api::pipeline_layout *out_handle) override { *out_handle = { 0 }; return false; }
+	void destroy_pipeline_layout(api::pipeline_layout) override {}
+	bool allocate_descriptor_sets(uint32_t, api::pipeline_layout, uint32_t, api::descriptor_set *) override { return false; }
+	void free_descriptor_sets(uint32_t, const api::descriptor_set *) override {}
+	void get_descriptor_pool_offset(api::descriptor_set, uint32_t, uint32_t, api::descriptor_pool *, uint32_t *) const override {}
+	void copy_descriptor_sets(uint32_t, const api::descriptor_set_copy *) override {}
+	void update_descriptor_sets(uint32_t, const api::descriptor_set_update *) override {}
+	bool create_query_pool(api::query_type type, uint32_t size, api::query_pool *out_handle) override
+	{
+		if (!supports_queries || type != api::query_type::timestamp)
+		{
+			*out_handle = { 0 };
+			return false;
+		}
+
+		timestamps.assign(size, 0);
+		timestamps_available.assign(size, false);
+		*out_handle = { 1 };
+		return true;
+	}
+	void destroy_query_pool(api::query_pool) override {}
+	bool get_query_pool_results(api::query_pool, uint32_t first, uint32_t count, void *results, uint32_t stride) override
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (queries == query_behavior::availability && !timestamps_available[first + i])
+				return false;
+			*reinterpret_cast<uint64_t *>(static_cast<uint8_t *>(results) + i * stride) = timestamps[first + i];
+		}
+		return true;
+	}
+	void set_resource_name(api::resource, const char *) override {}
+	void set_resource_view_name(api::resource_view, const char *) override {}
+
+	// api::device_object
+	api::device *get_device() override { return this; }
+
+	// api::command_queue
+	api::command_queue_type get_type() const override { return api::command_queue_type::graphics; }
+	void wait_idle() const override
+	{
+		mock_device *const self = const_cast<mock_device *>(this);
+		self->num_wait_idle++;
+		self->flush_immediate_command_list();
+		for (const auto &submission : submitted)
+			self->execute(submission.second);
+		self->submitted.clear();
+	}
+	void flush_immediate_command_list() const override
+	{
+		mock_device *const self = const_cast<mock_device *>(this);
+		if (!recorded.empty())
+			self->submitted.emplace_back(frame, std::move(self->recorded));
+		self->recorded.clear();
+	}
+	api::command_list *get_immediate_command_list() override { return this; }
+	void begin_debug_event(const char *, const float[4] = nullptr) override {}
+	void end_debug_event() override {}
+	void insert_debug_marker(const char *, const float[4] = nullptr) override {}
+
+	// api::command_list
+	void barrier(uint32_t, const api::resource *, const api::resource_usage *, const api::resource_usage *) override {}
+	void begin_render_pass(uint32_t, const api::render_pass_render_target_desc *, const api::render_pass_depth_stencil_desc * = nullptr) override {}
+	void end_render_pass() override {}
+	void bind_render_targets_and_depth_stencil(uint32_t, const api::resource_view *, api::resource_view = { 0 }) override {}
+	void bind_pipeline(api::pipeline_stage, api::pipeline) override {}
+	void bind_pipeline_states(uint32_t, const api::dynamic_state *, const uint32_t *) override {}
+	void bind_viewports(uint32_t, uint32_t, const api::viewport *) override {}
+	void bind_scissor_rects(uint32_t, uint32_t, const api::rect *) override {}
+	void push_constants(api::shader_stage, api::pipeline_layout, uint32_t, uint32_t, uint32_t, const void *) override {}
+	void push_descriptors(api::shader_stage, api::pipeline_layout, uint32_t, const api::descriptor_set_update &) override {}
+	void bind_descriptor_sets(api::shader_stage, api::pipeline_layout, uint32_t, uint32_t, const api::descriptor_set *) override {}
+	void bind_index_buffer(api::resource, uint64_t, uint32_t) override {}
+	void bind_vertex_buffers(uint32_t, uint32_t, const api::resource *, const uint64_t *, const uint32_t *) override {}
+	void bind_stream_output_buffers(uint32_t, uint32_t, const api::resource *, const uint64_t *, const uint64_t *) override {}
+	void draw(uint32_t, uint32_t, uint32_t, uint32_t) override {}
+	void draw_indexed(uint32_t, uint32_t, uint32_t, int32_t, uint32_t) override {}
+	void dispatch(uint32_t, uint32_t, uint32_t) override {}
+	void draw_or_dispatch_indirect(api::indirect_command, api::resource, uint64_t, uint32_t, uint32_t) override {}
+	void copy_resource(api::resource, api::resource) override {}
+	void copy_buffer_region(api::resource, uint64_t, api::resource, uint64_t, uint64_t) override {}
+	void copy_buffer_to_texture(api::resource, uint64_t, uint32_t, uint32_t, api::resource, uint32_t, const api::subresource_box * = nullptr) override {}
+	void copy_texture_region(api::resource source, uint32_t, const api::subresource_box *, api::resource dest, uint32_t, const api::subresource_box *, api::filter_mode = api::filter_mode::min_mag_mip_point) override
+	{
+		recorded.push_back({ dest.handle, 0, resources[source.handle].data });
+		copies_in_flight.push_back(dest.handle);
+	}
+	void copy_texture_to_buffer(api::resource source, uint32_t, const api::subresource_box *, api::resource dest, uint64_t, uint32_t = 0, uint32_t = 0) override
+	{
+		// Rows in the buffer are aligned on D3D12
+		const resource &src = resources[source.handle];
+		const size_t row_pitch = native_api == api::device_api::d3d12 ? (src.width * 4 + 255) & ~255 : src.width * 4;
+		std::vector<uint8_t> data(row_pitch * src.height);
+		for (uint32_t y = 0; y < src.height; ++y)
+			std::memcpy(data.data() + y * row_pitch, src.data.data() + static_cast<size_t>(y) * src.width * 4, static_cast<size_t>(src.width) * 4);
+
+		recorded.push_back({ dest.handle, 0, std::move(data) });
+		copies_in_flight.push_back(dest.handle);
+	}
+	void resolve_texture_region(api::resource, uint32_t, const api::subresource_box *, api::resource, uint32_t, int32_t, int32_t, int32_t, api::format) override {}
+	void clear_depth_stencil_view(api::resource_view, const float *, const uint8_t *, uint32_t = 0, const api::rect * = nullptr) override {}
+	void clear_render_target_view(api::resource_view, const float[4], uint32_t = 0, const api::rect * = nullptr) override {}
+	void clear_unordered_access_view_uint(api::resource_view, const uint32_t[4], uint32_t = 0, const api::rect * = nullptr) override {}
+	void clear_unordered_access_view_float(api::resource_view, const float[4], uint32_t = 0, const api::rect * = nullptr) override {}
+	void generate_mipmaps(api::resource_view) override {}
+	void begin_query(api::query_pool, api::query_type, uint32_t) override {}
+	void end_query(api::query_pool, api::query_type, uint32_t index) override
+	{
+		// Vulkan resets the query when the command list executes, so until then the result of the previous use stays available, same as the last written value on D3D12
+		recorded.push_back({ 0, index, {} });
+	}
+	void copy_query_pool_results(api::query_pool, api::query_type, uint32_t, uint32_t, api::resource, uint64_t, uint32_t) override {}
+};
+
+static const std::pair<const char *, mock_device::query_behavior> s_query_behaviors[] = {
+	{ "queries with availability", mock_device::query_behavior::availability },
+	{ "queries without availability", mock_device::query_behavior::last_written },
+};
+
+// Every screenshot is delivered with the content it was queued with, without mapping an intermediate resource before the GPU finished copying into it, no matter how deep the GPU queue is
+static void test_screenshot_every_frame(api::device_api api, mock_device::query_behavior queries, uint64_t gpu_latency)
+{
+	mock_device device(api, queries, gpu_latency);
+	readback_ring ring(&device, &device);
+	const uint64_t back_buffer = device.create_back_buffer(64, 32, 0);
+
+	std::vector<std::pair<uint64_t, uint8_t>> received;
+	for (uint64_t frame = 0; frame < 100; ++frame)
+	{
+		// Change the back buffer content each frame so the right data can be checked
+		const uint8_t fill = static_cast<uint8_t>(frame);
+		std::fill(device.resources[back_buffer].data.begin(), device.resources[back_buffer].data.end(), fill);
+
+		CHECK(ring.queue({ back_buffer }, api::resource_usage::present, [&received, &device, fill](std::vector<uint8_t> &&pixels) {
+			received.emplace_back(device.frame, pixels.empty() ? 0 : pixels[0]);
+			CHECK(pixels.size() == 64 * 32 * 4 && std::all_of(pixels.begin(), pixels.end(), [fill](uint8_t value) { return value == fill; }));
+		}) == readback_ring::status::success);
+
+		device.present(ring);
+	}
+	ring.process(true);
+
+	CHECK(received.size() == 100);
+	for (size_t i = 0; i < received.size(); ++i)
+		CHECK(received[i].second == static_cast<uint8_t>(i));
+
+	// Pixels of a frame are delivered as soon as the GPU finished the copy, without ever stalling on the device (apart from the final wait when the runtime goes away)
+	CHECK(received.front().first == gpu_latency);
+	CHECK(device.num_wait_idle == 1);
+	CHECK(device.num_early_maps == 0);
+
+	// Only as many intermediate resources as readbacks are in flight at once are created, and then reused
+	CHECK(device.num_creates == gpu_latency + 1);
+	CHECK(device.num_destroys == 0);
+
+	ring.destroy();
+	CHECK(device.num_destroys == device.num_creates);
+}
+
+static void test_reuse_by_dimensions()
+{
+	mock_device device(api::device_api::d3d12, mock_device::query_behavior::last_written, 2);
+	readback_ring ring(&device, &device);
+	const uint64_t small = device.create_back_buffer(16, 16, 1);
+	const uint64_t large = device.create_back_buffer(32, 32, 2);
+
+	// Alternating between two sizes keeps one intermediate resource per size, instead of recreating one each time
+	for (int i = 0; i < 20; ++i)
+	{
+		ring.queue({ i % 2 ? large : small }, api::resource_usage::present, [](std::vector<uint8_t> &&) {});
+		ring.queue({ i % 2 ? small : large }, api::resource_usage::present, [](std::vector<uint8_t> &&) {});
+		while (ring.num_pending() != 0)
+			device.present(ring);
+	}
+
+	CHECK(device.num_creates == 2);
+	CHECK(device.num_destroys == 0);
+	CHECK(device.num_wait_idle == 0);
+	CHECK(device.num_early_maps == 0);
+
+	// A new size replaces the resource of an unused slot
+	const uint64_t other = device.create_back_buffer(8, 8, 3);
+	ring.queue({ other }, api::resource_usage::present, [](std::vector<uint8_t> &&) {});
+	ring.process(true);
+	CHECK(device.num_destroys == 1);
+	CHECK(device.num_early_maps == 0);
+	ring.destroy();
+}
+
+static void test_slot_limit()
+{
+	mock_device device(api::device_api::vulkan, mock_device::query_behavior::last_written, 3);
+	readback_ring ring(&device, &device);
+	const uint64_t back_buffer = device.create_back_buffer(8, 8, 0);
+
+	// More readbacks in a single frame than there are slots fail, instead of creating resources without bound
+	size_t queued = 0, delivered = 0;
+	for (size_t i = 0; i < readback_ring::max_slots + 4; ++i)
+		queued += ring.queue({ back_buffer }, api::resource_usage::present, [&delivered](std::vector<uint8_t> &&) { delivered++; }) == readback_ring::status::success;
+
+	CHECK(queued == readback_ring::max_slots);
+	CHECK(ring.num_pending() == readback_ring::max_slots);
+
+	for (uint64_t k = 0; k <= device.gpu_latency; ++k)
+		device.present(ring);
+
+	CHECK(delivered == queued);
+	CHECK(device.num_wait_idle == 0);
+	CHECK(device.num_early_maps == 0);
+	CHECK(ring.queue({ back_buffer }, api::resource_usage::present, [](std::vector<uint8_t> &&) {}) == readback_ring::status::success);
+	ring.process(true);
+	ring.destroy();
+}
+
+// Readbacks that are finished synchronously after waiting for the queue to become idle must not make the next readback in the same slot look complete early
+static void test_synchronous_readback()
+{
+	mock_device device(api::device_api::d3d12, mock_device::query_behavior::last_written, 3);
+	readback_ring ring(&device, &device);
+	const uint64_t back_buffer = device.create_back_buffer(16, 16, 5);
+
+	std::vector<uint8_t> pixels(16 * 16 * 4);
+	for (int i = 0; i < 3; ++i)
+	{
+		size_t slot_index = readback_ring::invalid_slot;
+		CHECK(ring.queue({ back_buffer }, api::resource_usage::present, slot_index) == readback_ring::status::success);
+		device.wait_idle();
+		CHECK(ring.finish(slot_index, pixels.data()));
+		CHECK(pixels[0] == 5);
+
+		bool delivered = false;
+		CHECK(ring.queue({ back_buffer }, api::resource_usage::present, [&delivered](std::vector<uint8_t> &&) { delivered = true; }) == readback_ring::status::success);
+		for (uint64_t k = 0; k < device.gpu_latency; ++k)
+		{
+			device.present(ring);
+			CHECK(!delivered);
+		}
+		device.present(ring);
+		CHECK(delivered);
+	}
+
+	CHECK(device.num_early_maps == 0);
+	ring.destroy();
+}
+
+// Devices that cannot create timestamp queries fall back to waiting for the queue to become idle once per frame
+static void test_without_queries()
+{
+	mock_device device(api::device_api::opengl, mock_device::query_behavior::availability, 3, false);
+	readback_ring ring(&device, &device);
+	const uint64_t back_buffer = device.create_back_buffer(16, 16, 7);
+
+	size_t delivered = 0;
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		ring.queue({ back_buffer }, api::resource_usage::present, [&delivered](std::vector<uint8_t> &&pixels) { delivered += !pixels.empty() && pixels[0] == 7; });
+		device.present(ring);
+	}
+	ring.process(true);
+
+	CHECK(delivered == 10);
+	CHECK(device.num_early_maps == 0);
+	CHECK(device.num_wait_idle == 10);
+	ring.destroy();
+}
+
+static void bench_present_overhead()
+{
+	for (const auto &[name, queries] : s_query_behaviors)
+	{
+		mock_device device(api::device_api::d3d12, queries, 3);
+		readback_ring ring(&device, &device);
+		const uint64_t back_buffer = device.create_back_buffer(1920, 1080, 0);
+
+		const auto start_time = std::chrono::high_resolution_clock::now();
+		for (uint64_t frame = 0; frame < 1000; ++frame)
+		{
+			if (frame % 10 == 0)
+				ring.queue({ back_buffer }, api::resource_usage::present, [](std::vector<uint8_t> &&) {});
+			device.present(ring);
+		}
+		ring.process(true);
+		const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+		std::printf("1000 frames with a 1920x1080 screenshot every 10 frames, %s: %.1f ms, %zu intermediate resources created, %zu waits for idle\n", name, elapsed, device.num_creates, device.num_wait_idle);
+		ring.destroy();
+	}
+}
+
+int main()
+{
+	for (const api::device_api api : { api::device_api::d3d11, api::device_api::d3d12, api::device_api::vulkan })
+		for (const auto &[name, queries] : s_query_behaviors)
+			for (const uint64_t gpu_latency : { 1, 3, 6, 10 })
+				test_screenshot_every_frame(api, queries, gpu_latency);
+	test_reuse_by_dimensions();
+	test_slot_limit();
+	test_synchronous_readback();
+	test_without_queries();
+	bench_present_overhead();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All readback tests passed");
+	return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/sharded_unordered_map.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Test and benchmark of the sharded map the D3D12 device keeps resource views in, compared to one map under a single lock like the device mutex, with 1 to 16 threads creating, looking up and destroying views
+// Each lock counts the acquisitions that could not be taken right away and had to wait for another thread, which is the contention that sharding is meant to avoid (e.g. "g++ -std=c++17 -O2 -pthread resource_view_registry_bench.cpp -o resource_view_registry_bench")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+// Same size as 'reshade::api::resource_view_desc'
+struct resource_view_desc
+{
+	uint32_t type;
+	uint32_t format;
+	uint64_t first_level;
+	uint64_t level_count;
+	uint32_t first_layer;
+	uint32_t layer_count;
+};
+
+using view_data = std::pair<void *, resource_view_desc>;
+
+static thread_local uint64_t s_acquisitions = 0;
+static thread_local uint64_t s_waits = 0;
+
+// Shared mutex that counts how often a thread had to wait for it
+class counting_shared_mutex
+{
+public:
+	void lock()
+	{
+		s_acquisitions++;
+		if (_mutex.try_lock())
+			return;
+
+		s_waits++;
+		_mutex.lock();
+	}
+	bool try_lock() { return _mutex.try_lock(); }
+	void unlock() { _mutex.unlock(); }
+
+	void lock_shared()
+	{
+		s_acquisitions++;
+		if (_mutex.try_lock_shared())
+			return;
+
+		s_waits++;
+		_mutex.lock_shared();
+	}
+	bool try_lock_shared() { return _mutex.try_lock_shared(); }
+	void unlock_shared() { _mutex.unlock_shared(); }
+
+private:
+	std::shared_mutex _mutex;
+};
+
+// Previous design, with all views in one map under the device mutex
+class single_lock_map
+{
+public:
+	void insert_or_assign(uintptr_t key, const view_data &value)
+	{
+		const std::unique_lock<counting_shared_mutex> lock(_mutex);
+		_map.insert_or_assign(key, value);
+	}
+
+	bool erase(uintptr_t key)
+	{
+		const std::unique_lock<counting_shared_mutex> lock(_mutex);
+		return _map.erase(key) != 0;
+	}
+
+	bool find(uintptr_t key, view_data &value) const
+	{
+		const std::shared_lock<counting_shared_mutex> lock(_mutex);
+
+		if (const auto it = _map.find(key); it != _map.end())
+		{
+			value = it->second;
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	mutable counting_shared_mutex _mutex;
+	std::unordered_map<uintptr_t, view_data> _map;
+};
+
+using sharded_map = sharded_unordered_map<uintptr_t, view_data, 64, 12, counting_shared_mutex>;
+
+// Descriptor handles are addresses in a heap, with 32 bytes per descriptor
+// Threads create views in chunks of 64 descriptors, which are interleaved with the chunks of other threads, the same as when each thread allocates from a shared heap
+constexpr size_t descriptors_per_chunk = 64;
+constexpr size_t views_per_thread = 4096;
+constexpr uintptr_t heap_base = 0x10000000;
+
+static uintptr_t descriptor_handle(size_t thread_index, size_t num_threads, size_t view_index)
+{
+	const size_t chunk = (view_index / descriptors_per_chunk) * num_threads + thread_index;
+	return heap_base + (chunk * descriptors_per_chunk + view_index % descriptors_per_chunk) * 32;
+}
+
+static view_data make_view_data(size_t thread_index, size_t view_index)
+{
+	view_data data = {};
+	data.first = reinterpret_cast<void *>((thread_index << 32) | view_index);
+	data.second.format = static_cast<uint32_t>(view_index);
+	data.second.layer_count = static_cast<uint32_t>(thread_index);
+	return data;
+}
+
+struct result
+{
+	double milliseconds;
+	uint64_t acquisitions;
+	uint64_t waits;
+	uint64_t wrong_values;
+};
+
+// Every round, each thread creates its views, looks each up a number of times (e.g. from command list hooks) and then destroys them again
+template <typename T>
+static result run(size_t num_threads, size_t lookups_per_view, size_t num_rounds)
+{
+	T map;
+	std::atomic<uint64_t> acquisitions = 0, waits = 0, wrong_values = 0;
+
+	std::vector<std::thread> threads;
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	for (size_t t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			s_acquisitions = 0;
+			s_waits = 0;
+			uint64_t thread_wrong_values = 0;
+
+			for (size_t round = 0; round < num_rounds; ++round)
+			{
+				for (size_t i = 0; i < views_per_thread; ++i)
+					map.insert_or_assign(descriptor_handle(t, num_threads, i), make_view_data(t, i));
+
+				for (size_t k = 0; k < lookups_per_view; ++k)
+				{
+					for (size_t i = 0; i < views_per_thread; ++i)
+					{
+						view_data data;
+						if (!map.find(descriptor_handle(t, num_threads, i), data) || data.first != make_view_data(t, i).first || data.second.format != i)
+							thread_wrong_values++;
+					}
+				}
+
+				for (size_t i = 0; i < views_per_thread; ++i)
+					if (!map.erase(descriptor_handle(t, num_threads, i)))
+						thread_wrong_values++;
+			}
+
+			acquisitions += s_acquisitions;
+			waits += s_waits;
+			wrong_values += thread_wrong_values;
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+	return { elapsed, acquisitions.load(), waits.load(), wrong_values.load() };
+}
+
+static void test_erase_if()
+{
+	sharded_unordered_map<uintptr_t, view_data> map;
+	for (size_t i = 0; i < 10000; ++i)
+		map.insert_or_assign(descriptor_handle(0, 1, i), make_view_data(i % 3, i));
+
+	// Remove all views of one resource, like 'unregister_resource' would
+	map.erase_if([](uintptr_t, const view_data &data) { return (reinterpret_cast<uintptr_t>(data.first) >> 32) == 1; });
+
+	size_t num_found = 0;
+	for (size_t i = 0; i < 10000; ++i)
+	{
+		view_data data;
+		const bool found = map.find(descriptor_handle(0, 1, i), data);
+		CHECK(found == (i % 3 != 1));
+		num_found += found;
+	}
+	CHECK(num_found == 10000 - 3333);
+
+	// Assigning an existing key replaces its value
+	map.insert_or_assign(descriptor_handle(0, 1, 0), make_view_data(7, 0));
+	view_data data;
+	CHECK(map.find(descriptor_handle(0, 1, 0), data) && data.first == make_view_data(7, 0).first);
+	CHECK(map.erase(descriptor_handle(0, 1, 0)) && !map.erase(descriptor_handle(0, 1, 0)));
+}
+
+int main()
+{
+	test_erase_if();
+
+	constexpr size_t num_rounds = 20;
+
+	std::printf("threads lookups   single lock (waits per 1000 locks)   sharded (waits per 1000 locks)\n");
+
+	for (const size_t num_threads : { 1, 4, 16 })
+	{
+		for (const size_t lookups_per_view : { 1, 8 })
+		{
+			const result a = run<single_lock_map>(num_threads, lookups_per_view, num_rounds);
+			const result b = run<sharded_map>(num_threads, lookups_per_view, num_rounds);
+
+			CHECK(a.wrong_values == 0);
+			CHECK(b.wrong_values == 0);
+
+			std::printf("%7zu %7zu %10.1f ms (%7.3f)                  %10.1f ms (%7.3f)\n", num_threads, lookups_per_view,
+				a.milliseconds, 1000.0 * a.waits / a.acquisitions,
+				b.milliseconds, 1000.0 * b.waits / b.acquisitions);
+		}
+	}
+
+	std::printf("%u hardware threads available, so with more threads than that they are time-sliced and waits are mostly caused by a lock holder being preempted\n", std::thread::hardware_concurrency());
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All resource view registry tests passed");
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Include the pack tool itself, so that the test runs the real writer instead of a copy of it
+#define main shader_pack_main
+#include "../examples/03-shader_replace/shader_pack.cpp"
+#undef main
+#include <chrono>
+#include <random>
+#include <cstring>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// Test and benchmark of the shader pack written by the shader_pack tool and read by the shader_replace add-on
+// Packs a directory of random dumped shaders, then checks that every one is found with identical contents and that corrupt packs are rejected (e.g. "g++ -std=c++17 -O2 shader_pack_test.cpp -o shader_pack_test")
+// On Linux this also compares the resident memory of looking up shaders in the mapped pack against reading every one into a vector that is never freed, which is what the add-on did before
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+static std::vector<uint8_t> read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+#ifdef __linux__
+static long resident_memory_kb()
+{
+	long value = 0;
+	if (FILE *const file = std::fopen("/proc/self/status", "r"))
+	{
+		for (char line[256]; std::fgets(line, sizeof(line), file) != nullptr;)
+			if (std::strncmp(line, "VmRSS:", 6) == 0)
+				std::sscanf(line + 6, "%ld", &value);
+		std::fclose(file);
+	}
+	return value;
+}
+#endif
+
+int main()
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "reshade_shader_pack_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory / "shaders");
+
+	struct shader
+	{
+		uint32_t hash;
+		shader_pack_type type;
+		std::filesystem::path path;
+	};
+
+	constexpr size_t num_shaders = 5000;
+	constexpr size_t num_lookups = 20000;
+
+	// Write random shaders named like the files the shader_dump add-on writes
+	std::vector<shader> shaders;
+	std::mt19937 rng(1);
+	for (size_t i = 0; i < num_shaders; ++i)
+	{
+		static const char *const extensions[] = { ".cso", ".spv", ".glsl" };
+
+		shader &s = shaders.emplace_back();
+		s.hash = static_cast<uint32_t>(rng());
+		s.type = static_cast<shader_pack_type>(i % 3);
+
+		char file_name[64];
+		std::snprintf(file_name, sizeof(file_name), "game.exe_shader_0x%08X%s", s.hash, extensions[i % 3]);
+		s.path = directory / "shaders" / file_name;
+
+		std::vector<char> code(64 + rng() % 3000);
+		for (char &c : code)
+			c = static_cast<char>(rng());
+		std::ofstream(s.path, std::ios::binary).write(code.data(), code.size());
+	}
+
+	const std::string input_path = (directory / "shaders").u8string();
+	const std::string output_path = (directory / "game.exe_shaders.pack").u8string();
+	char program_name[] = "shader_pack";
+	char *argv[] = { program_name, const_cast<char *>(input_path.c_str()), const_cast<char *>(output_path.c_str()) };
+	CHECK(shader_pack_main(3, argv) == 0);
+
+	std::vector<uint8_t> pack = read_file(output_path);
+	CHECK(validate_shader_pack(pack.data(), pack.size()));
+
+	for (const shader &s : shaders)
+	{
+		const shader_pack_entry *const entry = find_shader_pack_entry(pack.data(), s.hash, s.type);
+		CHECK(entry != nullptr && entry->offset % shader_pack_alignment == 0);
+		if (entry == nullptr)
+			continue;
+
+		const std::vector<uint8_t> code = read_file(s.path);
+		CHECK(entry->size == code.size() && std::memcmp(pack.data() + entry->offset, code.data(), code.size()) == 0);
+	}
+
+	CHECK(find_shader_pack_entry(pack.data(), shaders[0].hash, static_cast<shader_pack_type>((static_cast<uint32_t>(shaders[0].type) + 1) % 3)) == nullptr);
+
+	// Corrupt packs must be rejected before anything is looked up in them
+	{
+		CHECK(!validate_shader_pack(pack.data(), sizeof(shader_pack_header) - 1));
+		CHECK(!validate_shader_pack(pack.data(), sizeof(shader_pack_header) + sizeof(shader_pack_entry)));
+
+		std::vector<uint8_t> corrupt = pack;
+		auto entries = reinterpret_cast<shader_pack_entry *>(corrupt.data() + sizeof(shader_pack_header));
+		std::swap(entries[0], entries[1]);
+		CHECK(!validate_shader_pack(corrupt.data(), corrupt.size()));
+
+		corrupt = pack;
+		entries = reinterpret_cast<shader_pack_entry *>(corrupt.data() + sizeof(shader_pack_header));
+		entries[10].size = corrupt.size();
+		CHECK(!validate_shader_pack(corrupt.data(), corrupt.size()));
+	}
+
+#ifdef __linux__
+	// Map the pack like the add-on does and look up shaders as pipeline creation would
+	{
+		const int file = open(output_path.c_str(), O_RDONLY);
+		const uint8_t *const data = static_cast<const uint8_t *>(mmap(nullptr, pack.size(), PROT_READ, MAP_PRIVATE, file, 0));
+		CHECK(data != MAP_FAILED);
+
+		const long rss_before = resident_memory_kb();
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		size_t checksum = 0;
+		for (size_t i = 0; i < num_lookups; ++i)
+		{
+			const shader &s = shaders[i % shaders.size()];
+			if (const shader_pack_entry *const entry = find_shader_pack_entry(data, s.hash, s.type))
+				checksum += data[entry->offset + entry->size - 1];
+		}
+
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count();
+		std::printf("Mapped pack: %zu lookups, %.0f ns per lookup, RSS %+ld KiB (file-backed, %zu KiB pack) (%zu)\n",
+			num_lookups, elapsed / num_lookups, resident_memory_kb() - rss_before, pack.size() / 1024, checksum);
+
+		munmap(const_cast<uint8_t *>(data), pack.size());
+		close(file);
+	}
+
+	// Previous behavior when pipeline creation fails and nothing frees the copy
+	{
+		const long rss_before = resident_memory_kb();
+
+		std::vector<std::vector<uint8_t>> data_to_delete;
+		for (size_t i = 0; i < num_lookups; ++i)
+			data_to_delete.push_back(read_file(shaders[i % shaders.size()].path));
+
+		std::printf("Read into vectors: %zu lookups, RSS %+ld KiB (anonymous, grows with every creation)\n", num_lookups, resident_memory_kb() - rss_before);
+	}
+#endif
+
+	std::filesystem::remove_all(directory);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All shader pack tests passed");
+	return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/texture_cache.hpp"
+#include "../source/hash_utils.hpp"
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+// Test and benchmark of the texture cache, which stores decoded and mipmapped image data keyed by the file contents and texture description
+// Loads textures the way the runtime does against a temporary cache directory, with zlib compressed source files standing in for PNG decoding (e.g. "g++ -std=c++17 -O2 -I../include texture_cache_test.cpp ../source/texture_cache.cpp -lz -o texture_cache_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using clock_type = std::chrono::high_resolution_clock;
+using reshade::api::format;
+
+// Reads the entire file in one go, like the runtime does
+static bool read_file(const std::filesystem::path &path, std::string &data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	return file.read(data.data(), data.size()).good();
+}
+
+// Same as 'runtime::load_effect_cache' and 'runtime::save_effect_cache', which do not overwrite existing files
+static bool load_cache_file(const std::filesystem::path &cache_path, const std::string &id, std::string &data)
+{
+	return read_file(cache_path / ("reshade-" + id + ".tex"), data);
+}
+static bool save_cache_file(const std::filesystem::path &cache_path, const std::string &id, const std::string &data)
+{
+	const std::filesystem::path path = cache_path / ("reshade-" + id + ".tex");
+	if (std::filesystem::exists(path))
+		return false;
+	std::ofstream file(path, std::ios::binary);
+	file.write(data.data(), data.size());
+	return file.good();
+}
+
+struct texture_desc
+{
+	std::filesystem::path source_path;
+	uint32_t width, height, levels;
+};
+
+// Decodes the source file and generates the mipmap chain with a box filter, in place of 'stbi_load_from_memory' and 'convert_texture_data'
+static bool decode_texture(const std::string &mem, const texture_desc &desc, std::vector<uint8_t> &data)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(desc.width) * desc.height * 4);
+	uLongf size = static_cast<uLongf>(pixels.size());
+	if (uncompress(pixels.data(), &size, reinterpret_cast<const Bytef *>(mem.data()), static_cast<uLong>(mem.size())) != Z_OK || size != pixels.size())
+		return false;
+
+	data.resize(reshade::texture_data_size(format::r8g8b8a8_unorm, desc.width, desc.height, desc.levels));
+	std::memcpy(data.data(), pixels.data(), pixels.size());
+
+	size_t offset = 0;
+	for (uint32_t level = 1; level < desc.levels; ++level)
+	{
+		const uint32_t src_width = std::max(desc.width >> (level - 1), 1u), src_height = std::max(desc.height >> (level - 1), 1u);
+		const uint32_t dst_width = std::max(desc.width >> level, 1u), dst_height = std::max(desc.height >> level, 1u);
+		const uint8_t *const src = data.data() + offset;
+		offset += static_cast<size_t>(src_width) * src_height * 4;
+		uint8_t *const dst = data.data() + offset;
+
+		for (uint32_t y = 0; y < dst_height; ++y)
+			for (uint32_t x = 0; x < dst_width; ++x)
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const uint32_t x0 = std::min(x * 2, src_width - 1), x1 = std::min(x * 2 + 1, src_width - 1);
+					const uint32_t y0 = std::min(y * 2, src_height - 1), y1 = std::min(y * 2 + 1, src_height - 1);
+					dst[(y * dst_width + x) * 4 + c] = static_cast<uint8_t>((
+						src[(y0 * src_width + x0) * 4 + c] + src[(y0 * src_width + x1) * 4 + c] +
+						src[(y1 * src_width + x0) * 4 + c] + src[(y1 * src_width + x1) * 4 + c] + 2) / 4);
+				}
+	}
+
+	return true;
+}
+
+struct load_result
+{
+	bool cache_hit = false;
+	std::vector<uint8_t> data;
+};
+
+// Follows the texture load job in 'runtime::load_textures'
+static load_result load_texture(const std::filesystem::path &cache_path, const texture_desc &desc)
+{
+	load_result result;
+
+	std::string mem;
+	read_file(desc.source_path, mem);
+	const std::string cache_id = reshade::texture_cache_id(desc.source_path, mem.data(), mem.size(), format::r8g8b8a8_unorm, desc.width, desc.height, desc.levels);
+
+	if (std::string cached_data; load_cache_file(cache_path, cache_id, cached_data))
+	{
+		if (reshade::parse_texture_cache_data(cached_data, format::r8g8b8a8_unorm, desc.width, desc.height, desc.levels, result.data))
+		{
+			result.cache_hit = true;
+			return result;
+		}
+
+		std::error_code ec;
+		std::filesystem::remove(cache_path / ("reshade-" + cache_id + ".tex"), ec);
+	}
+
+	if (decode_texture(mem, desc, result.data))
+		save_cache_file(cache_path, cache_id, reshade::build_texture_cache_data(format::r8g8b8a8_unorm, desc.width, desc.height, desc.levels, result.data));
+	else
+		result.data.clear();
+
+	return result;
+}
+
+static void write_source_file(const texture_desc &desc, uint32_t seed)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(desc.width) * desc.height * 4);
+	uint32_t random = seed;
+	for (size_t i = 0; i < pixels.size(); i += 4)
+	{
+		random = random * 1664525 + 1013904223;
+		const size_t x = (i / 4) % desc.width, y = (i / 4) / desc.width;
+		pixels[i + 0] = static_cast<uint8_t>(x + seed);
+		pixels[i + 1] = static_cast<uint8_t>(y);
+		pixels[i + 2] = static_cast<uint8_t>((random >> 24) & 0xF);
+		pixels[i + 3] = 255;
+	}
+
+	std::vector<uint8_t> compressed(compressBound(static_cast<uLong>(pixels.size())));
+	uLongf size = static_cast<uLongf>(compressed.size());
+	compress2(compressed.data(), &size, pixels.data(), static_cast<uLong>(pixels.size()), 6);
+
+	std::ofstream file(desc.source_path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(compressed.data()), size);
+}
+
+static size_t count_cache_files(const std::filesystem::path &cache_path)
+{
+	size_t count = 0;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(cache_path))
+		count += entry.path().extension() == ".tex";
+	return count;
+}
+
+static void test_cache_id()
+{
+	const std::filesystem::path path = "textures/Noise.png";
+
+	// Names are persisted, so they must not change between builds
+	CHECK(reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm, 256, 256, 9) == "Noise-44bc2cf5ad770999-256x256x9-28");
+
+	const std::string base = reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm, 256, 256, 9);
+	CHECK(reshade::texture_cache_id(path, "abd", 3, format::r8g8b8a8_unorm, 256, 256, 9) != base);
+	CHECK(reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm_srgb, 256, 256, 9) != base);
+	CHECK(reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm, 512, 256, 9) != base);
+	CHECK(reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm, 256, 512, 9) != base);
+	CHECK(reshade::texture_cache_id(path, "abc", 3, format::r8g8b8a8_unorm, 256, 256, 1) != base);
+	CHECK(reshade::texture_cache_id("other/Noise.png", "abc", 3, format::r8g8b8a8_unorm, 256, 256, 9) == base);
+}
+
+static void test_cache_data()
+{
+	const uint32_t width = 37, height = 19, levels = 6;
+	std::vector<uint8_t> data(reshade::texture_data_size(format::r8g8b8a8_unorm, width, height, levels));
+	CHECK(data.size() == (37 * 19 + 18 * 9 + 9 * 4 + 4 * 2 + 2 * 1 + 1 * 1) * 4);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = static_cast<uint8_t>(i * 7);
+
+	const std::string cached_data = reshade::build_texture_cache_data(format::r8g8b8a8_unorm, width, height, levels, data);
+
+	std::vector<uint8_t> parsed;
+	CHECK(reshade::parse_texture_cache_data(cached_data, format::r8g8b8a8_unorm, width, height, levels, parsed) && parsed == data);
+
+	// Files written for a different texture description have to be rejected, even though the name would normally differ too
+	parsed.clear();
+	CHECK(!reshade::parse_texture_cache_data(cached_data, format::r8g8b8a8_unorm_srgb, width, height, levels, parsed));
+	CHECK(!reshade::parse_texture_cache_data(cached_data, format::r8g8b8a8_unorm, width + 1, height, levels, parsed));
+	CHECK(!reshade::parse_texture_cache_data(cached_data, format::r8g8b8a8_unorm, width, height, levels - 1, parsed));
+	CHECK(parsed.empty());
+
+	// Truncated and extended files, an empty file and a file of a previous cache version
+	CHECK(!reshade::parse_texture_cache_data(cached_data.substr(0, cached_data.size() - 1), format::r8g8b8a8_unorm, width, height, levels, parsed));
+	CHECK(!reshade::parse_texture_cache_data(cached_data + '\0', format::r8g8b8a8_unorm, width, height, levels, parsed));
+	CHECK(!reshade::parse_texture_cache_data(cached_data.substr(0, 10), format::r8g8b8a8_unorm, width, height, levels, parsed));
+	CHECK(!reshade::parse_texture_cache_data(std::string(), format::r8g8b8a8_unorm, width, height, levels, parsed));
+	std::string old_version = cached_data;
+	old_version[4] = 1;
+	CHECK(!reshade::parse_texture_cache_data(old_version, format::r8g8b8a8_unorm, width, height, levels, parsed));
+	CHECK(parsed.empty());
+}
+
+// Loads textures cold (empty cache) and warm (every file cached), and checks that editing a source file or corrupting a cache file invalidates only that entry
+static void test_and_bench_load(const std::filesystem::path &temp_path)
+{
+	const std::filesystem::path source_path = temp_path / "textures";
+	const std::filesystem::path cache_path = temp_path / "cache";
+	std::filesystem::create_directories(source_path);
+	std::filesystem::create_directories(cache_path);
+
+	std::vector<texture_desc> textures;
+	for (uint32_t i = 0; i < 24; ++i)
+	{
+		const uint32_t size = i < 4 ? 2048 : i < 12 ? 1024 : 256;
+		texture_desc &desc = textures.emplace_back();
+		desc.source_path = source_path / ("texture" + std::to_string(i) + ".png");
+		desc.width = size;
+		desc.height = size / (1 + i % 2);
+		desc.levels = 1 + (i % 3 == 0 ? 0 : static_cast<uint32_t>(std::log2(size)));
+		write_source_file(desc, i);
+	}
+
+	std::vector<std::vector<uint8_t>> cold_data;
+	double time[2] = {};
+	size_t total_size = 0;
+	for (int warm = 0; warm < 2; ++warm)
+	{
+		const auto start_time = clock_type::now();
+		for (const texture_desc &desc : textures)
+		{
+			load_result result = load_texture(cache_path, desc);
+			CHECK(result.cache_hit == (warm != 0));
+			CHECK(result.data.size() == reshade::texture_data_size(format::r8g8b8a8_unorm, desc.width, desc.height, desc.levels));
+
+			if (warm)
+			{
+				CHECK(result.data == cold_data[&desc - textures.data()]);
+			}
+			else
+			{
+				total_size += result.data.size();
+				cold_data.push_back(std::move(result.data));
+			}
+		}
+		time[warm] = std::chrono::duration<double, std::milli>(clock_type::now() - start_time).count();
+	}
+	CHECK(count_cache_files(cache_path) == textures.size());
+
+	std::printf("Loading %zu textures (%.1f MiB with mipmaps): cold cache %7.1f ms, warm cache %7.1f ms, %.1fx faster\n",
+		textures.size(), total_size / (1024.0 * 1024.0), time[0], time[1], time[0] / time[1]);
+
+	// Editing a source file changes its name in the cache, so only that texture is decoded again
+	write_source_file(textures[5], 1000);
+	for (const texture_desc &desc : textures)
+		CHECK(load_texture(cache_path, desc).cache_hit == (&desc != &textures[5]));
+	CHECK(count_cache_files(cache_path) == textures.size() + 1); // The stale file stays around until it is pruned
+
+	// A truncated cache file is deleted and written again on the next load
+	std::filesystem::path corrupted_path;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(cache_path))
+		if (entry.path().filename().u8string().compare(0, 16, "reshade-texture7") == 0)
+			corrupted_path = entry.path();
+	std::filesystem::resize_file(corrupted_path, std::filesystem::file_size(corrupted_path) - 1);
+
+	const load_result result = load_texture(cache_path, textures[7]);
+	CHECK(!result.cache_hit && result.data == cold_data[7]);
+	CHECK(std::filesystem::file_size(corrupted_path) == sizeof(uint32_t) * 6 + cold_data[7].size());
+	CHECK(load_texture(cache_path, textures[7]).cache_hit);
+}
+
+// Fills a cache directory beyond the 512 MiB limit with sparse files of different ages, next to files the pruning has to ignore
+static void test_and_bench_prune(const std::filesystem::path &temp_path)
+{
+	const std::filesystem::path cache_path = temp_path / "prune";
+	std::filesystem::create_directories(cache_path);
+
+	constexpr size_t num_files = 48;
+	constexpr uintmax_t file_size = 16 * 1024 * 1024;
+	const auto now = std::filesystem::file_time_type::clock::now();
+
+	for (size_t i = 0; i < num_files; ++i)
+	{
+		const std::filesystem::path path = cache_path / ("reshade-image" + std::to_string(i) + "-0123456789abcdef-1024x1024x11-28.tex");
+		std::ofstream(path, std::ios::binary).put('\0');
+		std::filesystem::resize_file(path, file_size);
+		// Write files in a shuffled order, so that the pruning cannot rely on the directory order
+		std::filesystem::last_write_time(path, now - std::chrono::hours((i * 7) % num_files));
+	}
+	for (const char *const name : { "reshade-effect-1234.cso", "reshade-effect-1234.i", "other.tex" })
+	{
+		std::ofstream(cache_path / name, std::ios::binary).put('\0');
+		std::filesystem::resize_file(cache_path / name, file_size);
+		std::filesystem::last_write_time(cache_path / name, now - std::chrono::hours(1000));
+	}
+
+	auto start_time = clock_type::now();
+	reshade::prune_texture_cache(cache_path);
+	const double prune_time = std::chrono::duration<double, std::milli>(clock_type::now() - start_time).count();
+
+	uintmax_t remaining_size = 0;
+	for (size_t i = 0; i < num_files; ++i)
+	{
+		const std::filesystem::path path = cache_path / ("reshade-image" + std::to_string(i) + "-0123456789abcdef-1024x1024x11-28.tex");
+		const size_t age = (i * 7) % num_files;
+		// Exactly the oldest files that exceed the limit are removed
+		CHECK(std::filesystem::exists(path) == (age < reshade::texture_cache_max_size / file_size));
+		if (std::filesystem::exists(path))
+			remaining_size += file_size;
+	}
+	CHECK(remaining_size == reshade::texture_cache_max_size);
+	for (const char *const name : { "reshade-effect-1234.cso", "reshade-effect-1234.i", "other.tex" })
+		CHECK(std::filesystem::exists(cache_path / name));
+
+	// Nothing is removed while the cache is within the limit
+	start_time = clock_type::now();
+	reshade::prune_texture_cache(cache_path);
+	const double unchanged_time = std::chrono::duration<double, std::milli>(clock_type::now() - start_time).count();
+	CHECK(count_cache_files(cache_path) == reshade::texture_cache_max_size / file_size + 1);
+
+	// Pruning runs every time textures are loaded, so scanning a directory with many cache files has to stay cheap
+	const std::filesystem::path many_path = temp_path / "many";
+	std::filesystem::create_directories(many_path);
+	for (size_t i = 0; i < 5000; ++i)
+		std::ofstream(many_path / ("reshade-image" + std::to_string(i) + ".tex"), std::ios::binary).put('\0');
+	start_time = clock_type::now();
+	reshade::prune_texture_cache(many_path);
+	const double many_time = std::chrono::duration<double, std::milli>(clock_type::now() - start_time).count();
+	CHECK(count_cache_files(many_path) == 5000);
+
+	std::printf("Pruning %zu x 16 MiB cache files to 512 MiB: %.2f ms, checking a cache within the limit: %.2f ms, checking 5000 small cache files: %.2f ms\n", num_files, prune_time, unchanged_time, many_time);
+}
+
+int main()
+{
+	const std::filesystem::path temp_path = std::filesystem::temp_directory_path() / ("reshade_texture_cache_test_" + std::to_string(clock_type::now().time_since_epoch().count()));
+
+	test_cache_id();
+	test_cache_data();
+	test_and_bench_load(temp_path);
+	test_and_bench_prune(temp_path);
+
+	std::error_code ec;
+	std::filesystem::remove_all(temp_path, ec);
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All texture cache tests passed");
+	return 0;
+}
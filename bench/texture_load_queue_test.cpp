@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../source/texture_load_queue.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// Test and benchmark of the texture load queue, which decodes image files on worker threads and uploads them on the render thread within a per-frame budget
+// Jobs produce generated image data after a delay that stands in for reading and decoding the file, and a mock device copies uploaded data into its own memory (e.g. "g++ -std=c++17 -O2 -pthread texture_load_queue_test.cpp ../source/texture_load_queue.cpp -o texture_load_queue_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using clock_type = std::chrono::high_resolution_clock;
+
+struct mock_job
+{
+	size_t size = 0;
+	std::chrono::microseconds decode_time = {};
+	bool fail = false;
+	std::vector<uint8_t> data;
+	clock_type::time_point finish_time;
+	size_t upload_count = 0;
+};
+
+// Stands in for the graphics device, which copies uploaded data into memory it owns
+struct mock_device
+{
+	std::vector<uint8_t> memory;
+	size_t bytes_uploaded = 0;
+
+	void upload(const std::vector<uint8_t> &data)
+	{
+		if (memory.size() < data.size())
+			memory.resize(data.size());
+		std::memcpy(memory.data(), data.data(), data.size());
+		bytes_uploaded += data.size();
+	}
+};
+
+static uint8_t pattern(size_t job_index, size_t offset)
+{
+	return static_cast<uint8_t>(job_index * 31 + offset / 4096);
+}
+
+static void load_job(mock_job &job, size_t job_index)
+{
+	std::this_thread::sleep_for(job.decode_time);
+
+	if (!job.fail)
+	{
+		job.data.resize(job.size);
+		for (size_t offset = 0; offset < job.size; offset += 4096)
+			std::memset(job.data.data() + offset, pattern(job_index, offset), std::min<size_t>(4096, job.size - offset));
+	}
+
+	job.finish_time = clock_type::now();
+}
+
+struct frame_stats
+{
+	size_t num_frames = 0;
+	size_t max_bytes_per_frame = 0;
+	double max_upload_ms = 0;
+	double max_wait_ms = 0;
+	double total_ms = 0;
+};
+
+// Calls 'upload' once per frame like the runtime does, checking the budget and the order jobs are passed in
+static frame_stats run_frames(reshade::texture_load_queue &queue, std::vector<mock_job> &jobs, size_t upload_budget, mock_device &device, std::chrono::microseconds frame_time, std::vector<size_t> *upload_order = nullptr)
+{
+	frame_stats stats;
+
+	for (bool finished = false; !finished;)
+	{
+		std::this_thread::sleep_for(frame_time); // Render the frame
+
+		size_t frame_bytes = 0, last_job_bytes = 0, frame_jobs = 0;
+		const size_t remaining_before = queue.num_remaining_jobs();
+		const auto upload_start_time = clock_type::now();
+		finished = queue.upload(upload_budget, [&](size_t job_index) {
+			mock_job &job = jobs[job_index];
+			job.upload_count++;
+			if (upload_order != nullptr)
+				upload_order->push_back(job_index);
+
+			stats.max_wait_ms = std::max(stats.max_wait_ms, std::chrono::duration<double, std::milli>(clock_type::now() - job.finish_time).count());
+
+			// Data has to be complete by the time it is handed to the render thread
+			bool valid = true;
+			for (size_t offset = 0; offset < job.data.size(); offset += 4096)
+				valid &= job.data[offset] == pattern(job_index, offset);
+			CHECK(valid);
+			CHECK(job.data.size() == (job.fail ? 0 : job.size));
+
+			device.upload(job.data);
+
+			const size_t size = job.data.size();
+			job.data = {};
+			frame_bytes += size;
+			last_job_bytes = size;
+			frame_jobs++;
+			return size;
+		});
+		stats.max_upload_ms = std::max(stats.max_upload_ms, std::chrono::duration<double, std::milli>(clock_type::now() - upload_start_time).count());
+		stats.max_bytes_per_frame = std::max(stats.max_bytes_per_frame, frame_bytes);
+		stats.num_frames++;
+
+		// Only the last job of a frame may cross the budget, so that a single job larger than the budget still gets uploaded
+		if (upload_budget != 0)
+			CHECK(frame_bytes - last_job_bytes < upload_budget);
+		CHECK(queue.num_remaining_jobs() == remaining_before - frame_jobs);
+	}
+
+	stats.total_ms = std::chrono::duration<double, std::milli>(queue.total_time()).count();
+	return stats;
+}
+
+static std::vector<mock_job> make_jobs(size_t num_jobs, size_t min_size, size_t max_size, double decode_megabytes_per_second)
+{
+	std::vector<mock_job> jobs(num_jobs);
+	uint32_t random = 1;
+	for (mock_job &job : jobs)
+	{
+		random = random * 1664525 + 1013904223;
+		job.size = min_size + (random >> 8) % (max_size - min_size + 1);
+		job.decode_time = std::chrono::microseconds(static_cast<long long>(job.size / decode_megabytes_per_second));
+	}
+	return jobs;
+}
+
+static void test_budget_and_order()
+{
+	for (const size_t num_threads : { 1, 3, 8 })
+	{
+		for (const size_t upload_budget : { size_t(0), size_t(64 * 1024), size_t(1024 * 1024) })
+		{
+			std::vector<mock_job> jobs = make_jobs(200, 1, 512 * 1024, 2000.0);
+
+			mock_device device;
+			std::vector<size_t> upload_order;
+			reshade::texture_load_queue queue;
+			queue.start(jobs.size(), num_threads, [&jobs](size_t job_index) { load_job(jobs[job_index], job_index); });
+			CHECK(queue.is_running());
+			CHECK(queue.num_jobs() == jobs.size());
+
+			run_frames(queue, jobs, upload_budget, device, std::chrono::microseconds(200), &upload_order);
+
+			CHECK(!queue.is_running());
+			CHECK(queue.num_remaining_jobs() == 0);
+			CHECK(upload_order.size() == jobs.size());
+			CHECK(std::all_of(jobs.begin(), jobs.end(), [](const mock_job &job) { return job.upload_count == 1; }));
+
+			size_t total_size = 0;
+			for (const mock_job &job : jobs)
+				total_size += job.size;
+			CHECK(device.bytes_uploaded == total_size);
+
+			// A single worker finishes jobs in index order, so they have to be uploaded in that order too
+			if (num_threads == 1)
+				CHECK(std::is_sorted(upload_order.begin(), upload_order.end()));
+		}
+	}
+}
+
+// Jobs that failed to load are still handed to the render thread, so that it can report the error
+static void test_failed_jobs()
+{
+	std::vector<mock_job> jobs = make_jobs(50, 1, 4096, 2000.0);
+	for (size_t i = 0; i < jobs.size(); i += 3)
+		jobs[i].fail = true;
+
+	mock_device device;
+	reshade::texture_load_queue queue;
+	queue.start(jobs.size(), 4, [&jobs](size_t job_index) { load_job(jobs[job_index], job_index); });
+	run_frames(queue, jobs, 1024, device, std::chrono::microseconds(100));
+
+	CHECK(std::all_of(jobs.begin(), jobs.end(), [](const mock_job &job) { return job.upload_count == 1; }));
+}
+
+// An unlimited budget uploads every job that finished so far in a single frame
+static void test_unlimited_budget()
+{
+	std::vector<mock_job> jobs = make_jobs(64, 1024, 65536, 2000.0);
+	std::atomic<size_t> num_loaded = 0;
+
+	reshade::texture_load_queue queue;
+	queue.start(jobs.size(), 4, [&](size_t job_index) { load_job(jobs[job_index], job_index); num_loaded++; });
+	while (num_loaded != jobs.size())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	// Wait a little more for the last job to be added to the finished list after its callback returned
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	size_t num_uploaded = 0;
+	CHECK(queue.upload(0, [&](size_t job_index) { num_uploaded++; return jobs[job_index].data.size(); }));
+	CHECK(num_uploaded == jobs.size());
+	CHECK(!queue.is_running());
+}
+
+// Cancelling stops the worker threads after their current job and drops everything not uploaded yet
+static void test_cancel()
+{
+	std::vector<mock_job> jobs = make_jobs(200, 1024, 1024, 2000.0);
+	for (mock_job &job : jobs)
+		job.decode_time = std::chrono::milliseconds(5);
+	std::atomic<size_t> num_loaded = 0;
+
+	reshade::texture_load_queue queue;
+	queue.start(jobs.size(), 2, [&](size_t job_index) { load_job(jobs[job_index], job_index); num_loaded++; });
+
+	size_t num_uploaded = 0;
+	for (int frame = 0; frame < 5; ++frame)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(4));
+		CHECK(!queue.upload(1024, [&](size_t) { num_uploaded++; return size_t(1024); }));
+	}
+	CHECK(num_uploaded <= 5);
+
+	const auto cancel_start_time = clock_type::now();
+	queue.cancel();
+	const double cancel_ms = std::chrono::duration<double, std::milli>(clock_type::now() - cancel_start_time).count();
+
+	// Only the jobs that were in progress are finished, which takes about as long as a single job
+	CHECK(cancel_ms < 100);
+	CHECK(!queue.is_running());
+	CHECK(queue.num_remaining_jobs() == 0);
+
+	const size_t num_loaded_after_cancel = num_loaded;
+	CHECK(num_loaded_after_cancel < jobs.size());
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(num_loaded == num_loaded_after_cancel);
+
+	// Nothing is left to upload after cancelling
+	CHECK(queue.upload(0, [&](size_t) { num_uploaded++; return size_t(0); }));
+	CHECK(num_uploaded <= 5);
+
+	// The queue can be started again afterwards
+	std::vector<mock_job> new_jobs = make_jobs(20, 1, 4096, 2000.0);
+	mock_device device;
+	queue.start(new_jobs.size(), 2, [&new_jobs](size_t job_index) { load_job(new_jobs[job_index], job_index); });
+	run_frames(queue, new_jobs, 0, device, std::chrono::microseconds(100));
+	CHECK(std::all_of(new_jobs.begin(), new_jobs.end(), [](const mock_job &job) { return job.upload_count == 1; }));
+}
+
+// Loads a set of textures like a typical effect collection references (many small lookup textures and a few large ones) while rendering frames at 144 Hz
+// Decoding runs at 200 MB/s per thread and the mock device uploads with 'memcpy', so the numbers show the trade-off between the time until all textures are loaded and the worst frame time, not absolute values of any particular GPU
+static void bench_effect_collection()
+{
+	constexpr size_t num_small = 120, num_medium = 24, num_large = 4;
+	constexpr auto frame_time = std::chrono::microseconds(6944);
+
+	std::printf("%zu small (64 KiB to 1 MiB), %zu medium (4 to 16 MiB) and %zu large (64 MiB) textures, decoded at 200 MB/s per thread, 3 threads, 144 Hz frames:\n", num_small, num_medium, num_large);
+
+	for (const unsigned int upload_budget_mb : { 0u, 4u, 16u, 64u })
+	{
+		std::vector<mock_job> jobs = make_jobs(num_small, 64 * 1024, 1024 * 1024, 200.0);
+		for (mock_job &job : make_jobs(num_medium, 4 * 1024 * 1024, 16 * 1024 * 1024, 200.0))
+			jobs.push_back(std::move(job));
+		for (mock_job &job : make_jobs(num_large, 64 * 1024 * 1024, 64 * 1024 * 1024, 200.0))
+			jobs.push_back(std::move(job));
+		// Mix the sizes, so that large files do not all finish at the end
+		for (size_t i = 0; i < jobs.size(); i += 7)
+			std::swap(jobs[i], jobs[jobs.size() - 1 - i / 7]);
+
+		mock_device device;
+		reshade::texture_load_queue queue;
+		queue.start(jobs.size(), 3, [&jobs](size_t job_index) { load_job(jobs[job_index], job_index); });
+		const frame_stats stats = run_frames(queue, jobs, upload_budget_mb * 1024 * 1024, device, frame_time);
+
+		CHECK(std::all_of(jobs.begin(), jobs.end(), [](const mock_job &job) { return job.upload_count == 1; }));
+		const double max_upload_ms = std::chrono::duration<double, std::milli>(queue.max_upload_time()).count();
+		CHECK(max_upload_ms <= stats.max_upload_ms);
+
+		char budget[32];
+		if (upload_budget_mb == 0)
+			std::snprintf(budget, sizeof(budget), "unlimited");
+		else
+			std::snprintf(budget, sizeof(budget), "%2u MB/frame", upload_budget_mb);
+		std::printf("  budget %-11s: all textures loaded after %7.1f ms (%4zu frames), worst frame spent %6.2f ms uploading (%5.1f MiB), longest a decoded texture waited for upload %6.1f ms\n",
+			budget, stats.total_ms, stats.num_frames, stats.max_upload_ms, stats.max_bytes_per_frame / (1024.0 * 1024.0), stats.max_wait_ms);
+	}
+}
+
+int main()
+{
+	test_budget_and_order();
+	test_failed_jobs();
+	test_unlimited_budget();
+	test_cancel();
+
+	bench_effect_collection();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All texture load queue tests passed");
+	return 0;
+}
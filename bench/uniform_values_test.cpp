@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The API headers use Microsoft extensions that the uniform value code does not need, so stub them out to build with other compilers
+// The effect object headers rely on the standard headers MSVC includes with Windows.h, so include those first too
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <filesystem>
+#include <unordered_map>
+#define __declspec(x)
+#define __uuidof(x) x::uuid
+#define RESHADE_FX 1
+
+#include "../source/uniform_values.cpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Test and benchmark of the batched uniform variable update behind 'runtime::set_uniform_values', which checks all updates first, converts their values in bulk and then copies them into uniform storage
+// Compares against a reference that computes the storage location of every value on its own, and measures the batch against converting and copying one update at a time like the per-variable setters (e.g. "g++ -std=c++17 -O2 -fpermissive -w -I../include -I../source uniform_values_test.cpp -o uniform_values_test")
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+using reshade::api::effect_uniform_value_type;
+using reshade::api::effect_uniform_value_update;
+
+constexpr uint32_t renderer_d3d9 = 0x9000;
+constexpr uint32_t renderer_d3d11 = 0xb000;
+constexpr uint32_t renderer_opengl = 0x14600;
+
+// Lays out uniform variables like the effect compiler does, with every array element and matrix row starting at a 16 byte boundary
+static std::vector<reshade::uniform> make_variables(size_t num_variables, std::vector<uint8_t> &storage)
+{
+	struct variable_type { reshadefx::type::datatype base; unsigned int rows, cols; int array_length; };
+	static const variable_type types[] = {
+		{ reshadefx::type::t_float, 1, 1, 0 },
+		{ reshadefx::type::t_float, 4, 1, 0 },
+		{ reshadefx::type::t_int, 1, 1, 0 },
+		{ reshadefx::type::t_uint, 2, 1, 0 },
+		{ reshadefx::type::t_bool, 1, 1, 0 },
+		{ reshadefx::type::t_float, 3, 1, 8 },
+		{ reshadefx::type::t_int, 2, 1, 4 },
+		{ reshadefx::type::t_float, 4, 4, 0 },
+		{ reshadefx::type::t_float, 3, 3, 2 },
+		{ reshadefx::type::t_int, 2, 2, 0 },
+	};
+
+	std::vector<reshade::uniform> variables;
+	uint32_t offset = 0;
+	for (size_t i = 0; i < num_variables; ++i)
+	{
+		const variable_type &type = types[i % std::size(types)];
+
+		reshadefx::uniform_info info;
+		info.name = "Variable" + std::to_string(i);
+		info.type.base = type.base;
+		info.type.rows = type.rows;
+		info.type.cols = type.cols;
+		info.type.array_length = type.array_length;
+		info.type.qualifiers = reshadefx::type::q_uniform;
+
+		const uint32_t array_length = type.array_length != 0 ? type.array_length : 1;
+		if (info.type.is_matrix())
+			info.size = array_length * type.rows * 16;
+		else if (type.array_length != 0)
+			info.size = array_length * 16;
+		else
+			info.size = type.rows * 4;
+		info.offset = offset;
+		offset = (offset + info.size + 15) & ~15u;
+
+		reshade::uniform &variable = variables.emplace_back(info);
+		variable.effect_index = 0;
+	}
+
+	storage.assign(offset, 0xCD);
+	return variables;
+}
+
+// Independent reference that computes the location and stored value of every single component
+static void reference_update(const effect_uniform_value_update &update, uint32_t renderer_id, std::vector<uint8_t> &storage)
+{
+	const auto variable = reinterpret_cast<const reshade::uniform *>(update.variable.handle);
+	if (variable == nullptr || update.values == nullptr || update.type > effect_uniform_value_type::unsigned_int)
+		return;
+
+	const size_t array_length = variable->type.is_array() ? variable->type.array_length : 1;
+	const size_t components = variable->type.components();
+	const bool stored_as_float = variable->type.is_floating_point() || renderer_id == renderer_d3d9 || (variable->type.is_matrix() && (renderer_id & 0x10000) != 0);
+
+	for (size_t i = 0; i < update.count; ++i)
+	{
+		const size_t element = update.array_index + i / components;
+		const size_t component = i % components;
+		if (element >= array_length)
+			break;
+
+		size_t location;
+		if (variable->type.is_matrix())
+			location = variable->offset + element * variable->type.rows * 16 + (component / variable->type.cols) * 16 + (component % variable->type.cols) * 4;
+		else if (array_length > 1)
+			location = variable->offset + element * 16 + component * 4;
+		else
+			location = variable->offset + component * 4;
+
+		uint32_t value = 0;
+		switch (update.type)
+		{
+		case effect_uniform_value_type::boolean:
+			if (const bool b = static_cast<const bool *>(update.values)[i]; stored_as_float)
+			{
+				const float f = b ? 1.0f : 0.0f;
+				std::memcpy(&value, &f, 4);
+			}
+			else
+			{
+				value = b ? 1 : 0;
+			}
+			break;
+		case effect_uniform_value_type::floating_point:
+			if (const float f = static_cast<const float *>(update.values)[i]; stored_as_float)
+				std::memcpy(&value, &f, 4);
+			else
+				value = static_cast<uint32_t>(static_cast<int32_t>(f));
+			break;
+		case effect_uniform_value_type::signed_int:
+			if (const int32_t v = static_cast<const int32_t *>(update.values)[i]; stored_as_float)
+			{
+				const float f = static_cast<float>(v);
+				std::memcpy(&value, &f, 4);
+			}
+			else
+			{
+				value = static_cast<uint32_t>(v);
+			}
+			break;
+		case effect_uniform_value_type::unsigned_int:
+			if (const uint32_t v = static_cast<const uint32_t *>(update.values)[i]; stored_as_float)
+			{
+				const float f = static_cast<float>(v);
+				std::memcpy(&value, &f, 4);
+			}
+			else
+			{
+				value = v;
+			}
+			break;
+		}
+
+		std::memcpy(storage.data() + location, &value, 4);
+	}
+}
+
+// Same as 'runtime::set_uniform_values', which looks up the uniform storage by effect index and returns the number of times the preset would be saved
+static size_t batch_update(const effect_uniform_value_update *updates, size_t count, uint32_t renderer_id, std::vector<uint8_t> *effect_storage, std::vector<reshade::uniform_value_write> &writes, std::vector<uint32_t> &converted)
+{
+	reshade::prepare_uniform_value_updates(updates, count, renderer_id, writes, converted);
+
+	bool preset_modified = false;
+	for (const reshade::uniform_value_write &write : writes)
+	{
+		reshade::copy_uniform_value_data(write, effect_storage[write.effect_index]);
+		preset_modified |= write.special == reshade::special_uniform::none;
+	}
+
+	return preset_modified ? 1 : 0;
+}
+
+// Converts and copies one update at a time, like the per-variable setters and the previous 'set_uniform_values' did, which saved the preset after every variable
+static size_t per_update(const effect_uniform_value_update *updates, size_t count, uint32_t renderer_id, std::vector<uint8_t> *effect_storage)
+{
+	size_t num_preset_saves = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const effect_uniform_value_update &update = updates[i];
+		const auto variable = reinterpret_cast<const reshade::uniform *>(update.variable.handle);
+		if (variable == nullptr || update.values == nullptr)
+			continue;
+
+		const bool stored_as_float = variable->type.is_floating_point() || reshade::force_floating_point_value(variable->type, renderer_id);
+		const auto data = static_cast<uint32_t *>(alloca(update.count * sizeof(uint32_t)));
+		for (size_t k = 0; k < update.count; ++k)
+		{
+			float f;
+			switch (update.type)
+			{
+			case effect_uniform_value_type::boolean:
+				f = static_cast<const bool *>(update.values)[k] ? 1.0f : 0.0f;
+				if (stored_as_float)
+					std::memcpy(data + k, &f, 4);
+				else
+					data[k] = static_cast<const bool *>(update.values)[k] ? 1 : 0;
+				break;
+			case effect_uniform_value_type::floating_point:
+				f = static_cast<const float *>(update.values)[k];
+				if (stored_as_float)
+					std::memcpy(data + k, &f, 4);
+				else
+					data[k] = static_cast<uint32_t>(static_cast<int32_t>(f));
+				break;
+			default:
+				f = static_cast<float>(static_cast<const int32_t *>(update.values)[k]);
+				if (stored_as_float)
+					std::memcpy(data + k, &f, 4);
+				else
+					data[k] = static_cast<const uint32_t *>(update.values)[k];
+				break;
+			}
+		}
+
+		reshade::copy_uniform_value_data(*variable, reinterpret_cast<const uint8_t *>(data), update.count * 4, update.array_index, effect_storage[variable->effect_index]);
+		num_preset_saves += variable->special == reshade::special_uniform::none;
+	}
+
+	return num_preset_saves;
+}
+
+struct update_values
+{
+	std::vector<effect_uniform_value_update> updates;
+	std::vector<std::unique_ptr<uint32_t[]>> values;
+};
+
+static update_values make_updates(std::vector<reshade::uniform> &variables, size_t num_updates, uint32_t seed, bool with_invalid)
+{
+	update_values result;
+	uint32_t random = seed;
+	const auto next = [&random]() { random = random * 1664525 + 1013904223; return random >> 8; };
+
+	for (size_t i = 0; i < num_updates; ++i)
+	{
+		reshade::uniform &variable = variables[next() % variables.size()];
+		const size_t array_length = variable.type.is_array() ? variable.type.array_length : 1;
+
+		effect_uniform_value_update &update = result.updates.emplace_back();
+		update.variable = { reinterpret_cast<uintptr_t>(&variable) };
+		update.type = static_cast<effect_uniform_value_type>(next() % 4);
+		update.array_index = next() % array_length;
+		update.count = (array_length - update.array_index) * variable.type.components();
+		// Write only part of the remaining elements sometimes, or more values than there are elements
+		if (next() % 4 == 0)
+			update.count = 1 + next() % update.count;
+		else if (with_invalid && next() % 8 == 0)
+			update.count += 5;
+
+		auto &values = result.values.emplace_back(new uint32_t[update.count]);
+		for (size_t k = 0; k < update.count; ++k)
+		{
+			switch (update.type)
+			{
+			case effect_uniform_value_type::boolean:
+				reinterpret_cast<bool *>(values.get())[k] = (next() % 2) != 0;
+				break;
+			case effect_uniform_value_type::floating_point:
+				reinterpret_cast<float *>(values.get())[k] = static_cast<float>(static_cast<int>(next() % 2001) - 1000) / 8.0f;
+				break;
+			case effect_uniform_value_type::signed_int:
+				reinterpret_cast<int32_t *>(values.get())[k] = static_cast<int32_t>(next() % 2001) - 1000;
+				break;
+			case effect_uniform_value_type::unsigned_int:
+				values.get()[k] = next() % 100000;
+				break;
+			}
+		}
+		update.values = values.get();
+
+		if (with_invalid)
+		{
+			switch (next() % 16)
+			{
+			case 0:
+				update.variable = { 0 };
+				break;
+			case 1:
+				update.values = nullptr;
+				break;
+			case 2:
+				update.type = static_cast<effect_uniform_value_type>(4 + next() % 4);
+				break;
+			case 3:
+				update.array_index = array_length + next() % 3;
+				break;
+			case 4:
+				update.count = 0;
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void test_against_reference()
+{
+	for (const uint32_t renderer_id : { renderer_d3d9, renderer_d3d11, renderer_opengl })
+	{
+		for (uint32_t seed = 1; seed <= 50; ++seed)
+		{
+			std::vector<uint8_t> storage;
+			std::vector<reshade::uniform> variables = make_variables(40, storage);
+			std::vector<uint8_t> reference_storage = storage;
+
+			const update_values batch = make_updates(variables, 200, seed, true);
+
+			std::vector<reshade::uniform_value_write> writes;
+			std::vector<uint32_t> converted;
+			batch_update(batch.updates.data(), batch.updates.size(), renderer_id, &storage, writes, converted);
+
+			for (const effect_uniform_value_update &update : batch.updates)
+				reference_update(update, renderer_id, reference_storage);
+
+			// This also checks that padding between array elements and matrix rows was not touched
+			CHECK(storage == reference_storage);
+
+			// Every invalid update is skipped and everything else results in a write
+			size_t num_valid = 0;
+			for (const effect_uniform_value_update &update : batch.updates)
+			{
+				const auto variable = reinterpret_cast<const reshade::uniform *>(update.variable.handle);
+				num_valid += variable != nullptr && update.values != nullptr && update.count != 0 && update.type <= effect_uniform_value_type::unsigned_int &&
+					update.array_index < static_cast<size_t>(variable->type.is_array() ? variable->type.array_length : 1);
+			}
+			CHECK(writes.size() == num_valid);
+
+			// Converted values go into a single buffer, and values already in the stored type are not copied into it
+			size_t num_converted = 0;
+			for (const reshade::uniform_value_write &write : writes)
+			{
+				const bool points_to_converted = write.data >= reinterpret_cast<const uint8_t *>(converted.data()) && write.data < reinterpret_cast<const uint8_t *>(converted.data() + converted.size());
+				num_converted += points_to_converted ? write.size / 4 : 0;
+			}
+			CHECK(num_converted == converted.size());
+		}
+	}
+
+	// The same batch can be read back through the copy in the other direction
+	std::vector<uint8_t> storage;
+	std::vector<reshade::uniform> variables = make_variables(10, storage);
+	for (reshade::uniform &variable : variables)
+	{
+		std::vector<uint32_t> values(variable.size / 4), read(variable.size / 4);
+		const size_t array_length = variable.type.is_array() ? variable.type.array_length : 1;
+		const size_t count = array_length * variable.type.components();
+		for (size_t k = 0; k < count; ++k)
+			values[k] = static_cast<uint32_t>(k * 3 + 1);
+
+		reshade::copy_uniform_value_data(variable, reinterpret_cast<const uint8_t *>(values.data()), count * 4, 0, storage);
+		reshade::copy_uniform_value_data(variable, storage, 0, reinterpret_cast<uint8_t *>(read.data()), count * 4);
+		CHECK(std::equal(values.begin(), values.begin() + count, read.begin()));
+	}
+}
+
+static void bench_batch()
+{
+	constexpr size_t num_variables = 10000;
+	constexpr int num_iterations = 200;
+
+	std::vector<uint8_t> storage;
+	std::vector<reshade::uniform> variables = make_variables(num_variables, storage);
+	// One update per variable, like an add-on that drives every variable of a large preset each frame
+	const update_values batch = make_updates(variables, num_variables, 1, false);
+
+	std::vector<reshade::uniform_value_write> writes;
+	std::vector<uint32_t> converted;
+
+	double time[2] = {};
+	size_t num_preset_saves[2] = {};
+	for (int pass = 0; pass < 3; ++pass) // First pass warms up
+	{
+		auto start_time = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_iterations; ++i)
+			num_preset_saves[0] = per_update(batch.updates.data(), batch.updates.size(), renderer_d3d11, &storage);
+		const double per_update_time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start_time).count() / num_iterations;
+
+		start_time = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_iterations; ++i)
+			num_preset_saves[1] = batch_update(batch.updates.data(), batch.updates.size(), renderer_d3d11, &storage, writes, converted);
+		const double batch_time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start_time).count() / num_iterations;
+
+		if (pass != 0)
+			time[0] += per_update_time / 2, time[1] += batch_time / 2;
+	}
+
+	CHECK(num_preset_saves[0] == num_variables && num_preset_saves[1] == 1);
+
+	// Saving the preset serializes every variable of all active effects, which makes it far more expensive than copying the values, so the number of saves is what matters most
+	std::printf("%zu updates of mixed types (%zu values converted): converted and copied one at a time %8.1f us with %zu preset saves, checked, converted in bulk and copied %8.1f us with %zu preset save\n",
+		num_variables, converted.size(), time[0], num_preset_saves[0], time[1], num_preset_saves[1]);
+}
+
+int main()
+{
+	test_against_reference();
+	bench_batch();
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All uniform value tests passed");
+	return 0;
+}
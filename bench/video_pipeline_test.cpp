@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "../examples/10-video_capture/video_pipeline.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+// Test of the video capture pipeline, which feeds synthetic frames through color conversion, encoding and muxing into every container format given on the command line (defaults to mp4, mkv, mov and avi)
+// Unlike the other files here this needs the FFmpeg development files (e.g. "g++ -std=c++17 -O2 -pthread video_pipeline_test.cpp ../examples/10-video_capture/video_pipeline.cpp -lavformat -lavcodec -lavutil -o video_pipeline_test")
+// Check the resulting files with "ffprobe -show_streams video_pipeline_test.<ext>", which should report h264 yuv420p(tv, bt709) with the number of encoded frames printed below
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); s_failures++; }
+
+// Fills a BGRA image with eight vertical color bars and a grey box that moves with every frame
+static void make_frame(uint32_t width, uint32_t height, uint32_t index, std::vector<uint8_t> &pixels)
+{
+	static const uint8_t bars[8][3] = { { 255, 255, 255 }, { 0, 255, 255 }, { 255, 255, 0 }, { 0, 255, 0 }, { 255, 0, 255 }, { 0, 0, 255 }, { 255, 0, 0 }, { 0, 0, 0 } };
+
+	pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t *const pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+			const uint8_t *const bar = bars[x * 8 / width];
+			const bool in_box = y >= height / 2 - 20 && y < height / 2 + 20 && x >= (index * 8) % width && x < (index * 8) % width + 40;
+			pixel[0] = in_box ? 128 : bar[2];
+			pixel[1] = in_box ? 128 : bar[1];
+			pixel[2] = in_box ? 128 : bar[0];
+			pixel[3] = 255;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> extensions;
+	for (int i = 1; i < argc; ++i)
+		extensions.push_back(argv[i]);
+	if (extensions.empty())
+		extensions = { "mp4", "mkv", "mov", "avi" };
+
+	constexpr uint32_t width = 1280, height = 720, frame_rate = 30, num_frames = 90;
+
+	std::vector<uint8_t> pixels;
+
+	for (const std::string &extension : extensions)
+	{
+		video_pipeline pipeline;
+
+		video_pipeline::settings settings;
+		settings.filename = "video_pipeline_test." + extension;
+		settings.width = width;
+		settings.height = height;
+		settings.frame_rate = frame_rate;
+		settings.layout = video_pipeline::pixel_layout::bgra;
+		settings.max_queued_frames = num_frames; // Large enough that no frames are dropped, so the frame count in the file is predictable
+
+		if (!pipeline.start(settings))
+		{
+			std::fprintf(stderr, "%s: %s\n", settings.filename.c_str(), pipeline.last_error().c_str());
+			s_failures++;
+			continue;
+		}
+
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t i = 0; i < num_frames; ++i)
+		{
+			make_frame(width, height, i, pixels);
+			CHECK(pipeline.submit_frame(pixels.data(), width * 4, i * 1000 / frame_rate));
+		}
+
+		pipeline.stop();
+
+		const auto stats = pipeline.get_statistics();
+		const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+		std::printf("%s: %llu frames submitted, %llu dropped, %llu encoded, %llu packets (%llu bytes) in %.1f ms\n", settings.filename.c_str(),
+			static_cast<unsigned long long>(stats.frames_submitted), static_cast<unsigned long long>(stats.frames_dropped), static_cast<unsigned long long>(stats.frames_encoded),
+			static_cast<unsigned long long>(stats.packets_written), static_cast<unsigned long long>(stats.bytes_written), elapsed);
+
+		CHECK(stats.frames_submitted == num_frames);
+		CHECK(stats.frames_dropped == 0);
+		CHECK(stats.frames_encoded == num_frames);
+		CHECK(stats.packets_written == stats.frames_encoded);
+
+		std::error_code ec;
+		CHECK(std::filesystem::file_size(settings.filename, ec) > stats.bytes_written / 2 && !ec);
+	}
+
+	// Invalid settings must fail without leaving the pipeline half initialized
+	{
+		video_pipeline pipeline;
+
+		video_pipeline::settings settings;
+		settings.filename = "video_pipeline_test.mp4";
+		settings.width = 1;
+		settings.height = 1;
+		CHECK(!pipeline.start(settings));
+		CHECK(!pipeline.is_active());
+		CHECK(!pipeline.submit_frame(pixels.data(), 4, 0));
+	}
+
+	if (s_failures != 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", s_failures);
+		return 1;
+	}
+
+	std::puts("All video pipeline tests passed");
+	return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include "trace_format.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+// Command-line tool that decodes a binary trace file written by the api_trace add-on
+// Usage: api_trace_decode [--stats] <trace file>
+// Prints every record as text ordered by time, or with "--stats" a summary of how often each event occurred instead
+// This only depends on the standard library, so it can be built on any platform (e.g. "g++ -std=c++17 -O2 api_trace_decode.cpp -o api_trace_decode")
+
+struct record
+{
+	trace_record_header header;
+	const uint64_t *args;
+};
+
+static void print_records(const trace_file_header &file_header, const std::vector<record> &records)
+{
+	std::string line;
+
+	for (const record &record : records)
+	{
+		char prefix[64];
+		std::snprintf(prefix, sizeof(prefix), "%12.3f [%3u] ", (record.header.timestamp - file_header.start_time) / 1000.0, record.header.thread_index);
+
+		line = prefix;
+		format_trace_record(record.header, record.args, line);
+		line += '\n';
+
+		std::fputs(line.c_str(), stdout);
+	}
+}
+
+static void print_statistics(const trace_file_header &file_header, const std::vector<record> &records)
+{
+	struct event_statistics
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		uint64_t max_per_frame = 0;
+		uint64_t count_this_frame = 0;
+	} event_stats[static_cast<size_t>(trace_event::count)];
+
+	struct thread_statistics
+	{
+		uint64_t count = 0;
+		uint64_t dropped = 0;
+		uint64_t first_timestamp = 0;
+		uint64_t last_timestamp = 0;
+	};
+	std::vector<thread_statistics> thread_stats;
+
+	uint64_t num_frames = 0;
+	uint64_t total_count = 0;
+	uint64_t total_dropped = 0;
+	uint64_t total_bytes = 0;
+
+	for (const record &record : records)
+	{
+		const size_t bytes = sizeof(record.header) + record.header.arg_count * sizeof(uint64_t);
+		total_bytes += bytes;
+
+		if (record.header.thread_index >= thread_stats.size())
+			thread_stats.resize(record.header.thread_index + 1);
+		thread_statistics &thread = thread_stats[record.header.thread_index];
+		if (thread.count == 0)
+			thread.first_timestamp = record.header.timestamp;
+		thread.last_timestamp = std::max(thread.last_timestamp, record.header.timestamp);
+
+		if (record.header.event == trace_event::dropped)
+		{
+			const uint64_t dropped = record.header.arg_count != 0 ? record.args[0] : 0;
+			thread.dropped += dropped;
+			total_dropped += dropped;
+			continue;
+		}
+
+		thread.count++;
+		total_count++;
+
+		if (record.header.event >= trace_event::count)
+			continue;
+
+		event_statistics &stats = event_stats[static_cast<size_t>(record.header.event)];
+		stats.count++;
+		stats.bytes += bytes;
+		stats.count_this_frame++;
+
+		if (record.header.event == trace_event::present)
+		{
+			num_frames++;
+
+			for (event_statistics &frame_stats : event_stats)
+			{
+				frame_stats.max_per_frame = std::max(frame_stats.max_per_frame, frame_stats.count_this_frame);
+				frame_stats.count_this_frame = 0;
+			}
+		}
+	}
+
+	const uint64_t duration = records.empty() ? 0 : records.back().header.timestamp - file_header.start_time;
+
+	std::printf("%llu records (%llu bytes) in %.3f ms across %zu threads and %llu frames\n",
+		static_cast<unsigned long long>(total_count), static_cast<unsigned long long>(total_bytes), duration / 1000000.0, thread_stats.size(), static_cast<unsigned long long>(num_frames));
+	if (total_dropped != 0)
+		std::printf("%llu records were dropped because the recorder could not keep up\n", static_cast<unsigned long long>(total_dropped));
+
+	std::printf("\n%-40s %12s %8s %12s %12s %14s\n", "Event", "Count", "Share", "Per frame", "Max/frame", "Bytes");
+
+	// List the most frequent events first
+	std::vector<size_t> order(static_cast<size_t>(trace_event::count));
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&event_stats](size_t lhs, size_t rhs) { return event_stats[lhs].count > event_stats[rhs].count; });
+
+	for (const size_t i : order)
+	{
+		const event_statistics &stats = event_stats[i];
+		if (stats.count == 0)
+			continue;
+
+		std::printf("%-40s %12llu %7.2f%% %12.1f %12llu %14llu\n",
+			get_trace_event_info(static_cast<trace_event>(i)).name,
+			static_cast<unsigned long long>(stats.count),
+			100.0 * stats.count / total_count,
+			num_frames != 0 ? static_cast<double>(stats.count) / num_frames : static_cast<double>(stats.count),
+			static_cast<unsigned long long>(std::max(stats.max_per_frame, stats.count_this_frame)),
+			static_cast<unsigned long long>(stats.bytes));
+	}
+
+	std::printf("\n%-8s %12s %12s %14s %14s\n", "Thread", "Records", "Dropped", "First (us)", "Last (us)");
+
+	for (size_t i = 0; i < thread_stats.size(); ++i)
+	{
+		const thread_statistics &thread = thread_stats[i];
+		if (thread.count == 0 && thread.dropped == 0)
+			continue;
+
+		std::printf("%-8zu %12llu %12llu %14.3f %14.3f\n", i,
+			static_cast<unsigned long long>(thread.count),
+			static_cast<unsigned long long>(thread.dropped),
+			(thread.first_timestamp - file_header.start_time) / 1000.0,
+			(thread.last_timestamp - file_header.start_time) / 1000.0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bool statistics = false;
+	const char *path = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--stats")
+			statistics = true;
+		else if (path == nullptr)
+			path = argv[i];
+		else
+		{
+			path = nullptr; // Only one file at a time is supported
+			break;
+		}
+	}
+
+	if (path == nullptr)
+	{
+		std::fprintf(stderr, "usage: %s [--stats] <trace file>\n", argv[0]);
+		return 1;
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		std::fprintf(stderr, "error: failed to open '%s'\n", path);
+		return 1;
+	}
+
+	// Read into 64-bit words, so that the record arguments are aligned
+	const size_t size = static_cast<size_t>(file.tellg());
+	std::vector<uint64_t> data((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(data.data()), size);
+
+	trace_reader reader(reinterpret_cast<const uint8_t *>(data.data()), size);
+	if (!reader.valid())
+	{
+		std::fprintf(stderr, "error: '%s' is not a trace file of a supported version\n", path);
+		return 1;
+	}
+
+	std::vector<record> records;
+	for (record record; reader.next(record.header, record.args);)
+		records.push_back(record);
+
+	if (reader.truncated())
+		std::fprintf(stderr, "warning: '%s' ends in the middle of a record, ignoring the rest\n", path);
+
+	// Records are only ordered within each thread in the file, so merge them by time (keeping the order of records with the same timestamp)
+	std::stable_sort(records.begin(), records.end(), [](const record &lhs, const record &rhs) { return lhs.header.timestamp < rhs.header.timestamp; });
+
+	if (statistics)
+		print_statistics(reader.header(), records);
+	else
+		print_records(reader.header(), records);
+
+	return 0;
+}
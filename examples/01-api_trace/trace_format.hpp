@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/*
+ * Layout of an API trace file:
+ *   trace_file_header
+ *   trace_record_header followed by 'arg_count' 64-bit arguments, repeated until the end of the file
+ *
+ * Records are written in batches per thread, so they are only ordered by timestamp within the same thread. Sort them by timestamp to get the order across threads.
+ * This header does not depend on ReShade or Windows, so that trace files can be decoded on any platform.
+ */
+
+constexpr uint32_t trace_file_magic = 0x54415352; // "RSAT"
+constexpr uint32_t trace_file_version = 1;
+
+enum class trace_event : uint16_t
+{
+	dropped = 0, // Written by the recorder when a thread produced records faster than they could be written, with the number of lost records as argument
+	barrier,
+	begin_render_pass,
+	end_render_pass,
+	bind_render_targets_and_depth_stencil,
+	bind_pipeline,
+	bind_pipeline_state,
+	bind_viewports,
+	bind_scissor_rects,
+	push_constants,
+	push_descriptors,
+	bind_descriptor_set,
+	bind_index_buffer,
+	bind_vertex_buffer,
+	draw,
+	draw_indexed,
+	dispatch,
+	draw_or_dispatch_indirect,
+	copy_resource,
+	copy_buffer_region,
+	copy_buffer_to_texture,
+	copy_texture_region,
+	copy_texture_to_buffer,
+	resolve_texture_region,
+	clear_depth_stencil_view,
+	clear_render_target_view,
+	clear_unordered_access_view_uint,
+	clear_unordered_access_view_float,
+	generate_mipmaps,
+	present,
+
+	count
+};
+
+struct trace_file_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t start_time; // Timestamp the recording was started at (in nanoseconds, same clock as the record timestamps)
+};
+
+struct trace_record_header
+{
+	trace_event event;
+	uint16_t arg_count;
+	uint32_t thread_index; // Index of the thread that recorded this (in the order threads first recorded something, not the operating system thread ID)
+	uint64_t timestamp; // In nanoseconds
+};
+
+static_assert(sizeof(trace_file_header) == 16 && sizeof(trace_record_header) == 16);
+
+/// <summary>
+/// Describes how to interpret an argument of a record.
+/// </summary>
+enum class trace_arg : uint8_t
+{
+	none,
+	uint,
+	sint,
+	hex,
+	handle,
+	float32, // Bits of a 32-bit float in the lower half
+	resource_usage,
+	pipeline_stage,
+	shader_stage,
+	descriptor_type,
+	dynamic_state,
+	indirect_command,
+};
+
+struct trace_event_info
+{
+	const char *name;
+	trace_arg args[8];
+	// If set, the last argument kind in 'args' repeats for all remaining arguments of the record (e.g. a list of render targets)
+	bool variadic = false;
+};
+
+inline const trace_event_info &get_trace_event_info(trace_event event)
+{
+	using a = trace_arg;
+
+	static const trace_event_info infos[] = {
+		{ "dropped", { a::uint } },
+		{ "barrier", { a::handle, a::resource_usage, a::resource_usage } },
+		{ "begin_render_pass", { a::handle, a::handle }, true },
+		{ "end_render_pass", {} },
+		{ "bind_render_targets_and_depth_stencil", { a::handle, a::handle }, true },
+		{ "bind_pipeline", { a::pipeline_stage, a::handle } },
+		{ "bind_pipeline_state", { a::dynamic_state, a::uint } },
+		{ "bind_viewports", { a::uint, a::uint } },
+		{ "bind_scissor_rects", { a::uint, a::uint } },
+		{ "push_constants", { a::shader_stage, a::handle, a::uint, a::uint, a::hex }, true },
+		{ "push_descriptors", { a::shader_stage, a::handle, a::uint, a::descriptor_type, a::uint, a::uint } },
+		{ "bind_descriptor_set", { a::shader_stage, a::handle, a::uint, a::handle } },
+		{ "bind_index_buffer", { a::handle, a::uint, a::uint } },
+		{ "bind_vertex_buffer", { a::uint, a::handle, a::uint, a::uint } },
+		{ "draw", { a::uint, a::uint, a::uint, a::uint } },
+		{ "draw_indexed", { a::uint, a::uint, a::uint, a::sint, a::uint } },
+		{ "dispatch", { a::uint, a::uint, a::uint } },
+		{ "draw_or_dispatch_indirect", { a::indirect_command, a::handle, a::uint, a::uint, a::uint } },
+		{ "copy_resource", { a::handle, a::handle } },
+		{ "copy_buffer_region", { a::handle, a::uint, a::handle, a::uint, a::uint } },
+		{ "copy_buffer_to_texture", { a::handle, a::uint, a::uint, a::uint, a::handle, a::uint } },
+		{ "copy_texture_region", { a::handle, a::uint, a::handle, a::uint, a::uint } },
+		{ "copy_texture_to_buffer", { a::handle, a::uint, a::handle, a::uint, a::uint, a::uint } },
+		{ "resolve_texture_region", { a::handle, a::uint, a::handle, a::uint, a::sint, a::sint, a::sint, a::uint } },
+		{ "clear_depth_stencil_view", { a::handle, a::float32, a::uint } },
+		{ "clear_render_target_view", { a::handle, a::float32, a::float32, a::float32, a::float32 } },
+		{ "clear_unordered_access_view_uint", { a::handle, a::uint, a::uint, a::uint, a::uint } },
+		{ "clear_unordered_access_view_float", { a::handle, a::float32, a::float32, a::float32, a::float32 } },
+		{ "generate_mipmaps", { a::handle } },
+		{ "present", {} },
+	};
+	static_assert(sizeof(infos) / sizeof(infos[0]) == static_cast<size_t>(trace_event::count));
+
+	static const trace_event_info unknown = { "unknown", {}, true };
+	return static_cast<size_t>(event) < static_cast<size_t>(trace_event::count) ? infos[static_cast<size_t>(event)] : unknown;
+}
+
+inline uint64_t trace_arg_from_float(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+inline float trace_arg_to_float(uint64_t arg)
+{
+	const uint32_t bits = static_cast<uint32_t>(arg);
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// The following names match the values of the corresponding enumerations in the ReShade API headers
+
+inline const char *trace_resource_usage_name(uint64_t value)
+{
+	switch (value)
+	{
+	case 0:
+		return "undefined";
+	case 0x2:
+		return "index_buffer";
+	case 0x1:
+		return "vertex_buffer";
+	case 0x8000:
+		return "constant_buffer";
+	case 0x100:
+		return "stream_output";
+	case 0x200:
+		return "indirect_argument";
+	case 0x30:
+	case 0x20:
+	case 0x10:
+		return "depth_stencil";
+	case 0x4:
+		return "render_target";
+	case 0xC0:
+	case 0x80:
+	case 0x40:
+		return "shader_resource";
+	case 0x8:
+		return "unordered_access";
+	case 0x400:
+		return "copy_dest";
+	case 0x800:
+		return "copy_source";
+	case 0x1000:
+		return "resolve_dest";
+	case 0x2000:
+		return "resolve_source";
+	case 0x80000000:
+		return "general";
+	case 0x80000804:
+		return "present";
+	case 0xAC3:
+		return "cpu_access";
+	default:
+		return "unknown";
+	}
+}
+inline const char *trace_pipeline_stage_name(uint64_t value)
+{
+	switch (value)
+	{
+	case 0x8:
+		return "vertex_shader";
+	case 0x10:
+		return "hull_shader";
+	case 0x20:
+		return "domain_shader";
+	case 0x40:
+		return "geometry_shader";
+	case 0x80:
+		return "pixel_shader";
+	case 0x800:
+		return "compute_shader";
+	case 0x2:
+		return "input_assembler";
+	case 0x4:
+		return "stream_output";
+	case 0x100:
+		return "rasterizer";
+	case 0x200:
+		return "depth_stencil";
+	case 0x400:
+		return "output_merger";
+	case 0x7FFFFFFF:
+		return "all";
+	case 0x7FE:
+		return "all_graphics";
+	case 0x8F8:
+		return "all_shader_stages";
+	default:
+		return "unknown";
+	}
+}
+inline const char *trace_shader_stage_name(uint64_t value)
+{
+	switch (value)
+	{
+	case 0x1:
+		return "vertex";
+	case 0x2:
+		return "hull";
+	case 0x4:
+		return "domain";
+	case 0x8:
+		return "geometry";
+	case 0x10:
+		return "pixel";
+	case 0x20:
+		return "compute";
+	case 0x7FFFFFFF:
+		return "all";
+	case 0x1F:
+		return "all_graphics";
+	default:
+		return "unknown";
+	}
+}
+inline const char *trace_descriptor_type_name(uint64_t value)
+{
+	switch (value)
+	{
+	case 0:
+		return "sampler";
+	case 1:
+		return "sampler_with_resource_view";
+	case 2:
+		return "shader_resource_view";
+	case 3:
+		return "unordered_access_view";
+	case 6:
+		return "constant_buffer";
+	default:
+		return "unknown";
+	}
+}
+inline const char *trace_dynamic_state_name(uint64_t value)
+{
+	switch (value)
+	{
+	default:
+	case 0:
+		return "unknown";
+	case 15:
+		return "alpha_test_enable";
+	case 24:
+		return "alpha_reference_value";
+	case 25:
+		return "alpha_func";
+	case 194:
+		return "srgb_write_enable";
+	case 1000:
+		return "primitive_topology";
+	case 162:
+		return "sample_mask";
+	case 1003:
+		return "alpha_to_coverage_enable";
+	case 27:
+		return "blend_enable";
+	case 1004:
+		return "logic_op_enable";
+	case 171:
+		return "color_blend_op";
+	case 19:
+		return "src_color_blend_factor";
+	case 20:
+		return "dst_color_blend_factor";
+	case 209:
+		return "alpha_blend_op";
+	case 207:
+		return "src_alpha_blend_factor";
+	case 208:
+		return "dst_alpha_blend_factor";
+	case 1005:
+		return "logic_op";
+	case 193:
+		return "blend_constant";
+	case 168:
+		return "render_target_write_mask";
+	case 8:
+		return "fill_mode";
+	case 22:
+		return "cull_mode";
+	case 1001:
+		return "front_counter_clockwise";
+	case 195:
+		return "depth_bias";
+	case 1002:
+		return "depth_bias_clamp";
+	case 175:
+		return "depth_bias_slope_scaled";
+	case 136:
+		return "depth_clip_enable";
+	case 174:
+		return "scissor_enable";
+	case 161:
+		return "multisample_enable";
+	case 176:
+		return "antialiased_line_enable";
+	case 7:
+		return "depth_enable";
+	case 14:
+		return "depth_write_mask";
+	case 23:
+		return "depth_func";
+	case 52:
+		return "stencil_enable";
+	case 58:
+		return "stencil_read_mask";
+	case 59:
+		return "stencil_write_mask";
+	case 57:
+		return "stencil_reference_value";
+	case 56:
+		return "front_stencil_func";
+	case 55:
+		return "front_stencil_pass_op";
+	case 53:
+		return "front_stencil_fail_op";
+	case 54:
+		return "front_stencil_depth_fail_op";
+	case 189:
+		return "back_stencil_func";
+	case 188:
+		return "back_stencil_pass_op";
+	case 186:
+		return "back_stencil_fail_op";
+	case 187:
+		return "back_stencil_depth_fail_op";
+	}
+}
+inline const char *trace_indirect_command_name(uint64_t value)
+{
+	switch (value)
+	{
+	default:
+	case 0:
+		return "unknown";
+	case 1:
+		return "draw";
+	case 2:
+		return "draw_indexed";
+	case 3:
+		return "dispatch";
+	}
+}
+
+/// <summary>
+/// Appends a human-readable representation of the specified record to <paramref name="s"/>, like "draw(3, 1, 0, 0)".
+/// </summary>
+inline void format_trace_record(const trace_record_header &record, const uint64_t *args, std::string &s)
+{
+	const trace_event_info &info = get_trace_event_info(record.event);
+
+	size_t num_fixed_args = 0;
+	while (num_fixed_args < sizeof(info.args) / sizeof(info.args[0]) && info.args[num_fixed_args] != trace_arg::none)
+		++num_fixed_args;
+	// The last argument kind of a variadic event is the one that repeats
+	if (info.variadic && num_fixed_args != 0)
+		--num_fixed_args;
+
+	s += info.name;
+	s += '(';
+
+	for (size_t i = 0; i < record.arg_count; ++i)
+	{
+		const trace_arg kind = i < num_fixed_args ? info.args[i] : info.variadic && num_fixed_args < sizeof(info.args) / sizeof(info.args[0]) ? info.args[num_fixed_args] : trace_arg::hex;
+
+		if (i != 0)
+			s += ", ";
+		if (i == num_fixed_args && info.variadic)
+			s += "{ ";
+
+		char buffer[32];
+		switch (kind)
+		{
+		case trace_arg::uint:
+			std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(args[i]));
+			s += buffer;
+			break;
+		case trace_arg::sint:
+			std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(args[i]));
+			s += buffer;
+			break;
+		case trace_arg::float32:
+			std::snprintf(buffer, sizeof(buffer), "%g", trace_arg_to_float(args[i]));
+			s += buffer;
+			break;
+		default:
+		case trace_arg::hex:
+		case trace_arg::handle:
+			std::snprintf(buffer, sizeof(buffer), "0x%llX", static_cast<unsigned long long>(args[i]));
+			s += buffer;
+			break;
+		case trace_arg::resource_usage:
+			s += trace_resource_usage_name(args[i]);
+			break;
+		case trace_arg::pipeline_stage:
+			s += trace_pipeline_stage_name(args[i]);
+			break;
+		case trace_arg::shader_stage:
+			s += trace_shader_stage_name(args[i]);
+			break;
+		case trace_arg::descriptor_type:
+			s += trace_descriptor_type_name(args[i]);
+			break;
+		case trace_arg::dynamic_state:
+			s += trace_dynamic_state_name(args[i]);
+			break;
+		case trace_arg::indirect_command:
+			s += trace_indirect_command_name(args[i]);
+			break;
+		}
+	}
+
+	if (info.variadic && record.arg_count > num_fixed_args)
+		s += " }";
+	s += ')';
+}
+
+/// <summary>
+/// Iterates over the records in a trace file that was loaded into memory.
+/// </summary>
+class trace_reader
+{
+public:
+	trace_reader(const uint8_t *data, size_t size) : _data(data), _size(size)
+	{
+		if (size >= sizeof(trace_file_header))
+		{
+			std::memcpy(&_header, data, sizeof(_header));
+			_offset = sizeof(_header);
+		}
+	}
+
+	/// <summary>
+	/// Checks whether the data starts with a valid file header of a supported version.
+	/// </summary>
+	bool valid() const { return _header.magic == trace_file_magic && _header.version == trace_file_version; }
+	/// <summary>
+	/// Checks whether the data ended in the middle of a record (e.g. because the application crashed while it was being written).
+	/// </summary>
+	bool truncated() const { return _truncated; }
+
+	const trace_file_header &header() const { return _header; }
+
+	/// <summary>
+	/// Gets the next record in the file.
+	/// </summary>
+	/// <param name="record">Set to the header of the record.</param>
+	/// <param name="args">Set to the arguments of the record, which point into the data passed to the constructor.</param>
+	/// <returns><see langword="true"/> if a record was read, or <see langword="false"/> if the end of the data was reached.</returns>
+	bool next(trace_record_header &record, const uint64_t *&args)
+	{
+		if (!valid() || _size - _offset < sizeof(record))
+		{
+			_truncated = valid() && _offset != _size;
+			return false;
+		}
+
+		std::memcpy(&record, _data + _offset, sizeof(record));
+
+		const size_t args_size = record.arg_count * sizeof(uint64_t);
+		if (_size - _offset - sizeof(record) < args_size)
+		{
+			_truncated = true;
+			return false;
+		}
+
+		// Records are a multiple of 8 bytes in size, so arguments are aligned if the data is
+		args = reinterpret_cast<const uint64_t *>(_data + _offset + sizeof(record));
+		_offset += sizeof(record) + args_size;
+		return true;
+	}
+
+private:
+	const uint8_t *const _data;
+	const size_t _size;
+	size_t _offset = 0;
+	trace_file_header _header = {};
+	bool _truncated = false;
+};
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include "trace_recorder.hpp"
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+static_assert((trace_recorder::BUFFER_SIZE & (trace_recorder::BUFFER_SIZE - 1)) == 0, "Buffer size must be a power of two");
+
+static inline uint64_t current_time()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Positions in the ring buffers only ever increase and are wrapped when accessing the data, so that a full buffer can be told apart from an empty one
+static void write_to_ring(uint8_t *ring, size_t position, const void *data, size_t size)
+{
+	const size_t offset = position & (trace_recorder::BUFFER_SIZE - 1);
+	const size_t first_size = std::min(size, trace_recorder::BUFFER_SIZE - offset);
+	std::memcpy(ring + offset, data, first_size);
+	std::memcpy(ring, static_cast<const uint8_t *>(data) + first_size, size - first_size);
+}
+static void read_from_ring(const uint8_t *ring, size_t position, void *data, size_t size)
+{
+	const size_t offset = position & (trace_recorder::BUFFER_SIZE - 1);
+	const size_t first_size = std::min(size, trace_recorder::BUFFER_SIZE - offset);
+	std::memcpy(data, ring + offset, first_size);
+	std::memcpy(static_cast<uint8_t *>(data) + first_size, ring, size - first_size);
+}
+
+trace_recorder::~trace_recorder()
+{
+	stop();
+
+	for (thread_buffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr;)
+	{
+		thread_buffer *const next = buffer->next;
+		delete buffer;
+		buffer = next;
+	}
+}
+
+bool trace_recorder::start(const std::filesystem::path &path)
+{
+	stop();
+
+	const std::unique_lock<std::mutex> lock(_write_mutex);
+
+	_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!_file)
+		return false;
+
+	// Discard anything that threads added to their buffers after the previous recording was stopped
+	for (thread_buffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+	{
+		buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+	}
+
+	_start_time = current_time();
+	_stop_time = std::numeric_limits<uint64_t>::max();
+
+	const trace_file_header header = { trace_file_magic, trace_file_version, _start_time };
+	_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	_records_written = 0;
+	_records_dropped = 0;
+	_bytes_written = sizeof(header);
+
+	_flush_requested.store(false);
+	_recording.store(true);
+
+	_write_thread = std::thread(&trace_recorder::write_thread, this);
+
+	return true;
+}
+void trace_recorder::stop()
+{
+	if (!_recording.exchange(false))
+		return;
+
+	{
+		// Notify while holding the lock, so that the write thread cannot miss it between checking for the stop and starting to wait
+		const std::unique_lock<std::mutex> lock(_wake_mutex);
+		_wake_condition.notify_one();
+	}
+
+	_write_thread.join();
+
+	const std::unique_lock<std::mutex> lock(_write_mutex);
+
+	// Threads that checked whether recording is active right before it was stopped may still add their record, so include everything that happened up until now
+	_stop_time = current_time();
+
+	drain_buffers();
+
+	_file.close();
+}
+
+void trace_recorder::record_array(trace_event event, const uint64_t *args, size_t arg_count)
+{
+	if (!is_recording())
+		return;
+
+	thread_buffer *const buffer = get_thread_buffer();
+
+	arg_count = std::min<size_t>(arg_count, std::numeric_limits<uint16_t>::max());
+	const size_t size = sizeof(trace_record_header) + arg_count * sizeof(uint64_t);
+
+	const size_t head = buffer->head.load(std::memory_order_relaxed);
+	const size_t tail = buffer->tail.load(std::memory_order_acquire);
+
+	// Never wait for the write thread to catch up, since that would affect the timing of the application that is being traced
+	if (BUFFER_SIZE - (head - tail) < size)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const trace_record_header record = { event, static_cast<uint16_t>(arg_count), buffer->thread_index, current_time() };
+	write_to_ring(buffer->data, head, &record, sizeof(record));
+	write_to_ring(buffer->data, head + sizeof(record), args, arg_count * sizeof(uint64_t));
+
+	buffer->head.store(head + size, std::memory_order_release);
+
+	// Wake up the write thread early when the buffer is filling up, instead of waiting for it to wake up on its own
+	// Check before exchanging, so that threads do not keep invalidating the cache line of the flag while the write thread is already on its way
+	if ((head + size - tail) > BUFFER_SIZE / 2 && !_flush_requested.load(std::memory_order_relaxed) && !_flush_requested.exchange(true))
+		_wake_condition.notify_one();
+}
+
+trace_recorder::statistics trace_recorder::get_statistics() const
+{
+	return { _records_written.load(), _records_dropped.load(), _bytes_written.load() };
+}
+
+trace_recorder::thread_buffer *trace_recorder::get_thread_buffer()
+{
+	// There is only ever one recorder in practice, but check that the cached buffer belongs to this one anyway
+	thread_local const trace_recorder *t_owner = nullptr;
+	thread_local thread_buffer *t_buffer = nullptr;
+
+	if (t_owner == this)
+		return t_buffer;
+
+	thread_buffer *const buffer = new thread_buffer;
+	buffer->thread_index = _next_thread_index.fetch_add(1, std::memory_order_relaxed);
+
+	// Buffers are never removed from the list while the recorder exists, so pushing to the front is all that is needed
+	buffer->next = _buffers.load(std::memory_order_relaxed);
+	while (!_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+		continue;
+
+	t_owner = this;
+	t_buffer = buffer;
+	return buffer;
+}
+
+void trace_recorder::write_thread()
+{
+	while (is_recording())
+	{
+		{
+			std::unique_lock<std::mutex> lock(_wake_mutex);
+			_wake_condition.wait_for(lock, std::chrono::milliseconds(10), [this]() { return _flush_requested.load() || !is_recording(); });
+		}
+
+		_flush_requested.store(false);
+
+		const std::unique_lock<std::mutex> lock(_write_mutex);
+		drain_buffers();
+	}
+}
+
+void trace_recorder::drain_buffers()
+{
+	uint64_t records_written = 0;
+	uint64_t bytes_written = 0;
+
+	const auto write_range = [this, &bytes_written](const thread_buffer &buffer, size_t begin, size_t end) {
+		// Write directly from the ring buffer, in two parts if the range wraps around its end
+		const size_t offset = begin & (BUFFER_SIZE - 1);
+		const size_t size = end - begin;
+		const size_t first_size = std::min(size, BUFFER_SIZE - offset);
+		_file.write(reinterpret_cast<const char *>(buffer.data + offset), first_size);
+		_file.write(reinterpret_cast<const char *>(buffer.data), size - first_size);
+
+		bytes_written += size;
+	};
+
+	for (thread_buffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+	{
+		const size_t head = buffer->head.load(std::memory_order_acquire);
+		size_t tail = buffer->tail.load(std::memory_order_relaxed);
+
+		// Write consecutive records in one go, only interrupted by records that have to be skipped
+		size_t run_begin = tail;
+
+		while (tail != head)
+		{
+			trace_record_header record;
+			read_from_ring(buffer->data, tail, &record, sizeof(record));
+
+			const size_t size = sizeof(record) + record.arg_count * sizeof(uint64_t);
+
+			// Skip records from threads that checked whether recording is active right before the previous recording was stopped and only added their record after this one was started
+			if (record.timestamp < _start_time || record.timestamp > _stop_time)
+			{
+				write_range(*buffer, run_begin, tail);
+				run_begin = tail + size;
+			}
+			else
+			{
+				records_written++;
+			}
+
+			tail += size;
+		}
+
+		write_range(*buffer, run_begin, tail);
+
+		// Hand the space back to the thread owning the buffer only after the data was written out
+		buffer->tail.store(tail, std::memory_order_release);
+
+		if (const uint64_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed); dropped != 0)
+		{
+			const trace_record_header record = { trace_event::dropped, 1, buffer->thread_index, std::min(current_time(), _stop_time) };
+			_file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+			_file.write(reinterpret_cast<const char *>(&dropped), sizeof(dropped));
+
+			records_written++;
+			bytes_written += sizeof(record) + sizeof(dropped);
+			_records_dropped += dropped;
+		}
+	}
+
+	_records_written += records_written;
+	_bytes_written += bytes_written;
+}
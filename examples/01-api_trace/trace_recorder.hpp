@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include "trace_format.hpp"
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <condition_variable>
+
+/// <summary>
+/// Records binary trace records (see "trace_format.hpp") from any number of threads to a file.
+/// Each thread appends to its own ring buffer without locking, which a background thread drains to the file, so that recording does not serialize the threads being traced.
+/// This does not depend on ReShade, so it can be fed with synthetic records for testing as well.
+/// </summary>
+class trace_recorder
+{
+public:
+	// Size of the ring buffer of each thread, records are dropped (and counted) when it runs full
+	static constexpr size_t BUFFER_SIZE = 1024 * 1024; // Must be a power of two
+
+	struct statistics
+	{
+		uint64_t records_written;
+		uint64_t records_dropped;
+		uint64_t bytes_written;
+	};
+
+	trace_recorder() = default;
+	~trace_recorder();
+
+	/// <summary>
+	/// Starts recording to a new file at the specified <paramref name="path"/>.
+	/// </summary>
+	bool start(const std::filesystem::path &path);
+	/// <summary>
+	/// Stops recording and waits for all records recorded so far to be written and the file to be closed.
+	/// </summary>
+	void stop();
+
+	bool is_recording() const { return _recording.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Adds a record to the buffer of the calling thread. Does nothing if not currently recording.
+	/// </summary>
+	/// <param name="event">The type of the record.</param>
+	/// <param name="args">The arguments of the record (see <see cref="get_trace_event_info"/> for how they are interpreted).</param>
+	/// <param name="arg_count">The number of arguments.</param>
+	void record_array(trace_event event, const uint64_t *args, size_t arg_count);
+	template <typename... Args>
+	void record(trace_event event, Args... args)
+	{
+		const uint64_t arg_values[sizeof...(Args) + 1] = { static_cast<uint64_t>(args)... };
+		record_array(event, arg_values, sizeof...(Args));
+	}
+
+	/// <summary>
+	/// Gets statistics about the current or last recording.
+	/// </summary>
+	statistics get_statistics() const;
+
+private:
+	struct alignas(64) thread_buffer
+	{
+		uint32_t thread_index = 0;
+		thread_buffer *next = nullptr;
+		// Only written by the thread owning this buffer
+		std::atomic<size_t> head = 0;
+		// Only written by the thread draining the buffers
+		alignas(64) std::atomic<size_t> tail = 0;
+		std::atomic<uint64_t> dropped = 0;
+		uint8_t data[BUFFER_SIZE];
+	};
+
+	thread_buffer *get_thread_buffer();
+
+	void write_thread();
+	void drain_buffers();
+
+	std::atomic<bool> _recording = false;
+	std::atomic<bool> _flush_requested = false;
+	// Singly linked list of the buffers of all threads that ever recorded something, which are kept until the recorder is destroyed
+	std::atomic<thread_buffer *> _buffers = nullptr;
+	std::atomic<uint32_t> _next_thread_index = 0;
+
+	// Held while draining the buffers and writing to the file
+	std::mutex _write_mutex;
+	std::ofstream _file;
+	uint64_t _start_time = 0;
+	uint64_t _stop_time = 0;
+	std::atomic<uint64_t> _records_written = 0;
+	std::atomic<uint64_t> _records_dropped = 0;
+	std::atomic<uint64_t> _bytes_written = 0;
+
+	std::mutex _wake_mutex;
+	std::condition_variable _wake_condition;
+	std::thread _write_thread;
+};
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include "shader_pack.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+// Command-line tool that packs a directory of replacement shaders into a single file that the shader_replace add-on can memory-map
+// Usage: shader_pack <input directory> <output file>
+// Input files have to be named like the files written by the shader_dump add-on, i.e. "[executable name]_shader_0x[CRC-32 hash].cso/spv/glsl"
+
+static bool parse_file_name(const std::filesystem::path &path, uint32_t &hash, shader_pack_type &type)
+{
+	const std::filesystem::path extension = path.extension();
+	if (extension == ".cso")
+		type = shader_pack_type::cso;
+	else if (extension == ".spv")
+		type = shader_pack_type::spv;
+	else if (extension == ".glsl")
+		type = shader_pack_type::glsl;
+	else
+		return false;
+
+	const std::string stem = path.stem().u8string();
+	const size_t hash_pos = stem.rfind("_shader_0x");
+	if (hash_pos == std::string::npos || stem.size() != hash_pos + 10 + 8)
+		return false;
+
+	char *end = nullptr;
+	hash = static_cast<uint32_t>(std::strtoul(stem.c_str() + hash_pos + 10, &end, 16));
+	return end == stem.c_str() + stem.size();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3)
+	{
+		std::fprintf(stderr, "usage: %s <input directory> <output file>\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<shader_pack_entry> entries;
+	std::vector<std::filesystem::path> entry_paths;
+
+	std::error_code ec;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(argv[1], ec))
+	{
+		uint32_t hash = 0;
+		shader_pack_type type = shader_pack_type::cso;
+		if (!entry.is_regular_file(ec) || !parse_file_name(entry.path(), hash, type))
+			continue;
+
+		const uintmax_t file_size = entry.file_size(ec);
+		if (ec)
+			break;
+
+		entries.push_back({ hash, type, static_cast<uint64_t>(entry_paths.size()), file_size });
+		entry_paths.push_back(entry.path());
+	}
+	if (ec)
+	{
+		std::fprintf(stderr, "error: failed to enumerate '%s': %s\n", argv[1], ec.message().c_str());
+		return 1;
+	}
+
+	std::sort(entries.begin(), entries.end());
+
+	// The same shader may have been dumped for multiple executables, only keep the first one
+	const auto duplicates = std::unique(entries.begin(), entries.end(),
+		[](const shader_pack_entry &lhs, const shader_pack_entry &rhs) { return lhs.hash == rhs.hash && lhs.type == rhs.type; });
+	if (duplicates != entries.end())
+	{
+		std::fprintf(stderr, "warning: skipping %zu duplicate shaders\n", static_cast<size_t>(entries.end() - duplicates));
+		entries.erase(duplicates, entries.end());
+	}
+
+	const auto align = [](uint64_t offset) { return (offset + shader_pack_alignment - 1) & ~static_cast<uint64_t>(shader_pack_alignment - 1); };
+
+	// Assign file offsets (the offset field still holds the index into 'entry_paths' at this point)
+	std::vector<size_t> path_indices(entries.size());
+	uint64_t offset = align(sizeof(shader_pack_header) + entries.size() * sizeof(shader_pack_entry));
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		path_indices[i] = static_cast<size_t>(entries[i].offset);
+		entries[i].offset = offset;
+		offset = align(offset + entries[i].size);
+	}
+
+	std::ofstream file(argv[2], std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::fprintf(stderr, "error: failed to open '%s' for writing\n", argv[2]);
+		return 1;
+	}
+
+	const shader_pack_header header = { shader_pack_magic, shader_pack_version, static_cast<uint32_t>(entries.size()), 0 };
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(shader_pack_entry));
+
+	std::vector<char> code;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		code.resize(static_cast<size_t>(entries[i].size));
+
+		std::ifstream input(entry_paths[path_indices[i]], std::ios::binary);
+		if (!input.read(code.data(), code.size()))
+		{
+			std::fprintf(stderr, "error: failed to read '%s'\n", entry_paths[path_indices[i]].u8string().c_str());
+			return 1;
+		}
+
+		// Skipping ahead to the aligned offset fills the gap with zeros
+		file.seekp(static_cast<std::streamoff>(entries[i].offset));
+		file.write(code.data(), code.size());
+	}
+
+	if (!file)
+	{
+		std::fprintf(stderr, "error: failed to write '%s'\n", argv[2]);
+		return 1;
+	}
+
+	std::printf("Packed %zu shaders into '%s' (%llu bytes).\n", entries.size(), argv[2], static_cast<unsigned long long>(file.tellp()));
+	return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+/*
+ * Layout of a shader pack file:
+ *   shader_pack_header
+ *   shader_pack_entry[entry_count], sorted by hash and type
+ *   shader code of each entry, aligned to 'shader_pack_alignment' bytes
+ *
+ * The file is memory-mapped as a whole and entries are looked up in place, so nothing has to be parsed or copied.
+ */
+
+constexpr uint32_t shader_pack_magic = 0x50535352; // "RSSP"
+constexpr uint32_t shader_pack_version = 1;
+constexpr uint32_t shader_pack_alignment = 16; // SPIR-V code has to be at least 4-byte aligned
+
+enum class shader_pack_type : uint32_t
+{
+	cso = 0,
+	spv = 1,
+	glsl = 2,
+};
+
+struct shader_pack_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t reserved;
+};
+
+struct shader_pack_entry
+{
+	uint32_t hash;
+	shader_pack_type type;
+	uint64_t offset; // Offset of the shader code from the start of the file
+	uint64_t size;
+};
+
+static_assert(sizeof(shader_pack_header) == 16 && sizeof(shader_pack_entry) == 24);
+
+inline bool operator<(const shader_pack_entry &lhs, const shader_pack_entry &rhs)
+{
+	return lhs.hash != rhs.hash ? lhs.hash < rhs.hash : lhs.type < rhs.type;
+}
+
+/// <summary>
+/// Checks that the specified memory contains a valid shader pack, with all entries in bounds and sorted.
+/// </summary>
+inline bool validate_shader_pack(const uint8_t *data, size_t size)
+{
+	if (size < sizeof(shader_pack_header))
+		return false;
+
+	const auto header = reinterpret_cast<const shader_pack_header *>(data);
+	if (header->magic != shader_pack_magic || header->version != shader_pack_version)
+		return false;
+	if (header->entry_count > (size - sizeof(shader_pack_header)) / sizeof(shader_pack_entry))
+		return false;
+
+	const auto entries = reinterpret_cast<const shader_pack_entry *>(header + 1);
+	for (uint32_t i = 0; i < header->entry_count; ++i)
+	{
+		if (entries[i].offset > size || entries[i].size > size - entries[i].offset)
+			return false;
+		if (i != 0 && !(entries[i - 1] < entries[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Finds the shader code with the specified <paramref name="hash"/> and <paramref name="type"/> in a shader pack that was validated with <see cref="validate_shader_pack"/>.
+/// </summary>
+inline const shader_pack_entry *find_shader_pack_entry(const uint8_t *data, uint32_t hash, shader_pack_type type)
+{
+	const auto header = reinterpret_cast<const shader_pack_header *>(data);
+	const auto entries = reinterpret_cast<const shader_pack_entry *>(header + 1);
+
+	const shader_pack_entry key = { hash, type, 0, 0 };
+	const auto it = std::lower_bound(entries, entries + header->entry_count, key);
+	if (it == entries + header->entry_count || it->hash != hash || it->type != type)
+		return nullptr;
+
+	return it;
+}
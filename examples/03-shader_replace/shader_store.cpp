@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include <reshade.hpp>
+#include "shader_store.hpp"
+#include <fstream>
+
+shader_store::~shader_store()
+{
+	unmap_file(_pack);
+}
+
+bool shader_store::find(uint32_t hash, shader_pack_type type, const void *&code, size_t &code_size)
+{
+	static const wchar_t *const extensions[] = { L".cso", L".spv", L".glsl" };
+
+	wchar_t hash_string[11];
+	swprintf_s(hash_string, L"0x%08X", hash);
+
+	std::wstring suffix = L"_shader_";
+	suffix += hash_string;
+	suffix += extensions[static_cast<uint32_t>(type)];
+
+	// Individual files take precedence over the pack file, so that shaders can be iterated on without repacking
+	if (std::filesystem::path path; _index.find(suffix, path))
+	{
+		const uint32_t generation = _index.generation();
+
+		const std::unique_lock<std::mutex> lock(_loose_files_mutex);
+
+		loose_file &file = _loose_files[suffix];
+		if (file.data.empty() || file.generation != generation)
+		{
+			// The directory changed since this file was read, so read it again if it was modified
+			std::error_code ec;
+			const std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time(path, ec);
+
+			if (file.data.empty() || last_write_time != file.last_write_time)
+			{
+				if (!file.data.empty())
+				{
+					_retired_files.push_back(std::move(file.data));
+					if (_retired_files.size() > max_retired_files)
+						_retired_files.pop_front();
+				}
+				file.data.clear();
+
+				std::ifstream stream(path, std::ios::binary | std::ios::ate);
+				const std::streamoff size = stream.tellg();
+				if (size > 0)
+				{
+					file.data.resize(static_cast<size_t>(size));
+					stream.seekg(0, std::ios::beg).read(reinterpret_cast<char *>(file.data.data()), file.data.size());
+				}
+
+				if (!stream || file.data.empty())
+				{
+					_loose_files.erase(suffix);
+					return false;
+				}
+			}
+
+			file.generation = generation;
+			file.last_write_time = last_write_time;
+		}
+
+		code = file.data.data();
+		code_size = file.data.size();
+		return true;
+	}
+
+	std::call_once(_pack_opened, &shader_store::open_pack, this);
+
+	if (_pack.data == nullptr)
+		return false;
+
+	if (const shader_pack_entry *const entry = find_shader_pack_entry(_pack.data, hash, type))
+	{
+		code = _pack.data + entry->offset;
+		code_size = static_cast<size_t>(entry->size);
+		return true;
+	}
+
+	return false;
+}
+
+bool shader_store::map_file(const std::filesystem::path &path, mapped_file &file)
+{
+	// Allow the file to be deleted or renamed while mapped, so that it can still be replaced with a new pack on disk
+	file.file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file.file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(file.file, &size) || size.QuadPart == 0 || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+	{
+		unmap_file(file);
+		return false;
+	}
+
+	file.mapping = CreateFileMappingW(file.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (file.mapping == nullptr)
+	{
+		unmap_file(file);
+		return false;
+	}
+
+	file.data = static_cast<const uint8_t *>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+	if (file.data == nullptr)
+	{
+		unmap_file(file);
+		return false;
+	}
+
+	file.size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+void shader_store::unmap_file(mapped_file &file)
+{
+	if (file.data != nullptr)
+		UnmapViewOfFile(file.data);
+	if (file.mapping != nullptr)
+		CloseHandle(file.mapping);
+	if (file.file != INVALID_HANDLE_VALUE)
+		CloseHandle(file.file);
+	file = {};
+}
+
+void shader_store::open_pack()
+{
+	WCHAR module_path[MAX_PATH] = L"";
+	GetModuleFileNameW(nullptr, module_path, ARRAYSIZE(module_path));
+
+	std::filesystem::path pack_path = module_path;
+	pack_path += L"_shaders.pack";
+
+	if (!map_file(pack_path, _pack))
+		return;
+
+	if (!validate_shader_pack(_pack.data, _pack.size))
+	{
+		reshade::log_message(1, ("Shader pack file " + pack_path.u8string() + " is invalid and was ignored.").c_str());
+		unmap_file(_pack);
+		return;
+	}
+
+	char message[512];
+	sprintf_s(message, "Mapped shader pack file %s with %u shaders.", pack_path.u8string().c_str(), reinterpret_cast<const shader_pack_header *>(_pack.data)->entry_count);
+	reshade::log_message(3, message);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include "shader_pack.hpp"
+#include "../replacement_index.hpp"
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+/// <summary>
+/// Provides replacement shader code without allocating copies per pipeline creation.
+/// Looks for individual "[executable name]_shader_0x[hash].cso/spv/glsl" files first and then in the "[executable name]_shaders.pack" file created by the shader_pack tool, which is memory-mapped.
+/// All returned code stays valid until the store is destroyed.
+/// </summary>
+class shader_store
+{
+public:
+	~shader_store();
+
+	/// <summary>
+	/// Finds replacement shader code for the shader with the specified <paramref name="hash"/>.
+	/// </summary>
+	/// <param name="hash">CRC-32 hash of the original shader code.</param>
+	/// <param name="type">Type of the shader code.</param>
+	/// <param name="code">Set to a pointer to the replacement shader code.</param>
+	/// <param name="code_size">Set to the size of the replacement shader code in bytes.</param>
+	/// <returns><see langword="true"/> if replacement shader code was found, <see langword="false"/> otherwise.</returns>
+	bool find(uint32_t hash, shader_pack_type type, const void *&code, size_t &code_size);
+
+private:
+	struct mapped_file
+	{
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+		const uint8_t *data = nullptr;
+		size_t size = 0;
+	};
+	struct loose_file
+	{
+		std::vector<uint8_t> data;
+		uint32_t generation = 0;
+		std::filesystem::file_time_type last_write_time;
+	};
+
+	static bool map_file(const std::filesystem::path &path, mapped_file &file);
+	static void unmap_file(mapped_file &file);
+
+	void open_pack();
+
+	replacement_index _index;
+
+	std::once_flag _pack_opened;
+	mapped_file _pack;
+
+	// Individual files are read once and cached instead of mapped, so that they are not locked and can still be edited while the application is running
+	std::mutex _loose_files_mutex;
+	std::unordered_map<std::wstring, loose_file> _loose_files;
+	// Contents of files that changed on disk since they were read, which cannot be freed right away while pipeline creation on another thread may still be using them
+	// Code is only used for the duration of a single pipeline creation, so only the most recently retired files are kept alive, rather than letting this grow every time a file is edited
+	static constexpr size_t max_retired_files = 16;
+	std::deque<std::vector<uint8_t>> _retired_files;
+};
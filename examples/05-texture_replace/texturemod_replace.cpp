@@ -6,7 +6,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include <reshade.hpp>
-#include "crc32_hash.hpp"
+#include "../crc32_hash.hpp"
+#include "../replacement_index.hpp"
 #include <fstream>
 #include <filesystem>
 #include <stb_image.h>
@@ -14,6 +15,7 @@
 using namespace reshade::api;
 
 static thread_local std::vector<std::vector<uint8_t>> data_to_delete;
+static replacement_index s_replacements;
 
 static bool replace_texture(const resource_desc &desc, subresource_data &data)
 {
@@ -38,20 +40,16 @@ static bool replace_texture(const resource_desc &desc, subresource_data &data)
 			format_row_pitch(desc.texture.format, desc.texture.width)));
 #endif
 
-	char hash_string[11];
-	sprintf_s(hash_string, "0x%08X", hash);
+	wchar_t hash_string[11];
+	swprintf_s(hash_string, L"0x%08X", hash);
 
-	// Prepend executable file name to image files
-	WCHAR file_prefix[MAX_PATH] = L"";
-	GetModuleFileNameW(nullptr, file_prefix, ARRAYSIZE(file_prefix));
-
-	std::filesystem::path replace_path = file_prefix;
-	replace_path += L'_';
-	replace_path += hash_string;
-	replace_path += L".bmp";
+	// Replacement image files are prefixed with the executable file name
+	std::wstring replace_suffix = L"_";
+	replace_suffix += hash_string;
+	replace_suffix += L".bmp";
 
 	// Check if a replacement file for this texture hash exists and if so, overwrite the texture data with its contents
-	if (std::filesystem::exists(replace_path))
+	if (std::filesystem::path replace_path; s_replacements.find(replace_suffix, replace_path))
 	{
 		std::ifstream file(replace_path, std::ios::binary);
 		file.seekg(0, std::ios::end);
@@ -288,6 +288,36 @@ static void draw_history_window(reshade::api::effect_runtime *runtime)
 
 	ctx.history_pos = selected_pos;
 
+	// Collect all uniform variable changes and apply them in a single batch, so that the preset is only updated once
+	std::vector<reshade::api::effect_uniform_value_update> uniform_updates;
+	const auto add_uniform_update = [&uniform_updates](const history &entry, const history::uniform_value &value) {
+		reshade::api::effect_uniform_value_update &update = uniform_updates.emplace_back();
+		update.variable = entry.variable_handle;
+		switch (entry.variable_basetype)
+		{
+		case reshade::api::format::r32_typeless:
+			update.type = reshade::api::effect_uniform_value_type::boolean;
+			update.values = &value.as_bool;
+			update.count = 1;
+			break;
+		case reshade::api::format::r32_float:
+			update.type = reshade::api::effect_uniform_value_type::floating_point;
+			update.values = value.as_float;
+			update.count = 16;
+			break;
+		case reshade::api::format::r32_sint:
+			update.type = reshade::api::effect_uniform_value_type::signed_int;
+			update.values = value.as_int;
+			update.count = 16;
+			break;
+		case reshade::api::format::r32_uint:
+			update.type = reshade::api::effect_uniform_value_type::unsigned_int;
+			update.values = value.as_uint;
+			update.count = 16;
+			break;
+		}
+	};
+
 	if (distance > 0)
 	{
 		while (distance-- > 0)
@@ -295,21 +325,7 @@ static void draw_history_window(reshade::api::effect_runtime *runtime)
 			switch (it->kind)
 			{
 			case history::kind::uniform_value:
-				switch (it->variable_basetype)
-				{
-				case reshade::api::format::r32_typeless:
-					runtime->set_uniform_value_bool(it->variable_handle, &it->before.as_bool, 1);
-					break;
-				case reshade::api::format::r32_float:
-					runtime->set_uniform_value_float(it->variable_handle, it->before.as_float, 16);
-					break;
-				case reshade::api::format::r32_sint:
-					runtime->set_uniform_value_int(it->variable_handle, it->before.as_int, 16);
-					break;
-				case reshade::api::format::r32_uint:
-					runtime->set_uniform_value_uint(it->variable_handle, it->before.as_uint, 16);
-					break;
-				}
+				add_uniform_update(*it, it->before);
 				break;
 			case history::kind::technique_state:
 				runtime->set_technique_state(it->technique_handle, !it->technique_enabled);
@@ -328,21 +344,7 @@ static void draw_history_window(reshade::api::effect_runtime *runtime)
 			switch (it->kind)
 			{
 			case history::kind::uniform_value:
-				switch (it->variable_basetype)
-				{
-				case reshade::api::format::r32_typeless:
-					runtime->set_uniform_value_bool(it->variable_handle, &it->after.as_bool, 1);
-					break;
-				case reshade::api::format::r32_float:
-					runtime->set_uniform_value_float(it->variable_handle, it->after.as_float, 16);
-					break;
-				case reshade::api::format::r32_sint:
-					runtime->set_uniform_value_int(it->variable_handle, it->after.as_int, 16);
-					break;
-				case reshade::api::format::r32_uint:
-					runtime->set_uniform_value_uint(it->variable_handle, it->after.as_uint, 16);
-					break;
-				}
+				add_uniform_update(*it, it->after);
 				break;
 			case history::kind::technique_state:
 				runtime->set_technique_state(it->technique_handle, it->technique_enabled);
@@ -350,6 +352,8 @@ static void draw_history_window(reshade::api::effect_runtime *runtime)
 			}
 		}
 	}
+
+	runtime->set_uniform_values(uniform_updates.data(), uniform_updates.size());
 }
 
 extern "C" __declspec(dllexport) const char *NAME = "History Window";
@@ -7,6 +7,7 @@
 
 #include <imgui.h>
 #include <reshade.hpp>
+#include "state_tracking.hpp"
 #include <cmath>
 #include <cstring>
 #include <algorithm>
@@ -24,93 +25,6 @@ static unsigned int s_use_aspect_ratio_heuristics = 1;
 
 using namespace reshade::api;
 
-struct draw_stats
-{
-	uint32_t vertices = 0;
-	uint32_t drawcalls = 0;
-	uint32_t drawcalls_indirect = 0;
-	viewport last_viewport = {};
-};
-struct clear_stats : public draw_stats
-{
-	bool rect = false;
-};
-
-struct depth_stencil_info
-{
-	draw_stats total_stats;
-	draw_stats current_stats; // Stats since last clear operation
-	std::vector<clear_stats> clears;
-	bool copied_during_frame = false;
-};
-
-struct depth_stencil_hash
-{
-	inline size_t operator()(resource value) const
-	{
-		// Simply use the handle (which is usually a pointer) as hash value (with some bits shaved off due to pointer alignment)
-		return static_cast<size_t>(value.handle >> 4);
-	}
-};
-
-struct __declspec(uuid("43319e83-387c-448e-881c-7e68fc2e52c4")) state_tracking
-{
-	draw_stats best_copy_stats;
-	bool first_empty_stats = true;
-	viewport current_viewport = {};
-	resource current_depth_stencil = { 0 };
-	std::unordered_map<resource, depth_stencil_info, depth_stencil_hash> counters_per_used_depth_stencil;
-
-	state_tracking()
-	{
-		// Reserve some space upfront to avoid rehashing during command recording
-		counters_per_used_depth_stencil.reserve(32);
-	}
-
-	void reset()
-	{
-		reset_on_present();
-		current_depth_stencil = { 0 };
-	}
-	void reset_on_present()
-	{
-		best_copy_stats = { 0, 0 };
-		first_empty_stats = true;
-		counters_per_used_depth_stencil.clear();
-	}
-
-	void merge(const state_tracking &source)
-	{
-		// Executing a command list in a different command list inherits state
-		current_depth_stencil = source.current_depth_stencil;
-
-		if (first_empty_stats)
-			first_empty_stats = source.first_empty_stats;
-
-		if (source.best_copy_stats.vertices > best_copy_stats.vertices)
-			best_copy_stats = source.best_copy_stats;
-
-		if (source.counters_per_used_depth_stencil.empty())
-			return;
-
-		counters_per_used_depth_stencil.reserve(source.counters_per_used_depth_stencil.size());
-		for (const auto &[depth_stencil_handle, snapshot] : source.counters_per_used_depth_stencil)
-		{
-			depth_stencil_info &target_snapshot = counters_per_used_depth_stencil[depth_stencil_handle];
-			target_snapshot.total_stats.vertices += snapshot.total_stats.vertices;
-			target_snapshot.total_stats.drawcalls += snapshot.total_stats.drawcalls;
-			target_snapshot.total_stats.drawcalls_indirect += snapshot.total_stats.drawcalls_indirect;
-			target_snapshot.current_stats.vertices += snapshot.current_stats.vertices;
-			target_snapshot.current_stats.drawcalls += snapshot.current_stats.drawcalls;
-			target_snapshot.current_stats.drawcalls_indirect += snapshot.current_stats.drawcalls_indirect;
-
-			target_snapshot.clears.insert(target_snapshot.clears.end(), snapshot.clears.begin(), snapshot.clears.end());
-
-			target_snapshot.copied_during_frame |= snapshot.copied_during_frame;
-		}
-	}
-};
-
 struct __declspec(uuid("7c6363c7-f94e-437a-9160-141782c44a98")) state_tracking_inst
 {
 	// The depth-stencil that is currently selected as being the main depth target
@@ -148,8 +62,10 @@ struct depth_stencil_backup
 
 struct __declspec(uuid("e006e162-33ac-4b9f-b10f-0e15335c7bdb")) state_tracking_context
 {
-	// List of resources that were deleted this frame
-	std::vector<resource> destroyed_resources;
+	// Set of resources that were deleted this frame
+	// This has its own lock, so that destroying resources does not contend with the GUI and effect rendering reading the list of depth-stencils below
+	resource_set destroyed_resources;
+	std::shared_mutex destroyed_resources_mutex;
 
 	// List of all encountered depth-stencils of the last frame
 	std::vector<std::pair<resource, depth_stencil_info>> current_depth_stencil_list;
@@ -230,7 +146,10 @@ static void on_clear_depth_impl(command_list *cmd_list, state_tracking &state, r
 	if (depth_stencil_backup == nullptr || depth_stencil_backup->backup_texture == 0)
 		return;
 
-	depth_stencil_info &counters = state.counters_per_used_depth_stencil[depth_stencil];
+	// Merge stats of executed command lists first, so that they are included in the stats since the last clear
+	state.compact();
+
+	depth_stencil_info &counters = state.counters_for(depth_stencil);
 
 	// Update stats with data from previous frame
 	if (!fullscreen_draw_call && counters.current_stats.drawcalls == 0 && state.first_empty_stats)
@@ -406,9 +325,9 @@ static void on_destroy_resource(device *device, resource resource)
 	if (&device_state == nullptr)
 		return;
 
-	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+	const std::unique_lock<std::shared_mutex> lock(device_state.destroyed_resources_mutex);
 
-	device_state.destroyed_resources.push_back(resource);
+	device_state.destroyed_resources.insert(resource);
 }
 
 static bool on_draw(command_list *cmd_list, uint32_t vertices, uint32_t instances, uint32_t, uint32_t)
@@ -427,12 +346,7 @@ static bool on_draw(command_list *cmd_list, uint32_t vertices, uint32_t instance
 	}
 #endif
 
-	depth_stencil_info &counters = state.counters_per_used_depth_stencil[state.current_depth_stencil];
-	counters.total_stats.vertices += vertices * instances;
-	counters.total_stats.drawcalls += 1;
-	counters.current_stats.vertices += vertices * instances;
-	counters.current_stats.drawcalls += 1;
-	counters.current_stats.last_viewport = state.current_viewport;
+	state.record_draw(vertices * instances);
 
 	return false;
 }
@@ -451,12 +365,7 @@ static bool on_draw_indirect(command_list *cmd_list, indirect_command type, reso
 	if (state.current_depth_stencil == 0)
 		return false; // This is a draw call with no depth-stencil bound
 
-	depth_stencil_info &counters = state.counters_per_used_depth_stencil[state.current_depth_stencil];
-	counters.total_stats.drawcalls += draw_count;
-	counters.total_stats.drawcalls_indirect += draw_count;
-	counters.current_stats.drawcalls += draw_count;
-	counters.current_stats.last_viewport = state.current_viewport;
-	counters.current_stats.drawcalls_indirect += draw_count;
+	state.record_draw_indirect(draw_count);
 
 	return false;
 }
@@ -482,7 +391,7 @@ static void on_bind_depth_stencil(command_list *cmd_list, uint32_t, const resour
 	if (depth_stencil != state.current_depth_stencil && state.current_depth_stencil != 0 && (device->get_api() == device_api::d3d12 || device->get_api() == device_api::vulkan))
 		on_clear_depth_impl(cmd_list, state, state.current_depth_stencil, true);
 
-	state.current_depth_stencil = depth_stencil;
+	state.bind_depth_stencil(depth_stencil);
 }
 static bool on_clear_depth_stencil(command_list *cmd_list, resource_view dsv, const float *depth, const uint8_t *, uint32_t, const rect *)
 {
@@ -523,36 +432,29 @@ static void on_present(command_queue *queue, swapchain *swapchain, const rect *,
 {
 	auto &queue_state = queue->get_private_data<state_tracking>();
 
-	// Only update device list if there are any depth-stencils, otherwise this may be a second present call (at which point 'reset_on_present' already cleared out the queue list in the first present call)
-	if (queue_state.counters_per_used_depth_stencil.empty())
-		return;
-
-	// Also skip update when there has been very little activity (special case for emulators which may present more often than they render a frame)
-	if (queue_state.counters_per_used_depth_stencil.size() == 1 && queue_state.counters_per_used_depth_stencil.begin()->second.total_stats.drawcalls <= 4)
+	// Merge the stats of all command lists executed this frame
+	if (!queue_state.compact_for_present())
 		return;
 
 	auto &device_state = swapchain->get_device()->get_private_data<state_tracking_context>();
 
-	const std::unique_lock<std::shared_mutex> lock(s_mutex);
+	{
+		const std::unique_lock<std::shared_mutex> lock(device_state.destroyed_resources_mutex);
 
-	device_state.current_depth_stencil_list.clear();
-	device_state.current_depth_stencil_list.reserve(queue_state.counters_per_used_depth_stencil.size());
+		queue_state.remove_unused_and_destroyed(device_state.destroyed_resources);
 
-	for (const auto &[resource, snapshot] : queue_state.counters_per_used_depth_stencil)
-	{
-		if (snapshot.total_stats.drawcalls == 0)
-			continue; // Skip unused
+		device_state.destroyed_resources.clear();
+	}
 
-		if (std::find(device_state.destroyed_resources.begin(), device_state.destroyed_resources.end(), resource) != device_state.destroyed_resources.end())
-			continue; // Skip resources that were destroyed by the application
+	{
+		const std::unique_lock<std::shared_mutex> lock(s_mutex);
 
 		// Save to current list of depth-stencils on the device, so that it can be displayed in the GUI
-		device_state.current_depth_stencil_list.emplace_back(resource, snapshot);
+		// Swap the lists, so that the lock is only held briefly and the memory of the previous list is reused for the next frame
+		device_state.current_depth_stencil_list.swap(queue_state.counters_per_used_depth_stencil);
 	}
 
 	queue_state.reset_on_present();
-
-	device_state.destroyed_resources.clear();
 }
 
 static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_list, resource_view, resource_view)
@@ -571,10 +473,11 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 	runtime->get_screenshot_width_and_height(&frame_width, &frame_height);
 
 	std::shared_lock<std::shared_mutex> lock(s_mutex);
+	std::shared_lock<std::shared_mutex> destroyed_resources_lock(device_state.destroyed_resources_mutex);
 
 	for (const auto &[resource, snapshot] : device_state.current_depth_stencil_list)
 	{
-		if (std::find(device_state.destroyed_resources.begin(), device_state.destroyed_resources.end(), resource) != device_state.destroyed_resources.end())
+		if (device_state.destroyed_resources.contains(resource))
 			continue; // Skip resources that were destroyed by the application (check here again in case effects are rendered during the frame)
 
 		const resource_desc desc = device->get_resource_desc(resource);
@@ -607,6 +510,7 @@ static void on_begin_render_effects(effect_runtime *runtime, command_list *cmd_l
 		}
 	}
 
+	destroyed_resources_lock.unlock();
 	lock.unlock();
 
 	if (best_match != 0)
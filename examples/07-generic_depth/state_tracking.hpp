@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2021 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <reshade_api_pipeline.hpp>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+// Statistics of the depth-stencils used by a command list or queue, which only depend on the add-on API types, so that they can be replayed outside of ReShade as well
+
+struct draw_stats
+{
+	uint32_t vertices = 0;
+	uint32_t drawcalls = 0;
+	uint32_t drawcalls_indirect = 0;
+	reshade::api::viewport last_viewport = {};
+};
+struct clear_stats : public draw_stats
+{
+	bool rect = false;
+};
+
+struct depth_stencil_info
+{
+	draw_stats total_stats;
+	draw_stats current_stats; // Stats since last clear operation
+	std::vector<clear_stats> clears;
+	bool copied_during_frame = false;
+};
+
+struct depth_stencil_hash
+{
+	inline size_t operator()(reshade::api::resource value) const
+	{
+		// Simply use the handle (which is usually a pointer) as hash value (with some bits shaved off due to pointer alignment)
+		return static_cast<size_t>(value.handle >> 4);
+	}
+};
+
+// Hash set of resource handles using open addressing, so that adding to it does not allocate once it has grown to the typical size and clearing it keeps the memory around
+struct resource_set
+{
+	void insert(reshade::api::resource value)
+	{
+		if (value == 0)
+			return;
+
+		if (2 * (count + 1) > handles.size())
+			grow();
+
+		if (insert_unchecked(handles, value.handle))
+			count++;
+	}
+
+	bool contains(reshade::api::resource value) const
+	{
+		if (handles.empty())
+			return false;
+
+		for (size_t index = hash(value.handle);; ++index)
+		{
+			const uint64_t handle = handles[index & (handles.size() - 1)];
+			if (handle == value.handle)
+				return true;
+			if (handle == 0)
+				return false;
+		}
+	}
+
+	void clear()
+	{
+		if (count == 0)
+			return;
+
+		std::fill(handles.begin(), handles.end(), 0);
+		count = 0;
+	}
+
+private:
+	static inline size_t hash(uint64_t handle)
+	{
+		// Scramble the handle with a Fibonacci multiplication, since handles tend to be aligned to large powers of two, which would otherwise all collide in the same slots
+		return static_cast<size_t>((handle * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	static bool insert_unchecked(std::vector<uint64_t> &handles, uint64_t value)
+	{
+		for (size_t index = hash(value);; ++index)
+		{
+			uint64_t &handle = handles[index & (handles.size() - 1)];
+			if (handle == value)
+				return false;
+			if (handle == 0)
+			{
+				handle = value;
+				return true;
+			}
+		}
+	}
+
+	void grow()
+	{
+		std::vector<uint64_t> new_handles(std::max<size_t>(handles.size() * 2, 256)); // Must be a power of two
+		for (const uint64_t handle : handles)
+			if (handle != 0)
+				insert_unchecked(new_handles, handle);
+		handles.swap(new_handles);
+	}
+
+	// Zero marks an empty slot, which is fine since it is not a valid resource handle
+	std::vector<uint64_t> handles;
+	size_t count = 0;
+};
+
+struct __declspec(uuid("43319e83-387c-448e-881c-7e68fc2e52c4")) state_tracking
+{
+	static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+	draw_stats best_copy_stats;
+	bool first_empty_stats = true;
+	reshade::api::viewport current_viewport = {};
+	reshade::api::resource current_depth_stencil = { 0 };
+	// Index of the entry of the current depth-stencil in the list below, which is looked up on the first draw call after binding it
+	uint32_t current_depth_stencil_index = INVALID_INDEX;
+	// Stats per used depth-stencil in order of first use
+	// Executing a command list appends its entries as-is, so the same depth-stencil may appear multiple times until the list is compacted again
+	std::vector<std::pair<reshade::api::resource, depth_stencil_info>> counters_per_used_depth_stencil;
+	size_t compacted_size = 0;
+	bool needs_compaction = false;
+
+	// Small direct-mapped cache of entry indices, so that switching between the few depth-stencils a command list typically uses does not have to search the list
+	struct index_cache_entry
+	{
+		reshade::api::resource depth_stencil;
+		uint32_t index;
+	} index_cache[8] = {};
+
+	state_tracking()
+	{
+		// Reserve some space upfront to avoid reallocation during command recording
+		counters_per_used_depth_stencil.reserve(32);
+	}
+
+	void reset()
+	{
+		reset_on_present();
+		current_depth_stencil = { 0 };
+	}
+	void reset_on_present()
+	{
+		best_copy_stats = { 0, 0 };
+		first_empty_stats = true;
+		counters_per_used_depth_stencil.clear();
+		compacted_size = 0;
+		needs_compaction = false;
+		invalidate_indices();
+	}
+
+	void invalidate_indices()
+	{
+		current_depth_stencil_index = INVALID_INDEX;
+		for (index_cache_entry &entry : index_cache)
+			entry.depth_stencil = { 0 };
+	}
+
+	uint32_t find_or_add(reshade::api::resource depth_stencil)
+	{
+		index_cache_entry &entry = index_cache[depth_stencil_hash()(depth_stencil) % std::size(index_cache)];
+		if (entry.depth_stencil == depth_stencil)
+			return entry.index;
+
+		const auto it = std::find_if(counters_per_used_depth_stencil.begin(), counters_per_used_depth_stencil.end(), [depth_stencil](const auto &counters) { return counters.first == depth_stencil; });
+
+		entry.depth_stencil = depth_stencil;
+		entry.index = static_cast<uint32_t>(it - counters_per_used_depth_stencil.begin());
+
+		if (it == counters_per_used_depth_stencil.end())
+			counters_per_used_depth_stencil.emplace_back(depth_stencil, depth_stencil_info {});
+
+		return entry.index;
+	}
+
+	void bind_depth_stencil(reshade::api::resource depth_stencil)
+	{
+		if (depth_stencil != current_depth_stencil)
+		{
+			current_depth_stencil = depth_stencil;
+			current_depth_stencil_index = INVALID_INDEX;
+		}
+	}
+
+	void record_draw(uint32_t vertices)
+	{
+		depth_stencil_info &counters = current_counters();
+		counters.total_stats.vertices += vertices;
+		counters.total_stats.drawcalls += 1;
+		counters.current_stats.vertices += vertices;
+		counters.current_stats.drawcalls += 1;
+		counters.current_stats.last_viewport = current_viewport;
+	}
+	void record_draw_indirect(uint32_t draw_count)
+	{
+		depth_stencil_info &counters = current_counters();
+		counters.total_stats.drawcalls += draw_count;
+		counters.total_stats.drawcalls_indirect += draw_count;
+		counters.current_stats.drawcalls += draw_count;
+		counters.current_stats.last_viewport = current_viewport;
+		counters.current_stats.drawcalls_indirect += draw_count;
+	}
+
+	depth_stencil_info &counters_for(reshade::api::resource depth_stencil)
+	{
+		return counters_per_used_depth_stencil[find_or_add(depth_stencil)].second;
+	}
+	depth_stencil_info &current_counters()
+	{
+		if (current_depth_stencil_index == INVALID_INDEX)
+			current_depth_stencil_index = find_or_add(current_depth_stencil);
+
+		return counters_per_used_depth_stencil[current_depth_stencil_index].second;
+	}
+
+	void merge(const state_tracking &source)
+	{
+		// Executing a command list in a different command list inherits state
+		current_depth_stencil = source.current_depth_stencil;
+		current_depth_stencil_index = INVALID_INDEX;
+
+		if (first_empty_stats)
+			first_empty_stats = source.first_empty_stats;
+
+		if (source.best_copy_stats.vertices > best_copy_stats.vertices)
+			best_copy_stats = source.best_copy_stats;
+
+		if (source.counters_per_used_depth_stencil.empty())
+			return;
+
+		// Only append the entries here, since this happens for every executed command list, while merging entries of the same depth-stencil is only necessary once per frame
+		const size_t offset = counters_per_used_depth_stencil.size();
+		counters_per_used_depth_stencil.insert(counters_per_used_depth_stencil.end(), source.counters_per_used_depth_stencil.begin(), source.counters_per_used_depth_stencil.end());
+		needs_compaction = true;
+
+		// The last viewport is not inherited by the executing command list
+		for (size_t i = offset; i < counters_per_used_depth_stencil.size(); ++i)
+			counters_per_used_depth_stencil[i].second.current_stats.last_viewport = {};
+
+		// Keep the list from growing indefinitely on queues that execute command lists without ever presenting
+		if (counters_per_used_depth_stencil.size() > 2 * compacted_size + 64)
+			compact();
+	}
+
+	// Merges the stats of all command lists executed this frame and checks whether they should replace the list of depth-stencils of the previous frame
+	bool compact_for_present()
+	{
+		compact();
+
+		// Only update device list if there are any depth-stencils, otherwise this may be a second present call (at which point 'reset_on_present' already cleared out the queue list in the first present call)
+		if (counters_per_used_depth_stencil.empty())
+			return false;
+
+		// Also skip update when there has been very little activity (special case for emulators which may present more often than they render a frame)
+		if (counters_per_used_depth_stencil.size() == 1 && counters_per_used_depth_stencil.front().second.total_stats.drawcalls <= 4)
+			return false;
+
+		return true;
+	}
+
+	void remove_unused_and_destroyed(const resource_set &destroyed_resources)
+	{
+		counters_per_used_depth_stencil.erase(
+			std::remove_if(counters_per_used_depth_stencil.begin(), counters_per_used_depth_stencil.end(),
+				[&destroyed_resources](const auto &counters) {
+					return counters.second.total_stats.drawcalls == 0 || // Skip unused
+						destroyed_resources.contains(counters.first); // Skip resources that were destroyed by the application
+				}),
+			counters_per_used_depth_stencil.end());
+	}
+
+	void compact()
+	{
+		if (!needs_compaction || counters_per_used_depth_stencil.empty())
+			return;
+
+		// Sort so that entries of the same depth-stencil are next to each other, keeping them in the order they were added (which matters for the list of clears)
+		std::stable_sort(counters_per_used_depth_stencil.begin(), counters_per_used_depth_stencil.end(), [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+
+		auto target = counters_per_used_depth_stencil.begin();
+		for (auto it = target + 1; it < counters_per_used_depth_stencil.end(); ++it)
+		{
+			if (it->first != target->first)
+			{
+				if (++target != it)
+					*target = std::move(*it);
+				continue;
+			}
+
+			depth_stencil_info &target_snapshot = target->second;
+			const depth_stencil_info &snapshot = it->second;
+			target_snapshot.total_stats.vertices += snapshot.total_stats.vertices;
+			target_snapshot.total_stats.drawcalls += snapshot.total_stats.drawcalls;
+			target_snapshot.total_stats.drawcalls_indirect += snapshot.total_stats.drawcalls_indirect;
+			target_snapshot.current_stats.vertices += snapshot.current_stats.vertices;
+			target_snapshot.current_stats.drawcalls += snapshot.current_stats.drawcalls;
+			target_snapshot.current_stats.drawcalls_indirect += snapshot.current_stats.drawcalls_indirect;
+
+			target_snapshot.clears.insert(target_snapshot.clears.end(), snapshot.clears.begin(), snapshot.clears.end());
+
+			target_snapshot.copied_during_frame |= snapshot.copied_during_frame;
+		}
+
+		counters_per_used_depth_stencil.erase(target + 1, counters_per_used_depth_stencil.end());
+
+		compacted_size = counters_per_used_depth_stencil.size();
+		needs_compaction = false;
+
+		// Entries have moved, so any cached indices are no longer valid
+		invalidate_indices();
+	}
+};
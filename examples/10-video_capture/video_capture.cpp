@@ -4,195 +4,141 @@
  */
 
 #include <chrono>
+#include <cstdio>
+#include <string>
 #include <reshade.hpp>
+#include "video_pipeline.hpp"
 
-extern "C" {
-#include <libavutil/hwcontext.h>
-#include <libavcodec/avcodec.h>
-#include <libavformat/avformat.h>
-}
+// Number of intermediate resources frames are copied into, the oldest of which is read back every frame
+// This keeps enough frames in flight that mapping a resource does not have to wait for the GPU to finish the copy
+static constexpr size_t NUM_READBACK_SLOTS = 4;
 
 struct __declspec(uuid("0D7525F9-C4E1-426E-BC99-15BBD5FD51F2")) video_capture
 {
-	AVCodecContext *codec_ctx = nullptr;
-	AVFormatContext *output_ctx = nullptr;
-	AVFrame *frame = nullptr;
-
-	reshade::api::resource host_resource;
-
-	std::chrono::system_clock::time_point last_time;
-	std::chrono::system_clock::time_point start_time;
-
-	bool init_codec_ctx(const reshade::api::resource_desc &buffer_desc);
-	void destroy_codec_ctx();
-	bool init_format_ctx(const char *filename);
-	void destroy_format_ctx();
-};
+	video_pipeline pipeline;
 
-bool video_capture::init_codec_ctx(const reshade::api::resource_desc &buffer_desc)
-{
-	const AVCodec *codec = nullptr;
-	void *i = nullptr;
-	while ((codec = av_codec_iterate(&i)) != nullptr)
+	struct readback_slot
 	{
-		if (codec->id != AV_CODEC_ID_H264 || !av_codec_is_encoder(codec))
-			continue;
+		reshade::api::resource host_resource = { 0 };
+		bool pending = false;
+		int64_t timestamp_ms = 0;
+	} readback_slots[NUM_READBACK_SLOTS];
+	size_t current_slot = 0;
 
-		bool supports_rgb0 = false;
-		for (const AVPixelFormat *fmt = codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; ++fmt)
-			if (*fmt == AV_PIX_FMT_0BGR32 || *fmt == AV_PIX_FMT_0RGB32)
-				supports_rgb0 = true;
+	std::chrono::high_resolution_clock::time_point last_time;
+	std::chrono::high_resolution_clock::time_point start_time;
 
-		 if (supports_rgb0)
-			break; // Found a codec that passes requirements
-	}
+	bool start(reshade::api::device *device, const reshade::api::resource_desc &desc);
+	void stop(reshade::api::device *device);
 
-	if (codec == nullptr)
-	{
-		reshade::log_message(1, "Failed to find a H.264 encoder that passes requirements!");
-		return false;
-	}
+	void read_back_slot(reshade::api::device *device, readback_slot &slot);
+};
 
-	codec_ctx = avcodec_alloc_context3(codec);
+static std::string get_config_string(const char *key, const char *default_value)
+{
+	char value[256] = ""; size_t value_length = sizeof(value) - 1;
+	if (!reshade::config_get_value(nullptr, "VIDEO_CAPTURE", key, value, &value_length))
+		return default_value;
+	return std::string(value, value_length);
+}
 
-	codec_ctx->bit_rate = 400000;
-	codec_ctx->width = buffer_desc.texture.width;
-	codec_ctx->height = buffer_desc.texture.height;
-	codec_ctx->time_base = { 1, 30 }; // Frames per second
-	codec_ctx->color_range = AVCOL_RANGE_JPEG;
-	codec_ctx->gop_size = 250;
-	codec_ctx->max_b_frames = 2;
+bool video_capture::start(reshade::api::device *device, const reshade::api::resource_desc &desc)
+{
+	video_pipeline::settings settings;
 
-	switch (buffer_desc.texture.format)
+	switch (reshade::api::format_to_default_typed(desc.texture.format, 0))
 	{
 	case reshade::api::format::r8g8b8a8_unorm:
-	case reshade::api::format::r8g8b8a8_unorm_srgb:
 	case reshade::api::format::r8g8b8x8_unorm:
-	case reshade::api::format::r8g8b8x8_unorm_srgb:
-		codec_ctx->pix_fmt = AV_PIX_FMT_0BGR32;
+		settings.layout = video_pipeline::pixel_layout::rgba;
 		break;
 	case reshade::api::format::b8g8r8a8_unorm:
-	case reshade::api::format::b8g8r8a8_unorm_srgb:
 	case reshade::api::format::b8g8r8x8_unorm:
-	case reshade::api::format::b8g8r8x8_unorm_srgb:
-		codec_ctx->pix_fmt = AV_PIX_FMT_0RGB32;
+		settings.layout = video_pipeline::pixel_layout::bgra;
 		break;
 	default:
-		destroy_codec_ctx();
 		reshade::log_message(1, "Unsupported texture format!");
 		return false;
 	}
 
-	if (int err = avcodec_open2(codec_ctx, codec, nullptr); err < 0)
-	{
-		destroy_codec_ctx();
-
-		char errbuf[32 + AV_ERROR_MAX_STRING_SIZE] = "Failed to initialize encoder: ";
-		av_make_error_string(errbuf + strlen(errbuf), sizeof(errbuf) - strlen(errbuf), err);
-		reshade::log_message(1, errbuf);
-		return false;
-	}
-
-	frame = av_frame_alloc();
+	settings.width = desc.texture.width;
+	settings.height = desc.texture.height;
+	settings.filename = get_config_string("FileName", "video.mp4");
+	settings.encoder = get_config_string("Encoder", "");
+	settings.preset = get_config_string("Preset", "veryfast");
+	reshade::config_get_value(nullptr, "VIDEO_CAPTURE", "BitRate", settings.bit_rate);
+	reshade::config_get_value(nullptr, "VIDEO_CAPTURE", "FrameRate", settings.frame_rate);
+	reshade::config_get_value(nullptr, "VIDEO_CAPTURE", "MaxQueuedFrames", settings.max_queued_frames);
+	reshade::config_get_value(nullptr, "VIDEO_CAPTURE", "ConvertThreads", settings.num_convert_threads);
 
-	if (frame == nullptr)
+	if (!pipeline.start(settings))
 	{
-		destroy_codec_ctx();
+		reshade::log_message(1, pipeline.last_error().c_str());
 		return false;
 	}
 
-	frame->width = codec_ctx->width;
-	frame->height = codec_ctx->height;
-	frame->format = codec_ctx->pix_fmt;
-	frame->color_range = codec_ctx->color_range;
+	reshade::api::resource_desc host_desc = desc;
+	host_desc.type = reshade::api::resource_type::texture_2d;
+	host_desc.heap = reshade::api::memory_heap::gpu_to_cpu;
+	host_desc.usage = reshade::api::resource_usage::copy_dest;
+	host_desc.flags = reshade::api::resource_flags::none;
 
-	if (int err = av_frame_get_buffer(frame, 0); err < 0)
+	for (readback_slot &slot : readback_slots)
 	{
-		destroy_codec_ctx();
+		if (!device->create_resource(host_desc, nullptr, reshade::api::resource_usage::cpu_access, &slot.host_resource))
+		{
+			reshade::log_message(1, "Failed to create host resource!");
 
-		char errbuf[32 + AV_ERROR_MAX_STRING_SIZE] = "Failed to get frame buffer: ";
-		av_make_error_string(errbuf + strlen(errbuf), sizeof(errbuf) - strlen(errbuf), err);
-		reshade::log_message(1, errbuf);
-		return false;
+			stop(device);
+			return false;
+		}
 	}
 
+	current_slot = 0;
+	start_time = last_time = std::chrono::high_resolution_clock::now();
+
 	return true;
 }
-void video_capture::destroy_codec_ctx()
+void video_capture::stop(reshade::api::device *device)
 {
-	if (frame != nullptr)
-	{
-		av_frame_free(&frame);
-		frame = nullptr;
-	}
+	// Read back the frames that are still in flight, oldest first (which is the slot that would be reused next)
+	for (size_t i = 0; i < NUM_READBACK_SLOTS; ++i)
+		read_back_slot(device, readback_slots[(current_slot + i) % NUM_READBACK_SLOTS]);
 
-	if (codec_ctx != nullptr)
+	for (readback_slot &slot : readback_slots)
 	{
-		avcodec_free_context(&codec_ctx);
-		codec_ctx = nullptr;
+		if (slot.host_resource != 0)
+			device->destroy_resource(slot.host_resource);
+		slot = {};
 	}
-}
 
-bool video_capture::init_format_ctx(const char *filename)
-{
-	if (int err = avformat_alloc_output_context2(&output_ctx, nullptr, nullptr, filename); err < 0)
-	{
-		char errbuf[32 + AV_ERROR_MAX_STRING_SIZE] = "Failed to initialize ffmpeg output context: ";
-		av_make_error_string(errbuf + strlen(errbuf), sizeof(errbuf) - strlen(errbuf), err);
-		reshade::log_message(1, errbuf);
-		return false;
-	}
-
-	if (int err = avio_open(&output_ctx->pb, filename, AVIO_FLAG_WRITE); err < 0)
+	if (pipeline.is_active())
 	{
-		avformat_free_context(output_ctx);
-		output_ctx = nullptr;
-
-		reshade::log_message(1, "Failed to open output file!");
-		return false;
-	}
+		// This waits for all queued frames to be encoded and written
+		pipeline.stop();
 
-	// Add video stream with this codec to the output
-	AVStream *const stream = avformat_new_stream(output_ctx, nullptr);
-	stream->id = 0;
-	stream->time_base = codec_ctx->time_base;
-	avcodec_parameters_from_context(stream->codecpar, codec_ctx);
+		const video_pipeline::statistics stats = pipeline.get_statistics();
 
-	avformat_write_header(output_ctx, nullptr);
-
-	return true;
-}
-void video_capture::destroy_format_ctx()
-{
-	if (output_ctx != nullptr)
-	{
-		av_write_trailer(output_ctx);
-
-		avio_context_free(&output_ctx->pb);
-		avformat_free_context(output_ctx);
-		output_ctx = nullptr;
+		char message[256];
+		sprintf_s(message, "Finished video recording with %llu frames encoded and %llu frames dropped (%llu bytes written).", stats.frames_encoded, stats.frames_dropped, stats.bytes_written);
+		reshade::log_message(3, message);
 	}
 }
 
-static void encode_frame(AVCodecContext *enc, AVFormatContext *s, AVFrame *frame, int stream_index = 0)
+void video_capture::read_back_slot(reshade::api::device *device, readback_slot &slot)
 {
-	if (int err = avcodec_send_frame(enc, frame); err < 0)
-	{
-		char errbuf[32 + AV_ERROR_MAX_STRING_SIZE] = "Failed to send frame for encoding: ";
-		av_make_error_string(errbuf + strlen(errbuf), sizeof(errbuf) - strlen(errbuf), err);
-		reshade::log_message(1, errbuf);
+	if (!slot.pending)
 		return;
-	}
+	slot.pending = false;
 
-	AVStream *const stream = s->streams[stream_index];
+	reshade::api::subresource_data host_data;
+	if (!device->map_texture_region(slot.host_resource, 0, nullptr, reshade::api::map_access::read_only, &host_data))
+		return;
 
-	for (AVPacket pkt = {}; avcodec_receive_packet(enc, &pkt) >= 0; av_packet_unref(&pkt))
-	{
-		av_packet_rescale_ts(&pkt, enc->time_base, stream->time_base);
-		pkt.stream_index = stream_index;
+	// Only copies the frame, color conversion and encoding happen on the pipeline threads
+	pipeline.submit_frame(host_data.data, host_data.row_pitch, slot.timestamp_ms);
 
-		av_interleaved_write_frame(s, &pkt);
-	}
+	device->unmap_texture_region(slot.host_resource, 0);
 }
 
 static void on_init(reshade::api::swapchain *swapchain)
@@ -203,14 +149,7 @@ static void on_destroy(reshade::api::swapchain *swapchain)
 {
 	video_capture &data = swapchain->get_private_data<video_capture>();
 
-	if (data.host_resource != 0)
-		swapchain->get_device()->destroy_resource(data.host_resource);
-
-	// Flush the encoder
-	if (data.output_ctx != nullptr)
-		encode_frame(data.codec_ctx, data.output_ctx, nullptr);
-
-	data.destroy_format_ctx(); data.destroy_codec_ctx();
+	data.stop(swapchain->get_device());
 
 	swapchain->destroy_private_data<video_capture>();
 }
@@ -225,96 +164,50 @@ static void on_reshade_finish_effects(reshade::api::effect_runtime *runtime, res
 
 	if (runtime->is_key_pressed(VK_F11))
 	{
-		if (data.output_ctx != nullptr)
+		if (data.pipeline.is_active())
 		{
 			reshade::log_message(3, "Stopping video recording ...");
 
-			device->destroy_resource(data.host_resource);
-			data.host_resource = { 0 };
-
-			// Flush the encoder
-			encode_frame(data.codec_ctx, data.output_ctx, nullptr);
+			runtime->get_command_queue()->wait_idle();
 
-			data.destroy_format_ctx(); data.destroy_codec_ctx();
+			data.stop(device);
 		}
 		else
 		{
-			reshade::api::resource_desc desc = device->get_resource_desc(rtv_resource);
-
-			if (!data.init_codec_ctx(desc))
-				return;
-			if (!data.init_format_ctx("video.mp4"))
+			if (!data.start(device, device->get_resource_desc(rtv_resource)))
 				return;
 
-			desc.type = reshade::api::resource_type::texture_2d;
-			desc.heap = reshade::api::memory_heap::gpu_to_cpu;
-			desc.usage = reshade::api::resource_usage::copy_dest;
-
-			if (device->create_resource(desc, nullptr, reshade::api::resource_usage::cpu_access, &data.host_resource))
-			{
-				reshade::log_message(3, "Starting video recording ...");
-
-				data.start_time = data.last_time = std::chrono::system_clock::now();
-			}
-			else
-			{
-				reshade::log_message(1, "Failed to create host resource!");
-
-				data.destroy_format_ctx(); data.destroy_codec_ctx();
-				return;
-			}
+			reshade::log_message(3, "Starting video recording ...");
 		}
 	}
 
-	if (data.codec_ctx == nullptr || data.output_ctx == nullptr || data.host_resource == 0)
+	if (!data.pipeline.is_active())
 		return;
 
-	// Only encode a frame every few frames, depending on the set codec framerate
-	const auto time = std::chrono::system_clock::now();
-	if ((time - data.last_time) < (std::chrono::milliseconds(data.codec_ctx->time_base.num * std::milli::den) / data.codec_ctx->time_base.den))
+	// Only capture a frame every few frames, depending on the set frame rate
+	const auto time = std::chrono::high_resolution_clock::now();
+	if ((time - data.last_time) < (std::chrono::microseconds(std::micro::den) / data.pipeline.current_settings().frame_rate))
 		return;
 	data.last_time = time;
 
-	// TODO: This is slow/incorrect, because blocking for the frame and copy to finish.
-	// Instead multiple resources should be created and copied into in a round-robin fashion, only the oldest of which is mapped below and copies into the video frame.
-	// See also the OBS capture add-on example which does this.
+	// Read back the oldest frame before its slot is reused for the current one
+	video_capture::readback_slot &slot = data.readback_slots[data.current_slot];
+	data.read_back_slot(device, slot);
+
 	reshade::api::command_list *const cmd_list = runtime->get_command_queue()->get_immediate_command_list();
-	cmd_list->barrier(data.host_resource, reshade::api::resource_usage::cpu_access, reshade::api::resource_usage::copy_dest);
+	cmd_list->barrier(slot.host_resource, reshade::api::resource_usage::cpu_access, reshade::api::resource_usage::copy_dest);
 	cmd_list->barrier(rtv_resource, reshade::api::resource_usage::render_target, reshade::api::resource_usage::copy_source);
-	cmd_list->copy_resource(rtv_resource, data.host_resource);
-	cmd_list->barrier(data.host_resource, reshade::api::resource_usage::copy_dest, reshade::api::resource_usage::cpu_access);
+	cmd_list->copy_resource(rtv_resource, slot.host_resource);
+	cmd_list->barrier(slot.host_resource, reshade::api::resource_usage::copy_dest, reshade::api::resource_usage::cpu_access);
 	cmd_list->barrier(rtv_resource, reshade::api::resource_usage::copy_source, reshade::api::resource_usage::render_target);
 
+	// Submit the copy, but do not wait for it to finish (it is only mapped after the other slots were used)
 	runtime->get_command_queue()->flush_immediate_command_list();
 
-	if (av_frame_make_writable(data.frame) < 0)
-		return;
-
-	reshade::api::subresource_data host_data;
-	if (!device->map_texture_region(data.host_resource, 0, nullptr, reshade::api::map_access::read_only, &host_data))
-		return;
-
-	for (int y = 0; y < data.codec_ctx->height; ++y)
-	{
-		for (int x = 0; x < data.codec_ctx->width; ++x)
-		{
-			const size_t host_data_index = y * host_data.row_pitch + x * 4;
-			const size_t frame_data_index = y * data.frame->linesize[0] + x * 4;
-
-			data.frame->data[0][frame_data_index + 0] = static_cast<const uint8_t *>(host_data.data)[host_data_index + 0];
-			data.frame->data[0][frame_data_index + 1] = static_cast<const uint8_t *>(host_data.data)[host_data_index + 1];
-			data.frame->data[0][frame_data_index + 2] = static_cast<const uint8_t *>(host_data.data)[host_data_index + 2];
-		}
-	}
-
-	device->unmap_texture_region(data.host_resource, 0);
-
-	data.frame->pts = av_rescale_q(
-		std::chrono::duration_cast<std::chrono::milliseconds>(time - data.start_time).count(),
-		AVRational { std::milli::num, std::milli::den },
-		data.codec_ctx->time_base);
+	slot.pending = true;
+	slot.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(time - data.start_time).count();
 
-	encode_frame(data.codec_ctx, data.output_ctx, data.frame);
+	data.current_slot = (data.current_slot + 1) % NUM_READBACK_SLOTS;
 }
 
 extern "C" __declspec(dllexport) const char *NAME = "Video Capture";
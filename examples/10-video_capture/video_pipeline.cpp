@@ -0,0 +1,485 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include "video_pipeline.hpp"
+#include <cstring>
+#include <algorithm>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VIDEO_PIPELINE_SSE2 1
+#endif
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+static std::string format_error(const char *message, int err)
+{
+	char errbuf[AV_ERROR_MAX_STRING_SIZE] = "";
+	av_make_error_string(errbuf, sizeof(errbuf), err);
+	return std::string(message) + errbuf;
+}
+
+// BT.709 limited range coefficients, scaled by 2^14
+static const int16_t s_coeff_y[3] = { 2992, 10063, 1016 };
+static const int16_t s_coeff_u[3] = { -1648, -5548, 7196 };
+static const int16_t s_coeff_v[3] = { 7196, -6536, -660 };
+
+void video_pipeline::convert_rows_to_yuv420(pixel_layout layout, const uint8_t *src_row0, const uint8_t *src_row1, uint32_t width, uint8_t *dst_y0, uint8_t *dst_y1, uint8_t *dst_u, uint8_t *dst_v)
+{
+	// Swap red and blue coefficients instead of the channels in the source data
+	const int r = layout == pixel_layout::rgba ? 0 : 2;
+	const int b = layout == pixel_layout::rgba ? 2 : 0;
+
+	uint32_t x = 0;
+
+#if VIDEO_PIPELINE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coeff_y = layout == pixel_layout::rgba ?
+		_mm_setr_epi16(s_coeff_y[0], s_coeff_y[1], s_coeff_y[2], 0, s_coeff_y[0], s_coeff_y[1], s_coeff_y[2], 0) :
+		_mm_setr_epi16(s_coeff_y[2], s_coeff_y[1], s_coeff_y[0], 0, s_coeff_y[2], s_coeff_y[1], s_coeff_y[0], 0);
+	const __m128i coeff_u = layout == pixel_layout::rgba ?
+		_mm_setr_epi16(s_coeff_u[0], s_coeff_u[1], s_coeff_u[2], 0, s_coeff_u[0], s_coeff_u[1], s_coeff_u[2], 0) :
+		_mm_setr_epi16(s_coeff_u[2], s_coeff_u[1], s_coeff_u[0], 0, s_coeff_u[2], s_coeff_u[1], s_coeff_u[0], 0);
+	const __m128i coeff_v = layout == pixel_layout::rgba ?
+		_mm_setr_epi16(s_coeff_v[0], s_coeff_v[1], s_coeff_v[2], 0, s_coeff_v[0], s_coeff_v[1], s_coeff_v[2], 0) :
+		_mm_setr_epi16(s_coeff_v[2], s_coeff_v[1], s_coeff_v[0], 0, s_coeff_v[2], s_coeff_v[1], s_coeff_v[0], 0);
+	const __m128i offset_y = _mm_set1_epi32((16 << 14) + (1 << 13));
+	const __m128i offset_uv = _mm_set1_epi32((128 << 16) + (1 << 15));
+
+	// Computes the dot product of the coefficients with two pixels (16-bit per channel), returning the results in the 32-bit lanes 0 and 2
+	const auto dot2 = [](__m128i pixels, __m128i coeff) {
+		const __m128i products = _mm_madd_epi16(pixels, coeff);
+		return _mm_add_epi32(products, _mm_srli_epi64(products, 32));
+	};
+	// Combines the results of two 'dot2' calls into a single vector of four 32-bit values
+	const auto combine = [](__m128i a, __m128i b) {
+		return _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 0, 2, 0)));
+	};
+	// Computes luma for four pixels
+	const auto luma4 = [&](__m128i pixels) {
+		const __m128i y = combine(dot2(_mm_unpacklo_epi8(pixels, zero), coeff_y), dot2(_mm_unpackhi_epi8(pixels, zero), coeff_y));
+		return _mm_srai_epi32(_mm_add_epi32(y, offset_y), 14);
+	};
+
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i row0_a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_row0 + x * 4));
+		const __m128i row0_b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_row0 + x * 4 + 16));
+		const __m128i row1_a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_row1 + x * 4));
+		const __m128i row1_b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_row1 + x * 4 + 16));
+
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst_y0 + x), _mm_packus_epi16(_mm_packs_epi32(luma4(row0_a), luma4(row0_b)), zero));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst_y1 + x), _mm_packus_epi16(_mm_packs_epi32(luma4(row1_a), luma4(row1_b)), zero));
+
+		// Sum each 2x2 block of pixels, which results in two blocks per 16-bit vector
+		const __m128i sum_a = _mm_add_epi16(_mm_unpacklo_epi8(row0_a, zero), _mm_unpacklo_epi8(row1_a, zero));
+		const __m128i sum_b = _mm_add_epi16(_mm_unpackhi_epi8(row0_a, zero), _mm_unpackhi_epi8(row1_a, zero));
+		const __m128i sum_c = _mm_add_epi16(_mm_unpacklo_epi8(row0_b, zero), _mm_unpacklo_epi8(row1_b, zero));
+		const __m128i sum_d = _mm_add_epi16(_mm_unpackhi_epi8(row0_b, zero), _mm_unpackhi_epi8(row1_b, zero));
+		const __m128i blocks_ab = _mm_unpacklo_epi64(_mm_add_epi16(sum_a, _mm_srli_si128(sum_a, 8)), _mm_add_epi16(sum_b, _mm_srli_si128(sum_b, 8)));
+		const __m128i blocks_cd = _mm_unpacklo_epi64(_mm_add_epi16(sum_c, _mm_srli_si128(sum_c, 8)), _mm_add_epi16(sum_d, _mm_srli_si128(sum_d, 8)));
+
+		const __m128i u = _mm_srai_epi32(_mm_add_epi32(combine(dot2(blocks_ab, coeff_u), dot2(blocks_cd, coeff_u)), offset_uv), 16);
+		const __m128i v = _mm_srai_epi32(_mm_add_epi32(combine(dot2(blocks_ab, coeff_v), dot2(blocks_cd, coeff_v)), offset_uv), 16);
+
+		const __m128i uv = _mm_packus_epi16(_mm_packs_epi32(u, v), zero);
+		const int uv_packed[2] = { _mm_cvtsi128_si32(uv), _mm_cvtsi128_si32(_mm_srli_si128(uv, 4)) };
+		std::memcpy(dst_u + x / 2, &uv_packed[0], 4);
+		std::memcpy(dst_v + x / 2, &uv_packed[1], 4);
+	}
+#endif
+
+	for (; x < width; x += 2)
+	{
+		const uint8_t *const p00 = src_row0 + x * 4;
+		const uint8_t *const p01 = src_row0 + std::min(x + 1, width - 1) * 4;
+		const uint8_t *const p10 = src_row1 + x * 4;
+		const uint8_t *const p11 = src_row1 + std::min(x + 1, width - 1) * 4;
+
+		const auto luma = [r, b](const uint8_t *p) {
+			return static_cast<uint8_t>(std::min(255, (s_coeff_y[0] * p[r] + s_coeff_y[1] * p[1] + s_coeff_y[2] * p[b] + (16 << 14) + (1 << 13)) >> 14));
+		};
+
+		dst_y0[x] = luma(p00);
+		dst_y1[x] = luma(p10);
+		if (x + 1 < width)
+		{
+			dst_y0[x + 1] = luma(p01);
+			dst_y1[x + 1] = luma(p11);
+		}
+
+		const int sum_r = p00[r] + p01[r] + p10[r] + p11[r];
+		const int sum_g = p00[1] + p01[1] + p10[1] + p11[1];
+		const int sum_b = p00[b] + p01[b] + p10[b] + p11[b];
+
+		dst_u[x / 2] = static_cast<uint8_t>((s_coeff_u[0] * sum_r + s_coeff_u[1] * sum_g + s_coeff_u[2] * sum_b + (128 << 16) + (1 << 15)) >> 16);
+		dst_v[x / 2] = static_cast<uint8_t>((s_coeff_v[0] * sum_r + s_coeff_v[1] * sum_g + s_coeff_v[2] * sum_b + (128 << 16) + (1 << 15)) >> 16);
+	}
+}
+
+bool video_pipeline::start(const settings &settings)
+{
+	stop();
+
+	_settings = settings;
+	// Encoders require even dimensions for 4:2:0 chroma subsampling
+	_settings.width &= ~1u;
+	_settings.height &= ~1u;
+	_settings.frame_rate = std::max(1u, _settings.frame_rate);
+	_settings.max_queued_frames = std::max<size_t>(1, _settings.max_queued_frames);
+	_last_error.clear();
+
+	if (_settings.width == 0 || _settings.height == 0)
+	{
+		_last_error = "Invalid frame dimensions!";
+		return false;
+	}
+
+	const AVCodec *codec = nullptr;
+	if (!_settings.encoder.empty())
+	{
+		codec = avcodec_find_encoder_by_name(_settings.encoder.c_str());
+	}
+	else
+	{
+		void *i = nullptr;
+		while ((codec = av_codec_iterate(&i)) != nullptr)
+		{
+			if (codec->id != AV_CODEC_ID_H264 || !av_codec_is_encoder(codec) || codec->pix_fmts == nullptr)
+				continue;
+
+			bool supports_yuv420p = false;
+			for (const AVPixelFormat *fmt = codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; ++fmt)
+				if (*fmt == AV_PIX_FMT_YUV420P)
+					supports_yuv420p = true;
+
+			if (supports_yuv420p)
+				break; // Found a codec that passes requirements
+		}
+	}
+
+	if (codec == nullptr)
+	{
+		_last_error = "Failed to find a H.264 encoder that passes requirements!";
+		return false;
+	}
+
+	if (int err = avformat_alloc_output_context2(&_output_ctx, nullptr, nullptr, _settings.filename.c_str()); err < 0)
+	{
+		_output_ctx = nullptr;
+		_last_error = format_error("Failed to initialize output context: ", err);
+		return false;
+	}
+
+	_codec_ctx = avcodec_alloc_context3(codec);
+	_codec_ctx->bit_rate = _settings.bit_rate;
+	_codec_ctx->width = _settings.width;
+	_codec_ctx->height = _settings.height;
+	_codec_ctx->time_base = { 1, static_cast<int>(_settings.frame_rate) };
+	_codec_ctx->framerate = { static_cast<int>(_settings.frame_rate), 1 };
+	_codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+	_codec_ctx->color_range = AVCOL_RANGE_MPEG;
+	_codec_ctx->colorspace = AVCOL_SPC_BT709;
+	_codec_ctx->color_primaries = AVCOL_PRI_BT709;
+	_codec_ctx->color_trc = AVCOL_TRC_BT709;
+	_codec_ctx->gop_size = 250;
+	_codec_ctx->max_b_frames = 2;
+	_codec_ctx->thread_count = 0; // Let the encoder choose its own number of threads
+
+	if (_output_ctx->oformat->flags & AVFMT_GLOBALHEADER)
+		_codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	if (!_settings.preset.empty())
+		av_opt_set(_codec_ctx->priv_data, "preset", _settings.preset.c_str(), 0);
+
+	if (int err = avcodec_open2(_codec_ctx, codec, nullptr); err < 0)
+	{
+		destroy_contexts();
+		_last_error = format_error("Failed to initialize encoder: ", err);
+		return false;
+	}
+
+	if (int err = avio_open(&_output_ctx->pb, _settings.filename.c_str(), AVIO_FLAG_WRITE); err < 0)
+	{
+		destroy_contexts();
+		_last_error = format_error("Failed to open output file: ", err);
+		return false;
+	}
+
+	// Add video stream with this codec to the output
+	AVStream *const stream = avformat_new_stream(_output_ctx, nullptr);
+	stream->id = 0;
+	stream->time_base = _codec_ctx->time_base;
+	avcodec_parameters_from_context(stream->codecpar, _codec_ctx);
+
+	if (int err = avformat_write_header(_output_ctx, nullptr); err < 0)
+	{
+		destroy_contexts();
+		_last_error = format_error("Failed to write output header: ", err);
+		return false;
+	}
+
+	_raw_queue.reset(_settings.max_queued_frames);
+	_packet_queue.reset(64);
+	_free_buffers.clear();
+	_next_sequence_index = 0;
+	_converted_frames.clear();
+	_converting_finished = false;
+	_last_pts = -1;
+
+	_frames_submitted = 0;
+	_frames_dropped = 0;
+	_frames_encoded = 0;
+	_packets_written = 0;
+	_bytes_written = 0;
+
+	unsigned int num_convert_threads = _settings.num_convert_threads;
+	if (num_convert_threads == 0)
+		// Encoder uses threads of its own already, so keep this small
+		num_convert_threads = std::clamp(std::thread::hardware_concurrency() / 4, 1u, 4u);
+
+	for (unsigned int i = 0; i < num_convert_threads; ++i)
+		_convert_threads.emplace_back(&video_pipeline::convert_thread, this);
+	_encode_thread = std::thread(&video_pipeline::encode_thread, this);
+	_mux_thread = std::thread(&video_pipeline::mux_thread, this);
+
+	return true;
+}
+void video_pipeline::stop()
+{
+	if (_output_ctx == nullptr)
+		return;
+
+	// Shut down one stage after another, so that every stage can drain what the previous one produced
+	_raw_queue.close();
+	for (std::thread &thread : _convert_threads)
+		if (thread.joinable())
+			thread.join();
+	_convert_threads.clear();
+
+	{
+		const std::unique_lock<std::mutex> lock(_converted_mutex);
+		_converting_finished = true;
+	}
+	_converted_ready.notify_all();
+
+	if (_encode_thread.joinable())
+		_encode_thread.join();
+	if (_mux_thread.joinable())
+		_mux_thread.join();
+
+	if (_output_ctx->pb != nullptr)
+		av_write_trailer(_output_ctx);
+
+	destroy_contexts();
+}
+
+bool video_pipeline::submit_frame(const void *pixels, uint32_t row_pitch, int64_t timestamp_ms)
+{
+	_frames_submitted++;
+
+	if (_output_ctx == nullptr)
+	{
+		_frames_dropped++;
+		return false;
+	}
+
+	raw_frame frame;
+	frame.sequence_index = _next_sequence_index;
+	frame.timestamp_ms = timestamp_ms;
+
+	// Reuse buffers of frames that were already converted, to avoid allocating every frame
+	{
+		const std::unique_lock<std::mutex> lock(_free_buffers_mutex);
+		if (!_free_buffers.empty())
+		{
+			frame.pixels = std::move(_free_buffers.back());
+			_free_buffers.pop_back();
+		}
+	}
+
+	const size_t packed_row_pitch = static_cast<size_t>(_settings.width) * 4;
+	frame.pixels.resize(packed_row_pitch * _settings.height);
+	for (uint32_t y = 0; y < _settings.height; ++y)
+		std::memcpy(frame.pixels.data() + y * packed_row_pitch, static_cast<const uint8_t *>(pixels) + y * static_cast<size_t>(row_pitch), packed_row_pitch);
+
+	if (!_raw_queue.try_push(std::move(frame)))
+	{
+		_frames_dropped++;
+		return false;
+	}
+
+	// Only advance sequence index for frames that were actually queued, so that the encoder does not wait for dropped ones
+	_next_sequence_index++;
+	return true;
+}
+
+video_pipeline::statistics video_pipeline::get_statistics() const
+{
+	statistics stats = {};
+	stats.frames_submitted = _frames_submitted;
+	stats.frames_dropped = _frames_dropped;
+	stats.frames_encoded = _frames_encoded;
+	stats.packets_written = _packets_written;
+	stats.bytes_written = _bytes_written;
+	stats.frames_queued = _raw_queue.size();
+	return stats;
+}
+
+void video_pipeline::convert_thread()
+{
+	for (raw_frame frame;;)
+	{
+		// Limit the number of converted frames waiting for the encoder, so that memory usage stays bounded when encoding falls behind
+		{
+			std::unique_lock<std::mutex> lock(_converted_mutex);
+			_converted_consumed.wait(lock, [this]() { return _converted_frames.size() < _settings.max_queued_frames; });
+		}
+
+		if (!_raw_queue.pop(frame))
+			break;
+
+		AVFrame *av_frame = av_frame_alloc();
+		av_frame->width = _settings.width;
+		av_frame->height = _settings.height;
+		av_frame->format = AV_PIX_FMT_YUV420P;
+		av_frame->color_range = AVCOL_RANGE_MPEG;
+		av_frame->colorspace = AVCOL_SPC_BT709;
+		av_frame->pts = av_rescale_q(frame.timestamp_ms, AVRational { 1, 1000 }, _codec_ctx->time_base);
+
+		if (av_frame_get_buffer(av_frame, 0) == 0)
+		{
+			const size_t row_pitch = static_cast<size_t>(_settings.width) * 4;
+
+			for (uint32_t y = 0; y < _settings.height; y += 2)
+			{
+				convert_rows_to_yuv420(
+					_settings.layout,
+					frame.pixels.data() + y * row_pitch,
+					frame.pixels.data() + (y + 1) * row_pitch,
+					_settings.width,
+					av_frame->data[0] + y * av_frame->linesize[0],
+					av_frame->data[0] + (y + 1) * av_frame->linesize[0],
+					av_frame->data[1] + (y / 2) * av_frame->linesize[1],
+					av_frame->data[2] + (y / 2) * av_frame->linesize[2]);
+			}
+		}
+		else
+		{
+			av_frame_free(&av_frame); // Encoder skips frames that failed to convert
+		}
+
+		{
+			const std::unique_lock<std::mutex> lock(_free_buffers_mutex);
+			_free_buffers.push_back(std::move(frame.pixels));
+		}
+
+		{
+			const std::unique_lock<std::mutex> lock(_converted_mutex);
+			_converted_frames.emplace(frame.sequence_index, av_frame);
+		}
+		_converted_ready.notify_all();
+	}
+}
+
+void video_pipeline::encode_thread()
+{
+	for (uint64_t sequence_index = 0;; ++sequence_index)
+	{
+		AVFrame *frame = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_converted_mutex);
+			_converted_ready.wait(lock, [this, sequence_index]() { return _converted_frames.count(sequence_index) != 0 || (_converting_finished && _converted_frames.empty()); });
+
+			const auto it = _converted_frames.find(sequence_index);
+			if (it == _converted_frames.end())
+				break; // Conversion finished and all frames were encoded
+
+			frame = it->second;
+			_converted_frames.erase(it);
+		}
+		_converted_consumed.notify_all();
+
+		if (frame == nullptr)
+			continue;
+
+		// Timestamps have to increase monotonically, even if two frames were captured within the same frame interval
+		if (frame->pts <= _last_pts)
+			frame->pts = _last_pts + 1;
+		_last_pts = frame->pts;
+
+		const int err = avcodec_send_frame(_codec_ctx, frame);
+		av_frame_free(&frame);
+
+		if (err >= 0)
+			_frames_encoded++;
+
+		receive_packets();
+	}
+
+	// Flush the encoder
+	avcodec_send_frame(_codec_ctx, nullptr);
+	receive_packets();
+
+	_packet_queue.close();
+}
+
+void video_pipeline::mux_thread()
+{
+	for (AVPacket *packet = nullptr; _packet_queue.pop(packet); av_packet_free(&packet))
+	{
+		_bytes_written += packet->size;
+
+		if (av_interleaved_write_frame(_output_ctx, packet) >= 0)
+			_packets_written++;
+	}
+
+	// Flush any packets that are still buffered for interleaving
+	av_interleaved_write_frame(_output_ctx, nullptr);
+}
+
+bool video_pipeline::receive_packets()
+{
+	AVStream *const stream = _output_ctx->streams[0];
+
+	for (AVPacket *packet = av_packet_alloc(); packet != nullptr; packet = av_packet_alloc())
+	{
+		if (avcodec_receive_packet(_codec_ctx, packet) < 0)
+		{
+			av_packet_free(&packet);
+			break;
+		}
+
+		av_packet_rescale_ts(packet, _codec_ctx->time_base, stream->time_base);
+		packet->stream_index = stream->index;
+
+		// Block if the muxer falls behind, which in turn causes the conversion queue to fill up and frames to be dropped
+		if (!_packet_queue.push(std::move(packet)))
+		{
+			av_packet_free(&packet);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void video_pipeline::destroy_contexts()
+{
+	if (_codec_ctx != nullptr)
+		avcodec_free_context(&_codec_ctx);
+
+	if (_output_ctx != nullptr)
+	{
+		if (_output_ctx->pb != nullptr)
+			avio_closep(&_output_ctx->pb);
+
+		avformat_free_context(_output_ctx);
+		_output_ctx = nullptr;
+	}
+}
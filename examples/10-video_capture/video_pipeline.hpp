@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+extern "C" {
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+}
+
+/// <summary>
+/// Thread-safe FIFO queue with a fixed capacity, which can be closed to wake up all waiting threads.
+/// </summary>
+template <typename T>
+class bounded_queue
+{
+public:
+	void reset(size_t capacity)
+	{
+		const std::unique_lock<std::mutex> lock(_mutex);
+		_items.clear();
+		_capacity = capacity;
+		_closed = false;
+	}
+
+	/// <summary>
+	/// Adds an item to the queue, unless it is full or closed.
+	/// </summary>
+	bool try_push(T &&item)
+	{
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+			if (_closed || _items.size() >= _capacity)
+				return false;
+			_items.push_back(std::move(item));
+		}
+		_not_empty.notify_one();
+		return true;
+	}
+	/// <summary>
+	/// Adds an item to the queue, waiting for space to become available if it is full.
+	/// </summary>
+	bool push(T &&item)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_not_full.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+			if (_closed)
+				return false;
+			_items.push_back(std::move(item));
+		}
+		_not_empty.notify_one();
+		return true;
+	}
+
+	/// <summary>
+	/// Removes the oldest item from the queue, waiting for one to become available if it is empty.
+	/// </summary>
+	/// <returns><see langword="false"/> if the queue was closed and there are no items left, <see langword="true"/> otherwise.</returns>
+	bool pop(T &item)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+			if (_items.empty())
+				return false;
+			item = std::move(_items.front());
+			_items.pop_front();
+		}
+		_not_full.notify_one();
+		return true;
+	}
+
+	/// <summary>
+	/// Closes the queue, so that no more items can be added. Items that are already in the queue can still be removed.
+	/// </summary>
+	void close()
+	{
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+			_closed = true;
+		}
+		_not_empty.notify_all();
+		_not_full.notify_all();
+	}
+
+	size_t size() const
+	{
+		const std::unique_lock<std::mutex> lock(_mutex);
+		return _items.size();
+	}
+
+private:
+	mutable std::mutex _mutex;
+	std::condition_variable _not_empty;
+	std::condition_variable _not_full;
+	std::deque<T> _items;
+	size_t _capacity = 0;
+	bool _closed = false;
+};
+
+/// <summary>
+/// Encodes a stream of 32 bits-per-pixel frames to a video file.
+/// Color conversion, encoding and muxing each run on separate threads, connected through bounded queues, so that submitting a frame only has to copy it.
+/// This does not depend on ReShade, so it can be fed with synthetic frames for testing as well.
+/// </summary>
+class video_pipeline
+{
+public:
+	enum class pixel_layout
+	{
+		rgba, // Alpha channel is ignored
+		bgra, // Alpha channel is ignored
+	};
+
+	struct settings
+	{
+		// Output file path, the container format is deduced from the file extension
+		std::string filename = "video.mp4";
+		// Name of the FFmpeg encoder to use (e.g. "libx264" or "h264_nvenc"), or empty to use the first H.264 encoder that is available
+		std::string encoder;
+		// Encoder preset (e.g. "veryfast"), or empty to use the encoder default
+		std::string preset = "veryfast";
+		int64_t bit_rate = 8000000;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t frame_rate = 30;
+		pixel_layout layout = pixel_layout::bgra;
+		// Maximum number of frames waiting for color conversion, after which further frames are dropped
+		size_t max_queued_frames = 8;
+		// Number of color conversion threads, or zero to choose based on the number of hardware threads
+		unsigned int num_convert_threads = 0;
+	};
+
+	struct statistics
+	{
+		uint64_t frames_submitted;
+		uint64_t frames_dropped;
+		uint64_t frames_encoded;
+		uint64_t packets_written;
+		uint64_t bytes_written;
+		size_t frames_queued;
+	};
+
+	~video_pipeline() { stop(); }
+
+	/// <summary>
+	/// Opens the output file and encoder and starts all pipeline threads.
+	/// Dimensions are rounded down to a multiple of two, as required for 4:2:0 chroma subsampling.
+	/// </summary>
+	bool start(const settings &settings);
+	/// <summary>
+	/// Stops the pipeline after all queued frames were encoded and finalizes the output file.
+	/// </summary>
+	void stop();
+
+	bool is_active() const { return _output_ctx != nullptr; }
+
+	const settings &current_settings() const { return _settings; }
+	/// <summary>
+	/// Gets a description of the last error that occurred in <see cref="start"/>.
+	/// </summary>
+	const std::string &last_error() const { return _last_error; }
+
+	/// <summary>
+	/// Copies a frame into the pipeline. This never blocks, if the queue is full the frame is dropped instead.
+	/// </summary>
+	/// <param name="pixels">Pointer to the image data of the frame, in the pixel layout specified at start.</param>
+	/// <param name="row_pitch">Number of bytes between rows of the image data.</param>
+	/// <param name="timestamp_ms">Time in milliseconds since the start of the recording that this frame should be presented at.</param>
+	/// <returns><see langword="true"/> if the frame was queued, <see langword="false"/> if it was dropped.</returns>
+	bool submit_frame(const void *pixels, uint32_t row_pitch, int64_t timestamp_ms);
+
+	statistics get_statistics() const;
+
+	/// <summary>
+	/// Converts two rows of 32 bits-per-pixel RGB data to BT.709 limited range YUV with 4:2:0 chroma subsampling.
+	/// </summary>
+	static void convert_rows_to_yuv420(pixel_layout layout, const uint8_t *src_row0, const uint8_t *src_row1, uint32_t width, uint8_t *dst_y0, uint8_t *dst_y1, uint8_t *dst_u, uint8_t *dst_v);
+
+private:
+	struct raw_frame
+	{
+		uint64_t sequence_index = 0;
+		int64_t timestamp_ms = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	void convert_thread();
+	void encode_thread();
+	void mux_thread();
+
+	bool receive_packets();
+	void destroy_contexts();
+
+	settings _settings;
+	std::string _last_error;
+
+	AVCodecContext *_codec_ctx = nullptr;
+	AVFormatContext *_output_ctx = nullptr;
+
+	std::vector<std::thread> _convert_threads;
+	std::thread _encode_thread;
+	std::thread _mux_thread;
+
+	bounded_queue<raw_frame> _raw_queue;
+	std::mutex _free_buffers_mutex;
+	std::vector<std::vector<uint8_t>> _free_buffers;
+	uint64_t _next_sequence_index = 0;
+
+	// Frames are converted on multiple threads, so they may finish out of order and are sorted by sequence index again before encoding
+	std::mutex _converted_mutex;
+	std::condition_variable _converted_ready;
+	std::condition_variable _converted_consumed;
+	std::map<uint64_t, AVFrame *> _converted_frames;
+	bool _converting_finished = false;
+	int64_t _last_pts = 0;
+
+	bounded_queue<AVPacket *> _packet_queue;
+
+	std::atomic<uint64_t> _frames_submitted = 0;
+	std::atomic<uint64_t> _frames_dropped = 0;
+	std::atomic<uint64_t> _frames_encoded = 0;
+	std::atomic<uint64_t> _packets_written = 0;
+	std::atomic<uint64_t> _bytes_written = 0;
+};
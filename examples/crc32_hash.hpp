@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 1986 Gary S. Brown.
+ * You may use this program, or code or tables extracted from it, as desired without restriction.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace crc32_detail
+{
+	// Lookup tables for the slice-by-8 algorithm, the first of which is the classic byte-at-a-time table
+	// Each further table advances the CRC of a byte by another eight bits of zeros, so that eight bytes can be processed with independent lookups
+	struct slice_tables
+	{
+		uint32_t data[8][256] = {};
+
+		constexpr explicit slice_tables(uint32_t polynomial)
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t crc = i;
+				for (int k = 0; k < 8; ++k)
+					crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+				data[0][i] = crc;
+			}
+
+			for (uint32_t i = 0; i < 256; ++i)
+				for (int t = 1; t < 8; ++t)
+					data[t][i] = (data[t - 1][i] >> 8) ^ data[0][data[t - 1][i] & 0xFF];
+		}
+	};
+
+	inline uint32_t update_slice_by_8(const slice_tables &tables, uint32_t crc, const uint8_t *data, size_t size)
+	{
+		const auto &t = tables.data;
+
+		// Process unaligned bytes at the start one at a time
+		for (; size != 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0; --size, ++data)
+			crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+
+		for (; size >= 8; size -= 8, data += 8)
+		{
+			uint32_t lo, hi;
+			std::memcpy(&lo, data + 0, 4);
+			std::memcpy(&hi, data + 4, 4);
+			lo ^= crc;
+
+			crc =
+				t[7][(lo      ) & 0xFF] ^ t[6][(lo >>  8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][(lo >> 24)] ^
+				t[3][(hi      ) & 0xFF] ^ t[2][(hi >>  8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][(hi >> 24)];
+		}
+
+		for (; size != 0; --size, ++data)
+			crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+
+		return crc;
+	}
+
+	inline constexpr slice_tables crc32_tables(0xEDB88320); // CRC-32 (IEEE 802.3)
+}
+
+/// <summary>
+/// Computes the CRC-32 (IEEE 802.3) checksum of the specified data.
+/// This is what dumped and replaced files are named after, so its results have to stay the same.
+/// </summary>
+inline uint32_t compute_crc32(const uint8_t *data, size_t size)
+{
+	return ~crc32_detail::update_slice_by_8(crc32_detail::crc32_tables, 0xFFFFFFFF, data, size);
+}
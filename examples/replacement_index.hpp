@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <filesystem>
+#include <shared_mutex>
+#include <unordered_set>
+#include <Windows.h>
+
+/// <summary>
+/// In-memory index of the replacement files next to the executable, so that checking whether a replacement exists is a hash lookup instead of a file system query.
+/// The index is built on first use and rebuilt whenever a file in the directory is added, removed or renamed.
+/// Writes to existing files are deliberately not watched, since applications tend to write logs and save games next to the executable all the time, which would otherwise rebuild the index constantly.
+/// </summary>
+class replacement_index
+{
+public:
+	~replacement_index()
+	{
+		if (_change_handle != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(_change_handle);
+	}
+
+	/// <summary>
+	/// Looks up a replacement file that is named after the executable followed by the specified <paramref name="suffix"/>.
+	/// </summary>
+	/// <param name="suffix">File name suffix (e.g. "_0x12345678.bmp").</param>
+	/// <param name="path">Set to the full path of the replacement file if one was found.</param>
+	/// <returns><see langword="true"/> if a replacement file exists, <see langword="false"/> otherwise.</returns>
+	bool find(const std::wstring &suffix, std::filesystem::path &path)
+	{
+		refresh();
+
+		std::wstring file_name = _file_prefix + suffix;
+		to_lower(file_name);
+
+		const std::shared_lock<std::shared_mutex> lock(_mutex);
+
+		if (_file_names.find(file_name) == _file_names.end())
+			return false;
+
+		path = _directory / (_file_prefix + suffix);
+		return true;
+	}
+
+	/// <summary>
+	/// Gets a counter that is incremented every time the index is rebuilt, which can be used to invalidate data loaded from replacement files.
+	/// Most editors save by writing a temporary file and renaming it over the original, which counts as a change. A file that is modified in place is only noticed with the next change to the directory.
+	/// </summary>
+	uint32_t generation() const { return _generation.load(std::memory_order_acquire); }
+
+private:
+	static void to_lower(std::wstring &s)
+	{
+		// File names are case-insensitive on Windows
+		CharLowerBuffW(s.data(), static_cast<DWORD>(s.size()));
+	}
+
+	void refresh()
+	{
+		// Fast path once the index was built and nothing changed since, which only polls the notification handle without a file system query
+		if (_initialized.load(std::memory_order_acquire) && (_change_handle == INVALID_HANDLE_VALUE || WaitForSingleObject(_change_handle, 0) != WAIT_OBJECT_0))
+			return;
+
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
+		if (!_initialized.load(std::memory_order_relaxed))
+		{
+			WCHAR module_path[MAX_PATH] = L"";
+			GetModuleFileNameW(nullptr, module_path, ARRAYSIZE(module_path));
+
+			const std::filesystem::path executable_path = module_path;
+			_directory = executable_path.parent_path();
+			_file_prefix = executable_path.filename().native();
+
+			_change_handle = FindFirstChangeNotificationW(_directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME);
+		}
+		else if (_change_handle != INVALID_HANDLE_VALUE)
+		{
+			// Another thread may have rebuilt the index already while this one was waiting for the lock
+			if (WaitForSingleObject(_change_handle, 0) != WAIT_OBJECT_0)
+				return;
+
+			// Re-arm the notification before enumerating, so that changes made during enumeration are not missed
+			FindNextChangeNotification(_change_handle);
+		}
+
+		_file_names.clear();
+
+		std::wstring prefix = _file_prefix;
+		to_lower(prefix);
+
+		std::error_code ec;
+		for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(_directory, std::filesystem::directory_options::skip_permission_denied, ec))
+		{
+			std::wstring file_name = entry.path().filename().native();
+			to_lower(file_name);
+
+			if (file_name.size() > prefix.size() && file_name.compare(0, prefix.size(), prefix) == 0)
+				_file_names.insert(std::move(file_name));
+		}
+
+		_generation.fetch_add(1, std::memory_order_release);
+		_initialized.store(true, std::memory_order_release);
+	}
+
+	std::shared_mutex _mutex;
+	std::atomic_bool _initialized = false;
+	std::atomic_uint32_t _generation = 0;
+	HANDLE _change_handle = INVALID_HANDLE_VALUE;
+	std::filesystem::path _directory;
+	std::wstring _file_prefix;
+	std::unordered_set<std::wstring> _file_names;
+};
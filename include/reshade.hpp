@@ -10,7 +10,10 @@
 #include <charconv>
 #include <Windows.h>
 
-#define RESHADE_API_VERSION 2
+// Version history of the add-on API, every version only appends to the previous one:
+//  2: Initial add-on API
+//  3: Added 'effect_runtime::capture_screenshot_async', 'effect_runtime::get_uniform_values', 'effect_runtime::set_uniform_values', 'effect_runtime::get_effects_generation' (and the 'find_*' overloads with an 'effect_handle_cache'), 'set_addon_profiling' and 'get_addon_event_statistics', and 'effect_runtime::is_key_pressed' and 'effect_runtime::is_mouse_button_pressed' also report keys that were pressed and released again within the same frame
+#define RESHADE_API_VERSION 3
 
  // Use the kernel32 variant of module enumeration functions so it can be safely called from 'DllMain'
 extern "C" BOOL WINAPI K32EnumProcessModules(HANDLE hProcess, HMODULE *lphModule, DWORD cb, LPDWORD lpcbNeeded);
@@ -196,6 +199,61 @@ namespace reshade
 		func(ev, static_cast<void *>(callback));
 	}
 
+	/// <summary>
+	/// Profiling statistics of the callbacks an add-on registered for an event.
+	/// </summary>
+	struct addon_event_statistics
+	{
+		reshade::addon_event ev;
+		/// <summary>
+		/// Number of calls to callbacks for this event since profiling was enabled.
+		/// </summary>
+		uint64_t call_count;
+		/// <summary>
+		/// Number of calls that were timed (calls are only sampled at the interval set with <see cref="set_addon_profiling"/>).
+		/// </summary>
+		uint64_t sample_count;
+		/// <summary>
+		/// Total time in nanoseconds that the timed calls took.
+		/// </summary>
+		uint64_t sample_time_ns;
+		/// <summary>
+		/// Approximate median and 99th percentile time in nanoseconds of a single timed call.
+		/// </summary>
+		uint64_t median_time_ns;
+		uint64_t p99_time_ns;
+	};
+
+	/// <summary>
+	/// Enables or disables profiling of the event callbacks of all add-ons.
+	/// </summary>
+	/// <remarks>
+	/// Requires the ReShade module to support API version 3 or later.
+	/// </remarks>
+	/// <param name="interval">Every how many invocations of an event (per thread) calls to its callbacks are timed, or zero to disable profiling.</param>
+	inline void set_addon_profiling(uint32_t interval)
+	{
+		static const auto func = reinterpret_cast<void(*)(uint32_t)>(
+			GetProcAddress(internal::get_reshade_module_handle(), "ReShadeSetAddonProfiling"));
+		func(interval);
+	}
+	/// <summary>
+	/// Gets profiling statistics for every event an add-on registered callbacks for that were called.
+	/// </summary>
+	/// <remarks>
+	/// Requires the ReShade module to support API version 3 or later.
+	/// </remarks>
+	/// <param name="addon_name">Name of the add-on to get statistics for, or <see langword="nullptr"/> for the current add-on.</param>
+	/// <param name="statistics">Pointer to an array of statistics that is filled, or <see langword="nullptr"/> to only query the number of statistics.</param>
+	/// <param name="count">Pointer to an integer that contains the size of the statistics array and upon completion is set to the number of statistics available.</param>
+	/// <returns><see langword="true"/> if the add-on was found, <see langword="false"/> otherwise.</returns>
+	inline bool get_addon_event_statistics(const char *addon_name, addon_event_statistics *statistics, size_t *count)
+	{
+		static const auto func = reinterpret_cast<bool(*)(HMODULE, const char *, addon_event_statistics *, size_t *)>(
+			GetProcAddress(internal::get_reshade_module_handle(), "ReShadeGetAddonEventStatistics"));
+		return func(internal::get_current_module_handle(), addon_name, statistics, count);
+	}
+
 	/// <summary>
 	/// Registers an overlay with ReShade.
 	/// <para>The callback function is then called when the overlay is visible and allows adding Dear ImGui widgets for user interaction.</para>
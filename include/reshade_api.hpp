@@ -31,6 +31,82 @@ namespace reshade::api
 	/// </remarks>
 	RESHADE_DEFINE_HANDLE(effect_uniform_variable);
 
+	/// <summary>
+	/// Caches a handle that was found by name, so that it is only looked up again after effects were reloaded.
+	/// Pass this to the overloads of <see cref="effect_runtime::find_uniform_variable"/>, <see cref="effect_runtime::find_texture_variable"/> or <see cref="effect_runtime::find_technique"/> that take a cache, instead of storing the handle itself, to get a handle that survives reloads.
+	/// </summary>
+	template <typename T>
+	struct effect_handle_cache
+	{
+		T handle = { 0 };
+		uint32_t generation = 0;
+	};
+
+	/// <summary>
+	/// The type of the values in a batched uniform variable update or query.
+	/// </summary>
+	enum class effect_uniform_value_type : uint32_t
+	{
+		boolean,
+		floating_point,
+		signed_int,
+		unsigned_int,
+	};
+
+	/// <summary>
+	/// Describes an update of a uniform variable in a batch passed to <see cref="effect_runtime::set_uniform_values"/>.
+	/// </summary>
+	struct effect_uniform_value_update
+	{
+		/// <summary>
+		/// Opaque handle to the uniform variable to update.
+		/// </summary>
+		effect_uniform_variable variable = { 0 };
+		/// <summary>
+		/// Type of the values pointed to by <see cref="values"/>.
+		/// </summary>
+		effect_uniform_value_type type = effect_uniform_value_type::floating_point;
+		/// <summary>
+		/// Pointer to an array of values (of type <c>bool</c>, <c>float</c>, <c>int32_t</c> or <c>uint32_t</c>, depending on <see cref="type"/>) that are used to update the uniform variable.
+		/// </summary>
+		const void *values = nullptr;
+		/// <summary>
+		/// Number of values to write.
+		/// </summary>
+		size_t count = 0;
+		/// <summary>
+		/// Array offset to start writing values to when the uniform variable is an array variable.
+		/// </summary>
+		size_t array_index = 0;
+	};
+
+	/// <summary>
+	/// Describes a query of the value of a uniform variable in a batch passed to <see cref="effect_runtime::get_uniform_values"/>.
+	/// </summary>
+	struct effect_uniform_value_query
+	{
+		/// <summary>
+		/// Opaque handle to the uniform variable to read.
+		/// </summary>
+		effect_uniform_variable variable = { 0 };
+		/// <summary>
+		/// Type of the values pointed to by <see cref="values"/>.
+		/// </summary>
+		effect_uniform_value_type type = effect_uniform_value_type::floating_point;
+		/// <summary>
+		/// Pointer to an array of values (of type <c>bool</c>, <c>float</c>, <c>int32_t</c> or <c>uint32_t</c>, depending on <see cref="type"/>) that is filled with the values of the uniform variable.
+		/// </summary>
+		void *values = nullptr;
+		/// <summary>
+		/// Number of values to read.
+		/// </summary>
+		size_t count = 0;
+		/// <summary>
+		/// Array offset to start reading values from when the uniform variable is an array variable.
+		/// </summary>
+		size_t array_index = 0;
+	};
+
 	/// <summary>
 	/// A ReShade effect runtime, used to control effects.
 	/// <para>A separate runtime is instantiated for every swap chain.</para>
@@ -77,12 +153,19 @@ namespace reshade::api
 		/// <summary>
 		/// Gets whether the specified key was pressed this frame.
 		/// </summary>
+		/// <remarks>
+		/// This also returns <see langword="true"/> for a key that was pressed and released again within the same frame, in which case <see cref="is_key_down"/> returns <see langword="false"/> and <see cref="is_key_released"/> returns <see langword="true"/> as well.
+		/// Before add-on API version 3 such a key was not reported as pressed at all, so do not assume that a pressed key is also down.
+		/// </remarks>
 		/// <param name="keycode">The virtual key code to check.</param>
 		/// <returns><see langword="true"/> if the key was pressed this frame, <see langword="false"/> otherwise.</returns>
 		virtual bool is_key_pressed(uint32_t keycode) const = 0;
 		/// <summary>
 		/// Gets whether the specified key was released this frame.
 		/// </summary>
+		/// <remarks>
+		/// This also returns <see langword="true"/> for a key that was released and pressed again within the same frame, in which case <see cref="is_key_down"/> returns <see langword="true"/> as well.
+		/// </remarks>
 		/// <param name="keycode">The virtual key code to check.</param>
 		/// <returns><see langword="true"/> if the key was released this frame, <see langword="false"/> otherwise.</returns>
 		virtual bool is_key_released(uint32_t keycode) const = 0;
@@ -95,6 +178,9 @@ namespace reshade::api
 		/// <summary>
 		/// Gets whether the specified mouse button was pressed this frame.
 		/// </summary>
+		/// <remarks>
+		/// Same as <see cref="is_key_pressed"/>, this also returns <see langword="true"/> for a button that was pressed and released again within the same frame.
+		/// </remarks>
 		/// <param name="button">The mouse button index to check (0 = left, 1 = middle, 2 = right).</param>
 		/// <returns><see langword="true"/> if the mouse button was pressed this frame, <see langword="false"/> otherwise.</returns>
 		virtual bool is_mouse_button_pressed(uint32_t button) const = 0;
@@ -137,6 +223,22 @@ namespace reshade::api
 		/// <param name="variable_name">Name of the uniform variable declaration to find.</param>
 		/// <returns>Opaque handle to the uniform variable, or zero in case it was not found.</returns>
 		virtual effect_uniform_variable find_uniform_variable(const char *effect_name, const char *variable_name) const = 0;
+		/// <summary>
+		/// Finds a specific uniform variable in the loaded effects and returns a handle to it, reusing the handle in <paramref name="cache"/> if effects were not reloaded since it was found.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="effect_name">File name of the effect file the variable is declared in, or <see langword="nullptr"/> to search in all loaded effects.</param>
+		/// <param name="variable_name">Name of the uniform variable declaration to find.</param>
+		/// <param name="cache">Cache that is updated with the handle.</param>
+		/// <returns>Opaque handle to the uniform variable, or zero in case it was not found.</returns>
+		inline effect_uniform_variable find_uniform_variable(const char *effect_name, const char *variable_name, effect_handle_cache<effect_uniform_variable> &cache) const {
+			const uint32_t generation = get_effects_generation();
+			if (cache.handle == 0 || cache.generation != generation)
+				cache = { find_uniform_variable(effect_name, variable_name), generation };
+			return cache.handle;
+		}
 
 		/// <summary>
 		/// Gets information about the data type of a uniform <paramref name="variable"/>.
@@ -349,6 +451,22 @@ namespace reshade::api
 		/// <param name="variable_name">Name of the texture variable declaration to find.</param>
 		/// <returns>Opaque handle to the texture variable, or zero in case it was not found.</returns>
 		virtual effect_texture_variable find_texture_variable(const char *effect_name, const char *variable_name) const = 0;
+		/// <summary>
+		/// Finds a specific texture variable in the loaded effects and returns a handle to it, reusing the handle in <paramref name="cache"/> if effects were not reloaded since it was found.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="effect_name">File name of the effect file the variable is declared in, or <see langword="nullptr"/> to search in all loaded effects.</param>
+		/// <param name="variable_name">Name of the texture variable declaration to find.</param>
+		/// <param name="cache">Cache that is updated with the handle.</param>
+		/// <returns>Opaque handle to the texture variable, or zero in case it was not found.</returns>
+		inline effect_texture_variable find_texture_variable(const char *effect_name, const char *variable_name, effect_handle_cache<effect_texture_variable> &cache) const {
+			const uint32_t generation = get_effects_generation();
+			if (cache.handle == 0 || cache.generation != generation)
+				cache = { find_texture_variable(effect_name, variable_name), generation };
+			return cache.handle;
+		}
 
 		/// <summary>
 		/// Gets the name of a texture <paramref name="variable"/>.
@@ -465,6 +583,22 @@ namespace reshade::api
 		/// <param name="technique_name">Name of the technique to find.</param>
 		/// <returns>Opaque handle to the technique, or zero in case it was not found.</returns>
 		virtual effect_technique find_technique(const char *effect_name, const char *technique_name) = 0;
+		/// <summary>
+		/// Finds a specific technique in the loaded effects and returns a handle to it, reusing the handle in <paramref name="cache"/> if effects were not reloaded since it was found.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="effect_name">File name of the effect file the technique is declared in, or <see langword="nullptr"/> to search in all loaded effects.</param>
+		/// <param name="technique_name">Name of the technique to find.</param>
+		/// <param name="cache">Cache that is updated with the handle.</param>
+		/// <returns>Opaque handle to the technique, or zero in case it was not found.</returns>
+		inline effect_technique find_technique(const char *effect_name, const char *technique_name, effect_handle_cache<effect_technique> &cache) {
+			const uint32_t generation = get_effects_generation();
+			if (cache.handle == 0 || cache.generation != generation)
+				cache = { find_technique(effect_name, technique_name), generation };
+			return cache.handle;
+		}
 
 		/// <summary>
 		/// Gets the name of a <paramref name="technique"/>.
@@ -559,5 +693,47 @@ namespace reshade::api
 		/// <param name="name">Name of the definition.</param>
 		/// <param name="value">Value of the definition.</param>
 		virtual void set_preprocessor_definition(const char *name, const char *value) = 0;
+
+		/// <summary>
+		/// Captures a screenshot of the current back buffer resource without waiting for the GPU and calls the specified <paramref name="callback"/> function with its image data in 32 bits-per-pixel RGBA format once it is available.
+		/// </summary>
+		/// <remarks>
+		/// The callback is called from the thread presenting the swap chain a few frames later, or when the effect runtime is reset.
+		/// The image data pointer is only valid for the duration of the callback and is <see langword="nullptr"/> in case the readback failed.
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="callback">Function to call with the image data.</param>
+		/// <param name="user_data">Optional pointer passed to the callback function.</param>
+		/// <returns><see langword="true"/> if the capture was successfully queued, <see langword="false"/> otherwise (in this case <paramref name="callback"/> is never called).</returns>
+		virtual bool capture_screenshot_async(void(*callback)(effect_runtime *runtime, const uint8_t *pixels, uint32_t width, uint32_t height, void *user_data), void *user_data = nullptr) = 0;
+
+		/// <summary>
+		/// Gets the values of multiple uniform variables at once.
+		/// This is equivalent to calling <see cref="get_uniform_value_bool"/>, <see cref="get_uniform_value_float"/>, <see cref="get_uniform_value_int"/> or <see cref="get_uniform_value_uint"/> for each query.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="queries">Pointer to an array of queries, which are filled with the values of the uniform variables.</param>
+		/// <param name="count">Number of queries in the array.</param>
+		virtual void get_uniform_values(const effect_uniform_value_query *queries, size_t count) const = 0;
+		/// <summary>
+		/// Sets the values of multiple uniform variables at once.
+		/// This is equivalent to calling <see cref="set_uniform_value_bool"/>, <see cref="set_uniform_value_float"/>, <see cref="set_uniform_value_int"/> or <see cref="set_uniform_value_uint"/> for each update, but only updates the current preset once at the end, which makes it considerably faster when updating many variables every frame.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		/// <param name="updates">Pointer to an array of updates to apply in order.</param>
+		/// <param name="count">Number of updates in the array.</param>
+		virtual void set_uniform_values(const effect_uniform_value_update *updates, size_t count) = 0;
+
+		/// <summary>
+		/// Gets a counter that changes every time effects are loaded or unloaded, which invalidates all effect, variable and technique handles.
+		/// </summary>
+		/// <remarks>
+		/// Requires the ReShade module to support API version 3 or later.
+		/// </remarks>
+		virtual uint32_t get_effects_generation() const = 0;
 	};
 }
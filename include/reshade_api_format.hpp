@@ -401,36 +401,69 @@ namespace reshade::api
 		}
 	}
 
+	/// <summary>
+	/// Gets the number of bytes a single pixel (or a 4x4 block of pixels for block compressed formats) of the specified format <paramref name="value"/> occupies.
+	/// </summary>
+	/// <returns>The size in bytes, or zero if the format is unknown or its pixels are smaller than a byte.</returns>
+	inline const uint32_t format_bytes_per_block(format value)
+	{
+		// Lookup table for all formats with a value that matches the equivalent 'DXGI_FORMAT' (in the range [0, 115])
+		static constexpr uint8_t dxgi_bytes_per_block[116] = {
+			 0, 16, 16, 16, 16, 12, 12, 12, 12,  8,  8,  8,  8,  8,  8,  8, //   0 -  15
+			 8,  8,  8,  8,  8,  8,  8,  4,  4,  4,  4,  4,  4,  4,  4,  4, //  16 -  31
+			 4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, //  32 -  47
+			 2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  1,  1,  1,  1, //  48 -  63
+			 1,  1,  0,  4,  4,  4,  8,  8,  8, 16, 16, 16, 16, 16, 16,  8, //  64 -  79
+			 8,  8, 16, 16, 16,  2,  2,  4,  4,  4,  4,  4,  4,  4, 16, 16, //  80 -  95
+			16, 16, 16, 16,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, //  96 - 111
+			 0,  0,  0,  2                                                  // 112 - 115
+		};
+
+		if (static_cast<uint32_t>(value) < sizeof(dxgi_bytes_per_block))
+			return dxgi_bytes_per_block[static_cast<uint32_t>(value)];
+
+		switch (value)
+		{
+		case format::l8_unorm:
+		case format::s8_uint:
+			return 1;
+		case format::l8a8_unorm:
+		case format::l16_unorm:
+		case format::b5g5r5x1_unorm:
+			return 2;
+		case format::l16a16_unorm:
+		case format::r8g8b8x8_typeless:
+		case format::r8g8b8x8_unorm:
+		case format::r8g8b8x8_unorm_srgb:
+		case format::b10g10r10a2_typeless:
+		case format::b10g10r10a2_uint:
+		case format::b10g10r10a2_unorm:
+		case format::d24_unorm_x8_uint:
+		case format::intz:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
 	/// <summary>
 	/// Gets the number of bytes a texture row of the specified format <paramref name="value"/> occupies.
 	/// </summary>
 	inline const uint32_t format_row_pitch(format value, uint32_t width)
 	{
-		if (value == format::unknown)
-			return 0;
+		if (value == format::r1_unorm)
+			return (width + 7) / 8;
 
-		if (value <= format::r32g32b32a32_sint)
-			return 16 * width;
-		if (value <= format::r32g32b32_sint)
-			return 12 * width;
-		if (value <= format::x32_float_g8_uint)
-			return  8 * width;
-		if (value <= format::x24_unorm_g8_uint || value == format::l16a16_unorm)
-			return  4 * width;
-		if (value <= format::r16_sint || value == format::b5g6r5_unorm || value == format::b5g5r5a1_unorm || value == format::b5g5r5x1_unorm || value == format::l8a8_unorm || value == format::l16_unorm)
-			return  2 * width;
-		if (value <= format::a8_unorm || value == format::l8_unorm)
-			return  1 * width;
-		if (value <= format::g8r8_g8b8_unorm || (value >= format::b8g8r8a8_unorm && value <= format::b8g8r8x8_unorm_srgb) || (value >= format::r8g8b8x8_typeless && value <= format::r8g8b8x8_unorm_srgb))
-			return  4 * width;
+		const uint32_t bytes_per_block = format_bytes_per_block(value);
 
 		// Block compressed formats are bytes per block, rather than per pixel
-		if ((value >= format::bc1_typeless && value <= format::bc1_unorm_srgb) || (value >= format::bc4_typeless && value <= format::bc4_snorm))
-			return  8 * ((width + 3) / 4);
-		if ((value >= format::bc2_typeless && value <= format::bc2_unorm_srgb) || (value >= format::bc3_typeless && value <= format::bc3_unorm_srgb) || (value >= format::bc5_typeless && value <= format::bc7_unorm_srgb))
-			return 16 * ((width + 3) / 4);
+		if ((value >= format::bc1_typeless && value <= format::bc5_snorm) || (value >= format::bc6h_typeless && value <= format::bc7_unorm_srgb))
+			return bytes_per_block * ((width + 3) / 4);
+		// Packed formats share one block between two pixels
+		if (value == format::r8g8_b8g8_unorm || value == format::g8r8_g8b8_unorm)
+			return bytes_per_block * ((width + 1) / 2);
 
-		return 0;
+		return bytes_per_block * width;
 	}
 	/// <summary>
 	/// Gets the number of bytes a texture slice of the specified format <paramref name="value"/> occupies.
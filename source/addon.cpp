@@ -44,9 +44,8 @@ extern "C" __declspec(dllexport) void ReShadeSetConfigValue(void *, reshade::api
 {
 	ini_file &config = (runtime != nullptr) ? ini_file::load_cache(static_cast<reshade::runtime *>(runtime)->get_config_path()) : reshade::global_config();
 
+	// This is saved to disk by the background thread, so that add-ons setting many values in a row do not cause a write for every one of them
 	config.set(section, key, std::string(value));
-
-	config.save();
 }
 
 #if RESHADE_GUI
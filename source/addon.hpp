@@ -7,6 +7,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <cassert>
 
 template <typename T, size_t STACK_ELEMENTS = 16>
@@ -112,6 +113,8 @@ namespace reshade::api
 
 namespace reshade
 {
+	struct addon_event_stats;
+
 	struct addon_info
 	{
 		struct overlay_callback
@@ -131,6 +134,8 @@ namespace reshade
 		std::string version;
 
 		std::vector<std::pair<uint32_t, void *>> event_callbacks;
+		// Profiling statistics of the event callbacks of this add-on, indexed by event
+		std::shared_ptr<addon_event_stats[]> event_stats;
 #if RESHADE_GUI
 		void(*settings_overlay_callback)(api::effect_runtime *) = nullptr;
 		std::vector<overlay_callback> overlay_callbacks;
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cmath>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+
+namespace reshade
+{
+	/// <summary>
+	/// Profiling statistics of the callbacks an add-on registered for a single event.
+	/// </summary>
+	struct addon_event_stats
+	{
+		// Number of calls to the callbacks
+		std::atomic<uint64_t> call_count = 0;
+		// Number of calls that were timed and the total time they took in nanoseconds
+		std::atomic<uint64_t> sample_count = 0;
+		std::atomic<uint64_t> sample_time = 0;
+		// Histogram of timed calls, where bucket i counts calls that took less than 2^i nanoseconds (and at least 2^(i-1))
+		std::atomic<uint32_t> sample_histogram[32] = {};
+	};
+
+	/// <summary>
+	/// Adds a timed call to the profiling statistics.
+	/// </summary>
+	inline void record_addon_event_sample(addon_event_stats &stats, std::chrono::high_resolution_clock::duration duration)
+	{
+		const uint64_t duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+
+		size_t bucket = 0;
+		while (bucket < std::size(stats.sample_histogram) - 1 && (duration_ns >> bucket) != 0)
+			++bucket;
+
+		stats.sample_count.fetch_add(1, std::memory_order_relaxed);
+		stats.sample_time.fetch_add(duration_ns, std::memory_order_relaxed);
+		stats.sample_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Estimates the duration in nanoseconds that the specified fraction of timed calls took less than from the profiling statistics.
+	/// </summary>
+	inline uint64_t get_addon_event_percentile(const addon_event_stats &stats, double percentile)
+	{
+		uint64_t total_count = 0;
+		for (const std::atomic<uint32_t> &count : stats.sample_histogram)
+			total_count += count.load(std::memory_order_relaxed);
+		if (total_count == 0)
+			return 0;
+
+		const uint64_t target_count = static_cast<uint64_t>(std::ceil(total_count * percentile));
+
+		// Return upper bound of the first bucket at which the target number of calls is reached
+		uint64_t count = 0;
+		for (size_t bucket = 0; bucket < std::size(stats.sample_histogram); ++bucket)
+			if ((count += stats.sample_histogram[bucket].load(std::memory_order_relaxed)) >= target_count)
+				return (1ull << bucket) - 1;
+		return UINT64_MAX;
+	}
+
+	/// <summary>
+	/// Immutable list of callbacks registered for an event.
+	/// </summary>
+	struct addon_event_callback_list
+	{
+		std::vector<void *> callbacks;
+		// Statistics of the add-on that registered each callback, in the same order as the callbacks
+		std::vector<addon_event_stats *> stats;
+	};
+
+	/// <summary>
+	/// Invokes all callbacks in the <paramref name="event_list"/> while recording profiling statistics, timing the calls of every <paramref name="interval"/>-th invocation.
+	/// If the callbacks return <see langword="bool"/>, this stops at the first callback that reports back as having handled the event by returning <see langword="true"/>.
+	/// </summary>
+	/// <param name="invocation_index">Number of previous invocations of this event on the calling thread.</param>
+	template <typename R, typename F, typename... Args>
+	R invoke_addon_event_callbacks_profiled(uint32_t interval, uint32_t &invocation_index, const addon_event_callback_list &event_list, Args &&... args)
+	{
+		// Only time every few invocations, since querying the time is costly compared to a typical callback
+		const bool sample = (invocation_index++ % interval) == 0;
+
+		for (size_t cb = 0, count = event_list.callbacks.size(); cb < count; ++cb)
+		{
+			addon_event_stats &stats = *event_list.stats[cb];
+			stats.call_count.fetch_add(1, std::memory_order_relaxed);
+
+			const auto callback = reinterpret_cast<F>(event_list.callbacks[cb]);
+
+			if (!sample)
+			{
+				if constexpr (std::is_same_v<R, bool>)
+				{
+					if (callback(std::forward<Args>(args)...))
+						return true;
+				}
+				else
+				{
+					callback(std::forward<Args>(args)...);
+				}
+				continue;
+			}
+
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			if constexpr (std::is_same_v<R, bool>)
+			{
+				const bool handled = callback(std::forward<Args>(args)...);
+				record_addon_event_sample(stats, std::chrono::high_resolution_clock::now() - start_time);
+				if (handled)
+					return true;
+			}
+			else
+			{
+				callback(std::forward<Args>(args)...);
+				record_addon_event_sample(stats, std::chrono::high_resolution_clock::now() - start_time);
+			}
+		}
+
+		if constexpr (std::is_same_v<R, bool>)
+			return false;
+	}
+
+	/// <summary>
+	/// Publishes new callback lists for add-on events and keeps replaced lists alive while invocations on other threads may still be iterating them.
+	/// Invocations do not announce themselves, so a replaced list is kept for at least <see cref="grace_period"/>, which no invocation is expected to take longer than.
+	/// Only once more than <see cref="max_retired"/> lists were replaced are the oldest of those freed, so that add-ons that register and unregister callbacks all the time do not grow memory without bounds.
+	/// </summary>
+	class addon_event_list_publisher
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static constexpr size_t max_retired = 256;
+		static constexpr auto grace_period = std::chrono::seconds(10);
+
+		/// <summary>
+		/// Publishes a copy of the list in <paramref name="event_list"/> that was changed by <paramref name="modify"/>, or <see langword="nullptr"/> if that left no callbacks.
+		/// This may be called from multiple threads simultaneously, updates are serialized.
+		/// </summary>
+		template <typename F>
+		void update(std::atomic<const addon_event_callback_list *> &event_list, F modify)
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+
+			const addon_event_callback_list *const old_event_list = event_list.load(std::memory_order_relaxed);
+
+			addon_event_callback_list new_event_list;
+			if (old_event_list != nullptr)
+				new_event_list = *old_event_list;
+
+			modify(new_event_list);
+			assert(new_event_list.callbacks.size() == new_event_list.stats.size());
+
+			event_list.store(new_event_list.callbacks.empty() ? nullptr : new addon_event_callback_list(std::move(new_event_list)), std::memory_order_release);
+
+			if (old_event_list != nullptr)
+				retire_internal(std::shared_ptr<const addon_event_callback_list>(old_event_list), clock::now());
+		}
+
+		/// <summary>
+		/// Keeps an object that published lists may still reference (e.g. the statistics of an unregistered add-on) alive the same as a replaced list.
+		/// </summary>
+		void retire(std::shared_ptr<const void> object, clock::time_point now = clock::now())
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+
+			retire_internal(std::move(object), now);
+		}
+
+		/// <summary>
+		/// Frees all replaced lists and retired objects. Only call this when no more events can be in flight (e.g. once all add-ons were unloaded).
+		/// </summary>
+		void clear()
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+
+			_retired.clear();
+		}
+
+		/// <summary>
+		/// Gets the number of replaced lists and retired objects that are currently kept alive.
+		/// </summary>
+		size_t num_retired()
+		{
+			const std::unique_lock<std::mutex> lock(_mutex);
+
+			return _retired.size();
+		}
+
+	private:
+		void retire_internal(std::shared_ptr<const void> &&object, clock::time_point now)
+		{
+			_retired.emplace_back(now, std::move(object));
+
+			// Objects are retired in order, so the oldest ones are at the front
+			while (_retired.size() > max_retired && (now - _retired.front().first) >= grace_period)
+				_retired.pop_front();
+		}
+
+		std::mutex _mutex;
+		std::deque<std::pair<clock::time_point, std::shared_ptr<const void>>> _retired;
+	};
+}
@@ -18,8 +18,7 @@ extern HMODULE g_module_handle;
 
 extern std::filesystem::path get_module_path(HMODULE module);
 
-#if RESHADE_VERBOSE_LOG
-static const char *addon_event_to_string(reshade::addon_event ev)
+const char *reshade::addon_event_to_string(addon_event ev)
 {
 #define CASE(name) case reshade::addon_event::name: return #name
 	switch (ev)
@@ -109,15 +108,25 @@ static const char *addon_event_to_string(reshade::addon_event ev)
 #undef  CASE
 	return "unknown";
 }
-#endif
 
 #if RESHADE_ADDON_LITE
 bool reshade::addon_enabled = true;
 #endif
-std::vector<void *> reshade::addon_event_list[static_cast<uint32_t>(reshade::addon_event::max)];
+std::atomic<const reshade::addon_event_callback_list *> reshade::addon_event_list[static_cast<uint32_t>(reshade::addon_event::max)];
+std::atomic<uint32_t> reshade::addon_profiling_interval = 0;
 std::vector<reshade::addon_info> reshade::addon_loaded_info;
 static unsigned long s_reference_count = 0;
 
+// Serializes registration and keeps replaced event lists alive, invocation does not take a lock
+// The same applies to the statistics of unregistered add-ons, which these lists reference
+static reshade::addon_event_list_publisher s_event_list_publisher;
+
+template <typename F>
+static void update_event_list(reshade::addon_event ev, F modify)
+{
+	s_event_list_publisher.update(reshade::addon_event_list[static_cast<uint32_t>(ev)], std::move(modify));
+}
+
 void reshade::load_addons()
 {
 	// Only load add-ons the first time a reference is added
@@ -228,12 +237,34 @@ void reshade::unload_addons()
 #ifndef NDEBUG
 	// All events should have been unregistered at this point
 	for (const auto &event_info : addon_event_list)
-		assert(event_info.empty());
+		assert(event_info.load() == nullptr);
 #endif
 
+	// No more events can be in flight at this point, so free replaced event lists right away
+	s_event_list_publisher.clear();
+
 	addon_loaded_info.clear();
 }
 
+void reshade::reset_addon_event_stats()
+{
+	for (const addon_info &info : addon_loaded_info)
+	{
+		if (info.event_stats == nullptr)
+			continue;
+
+		for (size_t ev = 0; ev < static_cast<size_t>(addon_event::max); ++ev)
+		{
+			addon_event_stats &stats = info.event_stats[ev];
+			stats.call_count.store(0, std::memory_order_relaxed);
+			stats.sample_count.store(0, std::memory_order_relaxed);
+			stats.sample_time.store(0, std::memory_order_relaxed);
+			for (std::atomic<uint32_t> &count : stats.sample_histogram)
+				count.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
 reshade::addon_info *reshade::find_addon(void *address)
 {
 	if (address == nullptr)
@@ -255,6 +286,9 @@ extern "C" __declspec(dllexport) void ReShadeUnregisterAddon(HMODULE module);
 extern "C" __declspec(dllexport) void ReShadeRegisterEvent(reshade::addon_event ev, void *callback);
 extern "C" __declspec(dllexport) void ReShadeUnregisterEvent(reshade::addon_event ev, void *callback);
 
+extern "C" __declspec(dllexport) void ReShadeSetAddonProfiling(uint32_t interval);
+extern "C" __declspec(dllexport) bool ReShadeGetAddonEventStatistics(HMODULE module, const char *addon_name, reshade::addon_event_statistics *statistics, size_t *count);
+
 #if RESHADE_GUI
 extern "C" __declspec(dllexport) void ReShadeRegisterOverlay(const char *title, void(*callback)(reshade::api::effect_runtime *runtime));
 extern "C" __declspec(dllexport) void ReShadeUnregisterOverlay(const char *title, void(*callback)(reshade::api::effect_runtime *runtime));
@@ -362,6 +396,10 @@ void ReShadeUnregisterAddon(HMODULE module)
 	}
 #endif
 
+	// Keep statistics alive, since event lists that were replaced during unregistration above may still reference them
+	if (info->event_stats != nullptr)
+		s_event_list_publisher.retire(std::move(info->event_stats));
+
 	LOG(INFO) << "Unregistered add-on \"" << info->name << "\".";
 
 	reshade::addon_loaded_info.erase(reshade::addon_loaded_info.begin() + (info - reshade::addon_loaded_info.data()));
@@ -388,13 +426,18 @@ void ReShadeRegisterEvent(reshade::addon_event ev, void *callback)
 	}
 #endif
 
-	auto &event_list = reshade::addon_event_list[static_cast<uint32_t>(ev)];
-	event_list.push_back(callback);
+	if (info->event_stats == nullptr)
+		info->event_stats.reset(new reshade::addon_event_stats[static_cast<size_t>(reshade::addon_event::max)]);
+
+	update_event_list(ev, [callback, stats = &info->event_stats[static_cast<size_t>(ev)]](reshade::addon_event_callback_list &event_list) {
+		event_list.callbacks.push_back(callback);
+		event_list.stats.push_back(stats);
+	});
 
 	info->event_callbacks.emplace_back(static_cast<uint32_t>(ev), callback);
 
 #if RESHADE_VERBOSE_LOG
-	LOG(DEBUG) << "Registered event callback " << callback << " for event " << addon_event_to_string(ev) << '.';
+	LOG(DEBUG) << "Registered event callback " << callback << " for event " << reshade::addon_event_to_string(ev) << '.';
 #endif
 }
 void ReShadeUnregisterEvent(reshade::addon_event ev, void *callback)
@@ -411,16 +454,84 @@ void ReShadeUnregisterEvent(reshade::addon_event ev, void *callback)
 		return;
 #endif
 
-	auto &event_list = reshade::addon_event_list[static_cast<uint32_t>(ev)];
-	event_list.erase(std::remove(event_list.begin(), event_list.end(), callback), event_list.end());
+	update_event_list(ev, [callback](reshade::addon_event_callback_list &event_list) {
+		for (size_t cb = 0; cb < event_list.callbacks.size();)
+		{
+			if (event_list.callbacks[cb] == callback)
+			{
+				event_list.callbacks.erase(event_list.callbacks.begin() + cb);
+				event_list.stats.erase(event_list.stats.begin() + cb);
+			}
+			else
+			{
+				++cb;
+			}
+		}
+	});
 
 	info->event_callbacks.erase(std::remove(info->event_callbacks.begin(), info->event_callbacks.end(), std::make_pair(static_cast<uint32_t>(ev), callback)), info->event_callbacks.end());
 
 #if RESHADE_VERBOSE_LOG
-	LOG(DEBUG) << "Unregistered event callback " << callback << " for event " << addon_event_to_string(ev) << '.';
+	LOG(DEBUG) << "Unregistered event callback " << callback << " for event " << reshade::addon_event_to_string(ev) << '.';
 #endif
 }
 
+void ReShadeSetAddonProfiling(uint32_t interval)
+{
+	reshade::addon_profiling_interval.store(interval, std::memory_order_relaxed);
+}
+bool ReShadeGetAddonEventStatistics(HMODULE module, const char *addon_name, reshade::addon_event_statistics *statistics, size_t *count)
+{
+	if (count == nullptr)
+		return false;
+
+	const reshade::addon_info *info = nullptr;
+	if (addon_name == nullptr)
+	{
+		info = reshade::find_addon(module);
+	}
+	else
+	{
+		const auto it = std::find_if(reshade::addon_loaded_info.begin(), reshade::addon_loaded_info.end(),
+			[addon_name](const reshade::addon_info &info) { return info.name == addon_name; });
+		if (it != reshade::addon_loaded_info.end())
+			info = &(*it);
+	}
+
+	if (info == nullptr)
+		return false;
+
+	size_t num_statistics = 0;
+
+	if (info->event_stats != nullptr)
+	{
+		for (size_t ev = 0; ev < static_cast<size_t>(reshade::addon_event::max); ++ev)
+		{
+			const reshade::addon_event_stats &stats = info->event_stats[ev];
+
+			const uint64_t call_count = stats.call_count.load(std::memory_order_relaxed);
+			if (call_count == 0)
+				continue;
+
+			if (statistics != nullptr && num_statistics < *count)
+			{
+				reshade::addon_event_statistics &result = statistics[num_statistics];
+				result.ev = static_cast<reshade::addon_event>(ev);
+				result.call_count = call_count;
+				result.sample_count = stats.sample_count.load(std::memory_order_relaxed);
+				result.sample_time_ns = stats.sample_time.load(std::memory_order_relaxed);
+				result.median_time_ns = reshade::get_addon_event_percentile(stats, 0.5);
+				result.p99_time_ns = reshade::get_addon_event_percentile(stats, 0.99);
+			}
+
+			num_statistics++;
+		}
+	}
+
+	*count = num_statistics;
+	return true;
+}
+
 #if RESHADE_GUI
 void ReShadeRegisterOverlay(const char *title, void(*callback)(reshade::api::effect_runtime *runtime))
 {
@@ -6,7 +6,10 @@
 #pragma once
 
 #include "addon.hpp"
+#include "addon_event_list.hpp"
 #include "reshade_events.hpp"
+#include <atomic>
+#include <chrono>
 
 #if RESHADE_ADDON
 
@@ -20,9 +23,15 @@ namespace reshade
 #endif
 
 	/// <summary>
-	/// List of add-on event callbacks.
+	/// List of add-on event callbacks, or <see langword="nullptr"/> if there are none for an event.
+	/// A list is never modified after it was published, registration instead publishes a new one, so that events can be invoked without locking while callbacks are registered on other threads.
 	/// </summary>
-	extern std::vector<void *> addon_event_list[];
+	extern std::atomic<const addon_event_callback_list *> addon_event_list[];
+
+	/// <summary>
+	/// Every how many invocations of an event (per thread) calls to its callbacks are timed, or zero to disable add-on profiling.
+	/// </summary>
+	extern std::atomic<uint32_t> addon_profiling_interval;
 
 	/// <summary>
 	/// List of currently loaded add-ons.
@@ -44,13 +53,36 @@ namespace reshade
 	/// </summary>
 	addon_info *find_addon(void *address);
 
+	/// <summary>
+	/// Gets the name of the specified <paramref name="ev"/>ent.
+	/// </summary>
+	const char *addon_event_to_string(addon_event ev);
+
+	/// <summary>
+	/// Resets the profiling statistics of all add-ons.
+	/// </summary>
+	void reset_addon_event_stats();
+
+	/// <summary>
+	/// Invokes all registered callbacks for the specified <typeparamref name="ev"/>ent while recording profiling statistics.
+	/// This is kept out of line, so that it does not affect the code generated for the common case of profiling being disabled.
+	/// </summary>
+	template <addon_event ev, typename... Args>
+	__declspec(noinline) typename addon_event_traits<ev>::type invoke_addon_event_profiled(uint32_t interval, const addon_event_callback_list &event_list, Args &&... args)
+	{
+		// Count invocations per event, so that each event is sampled at the same interval
+		static thread_local uint32_t invocation_index = 0;
+
+		return invoke_addon_event_callbacks_profiled<typename addon_event_traits<ev>::type, typename addon_event_traits<ev>::decl>(interval, invocation_index, event_list, std::forward<Args>(args)...);
+	}
+
 	/// <summary>
 	/// Checks whether any callbacks were registered for the specified <paramref name="ev"/>ent.
 	/// </summary>
 	template <addon_event ev>
 	__forceinline bool has_addon_event()
 	{
-		return !addon_event_list[static_cast<uint32_t>(ev)].empty();
+		return addon_event_list[static_cast<uint32_t>(ev)].load(std::memory_order_relaxed) != nullptr;
 	}
 
 	/// <summary>
@@ -87,9 +119,13 @@ namespace reshade
 		if (!addon_enabled)
 			return;
 #endif
-		std::vector<void *> &event_list = addon_event_list[static_cast<uint32_t>(ev)];
-		for (size_t cb = 0, count = event_list.size(); cb < count; ++cb) // Generates better code than ranged-based for loop
-			reinterpret_cast<typename addon_event_traits<ev>::decl>(event_list[cb])(std::forward<Args>(args)...);
+		const addon_event_callback_list *const event_list = addon_event_list[static_cast<uint32_t>(ev)].load(std::memory_order_acquire);
+		if (event_list == nullptr)
+			return;
+		if (const uint32_t interval = addon_profiling_interval.load(std::memory_order_relaxed); interval != 0)
+			return invoke_addon_event_profiled<ev>(interval, *event_list, std::forward<Args>(args)...);
+		for (size_t cb = 0, count = event_list->callbacks.size(); cb < count; ++cb) // Generates better code than ranged-based for loop
+			reinterpret_cast<typename addon_event_traits<ev>::decl>(event_list->callbacks[cb])(std::forward<Args>(args)...);
 	}
 	/// <summary>
 	/// Invokes registered callbacks for the specified <typeparamref name="ev"/>ent until a callback reports back as having handled this event by returning <see langword="true"/>.
@@ -101,9 +137,13 @@ namespace reshade
 		if (!addon_enabled)
 			return false;
 #endif
-		std::vector<void *> &event_list = addon_event_list[static_cast<uint32_t>(ev)];
-		for (size_t cb = 0, count = event_list.size(); cb < count; ++cb)
-			if (reinterpret_cast<typename addon_event_traits<ev>::decl>(event_list[cb])(std::forward<Args>(args)...))
+		const addon_event_callback_list *const event_list = addon_event_list[static_cast<uint32_t>(ev)].load(std::memory_order_acquire);
+		if (event_list == nullptr)
+			return false;
+		if (const uint32_t interval = addon_profiling_interval.load(std::memory_order_relaxed); interval != 0)
+			return invoke_addon_event_profiled<ev>(interval, *event_list, std::forward<Args>(args)...);
+		for (size_t cb = 0, count = event_list->callbacks.size(); cb < count; ++cb)
+			if (reinterpret_cast<typename addon_event_traits<ev>::decl>(event_list->callbacks[cb])(std::forward<Args>(args)...))
 				return true;
 		return false;
 	}
@@ -446,7 +446,6 @@ void reshade::d3d12::device_impl::destroy_resource_view(api::resource_view handl
 
 	D3D12_CPU_DESCRIPTOR_HANDLE descriptor_handle = { static_cast<SIZE_T>(handle.handle) };
 
-	const std::unique_lock<std::shared_mutex> lock(_mutex);
 	_views.erase(descriptor_handle.ptr);
 
 	for (UINT i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; ++i)
@@ -459,10 +458,8 @@ reshade::api::resource reshade::d3d12::device_impl::get_resource_from_view(api::
 
 	D3D12_CPU_DESCRIPTOR_HANDLE descriptor_handle = { static_cast<SIZE_T>(view.handle) };
 
-	const std::shared_lock<std::shared_mutex> lock(_mutex);
-
-	if (const auto it = _views.find(descriptor_handle.ptr); it != _views.end())
-		return to_handle(it->second.first);
+	if (std::pair<ID3D12Resource *, api::resource_view_desc> view_data; _views.find(descriptor_handle.ptr, view_data))
+		return to_handle(view_data.first);
 	else
 		return assert(false), api::resource { 0 };
 }
@@ -472,10 +469,8 @@ reshade::api::resource_view_desc reshade::d3d12::device_impl::get_resource_view_
 
 	D3D12_CPU_DESCRIPTOR_HANDLE descriptor_handle = { static_cast<SIZE_T>(view.handle) };
 
-	const std::shared_lock<std::shared_mutex> lock(_mutex);
-
-	if (const auto it = _views.find(descriptor_handle.ptr); it != _views.end())
-		return it->second.second;
+	if (std::pair<ID3D12Resource *, api::resource_view_desc> view_data; _views.find(descriptor_handle.ptr, view_data))
+		return view_data.second;
 	else
 		return assert(false), api::resource_view_desc();
 }
@@ -1298,16 +1293,8 @@ void reshade::d3d12::device_impl::unregister_resource(ID3D12Resource *resource)
 #endif
 
 #if 0
-	const std::unique_lock<std::shared_mutex> lock(_mutex);
-
 	// Remove all views that referenced this resource
-	for (auto it = _views.begin(); it != _views.end();)
-	{
-		if (it->second.first == resource)
-			it = _views.erase(it);
-		else
-			++it;
-	}
+	_views.erase_if([resource](SIZE_T, const std::pair<ID3D12Resource *, api::resource_view_desc> &view_data) { return view_data.first == resource; });
 #endif
 }
 
@@ -7,6 +7,7 @@
 
 #include "addon_manager.hpp"
 #include "descriptor_heap.hpp"
+#include "sharded_unordered_map.hpp"
 #include <shared_mutex>
 
 struct D3D12DescriptorHeap;
@@ -110,7 +111,6 @@ namespace reshade::d3d12
 
 		inline void register_resource_view(D3D12_CPU_DESCRIPTOR_HANDLE handle, ID3D12Resource *resource, const api::resource_view_desc &desc)
 		{
-			const std::unique_lock<std::shared_mutex> lock(_mutex);
 			_views.insert_or_assign(handle.ptr, std::make_pair(resource, desc));
 		}
 
@@ -129,7 +129,8 @@ namespace reshade::d3d12
 		std::vector<D3D12DescriptorHeap *> _descriptor_heaps;
 		std::vector<std::pair<ID3D12Resource *, D3D12_GPU_VIRTUAL_ADDRESS_RANGE>> _buffer_gpu_addresses; // TODO: Replace with interval tree
 #endif
-		std::unordered_map<SIZE_T, std::pair<ID3D12Resource *, api::resource_view_desc>> _views;
+		// Views are created and looked up very frequently from many threads, so they are kept in a separately locked map instead of using the device mutex
+		sharded_unordered_map<SIZE_T, std::pair<ID3D12Resource *, api::resource_view_desc>> _views;
 
 		com_ptr<ID3D12PipelineState> _mipmap_pipeline;
 		com_ptr<ID3D12RootSignature> _mipmap_signature;
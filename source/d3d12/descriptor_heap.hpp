@@ -5,107 +5,71 @@
 
 #pragma once
 
+#include <mutex>
 #include <vector>
 #include <shared_mutex>
 #include <d3d12.h>
 #include "com_ptr.hpp"
+#include "lockfree_bitmap_allocator.hpp"
 
 namespace reshade::d3d12
 {
 	class descriptor_heap_cpu
 	{
-		struct heap_info
-		{
-			com_ptr<ID3D12DescriptorHeap> heap;
-			std::vector<bool> state;
-			SIZE_T heap_base = 0;
-		};
-
-		const UINT pool_size = 1024;
-
 	public:
 		descriptor_heap_cpu(ID3D12Device *device, D3D12_DESCRIPTOR_HEAP_TYPE type) :
-			_device(device), _type(type)
+			_device(device), _type(type), _allocator(device->GetDescriptorHandleIncrementSize(type))
 		{
-			_increment_size = device->GetDescriptorHandleIncrementSize(type);
 		}
 
 		bool allocate(D3D12_CPU_DESCRIPTOR_HANDLE &handle)
 		{
-			const std::unique_lock<std::shared_mutex> lock(_mutex);
+			uintptr_t address = 0;
 
-			for (int attempt = 0; attempt < 2; ++attempt)
+			// Allocation and freeing does not take a lock, only creating a new heap does
+			if (!_allocator.allocate(address))
 			{
-				for (heap_info &heap_info : _heap_infos)
-				{
-					// Find free empty in the heap
-					if (const auto it = std::find(heap_info.state.begin(), heap_info.state.end(), false);
-						it != heap_info.state.end())
-					{
-						const size_t index = it - heap_info.state.begin();
-						heap_info.state[index] = true; // Mark this entry as being in use
-
-						handle.ptr = heap_info.heap_base + index * _increment_size;
-						return true;
-					}
-				}
+				const std::unique_lock<std::mutex> lock(_mutex);
 
-				// No more space available in the existing heaps, so create a new one and try again
-				if (!allocate_heap())
-					break;
+				// Another thread may have created a new heap while waiting for the lock, so try again before creating another one
+				if (!_allocator.allocate(address) && (!allocate_heap() || !_allocator.allocate(address)))
+					return false;
 			}
 
-			return false;
+			handle.ptr = static_cast<SIZE_T>(address);
+			return true;
 		}
 
 		void free(D3D12_CPU_DESCRIPTOR_HANDLE handle)
 		{
-			const std::unique_lock<std::shared_mutex> lock(_mutex);
-
-			for (heap_info &heap_info : _heap_infos)
-			{
-				const SIZE_T heap_beg = heap_info.heap_base;
-				const SIZE_T heap_end = heap_info.heap_base + pool_size * _increment_size;
-
-				if (handle.ptr >= heap_beg && handle.ptr < heap_end)
-				{
-					const SIZE_T index = (handle.ptr - heap_beg) / _increment_size;
-
-					// Mark free slot in the descriptor heap
-					heap_info.state[index] = false;
-					break;
-				}
-			}
+			// Handles from other heap types are ignored, since they do not fall into the address range of any heap of this type
+			_allocator.free(static_cast<uintptr_t>(handle.ptr));
 		}
 
 	private:
 		bool allocate_heap()
 		{
-			heap_info &heap_info = _heap_infos.emplace_back();
-
 			D3D12_DESCRIPTOR_HEAP_DESC desc;
 			desc.Type = _type;
-			desc.NumDescriptors = pool_size;
+			desc.NumDescriptors = lockfree_bitmap_allocator::BLOCK_SIZE;
 			desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 			desc.NodeMask = 0;
 
-			if (FAILED(_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap_info.heap))))
-			{
-				_heap_infos.pop_back();
+			com_ptr<ID3D12DescriptorHeap> heap;
+			if (FAILED(_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap))))
 				return false;
-			}
 
-			heap_info.heap_base = heap_info.heap->GetCPUDescriptorHandleForHeapStart().ptr;
-			heap_info.state.resize(pool_size);
+			_allocator.add_block(static_cast<uintptr_t>(heap->GetCPUDescriptorHandleForHeapStart().ptr));
+			_heaps.push_back(std::move(heap));
 
 			return true;
 		}
 
 		ID3D12Device *const _device;
-		std::vector<heap_info> _heap_infos;
-		SIZE_T _increment_size;
-		D3D12_DESCRIPTOR_HEAP_TYPE _type;
-		std::shared_mutex _mutex;
+		const D3D12_DESCRIPTOR_HEAP_TYPE _type;
+		lockfree_bitmap_allocator _allocator;
+		std::mutex _mutex;
+		std::vector<com_ptr<ID3D12DescriptorHeap>> _heaps;
 	};
 
 	template <D3D12_DESCRIPTOR_HEAP_TYPE type, UINT static_size, UINT transient_size>
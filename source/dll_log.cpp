@@ -4,7 +4,11 @@
  */
 
 #include "dll_log.hpp"
-#include <shared_mutex>
+#include "log_message_queue.hpp"
+#include "log_history.hpp"
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <Windows.h>
 
 struct scoped_file_handle
@@ -22,9 +26,89 @@ private:
 	HANDLE handle = INVALID_HANDLE_VALUE;
 };
 
-static std::shared_mutex s_message_mutex;
+// Lines are formatted on the thread that logs them and then written to the file by a background thread, so that logging does not have to wait for the disk
+// If the queue is full, the logging thread writes all queued lines and its own instead, so that no lines are lost and memory use stays bounded
+static reshade::log::message_queue s_message_queue;
+// Held by whichever thread is currently popping lines from the queue and writing them to the file
+static std::timed_mutex s_write_mutex;
 static scoped_file_handle s_file_handle;
-std::ostringstream reshade::log::line_stream;
+static HANDLE s_writer_event = nullptr;
+static std::atomic<bool> s_async = false;
+static std::atomic<bool> s_writer_running = false;
+static std::atomic<bool> s_writer_sleeping = false;
+thread_local std::ostringstream reshade::log::line_stream;
+
+// Filled by whichever thread writes lines to the file, so that logging threads never have to wait for it and readers never have to lock it
+static reshade::log::history s_history;
+
+static void write_queued_lines(std::string &batch, const std::string *last_line = nullptr)
+{
+	batch.clear();
+	for (std::string line; s_message_queue.try_pop(line);)
+		batch += line;
+	if (last_line != nullptr)
+		batch += *last_line;
+
+	// Keep the lines even when there is no file to write them to, so that the overlay can still show them
+	s_history.append(batch);
+
+	if (batch.empty() || s_file_handle == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD written = 0;
+	WriteFile(s_file_handle, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr);
+	assert(written == batch.size());
+}
+
+static DWORD WINAPI writer_thread(LPVOID module)
+{
+	std::string batch;
+
+	while (true)
+	{
+		{
+			const std::unique_lock<std::timed_mutex> lock(s_write_mutex);
+
+			write_queued_lines(batch);
+		}
+
+		// Announce going to sleep before checking the queue one last time, so that a line pushed after the check is guaranteed to signal the event
+		s_writer_sleeping.store(true);
+
+		if (s_message_queue.empty() && WaitForSingleObject(s_writer_event, 1000) == WAIT_TIMEOUT)
+		{
+			s_writer_sleeping.store(false);
+
+			// Exit after being idle for a while, unless a line was pushed in the meantime that no new thread was started for
+			s_writer_running.store(false);
+			if (s_message_queue.empty() || s_writer_running.exchange(true))
+				break;
+		}
+
+		s_writer_sleeping.store(false);
+	}
+
+	// Release the reference to this module that was added when the thread was started
+	FreeLibraryAndExitThread(static_cast<HMODULE>(module), 0);
+}
+
+static bool start_writer_thread()
+{
+	// Keep the module loaded while the thread is running, since it would crash if the module was unloaded underneath it
+	HMODULE module = nullptr;
+	if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&writer_thread), &module))
+		return false;
+
+	const HANDLE thread = CreateThread(nullptr, 0, &writer_thread, module, 0, nullptr);
+	if (thread == nullptr)
+	{
+		FreeLibrary(module);
+		return false;
+	}
+
+	CloseHandle(thread);
+	return true;
+}
 
 reshade::log::message::message(level level)
 {
@@ -35,15 +119,15 @@ reshade::log::message::message(level level)
 	if (static_cast<size_t>(level) > ARRAYSIZE(level_names))
 		level = level::debug;
 
+	_level = level;
+
 	SYSTEMTIME time;
 	GetLocalTime(&time);
 
-	// Lock the stream until the message is complete
-	s_message_mutex.lock();
-
-	// Start a new line
+	// Start a new line (each thread has its own stream, so no need to lock it)
 	line_stream.str(std::string());
 	line_stream.clear();
+	line_stream.setf(std::ios::showbase);
 
 	line_stream << std::right << std::setfill('0')
 #if RESHADE_VERBOSE_LOG
@@ -60,42 +144,112 @@ reshade::log::message::message(level level)
 }
 reshade::log::message::~message()
 {
-	std::string line_string = line_stream.str();
-	line_string += '\n'; // Terminate line with line feed
-
-	// Replace all LF with CRLF
-	for (size_t offset = 0; (offset = line_string.find('\n', offset)) != std::string::npos; offset += 2)
-		line_string.replace(offset, 1, "\r\n", 2);
+	const std::string line = line_stream.str();
 
-	// Write line to the log file
-	if (s_file_handle != INVALID_HANDLE_VALUE)
+	// Replace all LF with CRLF and terminate line with CRLF
+	std::string line_string;
+	line_string.reserve(line.size() + 16);
+	for (const char c : line)
 	{
-		DWORD written = 0;
-		WriteFile(s_file_handle, line_string.data(), static_cast<DWORD>(line_string.size()), &written, nullptr);
-		assert(written == line_string.size());
+		if (c == '\n')
+			line_string += '\r';
+		line_string += c;
 	}
+	line_string += "\r\n";
 
 #ifndef NDEBUG
 	// Write line to the debug output
 	OutputDebugStringA(line_string.c_str());
 #endif
 
-	// The message is finished, we can unlock the stream
-	s_message_mutex.unlock();
+	if (s_async.load(std::memory_order_relaxed) && s_message_queue.try_push(line_string))
+	{
+		if (!s_writer_running.load() && !s_writer_running.exchange(true))
+		{
+			// Lines stay queued until the next attempt to start the thread or a flush if this fails
+			if (!start_writer_thread())
+				s_writer_running.store(false);
+		}
+		else if (s_writer_sleeping.exchange(false))
+		{
+			SetEvent(s_writer_event);
+		}
+
+		// Make sure errors are written out immediately, in case they are followed by a crash
+		if (_level == level::error)
+			flush();
+		return;
+	}
+
+	// Write line to the log file directly when not logging asynchronously or the queue is full (after any queued lines, to keep them in order)
+	std::unique_lock<std::timed_mutex> lock(s_write_mutex, std::defer_lock);
+	if (!lock.try_lock_for(std::chrono::seconds(1)))
+		return; // The background thread may have been terminated while holding the lock during process exit, so avoid waiting forever
+
+	std::string batch;
+	if (s_async.load(std::memory_order_relaxed))
+	{
+		// Another thread may have reserved a slot that it did not fill yet, in which case the queue cannot be emptied past it
+		// So keep writing until this line fits into the queue, instead of writing it ahead of an earlier line of this thread that is still queued after that slot
+		for (const auto start_time = std::chrono::steady_clock::now(); std::chrono::steady_clock::now() - start_time < std::chrono::seconds(1);)
+		{
+			write_queued_lines(batch);
+
+			if (s_message_queue.try_push(line_string))
+			{
+				write_queued_lines(batch);
+				return;
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	write_queued_lines(batch, &line_string);
 }
 
 bool reshade::log::open_log_file(const std::filesystem::path &path)
 {
-	// Close the previous file first
+	const std::unique_lock<std::timed_mutex> lock(s_write_mutex);
+
+	// Close the previous file first (after writing any lines that are still queued for it)
 	if (s_file_handle != INVALID_HANDLE_VALUE)
-		CloseHandle(s_file_handle);
+	{
+		std::string batch;
+		write_queued_lines(batch);
 
-	// Set default line stream settings
-	line_stream.setf(std::ios::left);
-	line_stream.setf(std::ios::showbase);
+		CloseHandle(s_file_handle);
+	}
 
-	// Open the log file for writing (and flush on each write) and clear previous contents
-	s_file_handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+	// Open the log file for writing and clear previous contents
+	// This does not use write-through, since lines are already written to the operating system cache before a crash could happen that would lose them
+	s_file_handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
 
 	return s_file_handle != INVALID_HANDLE_VALUE;
 }
+
+void reshade::log::set_async(bool enabled)
+{
+	if (enabled && s_writer_event == nullptr)
+		s_writer_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+	s_async.store(enabled && s_writer_event != nullptr);
+
+	if (!enabled)
+		flush();
+}
+
+void reshade::log::flush()
+{
+	std::unique_lock<std::timed_mutex> lock(s_write_mutex, std::defer_lock);
+	if (!lock.try_lock_for(std::chrono::seconds(1)))
+		return; // See comment in 'message::~message' above
+
+	std::string batch;
+	write_queued_lines(batch);
+}
+
+uint64_t reshade::log::read_history(uint64_t &next_sequence, std::vector<std::string> &lines)
+{
+	return s_history.read(next_sequence, lines);
+}
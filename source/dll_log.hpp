@@ -8,6 +8,7 @@
 #include <cassert>
 #include <iomanip>
 #include <sstream>
+#include <vector>
 #include <filesystem>
 #include <utf8/unchecked.h>
 
@@ -39,9 +40,31 @@ namespace reshade::log
 	bool open_log_file(const std::filesystem::path &path);
 
 	/// <summary>
-	/// The current log line stream.
+	/// Sets whether messages are written to the log file by a background thread instead of the thread that logged them.
+	/// This must not be enabled while the loader lock is held and the module may still fail to load, since that thread would then outlive the module.
+	/// Disabling it writes all queued messages before returning.
 	/// </summary>
-	extern std::ostringstream line_stream;
+	void set_async(bool enabled);
+
+	/// <summary>
+	/// Writes all queued messages to the log file before returning.
+	/// </summary>
+	void flush();
+
+	/// <summary>
+	/// Gets the lines that were logged since the line with the specified sequence number, as far as they are still kept in memory (see 'log::history').
+	/// Each line of a multi-line message is counted as a separate line. Lines are only added once they were written to the log file (or would have been if none is open).
+	/// This does not lock, so it can be called every frame without slowing down threads that are logging.
+	/// </summary>
+	/// <param name="next_sequence">The sequence number of the first line to get, which is updated to the sequence number of the line after the last one that was returned.</param>
+	/// <param name="lines">Vector to append the lines to.</param>
+	/// <returns>The number of requested lines that are no longer kept in memory and were therefore skipped.</returns>
+	uint64_t read_history(uint64_t &next_sequence, std::vector<std::string> &lines);
+
+	/// <summary>
+	/// The current log line stream of the calling thread.
+	/// </summary>
+	extern thread_local std::ostringstream line_stream;
 
 	/// <summary>
 	/// Constructs a single log message including current time and level and writes it to the open log file.
@@ -141,5 +164,8 @@ namespace reshade::log
 			utf8::unchecked::utf16to8(message, message + wcslen(message), std::back_inserter(utf8_message));
 			return operator<<(utf8_message);
 		}
+
+	private:
+		level _level;
 	};
 }
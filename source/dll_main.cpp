@@ -973,10 +973,21 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 		}
 
 		LOG(INFO) << "Initialized.";
+
+		// Initialization succeeded, so the module stays loaded and can start writing the log in the background from now on
+		reshade::log::set_async(true);
 		break;
 	case DLL_PROCESS_DETACH:
+		// Write all queued log lines, and any that follow directly, since no background thread can run while the loader lock is held
+		reshade::log::set_async(false);
+
 		LOG(INFO) << "Exiting ...";
 
+		// Save modifications the write-behind thread did not get to yet (e.g. because the process exits before the delay elapsed)
+		// Other threads were terminated already when the process exits, possibly while holding a lock, so do not wait for those indefinitely
+		if (!ini_file::flush_cache(std::chrono::milliseconds(500)))
+			LOG(WARN) << "Failed to save all modified configuration files before exiting.";
+
 		reshade::hooks::uninstall();
 
 		// Module is now invalid, so break out of any message loops that may still have it in the call stack (see 'HookGetMessage' implementation in input.cpp)
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "effect_name_index.hpp"
+#include "reshade_api.hpp"
+#include "runtime_objects.hpp"
+
+#if RESHADE_FX
+
+std::shared_lock<std::shared_mutex> reshade::effect_name_index::lock(const std::atomic<uint32_t> &generation, const std::vector<effect> &effects, const std::vector<texture> &textures, const std::vector<technique> &techniques)
+{
+	std::shared_lock<std::shared_mutex> lock(_mutex);
+	if (_generation == generation.load())
+		return lock;
+	lock.unlock();
+
+	{
+		const std::unique_lock<std::shared_mutex> exclusive_lock(_mutex);
+
+		// Another thread may have rebuilt the index already while this one was waiting for the lock
+		const uint32_t current_generation = generation.load();
+		if (_generation != current_generation)
+		{
+			_generation = current_generation;
+			update(effects, textures, techniques);
+		}
+	}
+
+	lock.lock();
+	return lock;
+}
+
+const reshade::uniform *reshade::effect_name_index::find_uniform(const char *effect_name, const char *variable_name) const
+{
+	const tables *const index = find_tables(effect_name);
+	if (index == nullptr)
+		return nullptr;
+
+	if (const auto it = index->uniforms.find(variable_name); it != index->uniforms.end())
+		return it->second;
+	return nullptr;
+}
+const reshade::texture *reshade::effect_name_index::find_texture(const char *effect_name, const char *variable_name) const
+{
+	const tables *const index = find_tables(effect_name);
+	if (index == nullptr)
+		return nullptr;
+
+	if (const auto it = index->textures.find(variable_name); it != index->textures.end())
+		return it->second;
+	return nullptr;
+}
+const reshade::technique *reshade::effect_name_index::find_technique(const char *effect_name, const char *technique_name) const
+{
+	const tables *const index = find_tables(effect_name);
+	if (index == nullptr)
+		return nullptr;
+
+	if (const auto it = index->techniques.find(technique_name); it != index->techniques.end())
+		return it->second;
+	return nullptr;
+}
+
+void reshade::effect_name_index::update(const std::vector<effect> &effects, const std::vector<texture> &textures, const std::vector<technique> &techniques)
+{
+	_per_effect.clear();
+	_all_effects = {};
+
+	// Keep the file names alive in a separate list, since the index only holds views into them
+	_effect_names.resize(effects.size());
+	for (size_t effect_index = 0; effect_index < effects.size(); ++effect_index)
+		_effect_names[effect_index] = effects[effect_index].source_file.filename().u8string();
+
+	// Insert objects in the same order as the linear searches did before, so that the first match still wins when names are ambiguous
+	for (size_t effect_index = 0; effect_index < effects.size(); ++effect_index)
+	{
+		const std::string_view effect_name = _effect_names[effect_index];
+
+		// Only the first effect with a given file name is searched for uniform variables
+		const bool first_with_name = _per_effect.find(effect_name) == _per_effect.end();
+		tables &index = _per_effect[effect_name];
+
+		for (const uniform &variable : effects[effect_index].uniforms)
+		{
+			_all_effects.uniforms.emplace(variable.name, &variable);
+			if (first_with_name)
+				index.uniforms.emplace(variable.name, &variable);
+		}
+	}
+
+	for (const texture &variable : textures)
+	{
+		_all_effects.textures.emplace(variable.name, &variable);
+		_all_effects.textures.emplace(variable.unique_name, &variable);
+
+		for (const size_t effect_index : variable.shared)
+		{
+			tables &index = _per_effect[_effect_names[effect_index]];
+			index.textures.emplace(variable.name, &variable);
+			index.textures.emplace(variable.unique_name, &variable);
+		}
+	}
+
+	for (const technique &tech : techniques)
+	{
+		_all_effects.techniques.emplace(tech.name, &tech);
+		_per_effect[_effect_names[tech.effect_index]].techniques.emplace(tech.name, &tech);
+	}
+}
+
+const reshade::effect_name_index::tables *reshade::effect_name_index::find_tables(const char *effect_name) const
+{
+	if (effect_name == nullptr)
+		return &_all_effects;
+
+	if (const auto it = _per_effect.find(effect_name); it != _per_effect.end())
+		return &it->second;
+	return nullptr;
+}
+
+#endif
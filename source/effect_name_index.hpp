@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace reshade
+{
+	// Forward declarations to avoid excessive #include
+	struct effect;
+	struct uniform;
+	struct texture;
+	struct technique;
+
+	/// <summary>
+	/// Lookup tables from names to effect objects, used to find variables and techniques through the add-on API without scanning all effects.
+	/// The tables are rebuilt on the next lookup whenever the generation changed, which happens every time effects, textures or techniques are added, removed or reordered.
+	/// Add-ons may look up names from any thread, so the tables are only accessed while holding the lock returned by <see cref="lock"/>.
+	/// </summary>
+	class effect_name_index
+	{
+	public:
+		/// <summary>
+		/// Locks the tables for lookups, after rebuilding them from the specified objects first if they were built for a different <paramref name="generation"/>.
+		/// The rebuild upgrades the shared lock to an exclusive one, so it waits for all lookups that are still in progress and only happens once when multiple threads notice the change at the same time.
+		/// </summary>
+		std::shared_lock<std::shared_mutex> lock(const std::atomic<uint32_t> &generation, const std::vector<effect> &effects, const std::vector<texture> &textures, const std::vector<technique> &techniques);
+
+		/// <summary>
+		/// Finds a uniform variable by name in the effect with the specified file name, or in all effects if <paramref name="effect_name"/> is <see langword="nullptr"/>.
+		/// Only the first effect with a given file name is searched, and the first match wins when names are ambiguous, the same as a linear search over the effects would.
+		/// </summary>
+		const uniform *find_uniform(const char *effect_name, const char *variable_name) const;
+		/// <summary>
+		/// Finds a texture variable by name or unique name in the effect with the specified file name, or in all effects if <paramref name="effect_name"/> is <see langword="nullptr"/>.
+		/// </summary>
+		const texture *find_texture(const char *effect_name, const char *variable_name) const;
+		/// <summary>
+		/// Finds a technique by name in the effect with the specified file name, or in all effects if <paramref name="effect_name"/> is <see langword="nullptr"/>.
+		/// </summary>
+		const technique *find_technique(const char *effect_name, const char *technique_name) const;
+
+	private:
+		struct tables
+		{
+			std::unordered_map<std::string_view, const uniform *> uniforms;
+			std::unordered_map<std::string_view, const texture *> textures;
+			std::unordered_map<std::string_view, const technique *> techniques;
+		};
+
+		void update(const std::vector<effect> &effects, const std::vector<texture> &textures, const std::vector<technique> &techniques);
+		const tables *find_tables(const char *effect_name) const;
+
+		std::shared_mutex _mutex;
+		uint32_t _generation = 0;
+		std::vector<std::string> _effect_names;
+		std::unordered_map<std::string_view, tables> _per_effect;
+		tables _all_effects;
+	};
+}
@@ -75,8 +75,16 @@ static bool read_file(const std::filesystem::path &path, std::string &data)
 		return false;
 #endif
 
-	// Read file contents into memory
-	std::string file_data(static_cast<size_t>(std::filesystem::file_size(path)) + 1, '\0');
+	// Read file contents into memory (effects are loaded on worker threads, so use the non-throwing overload, since an exception there would terminate the application)
+	std::error_code ec;
+	const uintmax_t file_size = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		fclose(file);
+		return false;
+	}
+
+	std::string file_data(static_cast<size_t>(file_size) + 1, '\0');
 	const size_t eof = fread((char *)file_data.data(), 1, file_data.size() - 1, file);
 
 	// Append a new line feed to the end of the input string to avoid issues with parsing
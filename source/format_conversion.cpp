@@ -0,0 +1,1378 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "format_conversion.hpp"
+#include <cmath>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace reshade::api;
+
+namespace
+{
+	struct conversion_tables
+	{
+		conversion_tables()
+		{
+			for (uint32_t i = 0; i < 4096; ++i)
+			{
+				const float value = i / 4095.0f;
+				linear_to_srgb8[i] = static_cast<uint8_t>(std::round((value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f) * 255.0f));
+			}
+
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				const float value = i / 255.0f;
+				srgb8_to_linear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+
+				unorm8_to_float[i] = value;
+				unorm8_to_half[i] = float_to_half(value);
+				unorm8_to_unorm10[i] = static_cast<uint16_t>((i * 1023 + 127) / 255);
+			}
+		}
+
+		static uint16_t float_to_half(float value)
+		{
+			// Only needs to handle values in the range [0, 1] here
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+			if (exponent <= 0)
+				return 0;
+			// Round mantissa to nearest
+			return static_cast<uint16_t>(((exponent << 10) | ((bits >> 13) & 0x3FF)) + ((bits >> 12) & 1));
+		}
+
+		// Linear values are quantized to 12 bits, which is plenty for the 8-bit output
+		uint8_t linear_to_srgb8[4096];
+		float srgb8_to_linear[256];
+		float unorm8_to_float[256];
+		uint16_t unorm8_to_half[256];
+		uint16_t unorm8_to_unorm10[256];
+	};
+
+	const conversion_tables s_tables;
+
+	inline float half_to_float(uint16_t value)
+	{
+		// See https://fgiesen.wordpress.com/2012/03/28/half-to-float-done-quic/
+		uint32_t bits = (value & 0x7FFF) << 13;
+		const uint32_t exponent = bits & (0x7C00 << 13);
+		bits += (127 - 15) << 23;
+
+		float result;
+		if (exponent == (0x7C00 << 13))
+		{
+			bits += (128 - 16) << 23; // Infinity or NaN
+			std::memcpy(&result, &bits, sizeof(result));
+		}
+		else if (exponent == 0)
+		{
+			bits += 1 << 23; // Denormal
+			std::memcpy(&result, &bits, sizeof(result));
+			result -= 6.103515625e-05f;
+		}
+		else
+		{
+			std::memcpy(&result, &bits, sizeof(result));
+		}
+
+		return (value & 0x8000) ? -result : result;
+	}
+
+	inline uint8_t float_to_unorm8(float value)
+	{
+		// Comparisons are written so that NaN maps to zero
+		return static_cast<uint8_t>((value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f) * 255.0f + 0.5f);
+	}
+	inline uint8_t float_to_srgb8(float value)
+	{
+		return s_tables.linear_to_srgb8[static_cast<uint32_t>((value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f) * 4095.0f + 0.5f)];
+	}
+
+	inline uint8_t unorm5_to_unorm8(uint32_t value)
+	{
+		return static_cast<uint8_t>((value * 527 + 23) >> 6);
+	}
+	inline uint8_t unorm6_to_unorm8(uint32_t value)
+	{
+		return static_cast<uint8_t>((value * 259 + 33) >> 6);
+	}
+	inline uint8_t unorm10_to_unorm8(uint32_t value)
+	{
+		return static_cast<uint8_t>((value * 1021 + 2048) >> 12);
+	}
+	inline uint8_t unorm16_to_unorm8(uint32_t value)
+	{
+		return static_cast<uint8_t>((value + 128 - ((value + 128) >> 8)) >> 8);
+	}
+}
+
+uint8_t reshade::linear_to_srgb8(float value)
+{
+	return float_to_srgb8(value);
+}
+float reshade::srgb8_to_linear(uint8_t value)
+{
+	return s_tables.srgb8_to_linear[value];
+}
+
+#pragma region Row Conversion To RGBA8
+
+typedef void (*convert_row_func)(const uint8_t *src, uint8_t *dst, uint32_t width);
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+static inline __m128i load_si128(const uint8_t *src) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)); }
+static inline void store_si128(uint8_t *dst, __m128i value) { _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), value); }
+
+// Converts four 32-bit lanes with 10-bit values to 8-bit using the same rounding as 'unorm10_to_unorm8'
+static inline __m128i unorm10_to_unorm8_sse2(__m128i value)
+{
+	return _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(value, _mm_set1_epi32(1021)), _mm_set1_epi32(2048)), 12);
+}
+// Converts four 32-bit lanes with 16-bit values to 8-bit using the same rounding as 'unorm16_to_unorm8'
+static inline __m128i unorm16_to_unorm8_sse2(__m128i value)
+{
+	value = _mm_add_epi32(value, _mm_set1_epi32(128));
+	return _mm_srli_epi32(_mm_sub_epi32(value, _mm_srli_epi32(value, 8)), 8);
+}
+// Converts four 16-bit floating-point values in the lower half of the register to 32-bit floating-point
+static inline __m128 half_to_float_sse2(__m128i value)
+{
+	// See https://gist.github.com/rygorous/2144712
+	const __m128i h = _mm_unpacklo_epi16(value, _mm_setzero_si128());
+	const __m128i expmant = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+	const __m128i justsign = _mm_xor_si128(h, expmant);
+	const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	const __m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7BFF)), _mm_set1_epi32(255 << 23));
+	return _mm_or_ps(_mm_or_ps(scaled, _mm_castsi128_ps(_mm_slli_epi32(justsign, 16))), _mm_castsi128_ps(infnan));
+}
+// Converts a linear RGBA floating-point pixel to sRGB encoded RGB and linear alpha
+static inline void store_float_pixel_sse2(__m128 value, uint8_t *dst)
+{
+	// Maximum operation returns the second operand if the first is NaN, so NaN maps to zero
+	const __m128i indices = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f)), _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f)));
+
+	alignas(16) int32_t index[4];
+	_mm_store_si128(reinterpret_cast<__m128i *>(index), indices);
+
+	dst[0] = s_tables.linear_to_srgb8[index[0]];
+	dst[1] = s_tables.linear_to_srgb8[index[1]];
+	dst[2] = s_tables.linear_to_srgb8[index[2]];
+	dst[3] = static_cast<uint8_t>(index[3]);
+}
+#endif
+
+static void convert_row_r8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i v = load_si128(src + x);
+		const __m128i lo = _mm_unpacklo_epi8(v, zero);
+		const __m128i hi = _mm_unpackhi_epi8(v, zero);
+		store_si128(dst + x * 4 +  0, _mm_or_si128(_mm_unpacklo_epi16(lo, zero), alpha));
+		store_si128(dst + x * 4 + 16, _mm_or_si128(_mm_unpackhi_epi16(lo, zero), alpha));
+		store_si128(dst + x * 4 + 32, _mm_or_si128(_mm_unpacklo_epi16(hi, zero), alpha));
+		store_si128(dst + x * 4 + 48, _mm_or_si128(_mm_unpackhi_epi16(hi, zero), alpha));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x];
+		dst[x * 4 + 1] = 0;
+		dst[x * 4 + 2] = 0;
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_l8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i v = load_si128(src + x);
+		const __m128i lo = _mm_unpacklo_epi8(v, v);
+		const __m128i hi = _mm_unpackhi_epi8(v, v);
+		store_si128(dst + x * 4 +  0, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+		store_si128(dst + x * 4 + 16, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+		store_si128(dst + x * 4 + 32, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+		store_si128(dst + x * 4 + 48, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x];
+		dst[x * 4 + 1] = src[x];
+		dst[x * 4 + 2] = src[x];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_a8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i v = load_si128(src + x);
+		const __m128i lo = _mm_unpacklo_epi8(zero, v);
+		const __m128i hi = _mm_unpackhi_epi8(zero, v);
+		store_si128(dst + x * 4 +  0, _mm_unpacklo_epi16(zero, lo));
+		store_si128(dst + x * 4 + 16, _mm_unpackhi_epi16(zero, lo));
+		store_si128(dst + x * 4 + 32, _mm_unpacklo_epi16(zero, hi));
+		store_si128(dst + x * 4 + 48, _mm_unpackhi_epi16(zero, hi));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = 0;
+		dst[x * 4 + 1] = 0;
+		dst[x * 4 + 2] = 0;
+		dst[x * 4 + 3] = src[x];
+	}
+}
+static void convert_row_rg8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i v = load_si128(src + x * 2);
+		store_si128(dst + x * 4 +  0, _mm_or_si128(_mm_unpacklo_epi16(v, zero), alpha));
+		store_si128(dst + x * 4 + 16, _mm_or_si128(_mm_unpackhi_epi16(v, zero), alpha));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 2 + 0];
+		dst[x * 4 + 1] = src[x * 2 + 1];
+		dst[x * 4 + 2] = 0;
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_l8a8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i luminance_mask = _mm_set1_epi32(0xFF);
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i v = load_si128(src + x * 2);
+		for (int i = 0; i < 2; ++i)
+		{
+			const __m128i la = i == 0 ? _mm_unpacklo_epi16(v, zero) : _mm_unpackhi_epi16(v, zero);
+			const __m128i l = _mm_and_si128(la, luminance_mask);
+			// Shift alpha from the second byte into the fourth, while replicating luminance into the first three
+			store_si128(dst + x * 4 + i * 16, _mm_or_si128(_mm_or_si128(l, _mm_slli_epi32(l, 8)), _mm_slli_epi32(la, 16)));
+		}
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 2 + 0];
+		dst[x * 4 + 1] = src[x * 2 + 0];
+		dst[x * 4 + 2] = src[x * 2 + 0];
+		dst[x * 4 + 3] = src[x * 2 + 1];
+	}
+}
+static void convert_row_rgba8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	std::memcpy(dst, src, width * 4);
+}
+static void convert_row_rgbx8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; x + 4 <= width; x += 4)
+		store_si128(dst + x * 4, _mm_or_si128(load_si128(src + x * 4), alpha));
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 4 + 0];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 2];
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+template <bool force_opaque>
+static void convert_row_bgra8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i ga_mask = _mm_set1_epi32(force_opaque ? 0x0000FF00 : 0xFF00FF00);
+	const __m128i byte_mask = _mm_set1_epi32(0xFF);
+	const __m128i alpha = _mm_set1_epi32(force_opaque ? 0xFF000000 : 0);
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i v = load_si128(src + x * 4);
+		// Swap red and blue channel
+		const __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), byte_mask);
+		const __m128i b = _mm_slli_epi32(_mm_and_si128(v, byte_mask), 16);
+		store_si128(dst + x * 4, _mm_or_si128(_mm_or_si128(_mm_and_si128(v, ga_mask), alpha), _mm_or_si128(r, b)));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 4 + 2];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 0];
+		dst[x * 4 + 3] = force_opaque ? 0xFF : src[x * 4 + 3];
+	}
+}
+template <bool swap_red_blue>
+static void convert_row_rgb10a2(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi32(0x3FF);
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i v = load_si128(src + x * 4);
+		const __m128i r = unorm10_to_unorm8_sse2(_mm_and_si128(v, mask));
+		const __m128i g = unorm10_to_unorm8_sse2(_mm_and_si128(_mm_srli_epi32(v, 10), mask));
+		const __m128i b = unorm10_to_unorm8_sse2(_mm_and_si128(_mm_srli_epi32(v, 20), mask));
+		const __m128i a = _mm_madd_epi16(_mm_srli_epi32(v, 30), _mm_set1_epi32(85));
+		store_si128(dst + x * 4, _mm_or_si128(
+			_mm_or_si128(swap_red_blue ? b : r, _mm_slli_epi32(g, 8)),
+			_mm_or_si128(_mm_slli_epi32(swap_red_blue ? r : b, 16), _mm_slli_epi32(a, 24))));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		uint32_t rgba;
+		std::memcpy(&rgba, src + x * 4, 4);
+		dst[x * 4 + (swap_red_blue ? 2 : 0)] = unorm10_to_unorm8( rgba        & 0x3FF);
+		dst[x * 4 + 1]                       = unorm10_to_unorm8((rgba >> 10) & 0x3FF);
+		dst[x * 4 + (swap_red_blue ? 0 : 2)] = unorm10_to_unorm8((rgba >> 20) & 0x3FF);
+		dst[x * 4 + 3] = static_cast<uint8_t>((rgba >> 30) * 85);
+	}
+}
+template <uint32_t channels>
+static void convert_row_unorm16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	if (channels == 4)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 4 <= width; x += 4)
+		{
+			const __m128i v0 = load_si128(src + x * 8);
+			const __m128i v1 = load_si128(src + x * 8 + 16);
+			const __m128i a = _mm_packs_epi32(unorm16_to_unorm8_sse2(_mm_unpacklo_epi16(v0, zero)), unorm16_to_unorm8_sse2(_mm_unpackhi_epi16(v0, zero)));
+			const __m128i b = _mm_packs_epi32(unorm16_to_unorm8_sse2(_mm_unpacklo_epi16(v1, zero)), unorm16_to_unorm8_sse2(_mm_unpackhi_epi16(v1, zero)));
+			store_si128(dst + x * 4, _mm_packus_epi16(a, b));
+		}
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		uint16_t values[channels];
+		std::memcpy(values, src + x * channels * 2, channels * 2);
+		dst[x * 4 + 0] = unorm16_to_unorm8(values[0]);
+		dst[x * 4 + 1] = channels > 1 ? unorm16_to_unorm8(values[1]) : 0;
+		dst[x * 4 + 2] = channels > 2 ? unorm16_to_unorm8(values[2]) : 0;
+		dst[x * 4 + 3] = channels > 3 ? unorm16_to_unorm8(values[3]) : 0xFF;
+	}
+}
+static void convert_row_l16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint16_t value;
+		std::memcpy(&value, src + x * 2, 2);
+		dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = unorm16_to_unorm8(value);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_l16a16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint16_t values[2];
+		std::memcpy(values, src + x * 4, 4);
+		dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = unorm16_to_unorm8(values[0]);
+		dst[x * 4 + 3] = unorm16_to_unorm8(values[1]);
+	}
+}
+template <uint32_t channels>
+static void convert_row_float16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	if (channels == 4)
+	{
+		for (; x + 2 <= width; x += 2)
+		{
+			const __m128i v = load_si128(src + x * 8);
+			store_float_pixel_sse2(half_to_float_sse2(v), dst + x * 4);
+			store_float_pixel_sse2(half_to_float_sse2(_mm_unpackhi_epi64(v, v)), dst + x * 4 + 4);
+		}
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		uint16_t values[channels];
+		std::memcpy(values, src + x * channels * 2, channels * 2);
+		dst[x * 4 + 0] = float_to_srgb8(half_to_float(values[0]));
+		dst[x * 4 + 1] = channels > 1 ? float_to_srgb8(half_to_float(values[1])) : 0;
+		dst[x * 4 + 2] = channels > 2 ? float_to_srgb8(half_to_float(values[2])) : 0;
+		dst[x * 4 + 3] = channels > 3 ? float_to_unorm8(half_to_float(values[3])) : 0xFF;
+	}
+}
+template <uint32_t channels>
+static void convert_row_float32(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	if (channels == 4)
+	{
+		for (; x < width; ++x)
+			store_float_pixel_sse2(_mm_loadu_ps(reinterpret_cast<const float *>(src + x * 16)), dst + x * 4);
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		float values[channels];
+		std::memcpy(values, src + x * channels * 4, channels * 4);
+		dst[x * 4 + 0] = float_to_srgb8(values[0]);
+		dst[x * 4 + 1] = channels > 1 ? float_to_srgb8(values[1]) : 0;
+		dst[x * 4 + 2] = channels > 2 ? float_to_srgb8(values[2]) : 0;
+		dst[x * 4 + 3] = channels > 3 ? float_to_unorm8(values[3]) : 0xFF;
+	}
+}
+static void convert_row_r11g11b10_float(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint32_t rgb;
+		std::memcpy(&rgb, src + x * 4, 4);
+		// These small floating-point formats have the same exponent bias as half-precision floating-point, so only need to shift the mantissa into place
+		dst[x * 4 + 0] = float_to_srgb8(half_to_float(static_cast<uint16_t>(( rgb        & 0x7FF) << 4)));
+		dst[x * 4 + 1] = float_to_srgb8(half_to_float(static_cast<uint16_t>(((rgb >> 11) & 0x7FF) << 4)));
+		dst[x * 4 + 2] = float_to_srgb8(half_to_float(static_cast<uint16_t>(((rgb >> 22) & 0x3FF) << 5)));
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_r9g9b9e5(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint32_t rgbe;
+		std::memcpy(&rgbe, src + x * 4, 4);
+		const float scale = std::ldexp(1.0f, static_cast<int>(rgbe >> 27) - 15 - 9);
+		dst[x * 4 + 0] = float_to_srgb8(( rgbe        & 0x1FF) * scale);
+		dst[x * 4 + 1] = float_to_srgb8(((rgbe >>  9) & 0x1FF) * scale);
+		dst[x * 4 + 2] = float_to_srgb8(((rgbe >> 18) & 0x1FF) * scale);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_b5g6r5(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint16_t bgr;
+		std::memcpy(&bgr, src + x * 2, 2);
+		dst[x * 4 + 0] = unorm5_to_unorm8( bgr >> 11);
+		dst[x * 4 + 1] = unorm6_to_unorm8((bgr >>  5) & 0x3F);
+		dst[x * 4 + 2] = unorm5_to_unorm8( bgr        & 0x1F);
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+template <bool force_opaque>
+static void convert_row_b5g5r5a1(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint16_t bgra;
+		std::memcpy(&bgra, src + x * 2, 2);
+		dst[x * 4 + 0] = unorm5_to_unorm8((bgra >> 10) & 0x1F);
+		dst[x * 4 + 1] = unorm5_to_unorm8((bgra >>  5) & 0x1F);
+		dst[x * 4 + 2] = unorm5_to_unorm8( bgra        & 0x1F);
+		dst[x * 4 + 3] = force_opaque || (bgra >> 15) != 0 ? 0xFF : 0;
+	}
+}
+static void convert_row_b4g4r4a4(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint16_t bgra;
+		std::memcpy(&bgra, src + x * 2, 2);
+		dst[x * 4 + 0] = static_cast<uint8_t>(((bgra >>  8) & 0xF) * 17);
+		dst[x * 4 + 1] = static_cast<uint8_t>(((bgra >>  4) & 0xF) * 17);
+		dst[x * 4 + 2] = static_cast<uint8_t>(( bgra        & 0xF) * 17);
+		dst[x * 4 + 3] = static_cast<uint8_t>(( bgra >> 12       ) * 17);
+	}
+}
+
+static convert_row_func find_convert_row_to_rgba8(format format)
+{
+	switch (format)
+	{
+	case format::r8_typeless:
+	case format::r8_unorm:
+	case format::r8_uint:
+		return convert_row_r8;
+	case format::l8_unorm:
+		return convert_row_l8;
+	case format::a8_unorm:
+		return convert_row_a8;
+	case format::r8g8_typeless:
+	case format::r8g8_unorm:
+	case format::r8g8_uint:
+		return convert_row_rg8;
+	case format::l8a8_unorm:
+		return convert_row_l8a8;
+	case format::r8g8b8a8_typeless:
+	case format::r8g8b8a8_unorm:
+	case format::r8g8b8a8_unorm_srgb:
+	case format::r8g8b8a8_uint:
+		return convert_row_rgba8;
+	case format::r8g8b8x8_typeless:
+	case format::r8g8b8x8_unorm:
+	case format::r8g8b8x8_unorm_srgb:
+		return convert_row_rgbx8;
+	case format::b8g8r8a8_typeless:
+	case format::b8g8r8a8_unorm:
+	case format::b8g8r8a8_unorm_srgb:
+		return convert_row_bgra8<false>;
+	case format::b8g8r8x8_typeless:
+	case format::b8g8r8x8_unorm:
+	case format::b8g8r8x8_unorm_srgb:
+		return convert_row_bgra8<true>;
+	case format::r10g10b10a2_typeless:
+	case format::r10g10b10a2_unorm:
+	case format::r10g10b10a2_uint:
+		return convert_row_rgb10a2<false>;
+	case format::b10g10r10a2_typeless:
+	case format::b10g10r10a2_unorm:
+	case format::b10g10r10a2_uint:
+		return convert_row_rgb10a2<true>;
+	case format::r16_typeless:
+	case format::r16_unorm:
+	case format::r16_uint:
+		return convert_row_unorm16<1>;
+	case format::l16_unorm:
+		return convert_row_l16;
+	case format::r16g16_typeless:
+	case format::r16g16_unorm:
+	case format::r16g16_uint:
+		return convert_row_unorm16<2>;
+	case format::l16a16_unorm:
+		return convert_row_l16a16;
+	case format::r16g16b16a16_typeless:
+	case format::r16g16b16a16_unorm:
+	case format::r16g16b16a16_uint:
+		return convert_row_unorm16<4>;
+	case format::r16_float:
+		return convert_row_float16<1>;
+	case format::r16g16_float:
+		return convert_row_float16<2>;
+	case format::r16g16b16a16_float:
+		return convert_row_float16<4>;
+	case format::r32_float:
+		return convert_row_float32<1>;
+	case format::r32g32_float:
+		return convert_row_float32<2>;
+	case format::r32g32b32_float:
+		return convert_row_float32<3>;
+	case format::r32g32b32a32_float:
+		return convert_row_float32<4>;
+	case format::r11g11b10_float:
+		return convert_row_r11g11b10_float;
+	case format::r9g9b9e5:
+		return convert_row_r9g9b9e5;
+	case format::b5g6r5_unorm:
+		return convert_row_b5g6r5;
+	case format::b5g5r5a1_unorm:
+		return convert_row_b5g5r5a1<false>;
+	case format::b5g5r5x1_unorm:
+		return convert_row_b5g5r5a1<true>;
+	case format::b4g4r4a4_unorm:
+		return convert_row_b4g4r4a4;
+	default:
+		return nullptr;
+	}
+}
+
+#pragma endregion
+
+#pragma region Block Decompression
+
+typedef void (*decode_block_func)(const uint8_t *src, uint8_t dst[16 * 4]);
+
+namespace
+{
+	struct block_bit_reader
+	{
+		explicit block_bit_reader(const uint8_t *block)
+		{
+			std::memcpy(&low, block, 8);
+			std::memcpy(&high, block + 8, 8);
+		}
+
+		uint32_t read(uint32_t num_bits)
+		{
+			assert(num_bits <= 16);
+
+			uint64_t value;
+			if (position >= 64)
+				value = high >> (position - 64);
+			else if (position + num_bits <= 64)
+				value = low >> position;
+			else
+				value = (low >> position) | (high << (64 - position));
+
+			position += num_bits;
+			return static_cast<uint32_t>(value) & ((1u << num_bits) - 1);
+		}
+
+		uint64_t low, high;
+		uint32_t position = 0;
+	};
+}
+
+// See https://docs.microsoft.com/windows/win32/direct3d11/bc7-format-mode-reference
+static const uint16_t s_bc7_partitions2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+static const uint8_t s_bc7_partitions3[64][16] = {
+	{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+	{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+	{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+	{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+	{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+	{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+	{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+	{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+	{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+	{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+	{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+	{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+	{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+	{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+	{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+	{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+};
+static const uint8_t s_bc7_anchors2[64] = {
+	15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+};
+static const uint8_t s_bc7_anchors3[2][64] = {
+	{
+		 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+		 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+	},
+	{
+		15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+		15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+	},
+};
+static const uint8_t s_bc7_weights2[4] = { 0, 21, 43, 64 };
+static const uint8_t s_bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t s_bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline const uint8_t *bc7_weights(uint32_t index_bits)
+{
+	return index_bits == 2 ? s_bc7_weights2 : index_bits == 3 ? s_bc7_weights3 : s_bc7_weights4;
+}
+static inline uint32_t bc7_subset(uint32_t num_subsets, uint32_t partition, uint32_t pixel)
+{
+	return num_subsets == 1 ? 0 : num_subsets == 2 ? (s_bc7_partitions2[partition] >> pixel) & 1 : s_bc7_partitions3[partition][pixel];
+}
+static inline bool bc7_is_anchor(uint32_t num_subsets, uint32_t partition, uint32_t pixel)
+{
+	return pixel == 0 ||
+		(num_subsets == 2 && pixel == s_bc7_anchors2[partition]) ||
+		(num_subsets == 3 && (pixel == s_bc7_anchors3[0][partition] || pixel == s_bc7_anchors3[1][partition]));
+}
+
+static void decode_bc1_colors(const uint8_t *src, uint8_t colors[4][4], bool allow_transparent)
+{
+	const uint16_t color_0 = static_cast<uint16_t>(src[0] | (src[1] << 8));
+	const uint16_t color_1 = static_cast<uint16_t>(src[2] | (src[3] << 8));
+
+	colors[0][0] = unorm5_to_unorm8(color_0 >> 11);
+	colors[0][1] = unorm6_to_unorm8((color_0 >> 5) & 0x3F);
+	colors[0][2] = unorm5_to_unorm8(color_0 & 0x1F);
+	colors[1][0] = unorm5_to_unorm8(color_1 >> 11);
+	colors[1][1] = unorm6_to_unorm8((color_1 >> 5) & 0x3F);
+	colors[1][2] = unorm5_to_unorm8(color_1 & 0x1F);
+	colors[0][3] = colors[1][3] = colors[2][3] = colors[3][3] = 0xFF;
+
+	if (color_0 > color_1 || !allow_transparent)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			colors[2][c] = static_cast<uint8_t>((2 * colors[0][c] + colors[1][c]) / 3);
+			colors[3][c] = static_cast<uint8_t>((colors[0][c] + 2 * colors[1][c]) / 3);
+		}
+	}
+	else
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			colors[2][c] = static_cast<uint8_t>((colors[0][c] + colors[1][c]) / 2);
+			colors[3][c] = 0;
+		}
+		colors[3][3] = 0;
+	}
+}
+static void decode_bc1_color_block(const uint8_t *src, uint8_t dst[16 * 4], bool allow_transparent)
+{
+	uint8_t colors[4][4];
+	decode_bc1_colors(src, colors, allow_transparent);
+
+	const uint32_t indices = src[4] | (src[5] << 8) | (src[6] << 16) | (static_cast<uint32_t>(src[7]) << 24);
+	for (uint32_t i = 0; i < 16; ++i)
+		std::memcpy(dst + i * 4, colors[(indices >> (2 * i)) & 0x3], 4);
+}
+template <bool is_signed>
+static void decode_bc4_channel(const uint8_t *src, uint8_t *dst, uint32_t dst_stride)
+{
+	int32_t values[8];
+	if (is_signed)
+	{
+		values[0] = std::max(static_cast<int8_t>(src[0]), static_cast<int8_t>(-127));
+		values[1] = std::max(static_cast<int8_t>(src[1]), static_cast<int8_t>(-127));
+	}
+	else
+	{
+		values[0] = src[0];
+		values[1] = src[1];
+	}
+
+	if (values[0] > values[1])
+	{
+		for (int i = 1; i < 7; ++i)
+			values[1 + i] = ((7 - i) * values[0] + i * values[1]) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			values[1 + i] = ((5 - i) * values[0] + i * values[1]) / 5;
+		values[6] = is_signed ? -127 : 0;
+		values[7] = is_signed ? 127 : 255;
+	}
+
+	if (is_signed)
+		// Remap signed range [-127, 127] to [0, 255]
+		for (int32_t &value : values)
+			value = ((value + 127) * 255 + 127) / 254;
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i)
+		indices |= static_cast<uint64_t>(src[2 + i]) << (8 * i);
+	for (uint32_t i = 0; i < 16; ++i)
+		dst[i * dst_stride] = static_cast<uint8_t>(values[(indices >> (3 * i)) & 0x7]);
+}
+
+static void decode_bc1_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	decode_bc1_color_block(src, dst, true);
+}
+static void decode_bc2_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	decode_bc1_color_block(src + 8, dst, false);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		dst[i * 4 + 3] = static_cast<uint8_t>(((src[i / 2] >> (4 * (i % 2))) & 0xF) * 17);
+}
+static void decode_bc3_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	decode_bc1_color_block(src + 8, dst, false);
+	decode_bc4_channel<false>(src, dst + 3, 4);
+}
+template <bool is_signed>
+static void decode_bc4_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	decode_bc4_channel<is_signed>(src, dst, 4);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		dst[i * 4 + 1] = dst[i * 4 + 0];
+		dst[i * 4 + 2] = dst[i * 4 + 0];
+		dst[i * 4 + 3] = 0xFF;
+	}
+}
+template <bool is_signed>
+static void decode_bc5_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	decode_bc4_channel<is_signed>(src + 0, dst + 0, 4);
+	decode_bc4_channel<is_signed>(src + 8, dst + 1, 4);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		dst[i * 4 + 2] = 0;
+		dst[i * 4 + 3] = 0xFF;
+	}
+}
+
+// See https://docs.microsoft.com/windows/win32/direct3d11/bc6h-format
+namespace
+{
+	enum bc6h_field : uint8_t { rw, gw, bw, rx, gx, bx, ry, gy, by, rz, gz, bz, d };
+
+	struct bc6h_bits
+	{
+		bc6h_field field;
+		uint8_t first_bit;
+		uint8_t num_bits;
+	};
+
+	struct bc6h_mode
+	{
+		bool transformed;
+		uint8_t endpoint_bits;
+		uint8_t delta_bits[3];
+		// Order in which the header bits of this mode are stored after the mode bits, terminated by an entry with zero bits
+		bc6h_bits layout[28];
+	};
+}
+
+static const bc6h_mode s_bc6h_modes[14] = {
+	{ true, 10, { 5, 5, 5 }, { { gy, 4, 1 }, { by, 4, 1 }, { bz, 4, 1 }, { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 5 }, { gz, 4, 1 }, { gy, 0, 4 }, { gx, 0, 5 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 5 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 5 }, { bz, 2, 1 }, { rz, 0, 5 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true,  7, { 6, 6, 6 }, { { gy, 5, 1 }, { gz, 4, 1 }, { gz, 5, 1 }, { rw, 0, 7 }, { bz, 0, 1 }, { bz, 1, 1 }, { by, 4, 1 }, { gw, 0, 7 }, { by, 5, 1 }, { bz, 2, 1 }, { gy, 4, 1 }, { bw, 0, 7 }, { bz, 3, 1 }, { bz, 5, 1 }, { bz, 4, 1 }, { rx, 0, 6 }, { gy, 0, 4 }, { gx, 0, 6 }, { gz, 0, 4 }, { bx, 0, 6 }, { by, 0, 4 }, { ry, 0, 6 }, { rz, 0, 6 }, { d, 0, 5 } } },
+	{ true, 11, { 5, 4, 4 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 5 }, { rw, 10, 1 }, { gy, 0, 4 }, { gx, 0, 4 }, { gw, 10, 1 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 4 }, { bw, 10, 1 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 5 }, { bz, 2, 1 }, { rz, 0, 5 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true, 11, { 4, 5, 4 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 4 }, { rw, 10, 1 }, { gz, 4, 1 }, { gy, 0, 4 }, { gx, 0, 5 }, { gw, 10, 1 }, { gz, 0, 4 }, { bx, 0, 4 }, { bw, 10, 1 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 4 }, { bz, 0, 1 }, { bz, 2, 1 }, { rz, 0, 4 }, { gy, 4, 1 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true, 11, { 4, 4, 5 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 4 }, { rw, 10, 1 }, { by, 4, 1 }, { gy, 0, 4 }, { gx, 0, 4 }, { gw, 10, 1 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 5 }, { bw, 10, 1 }, { by, 0, 4 }, { ry, 0, 4 }, { bz, 1, 1 }, { bz, 2, 1 }, { rz, 0, 4 }, { bz, 4, 1 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true,  9, { 5, 5, 5 }, { { rw, 0, 9 }, { by, 4, 1 }, { gw, 0, 9 }, { gy, 4, 1 }, { bw, 0, 9 }, { bz, 4, 1 }, { rx, 0, 5 }, { gz, 4, 1 }, { gy, 0, 4 }, { gx, 0, 5 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 5 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 5 }, { bz, 2, 1 }, { rz, 0, 5 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true,  8, { 6, 5, 5 }, { { rw, 0, 8 }, { gz, 4, 1 }, { by, 4, 1 }, { gw, 0, 8 }, { bz, 2, 1 }, { gy, 4, 1 }, { bw, 0, 8 }, { bz, 3, 1 }, { bz, 4, 1 }, { rx, 0, 6 }, { gy, 0, 4 }, { gx, 0, 5 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 5 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 6 }, { rz, 0, 6 }, { d, 0, 5 } } },
+	{ true,  8, { 5, 6, 5 }, { { rw, 0, 8 }, { bz, 0, 1 }, { by, 4, 1 }, { gw, 0, 8 }, { gy, 5, 1 }, { gy, 4, 1 }, { bw, 0, 8 }, { gz, 5, 1 }, { bz, 4, 1 }, { rx, 0, 5 }, { gz, 4, 1 }, { gy, 0, 4 }, { gx, 0, 6 }, { gz, 0, 4 }, { bx, 0, 5 }, { bz, 1, 1 }, { by, 0, 4 }, { ry, 0, 5 }, { bz, 2, 1 }, { rz, 0, 5 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ true,  8, { 5, 5, 6 }, { { rw, 0, 8 }, { bz, 1, 1 }, { by, 4, 1 }, { gw, 0, 8 }, { by, 5, 1 }, { gy, 4, 1 }, { bw, 0, 8 }, { bz, 5, 1 }, { bz, 4, 1 }, { rx, 0, 5 }, { gz, 4, 1 }, { gy, 0, 4 }, { gx, 0, 5 }, { bz, 0, 1 }, { gz, 0, 4 }, { bx, 0, 6 }, { by, 0, 4 }, { ry, 0, 5 }, { bz, 2, 1 }, { rz, 0, 5 }, { bz, 3, 1 }, { d, 0, 5 } } },
+	{ false, 6, { 6, 6, 6 }, { { rw, 0, 6 }, { gz, 4, 1 }, { bz, 0, 1 }, { bz, 1, 1 }, { by, 4, 1 }, { gw, 0, 6 }, { gy, 5, 1 }, { by, 5, 1 }, { bz, 2, 1 }, { gy, 4, 1 }, { bw, 0, 6 }, { gz, 5, 1 }, { bz, 3, 1 }, { bz, 5, 1 }, { bz, 4, 1 }, { rx, 0, 6 }, { gy, 0, 4 }, { gx, 0, 6 }, { gz, 0, 4 }, { bx, 0, 6 }, { by, 0, 4 }, { ry, 0, 6 }, { rz, 0, 6 }, { d, 0, 5 } } },
+	{ false, 10, { 10, 10, 10 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 10 }, { gx, 0, 10 }, { bx, 0, 10 } } },
+	{ true, 11, { 9, 9, 9 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 9 }, { rw, 10, 1 }, { gx, 0, 9 }, { gw, 10, 1 }, { bx, 0, 9 }, { bw, 10, 1 } } },
+	{ true, 12, { 8, 8, 8 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 8 }, { rw, 11, 1 }, { rw, 10, 1 }, { gx, 0, 8 }, { gw, 11, 1 }, { gw, 10, 1 }, { bx, 0, 8 }, { bw, 11, 1 }, { bw, 10, 1 } } },
+	{ true, 16, { 4, 4, 4 }, { { rw, 0, 10 }, { gw, 0, 10 }, { bw, 0, 10 }, { rx, 0, 4 }, { rw, 15, 1 }, { rw, 14, 1 }, { rw, 13, 1 }, { rw, 12, 1 }, { rw, 11, 1 }, { rw, 10, 1 }, { gx, 0, 4 }, { gw, 15, 1 }, { gw, 14, 1 }, { gw, 13, 1 }, { gw, 12, 1 }, { gw, 11, 1 }, { gw, 10, 1 }, { bx, 0, 4 }, { bw, 15, 1 }, { bw, 14, 1 }, { bw, 13, 1 }, { bw, 12, 1 }, { bw, 11, 1 }, { bw, 10, 1 } } },
+};
+
+static inline int32_t sign_extend(int32_t value, uint32_t bits)
+{
+	const int32_t sign_bit = 1 << (bits - 1);
+	return ((value & ((1 << bits) - 1)) ^ sign_bit) - sign_bit;
+}
+
+static void decode_bc6h_block_half(const uint8_t *src, bool is_signed, uint16_t dst[16][3])
+{
+	block_bit_reader bits(src);
+
+	uint32_t mode_index = bits.read(2);
+	if (mode_index > 1)
+	{
+		mode_index = (bits.read(3) << 2) | mode_index;
+		// Mode bits are 0bxxx10 for two subset modes and 0bxxx11 for one subset modes
+		mode_index = (mode_index & 0x3) == 0x2 ? 2 + (mode_index >> 2) : 10 + (mode_index >> 2);
+	}
+
+	if (mode_index >= 14)
+	{
+		// Reserved modes decode to zero
+		std::memset(dst, 0, sizeof(uint16_t) * 16 * 3);
+		return;
+	}
+
+	const bc6h_mode &mode = s_bc6h_modes[mode_index];
+	const uint32_t num_subsets = mode_index < 10 ? 2 : 1;
+
+	int32_t fields[13] = {};
+	for (const bc6h_bits *entry = mode.layout; entry->num_bits != 0 && entry < mode.layout + 28; ++entry)
+		fields[entry->field] |= bits.read(entry->num_bits) << entry->first_bit;
+
+	const uint32_t partition = fields[d];
+
+	// Endpoints are stored as subset 0 (w, x) and subset 1 (y, z)
+	int32_t endpoints[2][2][3];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		int32_t values[4] = { fields[rw + c], fields[rx + c], fields[ry + c], fields[rz + c] };
+
+		if (is_signed)
+			values[0] = sign_extend(values[0], mode.endpoint_bits);
+
+		for (uint32_t i = 1; i < num_subsets * 2; ++i)
+		{
+			if (mode.transformed || is_signed)
+				values[i] = sign_extend(values[i], mode.delta_bits[c]);
+
+			if (mode.transformed)
+			{
+				values[i] = (values[0] + values[i]) & ((1 << mode.endpoint_bits) - 1);
+				if (is_signed)
+					values[i] = sign_extend(values[i], mode.endpoint_bits);
+			}
+		}
+
+		// Unquantize endpoints to 16 bits
+		for (uint32_t i = 0; i < num_subsets * 2; ++i)
+		{
+			int32_t value = values[i];
+
+			if (!is_signed)
+			{
+				if (mode.endpoint_bits >= 15)
+					;
+				else if (value == 0)
+					value = 0;
+				else if (value == (1 << mode.endpoint_bits) - 1)
+					value = 0xFFFF;
+				else
+					value = ((value << 16) + 0x8000) >> mode.endpoint_bits;
+			}
+			else
+			{
+				if (mode.endpoint_bits < 16)
+				{
+					const bool negative = value < 0;
+					if (negative)
+						value = -value;
+
+					if (value == 0)
+						value = 0;
+					else if (value >= (1 << (mode.endpoint_bits - 1)) - 1)
+						value = 0x7FFF;
+					else
+						value = ((value << 15) + 0x4000) >> (mode.endpoint_bits - 1);
+
+					if (negative)
+						value = -value;
+				}
+			}
+
+			endpoints[i / 2][i % 2][c] = value;
+		}
+	}
+
+	const uint32_t index_bits = num_subsets == 2 ? 3 : 4;
+	const uint8_t *const weights = bc7_weights(index_bits);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t subset = bc7_subset(num_subsets, partition, i);
+		const uint32_t index = bits.read(index_bits - (bc7_is_anchor(num_subsets, partition, i) ? 1 : 0));
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			const int32_t value = ((64 - weights[index]) * endpoints[subset][0][c] + weights[index] * endpoints[subset][1][c] + 32) >> 6;
+
+			// Scale interpolated value to the half-precision floating-point bit pattern
+			if (!is_signed)
+				dst[i][c] = static_cast<uint16_t>((value * 31) >> 6);
+			else
+				dst[i][c] = static_cast<uint16_t>(value < 0 ? 0x8000 | ((-value * 31) >> 5) : (value * 31) >> 5);
+		}
+	}
+}
+template <bool is_signed>
+static void decode_bc6h_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	uint16_t values[16][3];
+	decode_bc6h_block_half(src, is_signed, values);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		dst[i * 4 + 0] = float_to_srgb8(half_to_float(values[i][0]));
+		dst[i * 4 + 1] = float_to_srgb8(half_to_float(values[i][1]));
+		dst[i * 4 + 2] = float_to_srgb8(half_to_float(values[i][2]));
+		dst[i * 4 + 3] = 0xFF;
+	}
+}
+
+// See https://docs.microsoft.com/windows/win32/direct3d11/bc7-format
+static void decode_bc7_block(const uint8_t *src, uint8_t dst[16 * 4])
+{
+	static const struct bc7_mode
+	{
+		uint8_t num_subsets;
+		uint8_t partition_bits;
+		uint8_t rotation_bits;
+		uint8_t index_selection_bits;
+		uint8_t color_bits;
+		uint8_t alpha_bits;
+		uint8_t endpoint_pbits;
+		uint8_t shared_pbits;
+		uint8_t index_bits;
+		uint8_t index_bits2;
+	} s_bc7_modes[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+	};
+
+	uint32_t mode_index = 0;
+	while (mode_index < 8 && (src[0] & (1 << mode_index)) == 0)
+		++mode_index;
+
+	if (mode_index == 8)
+	{
+		// Reserved mode decodes to zero
+		std::memset(dst, 0, 16 * 4);
+		return;
+	}
+
+	const bc7_mode &mode = s_bc7_modes[mode_index];
+
+	block_bit_reader bits(src);
+	bits.position = mode_index + 1;
+
+	const uint32_t partition = bits.read(mode.partition_bits);
+	const uint32_t rotation = bits.read(mode.rotation_bits);
+	const uint32_t index_selection = bits.read(mode.index_selection_bits);
+
+	uint32_t endpoints[3][2][4];
+	for (uint32_t c = 0; c < 3; ++c)
+		for (uint32_t s = 0; s < mode.num_subsets; ++s)
+			for (uint32_t e = 0; e < 2; ++e)
+				endpoints[s][e][c] = bits.read(mode.color_bits);
+	for (uint32_t s = 0; s < mode.num_subsets; ++s)
+		for (uint32_t e = 0; e < 2; ++e)
+			endpoints[s][e][3] = mode.alpha_bits != 0 ? bits.read(mode.alpha_bits) : 0xFF;
+
+	uint32_t color_bits = mode.color_bits;
+	uint32_t alpha_bits = mode.alpha_bits;
+	if (mode.endpoint_pbits || mode.shared_pbits)
+	{
+		uint32_t pbits[3][2];
+		for (uint32_t s = 0; s < mode.num_subsets; ++s)
+		{
+			if (mode.endpoint_pbits)
+				pbits[s][0] = bits.read(1), pbits[s][1] = bits.read(1);
+			else
+				pbits[s][0] = pbits[s][1] = bits.read(1);
+		}
+
+		for (uint32_t s = 0; s < mode.num_subsets; ++s)
+			for (uint32_t e = 0; e < 2; ++e)
+				for (uint32_t c = 0; c < (alpha_bits != 0 ? 4u : 3u); ++c)
+					endpoints[s][e][c] = (endpoints[s][e][c] << 1) | pbits[s][e];
+
+		color_bits += 1;
+		if (alpha_bits != 0)
+			alpha_bits += 1;
+	}
+
+	// Expand endpoints to 8 bits by replicating the most significant bits into the lower ones
+	for (uint32_t s = 0; s < mode.num_subsets; ++s)
+	{
+		for (uint32_t e = 0; e < 2; ++e)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				endpoints[s][e][c] = ((endpoints[s][e][c] << (8 - color_bits)) | (endpoints[s][e][c] >> (2 * color_bits - 8))) & 0xFF;
+			if (alpha_bits != 0)
+				endpoints[s][e][3] = ((endpoints[s][e][3] << (8 - alpha_bits)) | (endpoints[s][e][3] >> (2 * alpha_bits - 8))) & 0xFF;
+		}
+	}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; ++i)
+		indices[i] = bits.read(mode.index_bits - (bc7_is_anchor(mode.num_subsets, partition, i) ? 1 : 0));
+	uint32_t indices2[16] = {};
+	if (mode.index_bits2 != 0)
+		for (uint32_t i = 0; i < 16; ++i)
+			indices2[i] = bits.read(mode.index_bits2 - (i == 0 ? 1 : 0));
+
+	const uint8_t *const weights = bc7_weights(mode.index_bits);
+	const uint8_t *const weights2 = bc7_weights(mode.index_bits2);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t subset = bc7_subset(mode.num_subsets, partition, i);
+
+		uint32_t color_weight = weights[indices[i]];
+		uint32_t alpha_weight = color_weight;
+		if (mode.index_bits2 != 0)
+		{
+			if (index_selection)
+				color_weight = weights2[indices2[i]];
+			else
+				alpha_weight = weights2[indices2[i]];
+		}
+
+		uint8_t *const pixel = dst + i * 4;
+		for (uint32_t c = 0; c < 3; ++c)
+			pixel[c] = static_cast<uint8_t>(((64 - color_weight) * endpoints[subset][0][c] + color_weight * endpoints[subset][1][c] + 32) >> 6);
+		pixel[3] = static_cast<uint8_t>(((64 - alpha_weight) * endpoints[subset][0][3] + alpha_weight * endpoints[subset][1][3] + 32) >> 6);
+
+		if (rotation != 0)
+			std::swap(pixel[3], pixel[rotation - 1]);
+	}
+}
+
+static decode_block_func find_decode_block(format format)
+{
+	switch (format)
+	{
+	case format::bc1_typeless:
+	case format::bc1_unorm:
+	case format::bc1_unorm_srgb:
+		return decode_bc1_block;
+	case format::bc2_typeless:
+	case format::bc2_unorm:
+	case format::bc2_unorm_srgb:
+		return decode_bc2_block;
+	case format::bc3_typeless:
+	case format::bc3_unorm:
+	case format::bc3_unorm_srgb:
+		return decode_bc3_block;
+	case format::bc4_typeless:
+	case format::bc4_unorm:
+		return decode_bc4_block<false>;
+	case format::bc4_snorm:
+		return decode_bc4_block<true>;
+	case format::bc5_typeless:
+	case format::bc5_unorm:
+		return decode_bc5_block<false>;
+	case format::bc5_snorm:
+		return decode_bc5_block<true>;
+	case format::bc6h_typeless:
+	case format::bc6h_ufloat:
+		return decode_bc6h_block<false>;
+	case format::bc6h_sfloat:
+		return decode_bc6h_block<true>;
+	case format::bc7_typeless:
+	case format::bc7_unorm:
+	case format::bc7_unorm_srgb:
+		return decode_bc7_block;
+	default:
+		return nullptr;
+	}
+}
+
+#pragma endregion
+
+#pragma region Row Conversion From RGBA8
+
+static void convert_row_rgba8_to_r8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i a = _mm_packs_epi32(_mm_and_si128(load_si128(src + x * 4 +  0), mask), _mm_and_si128(load_si128(src + x * 4 + 16), mask));
+		const __m128i b = _mm_packs_epi32(_mm_and_si128(load_si128(src + x * 4 + 32), mask), _mm_and_si128(load_si128(src + x * 4 + 48), mask));
+		store_si128(dst + x, _mm_packus_epi16(a, b));
+	}
+#endif
+	for (; x < width; ++x)
+		dst[x] = src[x * 4];
+}
+static void convert_row_rgba8_to_rg8(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	for (; x + 8 <= width; x += 8)
+	{
+		// Sign extend the lower 16 bits, so that signed saturation during packing keeps them intact
+		const __m128i a = _mm_srai_epi32(_mm_slli_epi32(load_si128(src + x * 4 +  0), 16), 16);
+		const __m128i b = _mm_srai_epi32(_mm_slli_epi32(load_si128(src + x * 4 + 16), 16), 16);
+		store_si128(dst + x * 2, _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		dst[x * 2 + 0] = src[x * 4 + 0];
+		dst[x * 2 + 1] = src[x * 4 + 1];
+	}
+}
+template <uint32_t channels>
+static void convert_row_rgba8_to_unorm16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	if (channels == 4)
+	{
+		for (; x + 4 <= width; x += 4)
+		{
+			// Interleaving a byte with itself is the same as multiplying by 257
+			const __m128i v = load_si128(src + x * 4);
+			store_si128(dst + x * 8 +  0, _mm_unpacklo_epi8(v, v));
+			store_si128(dst + x * 8 + 16, _mm_unpackhi_epi8(v, v));
+		}
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			dst[(x * channels + c) * 2 + 0] = src[x * 4 + c];
+			dst[(x * channels + c) * 2 + 1] = src[x * 4 + c];
+		}
+	}
+}
+template <uint32_t channels>
+static void convert_row_rgba8_to_float16(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint16_t *const dst_half = reinterpret_cast<uint16_t *>(dst);
+	for (uint32_t x = 0; x < width; ++x)
+		for (uint32_t c = 0; c < channels; ++c)
+			dst_half[x * channels + c] = s_tables.unorm8_to_half[src[x * 4 + c]];
+}
+template <uint32_t channels>
+static void convert_row_rgba8_to_float32(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	float *const dst_float = reinterpret_cast<float *>(dst);
+	for (uint32_t x = 0; x < width; ++x)
+		for (uint32_t c = 0; c < channels; ++c)
+			dst_float[x * channels + c] = s_tables.unorm8_to_float[src[x * 4 + c]];
+}
+template <bool swap_red_blue>
+static void convert_row_rgba8_to_rgb10a2(const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		const uint32_t r = s_tables.unorm8_to_unorm10[src[x * 4 + (swap_red_blue ? 2 : 0)]];
+		const uint32_t g = s_tables.unorm8_to_unorm10[src[x * 4 + 1]];
+		const uint32_t b = s_tables.unorm8_to_unorm10[src[x * 4 + (swap_red_blue ? 0 : 2)]];
+		const uint32_t a = (src[x * 4 + 3] * 3 + 127) / 255;
+		const uint32_t rgba = r | (g << 10) | (b << 20) | (a << 30);
+		std::memcpy(dst + x * 4, &rgba, 4);
+	}
+}
+
+static convert_row_func find_convert_row_from_rgba8(format format)
+{
+	switch (format)
+	{
+	case format::r8_typeless:
+	case format::r8_unorm:
+		return convert_row_rgba8_to_r8;
+	case format::r8g8_typeless:
+	case format::r8g8_unorm:
+		return convert_row_rgba8_to_rg8;
+	case format::r8g8b8a8_typeless:
+	case format::r8g8b8a8_unorm:
+	case format::r8g8b8a8_unorm_srgb:
+	case format::r8g8b8x8_typeless:
+	case format::r8g8b8x8_unorm:
+	case format::r8g8b8x8_unorm_srgb:
+		return convert_row_rgba8;
+	case format::b8g8r8a8_typeless:
+	case format::b8g8r8a8_unorm:
+	case format::b8g8r8a8_unorm_srgb:
+	case format::b8g8r8x8_typeless:
+	case format::b8g8r8x8_unorm:
+	case format::b8g8r8x8_unorm_srgb:
+		// Swapping red and blue channel is symmetric
+		return convert_row_bgra8<false>;
+	case format::r10g10b10a2_typeless:
+	case format::r10g10b10a2_unorm:
+		return convert_row_rgba8_to_rgb10a2<false>;
+	case format::b10g10r10a2_typeless:
+	case format::b10g10r10a2_unorm:
+		return convert_row_rgba8_to_rgb10a2<true>;
+	case format::r16_typeless:
+	case format::r16_unorm:
+		return convert_row_rgba8_to_unorm16<1>;
+	case format::r16g16_typeless:
+	case format::r16g16_unorm:
+		return convert_row_rgba8_to_unorm16<2>;
+	case format::r16g16b16a16_typeless:
+	case format::r16g16b16a16_unorm:
+		return convert_row_rgba8_to_unorm16<4>;
+	case format::r16_float:
+		return convert_row_rgba8_to_float16<1>;
+	case format::r16g16_float:
+		return convert_row_rgba8_to_float16<2>;
+	case format::r16g16b16a16_float:
+		return convert_row_rgba8_to_float16<4>;
+	case format::r32_float:
+		return convert_row_rgba8_to_float32<1>;
+	case format::r32g32_float:
+		return convert_row_rgba8_to_float32<2>;
+	case format::r32g32b32_float:
+		return convert_row_rgba8_to_float32<3>;
+	case format::r32g32b32a32_float:
+		return convert_row_rgba8_to_float32<4>;
+	default:
+		return nullptr;
+	}
+}
+
+#pragma endregion
+
+bool reshade::is_convertible_to_rgba8(format format)
+{
+	return find_convert_row_to_rgba8(format) != nullptr || find_decode_block(format) != nullptr;
+}
+bool reshade::is_convertible_from_rgba8(format format)
+{
+	return find_convert_row_from_rgba8(format) != nullptr;
+}
+
+bool reshade::convert_to_rgba8(format format, uint32_t width, uint32_t height, const void *src, uint32_t src_row_pitch, uint8_t *dst, uint32_t dst_row_pitch)
+{
+	if (dst_row_pitch == 0)
+		dst_row_pitch = width * 4;
+
+	const uint8_t *src_row = static_cast<const uint8_t *>(src);
+
+	if (const convert_row_func convert_row = find_convert_row_to_rgba8(format))
+	{
+		for (uint32_t y = 0; y < height; ++y, src_row += src_row_pitch, dst += dst_row_pitch)
+			convert_row(src_row, dst, width);
+		return true;
+	}
+
+	if (const decode_block_func decode_block = find_decode_block(format))
+	{
+		const uint32_t block_size = format_row_pitch(format, 1);
+
+		for (uint32_t block_y = 0; block_y < height; block_y += 4, src_row += src_row_pitch)
+		{
+			const uint32_t rows = std::min(height - block_y, 4u);
+
+			for (uint32_t block_x = 0; block_x < width; block_x += 4)
+			{
+				uint8_t pixels[16 * 4];
+				decode_block(src_row + (block_x / 4) * block_size, pixels);
+
+				// Clip block at the image edges, in case the dimensions are not a multiple of the block size
+				const uint32_t columns = std::min(width - block_x, 4u);
+				for (uint32_t y = 0; y < rows; ++y)
+					std::memcpy(dst + (block_y + y) * static_cast<size_t>(dst_row_pitch) + block_x * 4, pixels + y * 16, columns * 4);
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+bool reshade::convert_from_rgba8(format format, uint32_t width, uint32_t height, const uint8_t *src, uint32_t src_row_pitch, void *dst, uint32_t dst_row_pitch)
+{
+	const convert_row_func convert_row = find_convert_row_from_rgba8(format);
+	if (convert_row == nullptr)
+		return false;
+
+	if (src_row_pitch == 0)
+		src_row_pitch = width * 4;
+
+	uint8_t *dst_row = static_cast<uint8_t *>(dst);
+	for (uint32_t y = 0; y < height; ++y, src += src_row_pitch, dst_row += dst_row_pitch)
+		convert_row(src, dst_row, width);
+	return true;
+}
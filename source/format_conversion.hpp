@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "reshade_api_format.hpp"
+
+namespace reshade
+{
+	/// <summary>
+	/// Converts a linear color value in the range [0, 1] to an 8-bit sRGB encoded value.
+	/// </summary>
+	uint8_t linear_to_srgb8(float value);
+	/// <summary>
+	/// Converts an 8-bit sRGB encoded value to a linear color value in the range [0, 1].
+	/// </summary>
+	float srgb8_to_linear(uint8_t value);
+
+	/// <summary>
+	/// Checks whether image data of the specified <paramref name="format"/> can be converted with <see cref="convert_to_rgba8"/>.
+	/// </summary>
+	bool is_convertible_to_rgba8(api::format format);
+	/// <summary>
+	/// Checks whether image data can be converted to the specified <paramref name="format"/> with <see cref="convert_from_rgba8"/>.
+	/// </summary>
+	bool is_convertible_from_rgba8(api::format format);
+
+	/// <summary>
+	/// Converts image data of the specified <paramref name="format"/> to 32 bits-per-pixel RGBA.
+	/// Floating-point formats are assumed to contain linear color values and are sRGB encoded during conversion, all other formats are copied as is.
+	/// </summary>
+	/// <param name="format">Format of the source image data.</param>
+	/// <param name="width">Width of the image data.</param>
+	/// <param name="height">Height of the image data.</param>
+	/// <param name="src">Pointer to the source image data.</param>
+	/// <param name="src_row_pitch">Number of bytes between rows of the source image data (or rows of blocks for block compressed formats).</param>
+	/// <param name="dst">Pointer to the destination buffer.</param>
+	/// <param name="dst_row_pitch">Number of bytes between rows of the destination buffer, or zero if rows are tightly packed.</param>
+	/// <returns><see langword="true"/> if the format is supported and the data was converted, <see langword="false"/> otherwise.</returns>
+	bool convert_to_rgba8(api::format format, uint32_t width, uint32_t height, const void *src, uint32_t src_row_pitch, uint8_t *dst, uint32_t dst_row_pitch = 0);
+	/// <summary>
+	/// Converts 32 bits-per-pixel RGBA image data to the specified <paramref name="format"/>.
+	/// Values are normalized to the range [0, 1] for floating-point formats, without applying any color space conversion.
+	/// </summary>
+	/// <param name="format">Format of the destination image data.</param>
+	/// <param name="width">Width of the image data.</param>
+	/// <param name="height">Height of the image data.</param>
+	/// <param name="src">Pointer to the source image data.</param>
+	/// <param name="src_row_pitch">Number of bytes between rows of the source image data, or zero if rows are tightly packed.</param>
+	/// <param name="dst">Pointer to the destination buffer.</param>
+	/// <param name="dst_row_pitch">Number of bytes between rows of the destination buffer.</param>
+	/// <returns><see langword="true"/> if the format is supported and the data was converted, <see langword="false"/> otherwise.</returns>
+	bool convert_from_rgba8(api::format format, uint32_t width, uint32_t height, const uint8_t *src, uint32_t src_row_pitch, void *dst, uint32_t dst_row_pitch);
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "frame_capture.hpp"
+#include "image_encoder.hpp"
+#include <cstdio>
+#include <algorithm>
+
+// Only file access depends on the platform, so that the rest can be built and tested anywhere
+static FILE *open_output_file(const std::filesystem::path &path)
+{
+#ifdef _WIN32
+	FILE *file = nullptr;
+	if (_wfopen_s(&file, path.c_str(), L"wb") != 0)
+		return nullptr;
+	return file;
+#else
+	return std::fopen(path.c_str(), "wb");
+#endif
+}
+
+bool reshade::frame_capture::start(const std::filesystem::path &path, output_format format, uint32_t width, uint32_t height, uint32_t frame_rate, size_t max_queued_frames, unsigned int num_threads, bool block_when_full)
+{
+	stop();
+
+	_path = path;
+	_format = format;
+	_width = width;
+	_height = height;
+	_max_queued_frames = std::max<size_t>(1, max_queued_frames);
+	_block_when_full = block_when_full;
+
+	{
+		const std::unique_lock<std::mutex> lock(_queue_mutex);
+
+		// Frames submitted from now on for an earlier session are ignored
+		_session++;
+
+		_queue.clear();
+		_next_sequence_index = 0;
+		_stop_requested = false;
+	}
+
+	_next_write_index = 0;
+
+	_frames_submitted = 0;
+	_frames_written = 0;
+	_frames_dropped = 0;
+	_bytes_written = 0;
+	_start_time = std::chrono::high_resolution_clock::now();
+
+	if (format != output_format::png_sequence)
+	{
+		// This may also be a named pipe, in which case an external encoder can read from the other end
+		_stream_file = open_output_file(path);
+		if (_stream_file == nullptr)
+			return false;
+
+		if (format == output_format::y4m)
+		{
+			char header[128];
+			const int header_size = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444 XCOLORRANGE=LIMITED\n", width, height, std::max(1u, frame_rate));
+			fwrite(header, 1, header_size, _stream_file);
+			_bytes_written += header_size;
+		}
+	}
+
+	if (num_threads == 0)
+		// Leave some hardware threads to the application
+		num_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+	for (unsigned int i = 0; i < num_threads; ++i)
+		_threads.emplace_back(&frame_capture::worker_thread, this);
+
+	return true;
+}
+void reshade::frame_capture::stop()
+{
+	if (_threads.empty())
+		return;
+
+	{
+		const std::unique_lock<std::mutex> lock(_queue_mutex);
+		_stop_requested = true;
+	}
+
+	_queue_not_empty.notify_all();
+	_queue_not_full.notify_all();
+
+	// Worker threads only exit after the queue was drained
+	for (std::thread &thread : _threads)
+		thread.join();
+	_threads.clear();
+
+	if (_stream_file != nullptr)
+	{
+		fclose(_stream_file);
+		_stream_file = nullptr;
+	}
+
+	_stop_time = std::chrono::high_resolution_clock::now();
+}
+
+bool reshade::frame_capture::submit_frame(uint64_t session, std::vector<uint8_t> &&pixels)
+{
+	std::unique_lock<std::mutex> lock(_queue_mutex);
+
+	if (session != _session)
+		return false;
+
+	const uint64_t frame_number = _frames_submitted++;
+
+	if (_stop_requested || pixels.size() != static_cast<size_t>(_width) * static_cast<size_t>(_height) * 4)
+	{
+		_frames_dropped++;
+		return false;
+	}
+
+	if (_queue.size() >= _max_queued_frames)
+	{
+		if (!_block_when_full)
+		{
+			_frames_dropped++;
+			return false;
+		}
+
+		_queue_not_full.wait(lock, [this]() { return _queue.size() < _max_queued_frames || _stop_requested; });
+	}
+
+	_queue.push_back({ frame_number, _next_sequence_index++, std::move(pixels) });
+
+	lock.unlock();
+	_queue_not_empty.notify_one();
+
+	return true;
+}
+void reshade::frame_capture::skip_frame(uint64_t session)
+{
+	const std::unique_lock<std::mutex> lock(_queue_mutex);
+
+	if (session != _session)
+		return;
+
+	_frames_submitted++;
+	_frames_dropped++;
+}
+
+reshade::frame_capture::statistics reshade::frame_capture::get_statistics() const
+{
+	statistics stats = {};
+	stats.frames_submitted = _frames_submitted;
+	stats.frames_written = _frames_written;
+	stats.frames_dropped = _frames_dropped;
+	stats.bytes_written = _bytes_written;
+
+	{
+		const std::unique_lock<std::mutex> lock(_queue_mutex);
+		stats.frames_queued = _queue.size();
+	}
+
+	const auto end_time = is_active() ? std::chrono::high_resolution_clock::now() : _stop_time;
+	const double elapsed_seconds = std::chrono::duration<double>(end_time - _start_time).count();
+	stats.frames_per_second = elapsed_seconds > 0.0 ? stats.frames_written / elapsed_seconds : 0.0;
+
+	return stats;
+}
+
+void reshade::frame_capture::worker_thread()
+{
+	std::vector<uint8_t> encoded_data;
+
+	while (true)
+	{
+		queued_frame frame;
+		{
+			std::unique_lock<std::mutex> lock(_queue_mutex);
+			_queue_not_empty.wait(lock, [this]() { return !_queue.empty() || _stop_requested; });
+
+			if (_queue.empty())
+				break; // Stop was requested and there is nothing left to encode
+
+			frame = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		_queue_not_full.notify_one();
+
+		const size_t num_pixels = static_cast<size_t>(_width) * static_cast<size_t>(_height);
+
+		switch (_format)
+		{
+		case output_format::png_sequence:
+		{
+			strip_alpha_channel(frame.pixels.data(), num_pixels);
+
+			char suffix[32];
+			std::snprintf(suffix, sizeof(suffix), " %06llu.png", static_cast<unsigned long long>(frame.number));
+			std::filesystem::path file_path = _path;
+			file_path += suffix;
+
+			// Frames are encoded in parallel already, so use a single thread per frame
+			if (encode_png(frame.pixels.data(), _width, _height, 3, encoded_data, 1))
+			{
+				if (FILE *const file = open_output_file(file_path); file != nullptr)
+				{
+					if (fwrite(encoded_data.data(), 1, encoded_data.size(), file) == encoded_data.size())
+						_bytes_written += encoded_data.size(),
+						_frames_written++;
+					fclose(file);
+				}
+			}
+			break;
+		}
+		case output_format::y4m:
+		{
+			// Convert to planar BT.709 limited range YCbCr
+			encoded_data.resize(num_pixels * 3);
+			uint8_t *const y_plane = encoded_data.data();
+			uint8_t *const u_plane = y_plane + num_pixels;
+			uint8_t *const v_plane = u_plane + num_pixels;
+
+			for (size_t i = 0; i < num_pixels; ++i)
+			{
+				const int r = frame.pixels[i * 4 + 0];
+				const int g = frame.pixels[i * 4 + 1];
+				const int b = frame.pixels[i * 4 + 2];
+
+				y_plane[i] = static_cast<uint8_t>(((  47 * r + 157 * g +  16 * b + 128) >> 8) +  16);
+				u_plane[i] = static_cast<uint8_t>(( -26 * r -  86 * g + 112 * b + 32896) >> 8);
+				v_plane[i] = static_cast<uint8_t>(( 112 * r - 102 * g -  10 * b + 32896) >> 8);
+			}
+
+			static const char frame_header[] = "FRAME\n";
+			if (write_in_order(frame.sequence_index, frame_header, sizeof(frame_header) - 1, encoded_data.data(), encoded_data.size()))
+				_frames_written++;
+			break;
+		}
+		case output_format::raw:
+			if (write_in_order(frame.sequence_index, nullptr, 0, frame.pixels.data(), frame.pixels.size()))
+				_frames_written++;
+			break;
+		}
+	}
+}
+
+bool reshade::frame_capture::write_in_order(uint64_t sequence_index, const void *header, size_t header_size, const void *data, size_t data_size)
+{
+	std::unique_lock<std::mutex> lock(_write_mutex);
+	_write_order.wait(lock, [this, sequence_index]() { return _next_write_index == sequence_index; });
+
+	const bool success =
+		(header_size == 0 || fwrite(header, 1, header_size, _stream_file) == header_size) &&
+		fwrite(data, 1, data_size, _stream_file) == data_size;
+	if (success)
+		_bytes_written += header_size + data_size;
+
+	_next_write_index++;
+
+	lock.unlock();
+	_write_order.notify_all();
+
+	return success;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <condition_variable>
+
+namespace reshade
+{
+	/// <summary>
+	/// Encodes a continuous sequence of captured frames on a pool of worker threads and writes them to disk or a pipe.
+	/// </summary>
+	class frame_capture
+	{
+	public:
+		enum class output_format : uint32_t
+		{
+			/// <summary>
+			/// Every frame is written to a separate, numbered PNG file.
+			/// </summary>
+			png_sequence = 0,
+			/// <summary>
+			/// All frames are written to a single YUV4MPEG2 stream (planar 4:4:4 YCbCr, BT.709 limited range).
+			/// </summary>
+			y4m = 1,
+			/// <summary>
+			/// All frames are written to a single stream of raw 32 bits-per-pixel RGBA image data.
+			/// </summary>
+			raw = 2,
+		};
+
+		struct statistics
+		{
+			uint64_t frames_submitted;
+			uint64_t frames_written;
+			uint64_t frames_dropped;
+			uint64_t bytes_written;
+			size_t frames_queued;
+			double frames_per_second;
+		};
+
+		~frame_capture() { stop(); }
+
+		/// <summary>
+		/// Starts a new capture session.
+		/// </summary>
+		/// <param name="path">Path to the output file for stream formats, or the base path (without extension) numbered images are appended to for image sequences.</param>
+		/// <param name="format">Output format to write.</param>
+		/// <param name="width">Width of all frames that will be submitted.</param>
+		/// <param name="height">Height of all frames that will be submitted.</param>
+		/// <param name="frame_rate">Frame rate that is written to the stream header (if the format has one).</param>
+		/// <param name="max_queued_frames">Maximum number of frames waiting to be encoded, after which submitting more frames either blocks or drops them.</param>
+		/// <param name="num_threads">Number of encoder threads to use, or zero to choose based on the number of hardware threads.</param>
+		/// <param name="block_when_full"><see langword="true"/> to block in <see cref="submit_frame"/> until there is space in the queue, <see langword="false"/> to drop frames instead.</param>
+		bool start(const std::filesystem::path &path, output_format format, uint32_t width, uint32_t height, uint32_t frame_rate, size_t max_queued_frames, unsigned int num_threads, bool block_when_full);
+		/// <summary>
+		/// Stops the current capture session, after waiting for all queued frames to be written.
+		/// </summary>
+		void stop();
+
+		bool is_active() const { return !_threads.empty(); }
+
+		/// <summary>
+		/// Gets the identifier of the current capture session, which changes every time a new session is started.
+		/// Frames that are read back asynchronously should be tagged with this when requested, so that frames of a previous session that complete late are not written to the next one.
+		/// </summary>
+		uint64_t session() const { return _session.load(); }
+
+		uint32_t width() const { return _width; }
+		uint32_t height() const { return _height; }
+		const std::filesystem::path &path() const { return _path; }
+
+		/// <summary>
+		/// Queues a frame of 32 bits-per-pixel RGBA image data for encoding.
+		/// </summary>
+		/// <param name="session">Identifier of the session the frame was captured for (see <see cref="session"/>). The frame is ignored if that is not the current one.</param>
+		/// <param name="pixels">Image data of the frame.</param>
+		/// <returns><see langword="true"/> if the frame was queued, <see langword="false"/> if it was dropped or ignored.</returns>
+		bool submit_frame(uint64_t session, std::vector<uint8_t> &&pixels);
+		/// <summary>
+		/// Records a frame that could not be captured, so that it is reported as dropped.
+		/// </summary>
+		/// <param name="session">Identifier of the session the frame was captured for (see <see cref="session"/>). Nothing is recorded if that is not the current one.</param>
+		void skip_frame(uint64_t session);
+
+		statistics get_statistics() const;
+
+	private:
+		struct queued_frame
+		{
+			uint64_t number; // Index of the frame among all submitted ones (including dropped ones)
+			uint64_t sequence_index; // Index of the frame among all queued ones, which determines the order in the output stream
+			std::vector<uint8_t> pixels;
+		};
+
+		void worker_thread();
+		bool write_in_order(uint64_t sequence_index, const void *header, size_t header_size, const void *data, size_t data_size);
+
+		std::filesystem::path _path;
+		output_format _format = output_format::png_sequence;
+		uint32_t _width = 0;
+		uint32_t _height = 0;
+		size_t _max_queued_frames = 0;
+		bool _block_when_full = false;
+		std::vector<std::thread> _threads;
+		std::atomic<uint64_t> _session = 0;
+
+		mutable std::mutex _queue_mutex;
+		std::condition_variable _queue_not_empty;
+		std::condition_variable _queue_not_full;
+		std::deque<queued_frame> _queue;
+		uint64_t _next_sequence_index = 0;
+		bool _stop_requested = false;
+
+		std::mutex _write_mutex;
+		std::condition_variable _write_order;
+		uint64_t _next_write_index = 0;
+		FILE *_stream_file = nullptr;
+
+		std::atomic<uint64_t> _frames_submitted = 0;
+		std::atomic<uint64_t> _frames_written = 0;
+		std::atomic<uint64_t> _frames_dropped = 0;
+		std::atomic<uint64_t> _bytes_written = 0;
+		std::chrono::high_resolution_clock::time_point _start_time;
+		std::chrono::high_resolution_clock::time_point _stop_time;
+	};
+}
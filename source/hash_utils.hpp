@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace reshade
+{
+	/// <summary>
+	/// Computes a 64-bit non-cryptographic hash of the specified data (this is the XXH64 algorithm).
+	/// Unlike 'std::hash', the result only depends on the data and not on the compiler or build, so it is safe to persist (e.g. in cache file names).
+	/// </summary>
+	inline uint64_t compute_hash64(const void *data_ptr, size_t size, uint64_t seed = 0)
+	{
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+		constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+		constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+		const auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+		const auto read64 = [](const uint8_t *p) { uint64_t value; std::memcpy(&value, p, 8); return value; };
+		const auto read32 = [](const uint8_t *p) { uint32_t value; std::memcpy(&value, p, 4); return value; };
+		const auto round = [&rotl](uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+		const auto merge = [&round](uint64_t acc, uint64_t value) { return (acc ^ round(0, value)) * prime1 + prime4; };
+
+		const uint8_t *data = static_cast<const uint8_t *>(data_ptr);
+		const uint8_t *const end = data + size;
+		uint64_t hash;
+
+		if (size >= 32)
+		{
+			uint64_t v1 = seed + prime1 + prime2;
+			uint64_t v2 = seed + prime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - prime1;
+
+			for (; data + 32 <= end; data += 32)
+			{
+				v1 = round(v1, read64(data +  0));
+				v2 = round(v2, read64(data +  8));
+				v3 = round(v3, read64(data + 16));
+				v4 = round(v4, read64(data + 24));
+			}
+
+			hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			hash = merge(hash, v1);
+			hash = merge(hash, v2);
+			hash = merge(hash, v3);
+			hash = merge(hash, v4);
+		}
+		else
+		{
+			hash = seed + prime5;
+		}
+
+		hash += static_cast<uint64_t>(size);
+
+		for (; data + 8 <= end; data += 8)
+			hash = rotl(hash ^ round(0, read64(data)), 27) * prime1 + prime4;
+		for (; data + 4 <= end; data += 4)
+			hash = rotl(hash ^ (read32(data) * prime1), 23) * prime2 + prime3;
+		for (; data < end; ++data)
+			hash = rotl(hash ^ (*data * prime5), 11) * prime1;
+
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		hash *= prime3;
+		hash ^= hash >> 32;
+
+		return hash;
+	}
+}
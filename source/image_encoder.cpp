@@ -0,0 +1,693 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "image_encoder.hpp"
+#include <queue>
+#include <thread>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <fpng.h>
+#include <stb_image_write.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Minimum number of pixels each thread should process, below which splitting up the work is not worth the overhead
+static constexpr size_t min_pixels_per_thread = 256 * 1024;
+
+static unsigned int compute_num_strips(uint32_t width, uint32_t height, uint32_t rows_per_unit, unsigned int max_threads)
+{
+	if (max_threads == 0)
+		max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	const size_t num_units = (height + rows_per_unit - 1) / rows_per_unit;
+	const size_t num_pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+	return static_cast<unsigned int>(std::max<size_t>(1, std::min({ static_cast<size_t>(max_threads), num_units, num_pixels / min_pixels_per_thread })));
+}
+
+template <typename F>
+static void parallel_for(unsigned int count, F func)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(count - 1);
+	for (unsigned int i = 1; i < count; ++i)
+		threads.emplace_back(func, i);
+
+	// Run the first work item on the calling thread
+	func(0u);
+
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+void reshade::strip_alpha_channel(uint8_t *pixels, size_t num_pixels)
+{
+	size_t i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	static const bool has_ssse3 = []() {
+		int cpu_info[4] = {};
+		__cpuid(cpu_info, 1);
+		return (cpu_info[2] & (1 << 9)) != 0;
+	}();
+
+	if (has_ssse3)
+	{
+		const __m128i shuffle_mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		// Output is always written behind the input that is read next, so this can be done in place
+		// The four trailing bytes of every store are garbage, but are overwritten again by the following store
+		for (; i + 4 <= num_pixels; i += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + 3 * i), _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + 4 * i)), shuffle_mask));
+	}
+#endif
+
+	for (; i < num_pixels; ++i)
+	{
+		pixels[3 * i + 0] = pixels[4 * i + 0];
+		pixels[3 * i + 1] = pixels[4 * i + 1];
+		pixels[3 * i + 2] = pixels[4 * i + 2];
+	}
+}
+
+namespace
+{
+	struct crc32_table
+	{
+		crc32_table()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t crc = i;
+				for (int k = 0; k < 8; ++k)
+					crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+				table[i] = crc;
+			}
+		}
+
+		uint32_t update(uint32_t crc, const uint8_t *data, size_t size) const
+		{
+			crc = ~crc;
+			for (size_t i = 0; i < size; ++i)
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		uint32_t table[256];
+	};
+
+	struct deflate_tables
+	{
+		deflate_tables()
+		{
+			for (uint32_t code = 0; code < 29; ++code)
+				for (uint32_t length = length_base[code]; length < length_base[code] + (1u << length_extra_bits[code]) && length <= 258; ++length)
+					length_code[length] = static_cast<uint8_t>(code);
+			// Length 258 has a dedicated code without extra bits
+			length_code[258] = 28;
+
+			for (uint32_t code = 0; code < 30; ++code)
+				for (uint32_t dist = distance_base[code]; dist < distance_base[code] + (1u << distance_extra_bits[code]) && dist <= 32768; ++dist)
+					distance_code[dist] = static_cast<uint8_t>(code);
+		}
+
+		static constexpr uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint8_t  length_extra_bits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint8_t  distance_extra_bits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		static constexpr uint8_t  code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		uint8_t length_code[259] = {};
+		uint8_t distance_code[32769] = {};
+	};
+
+	struct bit_writer
+	{
+		explicit bit_writer(std::vector<uint8_t> &out) : out(out) {}
+
+		void put_bits(uint32_t bits, uint32_t count)
+		{
+			assert(count <= 32 && bit_count < 32);
+			bit_buffer |= static_cast<uint64_t>(bits) << bit_count;
+			bit_count += count;
+
+			if (bit_count >= 32)
+			{
+				const uint8_t bytes[4] = { static_cast<uint8_t>(bit_buffer), static_cast<uint8_t>(bit_buffer >> 8), static_cast<uint8_t>(bit_buffer >> 16), static_cast<uint8_t>(bit_buffer >> 24) };
+				out.insert(out.end(), bytes, bytes + 4);
+				bit_buffer >>= 32;
+				bit_count -= 32;
+			}
+		}
+
+		void flush_to_byte_boundary()
+		{
+			for (; bit_count > 0; bit_count = bit_count > 8 ? bit_count - 8 : 0, bit_buffer >>= 8)
+				out.push_back(static_cast<uint8_t>(bit_buffer));
+		}
+
+		std::vector<uint8_t> &out;
+		uint64_t bit_buffer = 0;
+		uint32_t bit_count = 0;
+	};
+
+	struct deflate_symbol
+	{
+		uint16_t litlen; // Literal byte value, or match length if distance is not zero
+		uint16_t distance;
+	};
+}
+
+static const crc32_table s_crc32;
+static const deflate_tables s_deflate_tables;
+
+static void build_huffman_code_lengths(const uint32_t *freqs, uint32_t num_symbols, uint32_t max_length, uint8_t *lengths)
+{
+	std::fill_n(lengths, num_symbols, static_cast<uint8_t>(0));
+
+	std::vector<uint32_t> symbols;
+	for (uint32_t i = 0; i < num_symbols; ++i)
+		if (freqs[i] != 0)
+			symbols.push_back(i);
+
+	// Ensure there are always at least two codes, so that the resulting code is complete
+	for (uint32_t i = 0; symbols.size() < 2; ++i)
+		if (freqs[i] == 0)
+			symbols.push_back(i);
+
+	// Build Huffman tree to determine optimal code lengths (leaf nodes are the symbols, followed by the internal nodes)
+	std::vector<uint32_t> parents(symbols.size() * 2 - 1);
+	std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>, std::greater<std::pair<uint64_t, uint32_t>>> queue;
+	for (uint32_t i = 0; i < symbols.size(); ++i)
+		queue.emplace(freqs[symbols[i]], i);
+
+	for (uint32_t next_node = static_cast<uint32_t>(symbols.size()); queue.size() > 1; ++next_node)
+	{
+		const auto a = queue.top(); queue.pop();
+		const auto b = queue.top(); queue.pop();
+		parents[a.second] = next_node;
+		parents[b.second] = next_node;
+		queue.emplace(a.first + b.first, next_node);
+	}
+
+	std::vector<uint32_t> depths(parents.size());
+	uint32_t num_codes_of_length[64] = {};
+	for (size_t i = parents.size() - 1; i-- > 0;)
+		depths[i] = depths[parents[i]] + 1;
+	for (uint32_t i = 0; i < symbols.size(); ++i)
+		num_codes_of_length[std::min(depths[i], 63u)]++;
+
+	// Enforce maximum code length by moving codes from the overflowing lengths and rebalancing the tree until it is complete again
+	for (uint32_t i = max_length + 1; i < 64; ++i)
+		num_codes_of_length[max_length] += num_codes_of_length[i], num_codes_of_length[i] = 0;
+
+	uint32_t total = 0;
+	for (uint32_t i = 1; i <= max_length; ++i)
+		total += num_codes_of_length[i] << (max_length - i);
+	for (; total != (1u << max_length); --total)
+	{
+		num_codes_of_length[max_length]--;
+		for (uint32_t i = max_length - 1; i > 0; --i)
+		{
+			if (num_codes_of_length[i] != 0)
+			{
+				num_codes_of_length[i]--;
+				num_codes_of_length[i + 1] += 2;
+				break;
+			}
+		}
+	}
+
+	// Assign the shortest lengths to the most frequent symbols
+	std::stable_sort(symbols.begin(), symbols.end(),
+		[freqs](uint32_t lhs, uint32_t rhs) { return freqs[lhs] > freqs[rhs]; });
+
+	for (uint32_t length = 1, i = 0; length <= max_length; ++length)
+		for (uint32_t k = 0; k < num_codes_of_length[length]; ++k)
+			lengths[symbols[i++]] = static_cast<uint8_t>(length);
+}
+static void build_huffman_codes(const uint8_t *lengths, uint32_t num_symbols, uint16_t *codes)
+{
+	uint32_t num_codes_of_length[16] = {};
+	for (uint32_t i = 0; i < num_symbols; ++i)
+		num_codes_of_length[lengths[i]]++;
+	num_codes_of_length[0] = 0;
+
+	uint32_t next_code[16] = {};
+	for (uint32_t length = 1, code = 0; length < 16; ++length)
+		next_code[length] = code = (code + num_codes_of_length[length - 1]) << 1;
+
+	for (uint32_t i = 0; i < num_symbols; ++i)
+	{
+		if (lengths[i] == 0)
+			continue;
+
+		// Huffman codes are packed starting with the most significant bit, so need to reverse them for the bit writer
+		uint32_t code = next_code[lengths[i]]++, reversed_code = 0;
+		for (uint32_t k = 0; k < lengths[i]; ++k, code >>= 1)
+			reversed_code = (reversed_code << 1) | (code & 1);
+		codes[i] = static_cast<uint16_t>(reversed_code);
+	}
+}
+
+static void write_deflate_block(bit_writer &writer, const std::vector<deflate_symbol> &symbols, bool final)
+{
+	const deflate_tables &tables = s_deflate_tables;
+
+	uint32_t litlen_freqs[286] = {}, distance_freqs[30] = {};
+	for (const deflate_symbol &symbol : symbols)
+	{
+		if (symbol.distance == 0)
+		{
+			litlen_freqs[symbol.litlen]++;
+		}
+		else
+		{
+			litlen_freqs[257 + tables.length_code[symbol.litlen]]++;
+			distance_freqs[tables.distance_code[symbol.distance]]++;
+		}
+	}
+	litlen_freqs[256] = 1;
+
+	uint8_t lengths[286 + 30];
+	uint8_t *const litlen_lengths = lengths;
+	uint8_t distance_lengths[30];
+	build_huffman_code_lengths(litlen_freqs, 286, 15, litlen_lengths);
+	build_huffman_code_lengths(distance_freqs, 30, 15, distance_lengths);
+
+	uint16_t litlen_codes[286] = {}, distance_codes[30] = {};
+	build_huffman_codes(litlen_lengths, 286, litlen_codes);
+	build_huffman_codes(distance_lengths, 30, distance_codes);
+
+	uint32_t num_litlen_codes = 286;
+	while (num_litlen_codes > 257 && litlen_lengths[num_litlen_codes - 1] == 0)
+		num_litlen_codes--;
+	uint32_t num_distance_codes = 30;
+	while (num_distance_codes > 1 && distance_lengths[num_distance_codes - 1] == 0)
+		num_distance_codes--;
+
+	// Both code length sequences are run-length encoded together
+	std::memcpy(lengths + num_litlen_codes, distance_lengths, num_distance_codes);
+	const uint32_t num_lengths = num_litlen_codes + num_distance_codes;
+
+	struct code_length_symbol { uint8_t symbol, extra_bits, extra_value; };
+	std::vector<code_length_symbol> code_length_symbols;
+	uint32_t code_length_freqs[19] = {};
+
+	for (uint32_t i = 0; i < num_lengths;)
+	{
+		const uint8_t length = lengths[i];
+		uint32_t run = 1;
+		while (i + run < num_lengths && lengths[i + run] == length)
+			run++;
+		i += run;
+
+		if (length == 0)
+		{
+			for (uint32_t count; run >= 11; run -= count)
+				count = std::min(run, 138u), code_length_symbols.push_back({ 18, 7, static_cast<uint8_t>(count - 11) });
+			if (run >= 3)
+				code_length_symbols.push_back({ 17, 3, static_cast<uint8_t>(run - 3) }), run = 0;
+		}
+		else
+		{
+			code_length_symbols.push_back({ length, 0, 0 }), run--;
+			for (uint32_t count; run >= 3; run -= count)
+				count = std::min(run, 6u), code_length_symbols.push_back({ 16, 2, static_cast<uint8_t>(count - 3) });
+		}
+
+		for (; run > 0; run--)
+			code_length_symbols.push_back({ length, 0, 0 });
+	}
+
+	for (const code_length_symbol &symbol : code_length_symbols)
+		code_length_freqs[symbol.symbol]++;
+
+	uint8_t code_length_lengths[19];
+	uint16_t code_length_codes[19] = {};
+	build_huffman_code_lengths(code_length_freqs, 19, 7, code_length_lengths);
+	build_huffman_codes(code_length_lengths, 19, code_length_codes);
+
+	uint32_t num_code_length_codes = 19;
+	while (num_code_length_codes > 4 && code_length_lengths[deflate_tables::code_length_order[num_code_length_codes - 1]] == 0)
+		num_code_length_codes--;
+
+	// Write dynamic Huffman block header
+	writer.put_bits(final ? 1 : 0, 1);
+	writer.put_bits(2, 2);
+	writer.put_bits(num_litlen_codes - 257, 5);
+	writer.put_bits(num_distance_codes - 1, 5);
+	writer.put_bits(num_code_length_codes - 4, 4);
+	for (uint32_t i = 0; i < num_code_length_codes; ++i)
+		writer.put_bits(code_length_lengths[deflate_tables::code_length_order[i]], 3);
+	for (const code_length_symbol &symbol : code_length_symbols)
+	{
+		writer.put_bits(code_length_codes[symbol.symbol], code_length_lengths[symbol.symbol]);
+		if (symbol.extra_bits != 0)
+			writer.put_bits(symbol.extra_value, symbol.extra_bits);
+	}
+
+	// Write block data
+	for (const deflate_symbol &symbol : symbols)
+	{
+		if (symbol.distance == 0)
+		{
+			writer.put_bits(litlen_codes[symbol.litlen], litlen_lengths[symbol.litlen]);
+		}
+		else
+		{
+			const uint32_t length_code = tables.length_code[symbol.litlen];
+			writer.put_bits(litlen_codes[257 + length_code], litlen_lengths[257 + length_code]);
+			writer.put_bits(symbol.litlen - deflate_tables::length_base[length_code], deflate_tables::length_extra_bits[length_code]);
+
+			const uint32_t distance_code = tables.distance_code[symbol.distance];
+			writer.put_bits(distance_codes[distance_code], distance_lengths[distance_code]);
+			writer.put_bits(symbol.distance - deflate_tables::distance_base[distance_code], deflate_tables::distance_extra_bits[distance_code]);
+		}
+	}
+
+	writer.put_bits(litlen_codes[256], litlen_lengths[256]);
+}
+
+static void deflate_strip(const uint8_t *data, size_t size, bool last, std::vector<uint8_t> &out)
+{
+	constexpr uint32_t hash_bits = 15;
+	constexpr size_t max_block_symbols = 64 * 1024;
+
+	bit_writer writer(out);
+	std::vector<int32_t> hash_table(1 << hash_bits, -1);
+	std::vector<deflate_symbol> symbols;
+	symbols.reserve(max_block_symbols);
+
+	// Simple greedy LZ77 with a single hash table entry per position, which is enough to catch the long runs that are common in filtered image data
+	for (size_t i = 0; i < size;)
+	{
+		if (i + 4 <= size)
+		{
+			uint32_t value;
+			std::memcpy(&value, data + i, 4);
+			const uint32_t hash = (value * 2654435761u) >> (32 - hash_bits);
+
+			const int32_t candidate = hash_table[hash];
+			hash_table[hash] = static_cast<int32_t>(i);
+
+			if (candidate >= 0 && i - candidate <= 32768 && std::memcmp(data + candidate, data + i, 4) == 0)
+			{
+				const size_t max_length = std::min<size_t>(258, size - i);
+				size_t length = 4;
+				while (length < max_length && data[candidate + length] == data[i + length])
+					length++;
+
+				symbols.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(i - candidate) });
+				i += length;
+				goto next_symbol;
+			}
+		}
+
+		symbols.push_back({ data[i], 0 });
+		i += 1;
+
+	next_symbol:
+		if (symbols.size() >= max_block_symbols)
+		{
+			write_deflate_block(writer, symbols, false);
+			symbols.clear();
+		}
+	}
+
+	write_deflate_block(writer, symbols, last);
+
+	if (!last)
+	{
+		// Terminate with an empty stored block, so that the next strip starts on a byte boundary and can simply be appended (equivalent to 'Z_SYNC_FLUSH')
+		writer.put_bits(0, 3);
+		writer.flush_to_byte_boundary();
+		const uint8_t empty_stored_block[4] = { 0x00, 0x00, 0xFF, 0xFF };
+		out.insert(out.end(), empty_stored_block, empty_stored_block + 4);
+	}
+	else
+	{
+		writer.flush_to_byte_boundary();
+	}
+}
+
+static uint32_t compute_adler32(const uint8_t *data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	while (size > 0)
+	{
+		// Largest number of bytes that can be processed before the sums can overflow
+		size_t n = std::min<size_t>(size, 5552);
+		size -= n;
+		for (; n > 0; --n)
+			a += *data++, b += a;
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+static uint32_t combine_adler32(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+	constexpr uint32_t base = 65521;
+	const uint32_t rem = static_cast<uint32_t>(size2 % base);
+	uint32_t sum1 = adler1 & 0xFFFF;
+	uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sum1) % base);
+	sum1 += (adler2 & 0xFFFF) + base - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= (base << 1)) sum2 -= (base << 1);
+	if (sum2 >= base) sum2 -= base;
+	return sum1 | (sum2 << 16);
+}
+
+static void append_big_endian(std::vector<uint8_t> &out, uint32_t value)
+{
+	const uint8_t bytes[4] = { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+	out.insert(out.end(), bytes, bytes + 4);
+}
+static void append_png_chunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size, uint32_t crc)
+{
+	append_big_endian(out, static_cast<uint32_t>(size));
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	append_big_endian(out, crc);
+}
+static void append_png_chunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size)
+{
+	append_png_chunk(out, type, data, size, s_crc32.update(s_crc32.update(0, reinterpret_cast<const uint8_t *>(type), 4), data, size));
+}
+
+bool reshade::encode_png(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t comp, std::vector<uint8_t> &encoded_data, unsigned int max_threads)
+{
+	if (comp != 3 && comp != 4)
+		return false;
+
+	const unsigned int num_strips = compute_num_strips(width, height, 1, max_threads);
+	if (num_strips <= 1)
+		return fpng::fpng_encode_image_to_memory(pixels, width, height, comp, encoded_data);
+
+	const size_t row_pitch = static_cast<size_t>(width) * comp;
+	const uint32_t rows_per_strip = (height + num_strips - 1) / num_strips;
+
+	struct strip_result
+	{
+		std::vector<uint8_t> data;
+		size_t filtered_size;
+		uint32_t adler;
+		uint32_t crc;
+	};
+
+	std::vector<strip_result> strips(num_strips);
+
+	parallel_for(num_strips, [&](unsigned int strip_index) {
+		const uint32_t y_begin = strip_index * rows_per_strip;
+		const uint32_t y_end = std::min(y_begin + rows_per_strip, height);
+
+		// Apply the "Up" filter to every row but the first in the image (which has no prior row)
+		std::vector<uint8_t> filtered((y_end - y_begin) * (row_pitch + 1));
+		for (uint32_t y = y_begin; y < y_end; ++y)
+		{
+			uint8_t *const dst = filtered.data() + (y - y_begin) * (row_pitch + 1);
+			const uint8_t *const src = pixels + y * row_pitch;
+
+			if (y == 0)
+			{
+				dst[0] = 0;
+				std::memcpy(dst + 1, src, row_pitch);
+				continue;
+			}
+
+			dst[0] = 2;
+			const uint8_t *const prev = src - row_pitch;
+
+			size_t x = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+			for (; x + 16 <= row_pitch; x += 16)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 1 + x), _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + x))));
+#endif
+			for (; x < row_pitch; ++x)
+				dst[1 + x] = src[x] - prev[x];
+		}
+
+		strip_result &result = strips[strip_index];
+		result.filtered_size = filtered.size();
+		result.adler = compute_adler32(filtered.data(), filtered.size());
+
+		// The first strip also contains the zlib stream header
+		if (strip_index == 0)
+			result.data = { 0x78, 0x01 };
+
+		deflate_strip(filtered.data(), filtered.size(), strip_index == num_strips - 1, result.data);
+
+		// Every strip is written to a separate IDAT chunk, so can calculate the checksum here already
+		result.crc = s_crc32.update(s_crc32.update(0, reinterpret_cast<const uint8_t *>("IDAT"), 4), result.data.data(), result.data.size());
+	});
+
+	uint32_t adler = strips[0].adler;
+	size_t encoded_size = 8 + 25 + 12 + 4 + 12;
+	for (unsigned int i = 1; i < num_strips; ++i)
+		adler = combine_adler32(adler, strips[i].adler, strips[i].filtered_size);
+	for (const strip_result &strip : strips)
+		encoded_size += strip.data.size() + 12;
+
+	encoded_data.clear();
+	encoded_data.reserve(encoded_size);
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	encoded_data.insert(encoded_data.end(), signature, signature + 8);
+
+	uint8_t header[13] = {};
+	header[0] = static_cast<uint8_t>(width >> 24);
+	header[1] = static_cast<uint8_t>(width >> 16);
+	header[2] = static_cast<uint8_t>(width >> 8);
+	header[3] = static_cast<uint8_t>(width);
+	header[4] = static_cast<uint8_t>(height >> 24);
+	header[5] = static_cast<uint8_t>(height >> 16);
+	header[6] = static_cast<uint8_t>(height >> 8);
+	header[7] = static_cast<uint8_t>(height);
+	header[8] = 8; // Bit depth
+	header[9] = comp == 4 ? 6 : 2; // Color type (RGBA or RGB)
+	append_png_chunk(encoded_data, "IHDR", header, sizeof(header));
+
+	for (const strip_result &strip : strips)
+		append_png_chunk(encoded_data, "IDAT", strip.data.data(), strip.data.size(), strip.crc);
+
+	// The zlib stream ends with the checksum of all uncompressed data, which is only known after all strips were processed
+	const uint8_t trailer[4] = { static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16), static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler) };
+	append_png_chunk(encoded_data, "IDAT", trailer, sizeof(trailer));
+
+	append_png_chunk(encoded_data, "IEND", nullptr, 0);
+
+	return true;
+}
+
+static size_t find_jpeg_scan_data(const std::vector<uint8_t> &data, size_t *sos_offset = nullptr, size_t *sof_offset = nullptr)
+{
+	// Skip start of image marker and walk the marker segments up to the start of scan
+	for (size_t offset = 2; offset + 4 <= data.size();)
+	{
+		if (data[offset] != 0xFF)
+			break;
+
+		const uint8_t marker = data[offset + 1];
+		const size_t length = (static_cast<size_t>(data[offset + 2]) << 8) | data[offset + 3];
+
+		if (marker == 0xC0 && sof_offset != nullptr)
+			*sof_offset = offset;
+		if (marker == 0xDA)
+		{
+			if (sos_offset != nullptr)
+				*sos_offset = offset;
+			return offset + 2 + length;
+		}
+
+		offset += 2 + length;
+	}
+
+	return 0;
+}
+
+bool reshade::encode_jpeg(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t comp, int quality, std::vector<uint8_t> &encoded_data, unsigned int max_threads)
+{
+	if (comp != 3 && comp != 4)
+		return false;
+
+	const auto write_callback = [](void *context, void *data, int size) {
+		std::vector<uint8_t> &buffer = *static_cast<std::vector<uint8_t> *>(context);
+		buffer.insert(buffer.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+	};
+
+	// stb_image_write uses chroma subsampling for quality levels of 90 and below, which results in 16x16 instead of 8x8 blocks
+	const uint32_t mcu_size = quality <= 90 ? 16 : 8;
+	const uint32_t mcus_per_row = (width + mcu_size - 1) / mcu_size;
+	const uint32_t mcu_rows = (height + mcu_size - 1) / mcu_size;
+
+	unsigned int num_strips = compute_num_strips(width, height, mcu_size, max_threads);
+	uint32_t mcu_rows_per_strip = (mcu_rows + num_strips - 1) / num_strips;
+	// The restart interval is stored as a 16-bit value, so limit the strip size accordingly
+	mcu_rows_per_strip = std::min(mcu_rows_per_strip, 0xFFFF / mcus_per_row);
+	num_strips = mcu_rows_per_strip != 0 ? (mcu_rows + mcu_rows_per_strip - 1) / mcu_rows_per_strip : 1;
+
+	encoded_data.clear();
+
+	if (num_strips <= 1)
+		return stbi_write_jpg_to_func(write_callback, &encoded_data, width, height, comp, pixels, quality) != 0;
+
+	// Every strip is encoded as a separate image, which resets the DC predictors the same way a restart marker does, so the entropy coded data can be joined with restart markers in between
+	std::vector<std::vector<uint8_t>> strips(num_strips);
+	std::vector<char> strips_success(num_strips);
+
+	parallel_for(num_strips, [&](unsigned int strip_index) {
+		const uint32_t y_begin = strip_index * mcu_rows_per_strip * mcu_size;
+		const uint32_t y_end = std::min(y_begin + mcu_rows_per_strip * mcu_size, height);
+
+		strips_success[strip_index] = stbi_write_jpg_to_func(write_callback, &strips[strip_index], width, y_end - y_begin, comp, pixels + static_cast<size_t>(y_begin) * width * comp, quality) != 0;
+	});
+
+	if (std::find(strips_success.begin(), strips_success.end(), 0) != strips_success.end())
+		return false;
+
+	size_t sos_offset = 0, sof_offset = 0;
+	const size_t scan_data_offset = find_jpeg_scan_data(strips[0], &sos_offset, &sof_offset);
+	if (scan_data_offset == 0 || sof_offset == 0)
+		return false;
+
+	// Copy headers of the first strip and patch the image height to that of the entire image
+	encoded_data.reserve(strips[0].size() * num_strips);
+	encoded_data.assign(strips[0].begin(), strips[0].begin() + sos_offset);
+	encoded_data[sof_offset + 5] = static_cast<uint8_t>(height >> 8);
+	encoded_data[sof_offset + 6] = static_cast<uint8_t>(height);
+
+	// Add define restart interval marker
+	const uint32_t restart_interval = mcus_per_row * mcu_rows_per_strip;
+	const uint8_t restart_interval_segment[6] = { 0xFF, 0xDD, 0x00, 0x04, static_cast<uint8_t>(restart_interval >> 8), static_cast<uint8_t>(restart_interval) };
+	encoded_data.insert(encoded_data.end(), restart_interval_segment, restart_interval_segment + 6);
+
+	for (unsigned int i = 0; i < num_strips; ++i)
+	{
+		const std::vector<uint8_t> &strip = strips[i];
+
+		const size_t strip_scan_data_offset = i == 0 ? sos_offset : find_jpeg_scan_data(strip);
+		if (strip_scan_data_offset == 0 || strip.size() < strip_scan_data_offset + 2 || strip[strip.size() - 2] != 0xFF || strip[strip.size() - 1] != 0xD9)
+			return false;
+
+		if (i != 0)
+		{
+			const uint8_t restart_marker[2] = { 0xFF, static_cast<uint8_t>(0xD0 + ((i - 1) % 8)) };
+			encoded_data.insert(encoded_data.end(), restart_marker, restart_marker + 2);
+		}
+
+		// Append entropy coded data without the end of image marker (which is already padded to a byte boundary with one bits)
+		encoded_data.insert(encoded_data.end(), strip.begin() + strip_scan_data_offset, strip.end() - 2);
+	}
+
+	const uint8_t end_of_image[2] = { 0xFF, 0xD9 };
+	encoded_data.insert(encoded_data.end(), end_of_image, end_of_image + 2);
+
+	return true;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace reshade
+{
+	/// <summary>
+	/// Removes the alpha channel from 32 bits-per-pixel image data in place, so that it is tightly packed with 24 bits-per-pixel afterwards.
+	/// </summary>
+	void strip_alpha_channel(uint8_t *pixels, size_t num_pixels);
+
+	/// <summary>
+	/// Encodes 24 or 32 bits-per-pixel image data to PNG.
+	/// Large images are split into horizontal strips that are filtered and compressed on separate threads and then joined into a single standard zlib stream.
+	/// </summary>
+	/// <param name="pixels">Pointer to the image data to encode.</param>
+	/// <param name="width">Width of the image data.</param>
+	/// <param name="height">Height of the image data.</param>
+	/// <param name="comp">Number of components per pixel (3 or 4).</param>
+	/// <param name="encoded_data">Vector that is filled with the encoded PNG file data.</param>
+	/// <param name="max_threads">Maximum number of threads to use, or zero to use as many as there are hardware threads.</param>
+	bool encode_png(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t comp, std::vector<uint8_t> &encoded_data, unsigned int max_threads = 0);
+
+	/// <summary>
+	/// Encodes 24 or 32 bits-per-pixel image data to JPEG.
+	/// Large images are split into horizontal strips that are encoded on separate threads and then joined using restart markers.
+	/// </summary>
+	/// <param name="pixels">Pointer to the image data to encode.</param>
+	/// <param name="width">Width of the image data.</param>
+	/// <param name="height">Height of the image data.</param>
+	/// <param name="comp">Number of components per pixel (3 or 4).</param>
+	/// <param name="quality">JPEG quality level in the range 1 to 100.</param>
+	/// <param name="encoded_data">Vector that is filled with the encoded JPEG file data.</param>
+	/// <param name="max_threads">Maximum number of threads to use, or zero to use as many as there are hardware threads.</param>
+	bool encode_jpeg(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t comp, int quality, std::vector<uint8_t> &encoded_data, unsigned int max_threads = 0);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <algorithm>
+
+namespace reshade
+{
+	/// <summary>
+	/// Keeps track of the last overlay update and the buffers its ImGui draw data was uploaded to, so that it can be rendered again instead of building and uploading a new ImGui frame while the user is not interacting with the overlay.
+	/// </summary>
+	class imgui_draw_data_cache
+	{
+	public:
+		using clock = std::chrono::high_resolution_clock;
+
+		/// <summary>
+		/// Number of vertex and index buffers that are cycled through, which is the number of uploads after which a buffer is written to again.
+		/// </summary>
+		static constexpr size_t num_buffers = 4;
+
+		/// <summary>
+		/// Checks whether the draw data of the last update may be rendered again in this frame instead of building a new one.
+		/// The caller still has to check that the user is not interacting with the overlay and that nothing else requires a new update (e.g. a changed display size, a font atlas rebuild or a screenshot of the overlay).
+		/// </summary>
+		/// <param name="overlay_state">Bit mask of the overlay windows that are currently shown.</param>
+		/// <param name="idle_update_rate">Maximum number of updates per second while idle, or zero to update every frame.</param>
+		/// <param name="now">Time of the current frame.</param>
+		bool can_render_last_update(unsigned int overlay_state, unsigned int idle_update_rate, clock::time_point now) const
+		{
+			return idle_update_rate != 0 && _last_update_retainable && overlay_state == _last_overlay_state && (now - _last_update_time) * idle_update_rate < std::chrono::seconds(1);
+		}
+
+		/// <summary>
+		/// Marks the start of building a new update, after which the last one may no longer be rendered again until <see cref="end_update"/> was called.
+		/// </summary>
+		void begin_update(unsigned int overlay_state, clock::time_point now)
+		{
+			_last_overlay_state = overlay_state;
+			_last_update_time = now;
+			_last_update_retainable = false;
+		}
+		/// <summary>
+		/// Marks the end of building a new update with the resulting <paramref name="draw_data"/>.
+		/// Only allows rendering it again in later frames if it does not reference any textures other than the <paramref name="font_atlas"/>, since those may be destroyed in the meantime (e.g. effect textures or add-on images).
+		/// </summary>
+		template <typename TDrawData, typename TTextureId>
+		void end_update(const TDrawData *draw_data, TTextureId font_atlas)
+		{
+			_last_update_retainable = draw_data != nullptr && std::all_of(draw_data->CmdLists, draw_data->CmdLists + draw_data->CmdListsCount,
+				[font_atlas](const auto *draw_list) {
+					return std::all_of(draw_list->CmdBuffer.begin(), draw_list->CmdBuffer.end(), [font_atlas](const auto &cmd) { return cmd.TextureId == font_atlas; });
+				});
+		}
+
+		/// <summary>
+		/// Checks whether the draw data of the specified ImGui frame still has to be uploaded, which is not the case when rendering the last update again.
+		/// </summary>
+		bool needs_upload(int imgui_frame) const { return imgui_frame != _uploaded_frame; }
+
+		/// <summary>
+		/// Gets the index of the buffers the draw data was last uploaded to.
+		/// </summary>
+		size_t buffer_index() const { return _buffer_index; }
+		/// <summary>
+		/// Gets the index of the buffers to upload new draw data to.
+		/// Only switching buffers when uploading new data still guarantees that a buffer was last used at least as many frames ago as there are buffers, so that it is not written to while a previous frame using it may still be in flight.
+		/// </summary>
+		size_t next_buffer_index() const { return (_buffer_index + 1) % num_buffers; }
+
+		/// <summary>
+		/// Marks the draw data of the specified ImGui frame as uploaded to the buffers at the specified index.
+		/// </summary>
+		void uploaded(int imgui_frame, size_t buffer_index)
+		{
+			_uploaded_frame = imgui_frame;
+			_buffer_index = buffer_index;
+		}
+
+		/// <summary>
+		/// Forgets the last update and uploaded draw data, e.g. when the buffers were destroyed.
+		/// </summary>
+		void reset()
+		{
+			_buffer_index = 0;
+			_uploaded_frame = -1;
+			_last_update_retainable = false;
+		}
+
+	private:
+		size_t _buffer_index = 0;
+		// ImGui frame the data in the current vertex and index buffers was produced in
+		int _uploaded_frame = -1;
+		unsigned int _last_overlay_state = 0;
+		clock::time_point _last_update_time;
+		// Set when the last draw data only references the font atlas, so that it is safe to render it again in a later frame
+		bool _last_update_retainable = false;
+	};
+}
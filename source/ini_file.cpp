@@ -4,13 +4,23 @@
  */
 
 #include "ini_file.hpp"
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <cassert>
 #include <fstream>
-#include <sstream>
+#include <Windows.h>
 
-// TODO: This is unsafe if there are multiple threads accessing the cache simultaneously
+static std::shared_mutex s_ini_cache_mutex;
 static std::unordered_map<std::wstring, ini_file> s_ini_cache;
 
+// Modified files are written to disk by a background thread once 'ini_write_behind' decides they are due
+// The thread only exists while there are modifications that were not saved yet
+static std::mutex s_write_behind_mutex;
+static bool s_write_behind_pending = false;
+static bool s_write_behind_running = false;
+static std::atomic<bool> s_write_behind_failed = false;
+
 ini_file &reshade::global_config()
 {
 	return ini_file::load_cache(g_target_executable_path.parent_path() / L"ReShade.ini");
@@ -18,10 +28,44 @@ ini_file &reshade::global_config()
 
 ini_file::ini_file(const std::filesystem::path &path) : _path(path)
 {
-	load();
+	load_internal();
+}
+ini_file::ini_file(const ini_file &other)
+{
+	// The mutex is not copied, the snapshot gets its own
+	const std::shared_lock<std::shared_mutex> lock(other._mutex);
+
+	_modified = other._modified;
+	_path = other._path;
+	_modified_at = other._modified_at;
+	_write_behind = other._write_behind;
+	_sections = other._sections;
+}
+ini_file &ini_file::operator=(const ini_file &other)
+{
+	if (this == &other)
+		return *this;
+
+	std::unique_lock<std::shared_mutex> lock(_mutex, std::defer_lock);
+	std::shared_lock<std::shared_mutex> other_lock(other._mutex, std::defer_lock);
+	std::lock(lock, other_lock);
+
+	_modified = other._modified;
+	_path = other._path;
+	_modified_at = other._modified_at;
+	_write_behind = other._write_behind;
+	_sections = other._sections;
+
+	return *this;
 }
 
 void ini_file::load()
+{
+	const std::unique_lock<std::shared_mutex> lock(_mutex);
+
+	load_internal();
+}
+void ini_file::load_internal()
 {
 	std::error_code ec;
 	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
@@ -31,200 +75,257 @@ void ini_file::load()
 	// Clear when file does not exist too
 	_sections.clear();
 
-	std::ifstream file;
-	if (file.open(_path); !file)
-		return;
+	// Read the entire file in one go and parse it in place, instead of going through the stream line by line
+	std::string data;
+	{
+		std::ifstream file;
+		if (file.open(_path, std::ios::binary | std::ios::ate); !file)
+			return;
+
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		file.read(data.data(), data.size());
+		data.resize(static_cast<size_t>(file.gcount()));
+	}
 
 	_modified = false;
 	_modified_at = modified_at;
 
-	file.imbue(std::locale("en-us.UTF-8"));
-	// Remove BOM (0xefbbbf means 0xfeff)
-	if (file.get() != 0xef || file.get() != 0xbb || file.get() != 0xbf)
-		file.seekg(0, std::ios::beg);
+	parse_ini_data(data, _sections);
+}
 
-	std::string line, section;
-	while (std::getline(file, line))
-	{
-		trim(line);
+bool ini_file::save()
+{
+	const std::unique_lock<std::shared_mutex> lock(_mutex);
 
-		if (line.empty() || line[0] == ';' || line[0] == '/' || line[0] == '#')
-			continue;
+	return save_internal();
+}
+bool ini_file::save_internal()
+{
+	if (!_modified)
+		return true;
 
-		// Read section name
-		if (line[0] == '[')
-		{
-			section = trim(line.substr(0, line.find(']')), " \t[]");
-			continue;
-		}
+	// Reset state even on failure to avoid 'flush_cache' repeatedly trying and failing to save
+	_modified = false;
 
-		// Read section content
-		const auto assign_index = line.find('=');
-		if (assign_index != std::string::npos)
-		{
-			const std::string key = trim(line.substr(0, assign_index));
-			const std::string value = trim(line.substr(assign_index + 1));
+	std::error_code ec;
+	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
+	if (!ec && modified_at > _modified_at)
+		return false; // File exists and was modified on disk and therefore may have different data, so cannot save
 
-			if (value.empty())
-			{
-				_sections[section].insert({ key, {} });
-				continue;
-			}
+	const std::string data = format_ini_data(_sections);
 
-			// Append to key if it already exists
-			ini_file::value &elements = _sections[section][key];
-			for (size_t offset = 0, base = 0, len = value.size(); offset <= len;)
-			{
-				// Treat ",," as an escaped comma and only split on single ","
-				const size_t found = std::min(value.find_first_of(',', offset), len);
-				if (found + 1 < len && value[found + 1] == ',')
-				{
-					offset = found + 2;
-				}
-				else
-				{
-					std::string &element = elements.emplace_back();
-					element.reserve(found - base);
+	// Write to a temporary file first and then replace the actual file with it, so that it is never left partially written
+	std::filesystem::path temp_path = _path;
+	temp_path += L".tmp";
 
-					while (base < found)
-					{
-						const char c = value[base++];
-						element += c;
+	{
+		std::ofstream file(temp_path);
+		if (!file)
+			return false;
 
-						if (c == ',' && base < found && value[base] == ',')
-							base++; // Skip second comma in a ",," escape sequence
-					}
+		file.imbue(std::locale("en-us.UTF-8"));
+		file.write(data.data(), data.size());
 
-					offset = base = found + 1;
-				}
-			}
-		}
-		else
+		// Flush stream to disk before replacing the file
+		file.close();
+
+		if (file.fail())
 		{
-			_sections[section].insert({ line, {} });
+			std::filesystem::remove(temp_path, ec);
+			return false;
 		}
 	}
+
+	if (std::filesystem::rename(temp_path, _path, ec); ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	_modified_at = std::filesystem::last_write_time(_path, ec);
+
+	assert(std::filesystem::file_size(_path, ec) > 0);
+
+	return true;
 }
-bool ini_file::save()
+
+void ini_file::mark_modified()
 {
-	if (!_modified)
-		return true;
+	_write_behind.modified();
 
-	// Reset state even on failure to avoid 'flush_cache' repeatedly trying and failing to save
-	_modified = false;
+	if (_modified)
+		return;
 
-	std::error_code ec;
-	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
-	if (!ec && modified_at > _modified_at)
-		return false; // File exists and was modified on disk and therefore may have different data, so cannot save
+	// Only query the time once at the start of a batch of modifications
+	_modified = true;
+	_modified_at = std::filesystem::file_time_type::clock::now();
 
-	std::stringstream data;
-	std::vector<std::string> section_names, key_names;
+	const std::unique_lock<std::mutex> lock(s_write_behind_mutex);
 
-	section_names.reserve(_sections.size());
-	for (const auto &section : _sections)
-		section_names.push_back(section.first);
+	s_write_behind_pending = true;
+
+	if (s_write_behind_running)
+		return;
 
-	// Sort sections to generate consistent files
-	std::sort(section_names.begin(), section_names.end(),
-		[](std::string a, std::string b) {
-			std::transform(a.begin(), a.end(), a.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(toupper(c)); });
-			std::transform(b.begin(), b.end(), b.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(toupper(c)); });
-			return a < b;
-		});
+	// Keep the module loaded while the thread is running, since it would crash if the module was unloaded underneath it (e.g. when the application releases ReShade before the delay elapsed)
+	HMODULE module = nullptr;
+	if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&s_write_behind_mutex), &module))
+		return; // Modifications are still saved by 'flush_cache' when the runtime is destroyed
 
-	for (const std::string &section_name : section_names)
+	const HANDLE thread = CreateThread(nullptr, 0, [](LPVOID module) -> DWORD {
+		write_behind_thread();
+
+		// Release the reference to this module that was added when the thread was started
+		FreeLibraryAndExitThread(static_cast<HMODULE>(module), 0);
+	}, module, 0, nullptr);
+	if (thread == nullptr)
 	{
-		const auto &keys = _sections.at(section_name);
+		FreeLibrary(module);
+		return;
+	}
 
-		key_names.clear();
-		key_names.reserve(keys.size());
-		for (const auto &key : keys)
-			key_names.push_back(key.first);
+	CloseHandle(thread);
+	s_write_behind_running = true;
+}
 
-		std::sort(key_names.begin(), key_names.end(),
-			[](std::string a, std::string b) {
-				std::transform(a.begin(), a.end(), a.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(toupper(c)); });
-				std::transform(b.begin(), b.end(), b.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(toupper(c)); });
-				return a < b;
-			});
+void ini_file::write_behind_thread()
+{
+	std::unique_lock<std::mutex> lock(s_write_behind_mutex);
+
+	while (s_write_behind_pending)
+	{
+		s_write_behind_pending = false;
+		lock.unlock();
 
-		// Empty section should have been sorted to the top, so do not need to append it before keys
-		if (!section_name.empty())
-			data << '[' << section_name << ']' << '\n';
+		std::this_thread::sleep_for(ini_write_behind::poll_interval);
 
-		for (const std::string &key_name : key_names)
+		bool any_pending = false;
 		{
-			data << key_name << '=';
+			const std::shared_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex);
+
+			const auto now = std::filesystem::file_time_type::clock::now();
 
-			if (const ini_file::value &elements = keys.at(key_name); !elements.empty())
+			for (std::pair<const std::wstring, ini_file> &file : s_ini_cache)
 			{
-				std::string value;
-				for (const std::string &element : elements)
-				{
-					value.reserve(value.size() + element.size() + 1);
-					for (const char c : element)
-						value.append(c == ',' ? 2 : 1, c);
-					value += ','; // Separate multiple values with a comma
-				}
+				const std::unique_lock<std::shared_mutex> file_lock(file.second._mutex);
 
-				// Remove the last comma
-				value.pop_back();
+				if (!file.second._modified)
+					continue;
 
-				data << value;
+				if (file.second._write_behind.due(file.second._modified_at, now))
+				{
+					if (!file.second.save_internal())
+						s_write_behind_failed = true;
+				}
+				else
+				{
+					any_pending = true;
+				}
 			}
-
-			data << '\n';
 		}
 
-		data << '\n';
+		lock.lock();
+		s_write_behind_pending = s_write_behind_pending || any_pending;
 	}
 
-	std::ofstream file(_path);
-	if (!file)
-		return false;
-
-	const std::string str = data.str();
-	file.imbue(std::locale("en-us.UTF-8"));
-	file.write(str.data(), str.size());
-
-	// Flush stream to disk before updating last write time
-	file.close();
-	_modified_at = std::filesystem::last_write_time(_path, ec);
-
-	assert(std::filesystem::file_size(_path, ec) > 0);
-
-	return true;
+	s_write_behind_running = false;
 }
 
 bool ini_file::flush_cache()
 {
 	bool success = true;
 
-	// Save all files that were modified in one second intervals
+	const std::shared_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex);
+
 	for (std::pair<const std::wstring, ini_file> &file : s_ini_cache)
 	{
-		// Check modified status before requesting file time, since the latter is costly and therefore should be avoided when not necessary
-		if (file.second._modified && (std::filesystem::file_time_type::clock::now() - file.second._modified_at) > std::chrono::seconds(1))
-			success &= file.second.save();
+		const std::unique_lock<std::shared_mutex> lock(file.second._mutex);
+
+		success &= file.second.save_internal();
 	}
 
 	return success;
 }
 bool ini_file::flush_cache(const std::filesystem::path &path)
 {
+	const std::shared_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex);
+
 	const auto it = s_ini_cache.find(path);
 	return it != s_ini_cache.end() && it->second.save();
 }
 
+bool ini_file::flush_cache(std::chrono::milliseconds timeout)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	// The shared mutex does not support timed locking, so poll it until the deadline passed instead
+	const auto try_lock_until_deadline = [deadline](auto &lock) {
+		while (!lock.try_lock())
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	};
+
+	std::shared_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex, std::defer_lock);
+	if (!try_lock_until_deadline(cache_lock))
+		return false;
+
+	bool success = true;
+
+	for (std::pair<const std::wstring, ini_file> &file : s_ini_cache)
+	{
+		std::unique_lock<std::shared_mutex> lock(file.second._mutex, std::defer_lock);
+		if (!try_lock_until_deadline(lock))
+		{
+			success = false;
+			continue;
+		}
+
+		success &= file.second.save_internal();
+	}
+
+	return success;
+}
+
+bool ini_file::background_save_failed()
+{
+	return s_write_behind_failed.exchange(false);
+}
+
 ini_file &ini_file::load_cache(const std::filesystem::path &path)
 {
-	const auto it = s_ini_cache.try_emplace(path, path);
-	std::pair<const std::wstring, ini_file> &file = *it.first;
+	const std::wstring key = path.native();
+
+	// Most calls hit a file that is already cached, so only look it up with a shared lock first
+	ini_file *file = nullptr;
+	{
+		const std::shared_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex);
+
+		if (const auto it = s_ini_cache.find(key); it != s_ini_cache.end())
+			file = &it->second;
+	}
+
+	if (file == nullptr)
+	{
+		const std::unique_lock<std::shared_mutex> cache_lock(s_ini_cache_mutex);
+
+		// Another thread may have added the file in the meantime, in which case this does not load it a second time
+		const auto it = s_ini_cache.try_emplace(key, path);
+		if (it.second)
+			return it.first->second;
+
+		file = &it.first->second;
+	}
+
+	const std::unique_lock<std::shared_mutex> lock(file->_mutex);
 
-	// Don't reload file when it was just loaded or there are still modifications pending
-	if (!it.second && !file.second._modified)
-		file.second.load();
+	// Don't reload file when there are still modifications pending
+	if (!file->_modified)
+		file->load_internal();
 
-	return file.second;
+	return *file;
 }
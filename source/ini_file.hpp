@@ -5,10 +5,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <shared_mutex>
 #include <unordered_map>
+#include "ini_file_data.hpp"
 
 extern std::filesystem::path g_reshade_dll_path;
 extern std::filesystem::path g_reshade_base_path;
@@ -34,6 +37,12 @@ public:
 	/// </summary>
 	/// <param name="path">The path to the INI file to access.</param>
 	explicit ini_file(const std::filesystem::path &path);
+	/// <summary>
+	/// Creates a snapshot of another INI file, which is then no longer affected by changes made to the original.
+	/// </summary>
+	/// <remarks>The lock of <paramref name="other"/> is held shared while copying, so this is safe while other threads access it.</remarks>
+	ini_file(const ini_file &other);
+	ini_file &operator=(const ini_file &other);
 
 	/// <summary>
 	/// Gets the path to this INI file.
@@ -45,6 +54,8 @@ public:
 	/// </summary>
 	bool has(const std::string &section, const std::string &key) const
 	{
+		const std::shared_lock<std::shared_mutex> lock(_mutex);
+
 		const auto it1 = _sections.find(section);
 		if (it1 == _sections.end())
 			return false;
@@ -62,6 +73,8 @@ public:
 	template <typename T>
 	bool get(const std::string &section, const std::string &key, T &value) const
 	{
+		const std::shared_lock<std::shared_mutex> lock(_mutex);
+
 		const auto it1 = _sections.find(section);
 		if (it1 == _sections.end())
 			return false;
@@ -74,6 +87,8 @@ public:
 	template <typename T, size_t SIZE>
 	bool get(const std::string &section, const std::string &key, T(&values)[SIZE]) const
 	{
+		const std::shared_lock<std::shared_mutex> lock(_mutex);
+
 		const auto it1 = _sections.find(section);
 		if (it1 == _sections.end())
 			return false;
@@ -87,6 +102,8 @@ public:
 	template <typename T>
 	bool get(const std::string &section, const std::string &key, std::vector<T> &values) const
 	{
+		const std::shared_lock<std::shared_mutex> lock(_mutex);
+
 		const auto it1 = _sections.find(section);
 		if (it1 == _sections.end())
 			return false;
@@ -126,18 +143,20 @@ public:
 	template <>
 	void set(const std::string &section, const std::string &key, const std::string &value)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v.assign(1, value);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	void set(const std::string &section, const std::string &key, std::string &&value)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v.resize(1);
 		v[0] = std::forward<std::string>(value);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::filesystem::path &value)
@@ -147,37 +166,41 @@ public:
 	template <typename T, size_t SIZE>
 	void set(const std::string &section, const std::string &key, const T(&values)[SIZE], const size_t size = SIZE)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v.resize(size);
 		for (size_t i = 0; i < size; ++i)
 			v[i] = std::to_string(values[i]);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::vector<std::string> &values)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v = values;
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	void set(const std::string &section, const std::string &key, std::vector<std::string> &&values)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v = std::forward<std::vector<std::string>>(values);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::vector<std::filesystem::path> &values)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		auto &v = _sections[section][key];
 		v.resize(values.size());
 		for (size_t i = 0; i < values.size(); ++i)
 			v[i] = values[i].u8string();
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 
 	/// <summary>
@@ -187,6 +210,8 @@ public:
 	/// <param name="key"></param>
 	void remove_key(const std::string &section, const std::string &key)
 	{
+		const std::unique_lock<std::shared_mutex> lock(_mutex);
+
 		const auto it = _sections.find(section);
 		if (it != _sections.end())
 			it->second.erase(key);
@@ -202,17 +227,26 @@ public:
 	bool save();
 
 	/// <summary>
-	/// Saves all changes to INI files that were loaded through <see cref="load_cache"/> to disk.
+	/// Saves all changes to INI files that were loaded through <see cref="load_cache"/> to disk immediately, instead of waiting for the background thread to do so.
 	/// </summary>
 	static bool flush_cache();
 	static bool flush_cache(const std::filesystem::path &path);
+	/// <summary>
+	/// Saves all changes to INI files that were loaded through <see cref="load_cache"/> to disk, but skips files that cannot be locked within the specified <paramref name="timeout"/>.
+	/// This is used when the process exits, at which point other threads were terminated already and may have been holding a lock.
+	/// </summary>
+	static bool flush_cache(std::chrono::milliseconds timeout);
+	/// <summary>
+	/// Checks whether the background thread failed to save any INI file since the last call to this.
+	/// </summary>
+	static bool background_save_failed();
 
 	/// <summary>
 	/// Gets the specified INI file from cache or opens it when it was not cached yet.
-	/// WARNING: Reference is only valid until the next 'load_cache' call.
+	/// This may be called from multiple threads simultaneously, and the returned file synchronizes access to its values.
 	/// </summary>
 	/// <param name="path">The path to the INI file to access.</param>
-	/// <returns>A reference to the cached data. This reference is valid until the next call to <see cref="load_cache"/>.</returns>
+	/// <returns>A reference to the cached data. Files are never removed from the cache, so this reference stays valid.</returns>
 	static ini_file &load_cache(const std::filesystem::path &path);
 
 private:
@@ -274,19 +308,19 @@ private:
 		return i < values.size() ? std::filesystem::u8path(values[i]) : std::filesystem::path();
 	}
 
-	/// <summary>
-	/// Describes a single value in an INI file.
-	/// </summary>
-	using value = std::vector<std::string>;
-	/// <summary>
-	/// Describes a section of multiple key/value pairs in an INI file.
-	/// </summary>
-	using section = std::unordered_map<std::string, value>;
+	void load_internal();
+	bool save_internal();
+	void mark_modified();
+	static void write_behind_thread();
 
+	// Readers share the lock, so effect loading threads and the GUI can query values concurrently, while writers get exclusive access
+	mutable std::shared_mutex _mutex;
 	bool _modified = false;
 	std::filesystem::path _path;
+	// Time the file was last loaded or saved, or the time the current batch of modifications began
 	std::filesystem::file_time_type _modified_at;
-	std::unordered_map<std::string, section> _sections;
+	ini_write_behind _write_behind;
+	ini_sections _sections;
 };
 
 namespace reshade
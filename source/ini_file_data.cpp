@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#include "ini_file_data.hpp"
+#include <cctype>
+#include <algorithm>
+
+static inline std::string_view trim_view(std::string_view str, std::string_view chars = " \t")
+{
+	const size_t first = str.find_first_not_of(chars);
+	if (first == std::string_view::npos)
+		return {};
+	return str.substr(first, str.find_last_not_of(chars) - first + 1);
+}
+
+// Names that only differ in case are ordered by their exact spelling, so that the order does not depend on the order of the hash map
+static bool less_case_insensitive(const std::string &a, const std::string &b)
+{
+	const auto less_upper = [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) < std::toupper(static_cast<unsigned char>(b)); };
+	if (std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), less_upper))
+		return true;
+	if (std::lexicographical_compare(b.begin(), b.end(), a.begin(), a.end(), less_upper))
+		return false;
+	return a < b;
+}
+
+void parse_ini_data(std::string_view data, ini_sections &sections)
+{
+	// Remove BOM (0xefbbbf means 0xfeff)
+	if (data.size() >= 3 && data.compare(0, 3, "\xef\xbb\xbf") == 0)
+		data.remove_prefix(3);
+
+	std::string_view section_name;
+	ini_section *current_section = nullptr;
+
+	while (!data.empty())
+	{
+		const size_t line_end = std::min(data.find('\n'), data.size());
+		std::string_view line = data.substr(0, line_end);
+		data.remove_prefix(std::min(line_end + 1, data.size()));
+
+		// Convert line endings the same way a stream opened in text mode would
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+
+		line = trim_view(line);
+
+		if (line.empty() || line[0] == ';' || line[0] == '/' || line[0] == '#')
+			continue;
+
+		// Read section name
+		if (line[0] == '[')
+		{
+			section_name = trim_view(line.substr(0, line.find(']')), " \t[]");
+			current_section = nullptr;
+			continue;
+		}
+
+		// Only add a section once it has content, and look it up just once for all its keys
+		if (current_section == nullptr)
+			current_section = &sections[std::string(section_name)];
+
+		// Read section content
+		const auto assign_index = line.find('=');
+		if (assign_index != std::string_view::npos)
+		{
+			const std::string_view key = trim_view(line.substr(0, assign_index));
+			const std::string_view value = trim_view(line.substr(assign_index + 1));
+
+			// Append to key if it already exists
+			ini_value &elements = current_section->try_emplace(std::string(key)).first->second;
+			if (value.empty())
+				continue;
+
+			for (size_t offset = 0, base = 0, len = value.size(); offset <= len;)
+			{
+				// Treat ",," as an escaped comma and only split on single ","
+				const size_t found = std::min(value.find_first_of(',', offset), len);
+				if (found + 1 < len && value[found + 1] == ',')
+				{
+					offset = found + 2;
+				}
+				else
+				{
+					// Only need to copy character by character if the element contains escaped commas
+					if (offset == base)
+					{
+						elements.emplace_back(value.substr(base, found - base));
+					}
+					else
+					{
+						std::string &element = elements.emplace_back();
+						element.reserve(found - base);
+
+						while (base < found)
+						{
+							const char c = value[base++];
+							element += c;
+
+							if (c == ',' && base < found && value[base] == ',')
+								base++; // Skip second comma in a ",," escape sequence
+						}
+					}
+
+					offset = base = found + 1;
+				}
+			}
+		}
+		else
+		{
+			current_section->try_emplace(std::string(line));
+		}
+	}
+}
+
+std::string format_ini_data(const ini_sections &sections)
+{
+	std::string data;
+	std::vector<std::string> section_names, key_names;
+
+	section_names.reserve(sections.size());
+	for (const auto &section : sections)
+		section_names.push_back(section.first);
+
+	// Sort sections to generate consistent files
+	std::sort(section_names.begin(), section_names.end(), less_case_insensitive);
+
+	for (const std::string &section_name : section_names)
+	{
+		const ini_section &keys = sections.at(section_name);
+
+		key_names.clear();
+		key_names.reserve(keys.size());
+		for (const auto &key : keys)
+			key_names.push_back(key.first);
+
+		std::sort(key_names.begin(), key_names.end(), less_case_insensitive);
+
+		// Empty section should have been sorted to the top, so do not need to append it before keys
+		if (!section_name.empty())
+			data += '[' + section_name + ']' + '\n';
+
+		for (const std::string &key_name : key_names)
+		{
+			data += key_name;
+			data += '=';
+
+			if (const ini_value &elements = keys.at(key_name); !elements.empty())
+			{
+				for (const std::string &element : elements)
+				{
+					for (const char c : element)
+						data.append(c == ',' ? 2 : 1, c);
+					data += ','; // Separate multiple values with a comma
+				}
+
+				// Remove the last comma
+				data.pop_back();
+			}
+
+			data += '\n';
+		}
+
+		data += '\n';
+	}
+
+	return data;
+}
+
+bool ini_write_behind::due(time_point first_modified_at, time_point now)
+{
+	// Restart the quiet period whenever the file was modified since it was last checked
+	if (_modification_count != _last_seen_modification_count)
+	{
+		_last_seen_modification_count = _modification_count;
+		_quiet_since = now;
+	}
+
+	// Save once modifications stopped for a while, but do not delay saving indefinitely if they never stop
+	return (now - _quiet_since) >= quiet_period || (now - first_modified_at) >= max_delay;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+
+/// <summary>
+/// Describes a single value in an INI file, which is a list of elements that are separated by commas in the file.
+/// </summary>
+using ini_value = std::vector<std::string>;
+/// <summary>
+/// Describes a section of multiple key/value pairs in an INI file.
+/// </summary>
+using ini_section = std::unordered_map<std::string, ini_value>;
+/// <summary>
+/// Describes all sections in an INI file, with keys that are not in any section stored in the section with an empty name.
+/// </summary>
+using ini_sections = std::unordered_map<std::string, ini_section>;
+
+/// <summary>
+/// Parses the contents of an INI file in a single pass and adds all sections and keys to <paramref name="sections"/>.
+/// Values of keys that appear multiple times are appended, and a ",," sequence in a value is an escaped comma that does not separate elements.
+/// </summary>
+/// <param name="data">Contents of the INI file, with or without a UTF-8 byte order mark and with either LF or CRLF line endings.</param>
+/// <param name="sections">Sections to add to.</param>
+void parse_ini_data(std::string_view data, ini_sections &sections);
+
+/// <summary>
+/// Formats <paramref name="sections"/> into the contents of an INI file that <see cref="parse_ini_data"/> reads back the same.
+/// Sections and keys are sorted case-insensitively, so that the same values always result in the same file.
+/// </summary>
+std::string format_ini_data(const ini_sections &sections);
+
+/// <summary>
+/// Decides when the background thread writes a modified INI file to disk, so that a burst of changes (e.g. while dragging a slider) only results in a single write.
+/// </summary>
+class ini_write_behind
+{
+public:
+	using time_point = std::filesystem::file_time_type;
+
+	/// <summary>
+	/// Interval at which the background thread checks modified files.
+	/// </summary>
+	static constexpr auto poll_interval = std::chrono::milliseconds(100);
+	/// <summary>
+	/// A modified file is saved once it was not modified for this long ...
+	/// </summary>
+	static constexpr auto quiet_period = std::chrono::milliseconds(1000);
+	/// <summary>
+	/// ... or at the latest this long after the first modification, so that changes still reach disk if they never stop.
+	/// </summary>
+	static constexpr auto max_delay = std::chrono::seconds(5);
+
+	/// <summary>
+	/// Counts a modification of the file. Modifications are only counted, so that setting a value does not have to query the time.
+	/// </summary>
+	void modified() { _modification_count++; }
+
+	/// <summary>
+	/// Checks whether a file with pending modifications should be saved now. This is called by the background thread every <see cref="poll_interval"/>.
+	/// </summary>
+	/// <param name="first_modified_at">Time the current batch of modifications began.</param>
+	/// <param name="now">Current time.</param>
+	bool due(time_point first_modified_at, time_point now);
+
+private:
+	uint32_t _modification_count = 0;
+	uint32_t _last_seen_modification_count = 0;
+	time_point _quiet_since;
+};
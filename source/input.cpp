@@ -7,6 +7,7 @@
 #include "dll_log.hpp"
 #include "hook_manager.hpp"
 #include <algorithm>
+#include <shared_mutex>
 #include <unordered_map>
 #include <Windows.h>
 
@@ -139,11 +140,11 @@ bool reshade::input::handle_window_message(const void *message_data)
 	// Calculate window client mouse position
 	ScreenToClient(static_cast<HWND>(input->_window), &details.pt);
 
-	// Prevent input threads from modifying input while it is accessed elsewhere
-	const std::unique_lock<std::shared_mutex> input_lock = input->lock();
+	// Prevent multiple input threads from modifying input at the same time (this is never held for long, since the render thread only locks it to swap in 'next_frame')
+	const std::unique_lock<std::mutex> input_lock(input->_mutex);
 
-	input->_mouse_position[0] = details.pt.x;
-	input->_mouse_position[1] = details.pt.y;
+	input->_pending_state.mouse_position[0] = details.pt.x;
+	input->_pending_state.mouse_position[1] = details.pt.y;
 
 	switch (details.message)
 	{
@@ -162,30 +163,30 @@ bool reshade::input::handle_window_message(const void *message_data)
 				break; // Input is already handled (since legacy mouse messages are enabled), so nothing to do here
 
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_DOWN)
-				input->_keys[VK_LBUTTON] = 0x88;
+				input->_pending_state.key_down(VK_LBUTTON);
 			else if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_UP)
-				input->_keys[VK_LBUTTON] = 0x08;
+				input->_pending_state.key_up(VK_LBUTTON);
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_DOWN)
-				input->_keys[VK_RBUTTON] = 0x88;
+				input->_pending_state.key_down(VK_RBUTTON);
 			else if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_UP)
-				input->_keys[VK_RBUTTON] = 0x08;
+				input->_pending_state.key_up(VK_RBUTTON);
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_DOWN)
-				input->_keys[VK_MBUTTON] = 0x88;
+				input->_pending_state.key_down(VK_MBUTTON);
 			else if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_UP)
-				input->_keys[VK_MBUTTON] = 0x08;
+				input->_pending_state.key_up(VK_MBUTTON);
 
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_BUTTON_4_DOWN)
-				input->_keys[VK_XBUTTON1] = 0x88;
+				input->_pending_state.key_down(VK_XBUTTON1);
 			else if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_BUTTON_4_UP)
-				input->_keys[VK_XBUTTON1] = 0x08;
+				input->_pending_state.key_up(VK_XBUTTON1);
 
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_BUTTON_5_DOWN)
-				input->_keys[VK_XBUTTON2] = 0x88;
+				input->_pending_state.key_down(VK_XBUTTON2);
 			else if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_BUTTON_5_UP)
-				input->_keys[VK_XBUTTON2] = 0x08;
+				input->_pending_state.key_up(VK_XBUTTON2);
 
 			if (raw_data.data.mouse.usButtonFlags & RI_MOUSE_WHEEL)
-				input->_mouse_wheel_delta += static_cast<short>(raw_data.data.mouse.usButtonData) / WHEEL_DELTA;
+				input->_pending_state.mouse_wheel_delta += static_cast<short>(raw_data.data.mouse.usButtonData) / WHEEL_DELTA;
 			break;
 		case RIM_TYPEKEYBOARD:
 			if (raw_data.data.keyboard.VKey == 0)
@@ -193,7 +194,7 @@ bool reshade::input::handle_window_message(const void *message_data)
 
 			is_keyboard_message = true;
 			// Do not block key up messages if the key down one was not blocked previously
-			if (input->_block_keyboard && (raw_data.data.keyboard.Flags & RI_KEY_BREAK) != 0 && raw_data.data.keyboard.VKey < 0xFF && (input->_keys[raw_data.data.keyboard.VKey] & 0x04) == 0)
+			if (input->_block_keyboard && (raw_data.data.keyboard.Flags & RI_KEY_BREAK) != 0 && raw_data.data.keyboard.VKey < 0xFF && (input->_pending_state.keys[raw_data.data.keyboard.VKey] & 0x04) == 0)
 				is_keyboard_message = false;
 
 			if (raw_input_window == s_raw_input_windows.end() || (raw_input_window->second & 0x1) == 0)
@@ -201,68 +202,68 @@ bool reshade::input::handle_window_message(const void *message_data)
 
 			// Filter out prefix messages without a key code
 			if (raw_data.data.keyboard.VKey < 0xFF)
-				input->_keys[raw_data.data.keyboard.VKey] = (raw_data.data.keyboard.Flags & RI_KEY_BREAK) == 0 ? 0x88 : 0x08,
+				(raw_data.data.keyboard.Flags & RI_KEY_BREAK) == 0 ? input->_pending_state.key_down(raw_data.data.keyboard.VKey) : input->_pending_state.key_up(raw_data.data.keyboard.VKey),
 				input->_keys_time[raw_data.data.keyboard.VKey] = details.time;
 
 			// No 'WM_CHAR' messages are sent if legacy keyboard messages are disabled, so need to generate text input manually here
 			// Cannot use the ToUnicode function always as it seems to reset dead key state and thus calling it can break subsequent application input, should be fine here though since the application is already explicitly using raw input
 			// Since Windows 10 version 1607 this supports the 0x2 flag, which prevents the keyboard state from being changed, so it is not a problem there anymore either way
-			if (WCHAR ch[3] = {}; (raw_data.data.keyboard.Flags & RI_KEY_BREAK) == 0 && ToUnicode(raw_data.data.keyboard.VKey, raw_data.data.keyboard.MakeCode, input->_keys, ch, 2, 0x2))
-				input->_text_input += ch;
+			if (WCHAR ch[3] = {}; (raw_data.data.keyboard.Flags & RI_KEY_BREAK) == 0 && ToUnicode(raw_data.data.keyboard.VKey, raw_data.data.keyboard.MakeCode, input->_pending_state.keys, ch, 2, 0x2))
+				input->_pending_state.text_input += ch;
 			break;
 		}
 		break;
 	case WM_CHAR:
-		input->_text_input += static_cast<wchar_t>(details.wParam);
+		input->_pending_state.text_input += static_cast<wchar_t>(details.wParam);
 		break;
 	case WM_KEYDOWN:
 	case WM_SYSKEYDOWN:
-		assert(details.wParam > 0 && details.wParam < ARRAYSIZE(input->_keys));
-		input->_keys[details.wParam] = 0x88;
+		assert(details.wParam > 0 && details.wParam < ARRAYSIZE(input->_pending_state.keys));
+		input->_pending_state.key_down(static_cast<unsigned int>(details.wParam));
 		input->_keys_time[details.wParam] = details.time;
 		if (input->_block_keyboard)
-			input->_keys[details.wParam] |= 0x04;
+			input->_pending_state.keys[details.wParam] |= 0x04;
 		break;
 	case WM_KEYUP:
 	case WM_SYSKEYUP:
-		assert(details.wParam > 0 && details.wParam < ARRAYSIZE(input->_keys));
+		assert(details.wParam > 0 && details.wParam < ARRAYSIZE(input->_pending_state.keys));
 		// Do not block key up messages if the key down one was not blocked previously (so key does not get stuck for the application)
-		if (input->_block_keyboard && (input->_keys[details.wParam] & 0x04) == 0)
+		if (input->_block_keyboard && (input->_pending_state.keys[details.wParam] & 0x04) == 0)
 			is_keyboard_message = false;
-		input->_keys[details.wParam] = 0x08;
+		input->_pending_state.key_up(static_cast<unsigned int>(details.wParam));
 		input->_keys_time[details.wParam] = details.time;
 		break;
 	case WM_LBUTTONDOWN:
 	case WM_LBUTTONDBLCLK: // Double clicking generates this sequence: WM_LBUTTONDOWN -> WM_LBUTTONUP -> WM_LBUTTONDBLCLK -> WM_LBUTTONUP, so handle it like a normal down
-		input->_keys[VK_LBUTTON] = 0x88;
+		input->_pending_state.key_down(VK_LBUTTON);
 		break;
 	case WM_LBUTTONUP:
-		input->_keys[VK_LBUTTON] = 0x08;
+		input->_pending_state.key_up(VK_LBUTTON);
 		break;
 	case WM_RBUTTONDOWN:
 	case WM_RBUTTONDBLCLK:
-		input->_keys[VK_RBUTTON] = 0x88;
+		input->_pending_state.key_down(VK_RBUTTON);
 		break;
 	case WM_RBUTTONUP:
-		input->_keys[VK_RBUTTON] = 0x08;
+		input->_pending_state.key_up(VK_RBUTTON);
 		break;
 	case WM_MBUTTONDOWN:
 	case WM_MBUTTONDBLCLK:
-		input->_keys[VK_MBUTTON] = 0x88;
+		input->_pending_state.key_down(VK_MBUTTON);
 		break;
 	case WM_MBUTTONUP:
-		input->_keys[VK_MBUTTON] = 0x08;
+		input->_pending_state.key_up(VK_MBUTTON);
 		break;
 	case WM_MOUSEWHEEL:
-		input->_mouse_wheel_delta += GET_WHEEL_DELTA_WPARAM(details.wParam) / WHEEL_DELTA;
+		input->_pending_state.mouse_wheel_delta += GET_WHEEL_DELTA_WPARAM(details.wParam) / WHEEL_DELTA;
 		break;
 	case WM_XBUTTONDOWN:
 		assert(HIWORD(details.wParam) == XBUTTON1 || HIWORD(details.wParam) == XBUTTON2);
-		input->_keys[VK_XBUTTON1 + (HIWORD(details.wParam) - XBUTTON1)] = 0x88;
+		input->_pending_state.key_down(VK_XBUTTON1 + (HIWORD(details.wParam) - XBUTTON1));
 		break;
 	case WM_XBUTTONUP:
 		assert(HIWORD(details.wParam) == XBUTTON1 || HIWORD(details.wParam) == XBUTTON2);
-		input->_keys[VK_XBUTTON1 + (HIWORD(details.wParam) - XBUTTON1)] = 0x08;
+		input->_pending_state.key_up(VK_XBUTTON1 + (HIWORD(details.wParam) - XBUTTON1));
 		break;
 	}
 
@@ -271,13 +272,13 @@ bool reshade::input::handle_window_message(const void *message_data)
 
 bool reshade::input::is_key_down(unsigned int keycode) const
 {
-	assert(keycode < ARRAYSIZE(_keys));
-	return keycode < ARRAYSIZE(_keys) && (_keys[keycode] & 0x80) == 0x80;
+	assert(keycode < ARRAYSIZE(_frame_state.keys));
+	return _frame_state.is_key_down(keycode);
 }
 bool reshade::input::is_key_pressed(unsigned int keycode) const
 {
-	assert(keycode < ARRAYSIZE(_keys));
-	return keycode > 0 && keycode < ARRAYSIZE(_keys) && (_keys[keycode] & 0x88) == 0x88;
+	assert(keycode < ARRAYSIZE(_frame_state.keys));
+	return _frame_state.is_key_pressed(keycode);
 }
 bool reshade::input::is_key_pressed(unsigned int keycode, bool ctrl, bool shift, bool alt, bool force_modifiers) const
 {
@@ -292,14 +293,14 @@ bool reshade::input::is_key_pressed(unsigned int keycode, bool ctrl, bool shift,
 }
 bool reshade::input::is_key_released(unsigned int keycode) const
 {
-	assert(keycode < ARRAYSIZE(_keys));
-	return keycode > 0 && keycode < ARRAYSIZE(_keys) && (_keys[keycode] & 0x88) == 0x08;
+	assert(keycode < ARRAYSIZE(_frame_state.keys));
+	return _frame_state.is_key_released(keycode);
 }
 
 bool reshade::input::is_any_key_down() const
 {
 	// Skip mouse buttons
-	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_keys); i++)
+	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_frame_state.keys); i++)
 		if (is_key_down(i))
 			return true;
 	return false;
@@ -315,14 +316,14 @@ bool reshade::input::is_any_key_released() const
 
 unsigned int reshade::input::last_key_pressed() const
 {
-	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_keys); i++)
+	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_frame_state.keys); i++)
 		if (is_key_pressed(i))
 			return i;
 	return 0;
 }
 unsigned int reshade::input::last_key_released() const
 {
-	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_keys); i++)
+	for (unsigned int i = VK_XBUTTON2 + 1; i < ARRAYSIZE(_frame_state.keys); i++)
 		if (is_key_released(i))
 			return i;
 	return 0;
@@ -370,8 +371,7 @@ void reshade::input::next_frame()
 {
 	_frame_count++;
 
-	for (auto &state : _keys)
-		state &= ~0x08;
+	const std::unique_lock<std::mutex> lock(_mutex);
 
 	// Reset any pressed down key states (apart from mouse buttons) that have not been updated for more than 5 seconds
 	// Do not check mouse buttons here, since 'GetAsyncKeyState' always returns the state of the physical mouse buttons, not the logical ones in case they were remapped
@@ -379,29 +379,32 @@ void reshade::input::next_frame()
 	// And time is not tracked for mouse buttons anyway
 	const DWORD time = GetTickCount();
 	for (unsigned int i = 8; i < 256; ++i)
-		if ((_keys[i] & 0x80) != 0 &&
+		if ((_pending_state.keys[i] & 0x80) != 0 &&
 			(time - _keys_time[i]) > 5000 &&
 			(GetAsyncKeyState(i) & 0x8000) == 0)
-			(_keys[i] = 0x08);
-
-	_text_input.clear();
-	_mouse_wheel_delta = 0;
-	_last_mouse_position[0] = _mouse_position[0];
-	_last_mouse_position[1] = _mouse_position[1];
+			_pending_state.key_up(i);
 
 	// Update caps lock state
-	_keys[VK_CAPITAL] |= GetKeyState(VK_CAPITAL) & 0x1;
+	_pending_state.keys[VK_CAPITAL] |= GetKeyState(VK_CAPITAL) & 0x1;
 
 	// Update modifier key state
-	if ((_keys[VK_MENU] & 0x88) != 0 &&
+	if ((_pending_state.keys[VK_MENU] & 0x80) != 0 &&
 		(GetKeyState(VK_MENU) & 0x8000) == 0)
-		(_keys[VK_MENU] = 0x08);
+		_pending_state.key_up(VK_MENU);
 
 	// Update print screen state (there is no key down message, but the key up one is received via the message queue)
-	if ((_keys[VK_SNAPSHOT] & 0x80) == 0 &&
+	if ((_pending_state.keys[VK_SNAPSHOT] & 0x80) == 0 &&
 		(GetAsyncKeyState(VK_SNAPSHOT) & 0x8000) != 0)
-		(_keys[VK_SNAPSHOT] = 0x88),
+		_pending_state.key_down(VK_SNAPSHOT),
 		(_keys_time[VK_SNAPSHOT] = time);
+
+	// Publish all input received since the last frame as the new snapshot, which add-ons may be reading from other threads
+	const std::unique_lock<std::shared_mutex> frame_lock(_frame_mutex);
+
+	_last_mouse_position[0] = _frame_state.mouse_position[0];
+	_last_mouse_position[1] = _frame_state.mouse_position[1];
+
+	_pending_state.publish(_frame_state);
 }
 
 std::string reshade::input::key_name(unsigned int keycode)
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include "input_state.hpp"
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <shared_mutex>
@@ -37,7 +40,13 @@ namespace reshade
 
 		window_handle get_window_handle() const { return _window; }
 
-		// Before accessing input data with any of the member functions below, first call "lock()" and keep the returned object alive while accessing it.
+		// The member functions below read a snapshot of the input state that is only updated in "next_frame()", so they always see consistent state during a frame.
+		// The thread calling "next_frame()" can call them without locking, all other threads have to hold the lock returned by "lock_frame_state()" while doing so.
+
+		/// <summary>
+		/// Locks the input snapshot for reading, so that it is not replaced by "next_frame()" on another thread while it is being queried.
+		/// </summary>
+		std::shared_lock<std::shared_mutex> lock_frame_state() const { return std::shared_lock<std::shared_mutex>(_frame_mutex); }
 
 		bool is_key_down(unsigned int keycode) const;
 		bool is_key_pressed(unsigned int keycode) const;
@@ -55,16 +64,16 @@ namespace reshade
 		bool is_any_mouse_button_down() const;
 		bool is_any_mouse_button_pressed() const;
 		bool is_any_mouse_button_released() const;
-		short mouse_wheel_delta() const { return _mouse_wheel_delta; }
-		int mouse_movement_delta_x() const { return _mouse_position[0] - _last_mouse_position[0]; }
-		int mouse_movement_delta_y() const { return _mouse_position[1] - _last_mouse_position[1]; }
-		unsigned int mouse_position_x() const { return _mouse_position[0]; }
-		unsigned int mouse_position_y() const { return _mouse_position[1]; }
+		short mouse_wheel_delta() const { return _frame_state.mouse_wheel_delta; }
+		int mouse_movement_delta_x() const { return _frame_state.mouse_position[0] - _last_mouse_position[0]; }
+		int mouse_movement_delta_y() const { return _frame_state.mouse_position[1] - _last_mouse_position[1]; }
+		unsigned int mouse_position_x() const { return _frame_state.mouse_position[0]; }
+		unsigned int mouse_position_y() const { return _frame_state.mouse_position[1]; }
 
 		/// <summary>
 		/// Returns the character input as captured by 'WM_CHAR' for the current frame.
 		/// </summary>
-		const std::wstring &text_input() const { return _text_input; }
+		const std::wstring &text_input() const { return _frame_state.text_input; }
 
 		/// <summary>
 		/// Set to <c>true</c> to prevent mouse input window messages from reaching the application.
@@ -77,15 +86,9 @@ namespace reshade
 		void block_keyboard_input(bool enable) { _block_keyboard = enable; }
 		bool is_blocking_keyboard_input() const { return _block_keyboard; }
 
-		/// <summary>
-		/// Locks access to the input data to the current thread.
-		/// </summary>
-		/// <returns>A RAII object holding the lock, which releases it after going out of scope.</returns>
-		auto lock() { return std::unique_lock<std::shared_mutex>(_mutex); }
-
 		/// <summary>
 		/// Notifies the input manager to advance a frame.
-		/// This updates input state to e.g. track whether a key was pressed this frame or before.
+		/// This publishes all input that was received since the last call as the new snapshot that the member functions above read from.
 		/// </summary>
 		void next_frame();
 
@@ -108,16 +111,18 @@ namespace reshade
 		static bool handle_window_message(const void *message_data);
 
 	private:
-		std::shared_mutex _mutex;
 		window_handle _window;
-		bool _block_mouse = false;
-		bool _block_keyboard = false;
-		uint8_t _keys[256] = {};
+		std::atomic<bool> _block_mouse = false;
+		std::atomic<bool> _block_keyboard = false;
+		std::atomic<uint64_t> _frame_count = 0; // Keep track of frame count to identify windows with a lot of rendering
+
+		// Input received from window messages is accumulated in this state, which is only held locked briefly by the message thread and during the swap in 'next_frame'
+		std::mutex _mutex;
+		input_state _pending_state;
 		unsigned int _keys_time[256] = {};
-		short _mouse_wheel_delta = 0;
-		unsigned int _mouse_position[2] = {};
+		// Snapshot of the pending state at the last frame, which is only written by the thread calling 'next_frame' while holding the frame lock exclusively
+		mutable std::shared_mutex _frame_mutex;
+		input_state _frame_state;
 		unsigned int _last_mouse_position[2] = {};
-		uint64_t _frame_count = 0; // Keep track of frame count to identify windows with a lot of rendering
-		std::wstring _text_input;
 	};
 }
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace reshade
+{
+	/// <summary>
+	/// Keyboard and mouse state of a window, either accumulated from input messages as they arrive or published from those as the snapshot of a frame.
+	/// </summary>
+	struct input_state
+	{
+		// Bit 0x80 is set while the key is down, 0x08 if it was pressed and 0x10 if it was released during the frame (both can be set if it was tapped quickly), 0x04 if the key down message was blocked and 0x01 if the key is toggled
+		uint8_t keys[256] = {};
+		short mouse_wheel_delta = 0;
+		unsigned int mouse_position[2] = {};
+		std::wstring text_input;
+
+		void key_down(unsigned int keycode)
+		{
+			// Keep the released flag, so that releasing and pressing a key again within a frame is not lost
+			keys[keycode] = 0x88 | (keys[keycode] & 0x10);
+		}
+		void key_up(unsigned int keycode)
+		{
+			// Keep the pressed flag, so that a key that was pressed and released within a frame is still reported as pressed
+			keys[keycode] = 0x10 | (keys[keycode] & 0x08);
+		}
+
+		bool is_key_down(unsigned int keycode) const { return keycode < std::size(keys) && (keys[keycode] & 0x80) != 0; }
+		bool is_key_pressed(unsigned int keycode) const { return keycode > 0 && keycode < std::size(keys) && (keys[keycode] & 0x08) != 0; }
+		bool is_key_released(unsigned int keycode) const { return keycode > 0 && keycode < std::size(keys) && (keys[keycode] & 0x10) != 0; }
+
+		/// <summary>
+		/// Copies all input accumulated in this state to the <paramref name="snapshot"/> of a frame and starts accumulating input for the next frame.
+		/// Only which keys are held down or toggled and the mouse position carry over, key presses and releases, the mouse wheel delta and text input are only reported in a single snapshot.
+		/// </summary>
+		void publish(input_state &snapshot)
+		{
+			std::memcpy(snapshot.keys, keys, sizeof(keys));
+			snapshot.mouse_wheel_delta = mouse_wheel_delta;
+			snapshot.mouse_position[0] = mouse_position[0];
+			snapshot.mouse_position[1] = mouse_position[1];
+			snapshot.text_input.swap(text_input);
+
+			for (uint8_t &state : keys)
+				state &= ~(0x08 | 0x10);
+
+			text_input.clear();
+			mouse_wheel_delta = 0;
+		}
+	};
+}
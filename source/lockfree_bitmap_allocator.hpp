@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2021 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// <summary>
+/// A lock-free allocator of equally sized slots (e.g. descriptors in a descriptor heap), which are organized in blocks of <see cref="BLOCK_SIZE"/> slots with an occupancy bitmap each.
+/// The memory backing the blocks is managed by the owner, which adds a new block whenever allocation fails. Blocks are never removed before the allocator is destroyed.
+/// </summary>
+class lockfree_bitmap_allocator
+{
+public:
+	static constexpr uint32_t BLOCK_SIZE = 1024;
+
+private:
+	struct block
+	{
+		explicit block(uintptr_t base) : base(base) {}
+
+		const uintptr_t base;
+		// Index of a word in the bitmap that is likely to have free bits, to avoid scanning full words from the start every time
+		std::atomic<uint32_t> hint = 0;
+		// Bit is set if the corresponding slot is in use
+		std::atomic<uint64_t> bitmap[BLOCK_SIZE / 64] = {};
+	};
+
+	/// <summary>
+	/// Immutable list of blocks, which is replaced as a whole when a block is added, so that it can be read without locking.
+	/// </summary>
+	struct block_list
+	{
+		// Blocks in the order they were added, which is the order they are allocated from
+		std::vector<block *> blocks;
+		// Blocks sorted by base address, to look up the block a slot belongs to with a binary search
+		std::vector<block *> sorted_blocks;
+	};
+
+public:
+	explicit lockfree_bitmap_allocator(size_t stride) : _stride(stride) {}
+
+	/// <summary>
+	/// Allocates a free slot from any of the existing blocks.
+	/// </summary>
+	/// <param name="address">Set to the address of the allocated slot.</param>
+	/// <returns><c>true</c> if a slot was allocated, or <c>false</c> if all blocks are full (in which case a new one should be added).</returns>
+	bool allocate(uintptr_t &address)
+	{
+		const block_list *const list = _list.load(std::memory_order_acquire);
+		if (list == nullptr)
+			return false;
+
+		const size_t num_blocks = list->blocks.size();
+		const size_t start_block_index = _current_block_index.load(std::memory_order_relaxed);
+
+		// Start with the block that the last allocation succeeded in, since the blocks before it were probably full
+		for (size_t i = 0; i < num_blocks; ++i)
+		{
+			const size_t block_index = (start_block_index + i) % num_blocks;
+			block &block = *list->blocks[block_index];
+
+			if (uint32_t index; allocate_in_block(block, index))
+			{
+				if (block_index != start_block_index)
+					_current_block_index.store(block_index, std::memory_order_relaxed);
+
+				address = block.base + index * _stride;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Frees a slot that was previously allocated.
+	/// </summary>
+	/// <param name="address">The address of the slot to free.</param>
+	/// <returns><c>true</c> if the slot belonged to this allocator and was freed, <c>false</c> otherwise.</returns>
+	bool free(uintptr_t address)
+	{
+		block *const block = find_block(address);
+		if (block == nullptr)
+			return false;
+
+		const size_t index = (address - block->base) / _stride;
+		const uint32_t word_index = static_cast<uint32_t>(index / 64);
+		const uint64_t mask = 1ull << (index % 64);
+
+		const uint64_t prev_bits = block->bitmap[word_index].fetch_and(~mask, std::memory_order_release);
+		assert((prev_bits & mask) != 0); // Slot was freed twice
+		(void)prev_bits;
+
+		// Point the next allocation in this block at the word that has a free bit now
+		block->hint.store(word_index, std::memory_order_relaxed);
+		return true;
+	}
+
+	/// <summary>
+	/// Checks whether the specified <paramref name="address"/> falls into any of the blocks of this allocator.
+	/// </summary>
+	bool contains(uintptr_t address) const
+	{
+		return find_block(address) != nullptr;
+	}
+
+	/// <summary>
+	/// Adds a new block of <see cref="BLOCK_SIZE"/> free slots starting at the specified <paramref name="base"/> address.
+	/// This may be called while other threads are allocating or freeing slots.
+	/// </summary>
+	void add_block(uintptr_t base)
+	{
+		const std::unique_lock<std::mutex> lock(_mutex);
+
+		block *const new_block = _blocks.emplace_back(std::make_unique<block>(base)).get();
+
+		auto new_list = std::make_unique<block_list>();
+		if (const block_list *const list = _list.load(std::memory_order_relaxed); list != nullptr)
+			*new_list = *list;
+		new_list->blocks.push_back(new_block);
+		new_list->sorted_blocks.insert(
+			std::upper_bound(new_list->sorted_blocks.begin(), new_list->sorted_blocks.end(), base,
+				[](uintptr_t address, const block *block) { return address < block->base; }),
+			new_block);
+
+		// Keep the previous list alive, since other threads may still be reading it
+		_list.store(_lists.emplace_back(std::move(new_list)).get(), std::memory_order_release);
+
+		// Allocate from the new block first, since all others are likely full
+		_current_block_index.store(_blocks.size() - 1, std::memory_order_relaxed);
+	}
+
+private:
+	block *find_block(uintptr_t address) const
+	{
+		const block_list *const list = _list.load(std::memory_order_acquire);
+		if (list == nullptr)
+			return nullptr;
+
+		// Find the last block that starts at or before the address
+		const auto it = std::upper_bound(list->sorted_blocks.begin(), list->sorted_blocks.end(), address,
+			[](uintptr_t address, const block *block) { return address < block->base; });
+		if (it == list->sorted_blocks.begin())
+			return nullptr;
+
+		block *const block = *(it - 1);
+		if (address >= block->base + BLOCK_SIZE * _stride)
+			return nullptr;
+
+		return block;
+	}
+
+	static bool allocate_in_block(block &block, uint32_t &index)
+	{
+		constexpr uint32_t num_words = BLOCK_SIZE / 64;
+
+		const uint32_t hint = block.hint.load(std::memory_order_relaxed);
+
+		for (uint32_t i = 0; i < num_words; ++i)
+		{
+			const uint32_t word_index = (hint + i) % num_words;
+
+			for (uint64_t bits = block.bitmap[word_index].load(std::memory_order_relaxed); bits != ~0ull;)
+			{
+				const uint32_t bit_index = find_first_set(~bits);
+
+				// Mark this slot as being in use, unless another thread changed the word in the meantime (in which case try again with the updated bits)
+				if (block.bitmap[word_index].compare_exchange_weak(bits, bits | (1ull << bit_index), std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					if (word_index != hint)
+						block.hint.store(word_index, std::memory_order_relaxed);
+
+					index = word_index * 64 + bit_index;
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	static inline uint32_t find_first_set(uint64_t value)
+	{
+		assert(value != 0);
+#ifdef _MSC_VER
+		unsigned long index;
+#ifdef _WIN64
+		_BitScanForward64(&index, value);
+#else
+		if (!_BitScanForward(&index, static_cast<unsigned long>(value)))
+			_BitScanForward(&index, static_cast<unsigned long>(value >> 32)), index += 32;
+#endif
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	const size_t _stride;
+	std::atomic<size_t> _current_block_index = 0;
+	std::atomic<const block_list *> _list = nullptr;
+	// Ownership of all blocks and lists that were ever created, guarded by the mutex
+	std::mutex _mutex;
+	std::vector<std::unique_ptr<block>> _blocks;
+	std::vector<std::unique_ptr<const block_list>> _lists;
+};
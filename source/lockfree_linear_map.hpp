@@ -8,10 +8,12 @@
 #include <atomic>
 #include <utility>
 #include <cassert>
+#include <algorithm>
+#include <functional>
 
 /// <summary>
-/// A simple lock-free linear search table.
-/// The key values "one" and "zero" hold a special meaning (see <see cref="no_value"/> and <see cref="update_value"/>), so do not use them.
+/// A lock-free hash table using linear probing, which grows by chaining additional tables of twice the size when it runs full.
+/// The key values "zero", "one" and "two" hold a special meaning (see <see cref="no_value"/>, <see cref="update_value"/> and <see cref="erased_value"/>), so do not use them.
 /// </summary>
 template <typename TKey, typename TValue, uint32_t MAX_ENTRIES>
 class lockfree_linear_map : lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>
@@ -24,6 +26,7 @@ public:
 
 	using lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>::no_value;
 	using lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>::update_value;
+	using lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>::erased_value;
 
 	/// <summary>
 	/// Gets the value associated with the specified <paramref name="key"/>.
@@ -57,7 +60,7 @@ public:
 		delete new_value;
 
 		assert(false);
-		return default_value(); // Fall back if table is full
+		return default_value(); // Fall back if table could not grow
 	}
 
 	/// <summary>
@@ -100,18 +103,8 @@ public:
 	/// </summary>
 	void clear()
 	{
-		for (size_t i = 0; i < MAX_ENTRIES; ++i)
-		{
-			TValue *const old_value = _data[i].second;
-
-			// Clear this entry so it can be used again
-			if (TKey current_key = _data[i].first.exchange(no_value);
-				current_key != no_value && current_key != update_value) // If this in update mode, we can assume the thread updating will reset the key to its intended value
-			{
-				// Delete any value attached to the entry, but only if there was one to begin with
-				delete old_value;
-			}
-		}
+		// Delete any value attached to an entry, but only if there was one to begin with
+		lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>::clear([](TValue *old_value) { delete old_value; });
 	}
 
 private:
@@ -130,20 +123,47 @@ class lockfree_linear_map<TKey, TValue *, MAX_ENTRIES>
 {
 	using TValuePtr = TValue *;
 
+	// Round capacity up to a power of two, so that the hash can be mapped to an index with a shift
+	static constexpr uint32_t CAPACITY_BITS = [] { uint32_t bits = 1; while ((1u << bits) < MAX_ENTRIES) ++bits; return bits; }();
+	static constexpr uint32_t CAPACITY = 1u << CAPACITY_BITS;
+	// Maximum number of entries to look at in each table before moving on to the next one
+	static constexpr uint32_t MAX_PROBES = 16;
+
+	struct table
+	{
+		std::pair<std::atomic<TKey>, TValuePtr> *entries;
+		uint32_t index_mask;
+		uint32_t index_shift;
+		uint32_t max_probes;
+		std::atomic<table *> next;
+	};
+
 public:
 	~lockfree_linear_map()
 	{
 		clear();
+
+		for (table *next = _first.next.load(std::memory_order_acquire); next != nullptr;)
+		{
+			table *const current = next;
+			next = current->next.load(std::memory_order_relaxed);
+			delete[] current->entries;
+			delete current;
+		}
 	}
 
 	/// <summary>
-	/// Special key indicating that the entry is empty.
+	/// Special key indicating that the entry is empty and was never used.
 	/// </summary>
 	static constexpr TKey no_value = (TKey)0;
 	/// <summary>
 	/// Special key indicating that the entry is currently being updated.
 	/// </summary>
 	static constexpr TKey update_value = (TKey)1;
+	/// <summary>
+	/// Special key indicating that the entry was used before, but has been erased since.
+	/// </summary>
+	static constexpr TKey erased_value = (TKey)2;
 
 	/// <summary>
 	/// Gets the pointer associated with the specified <paramref name="key"/>.
@@ -153,19 +173,24 @@ public:
 	/// <returns>The pointer associated with the key or <c>nullptr</c> if it was not found.</returns>
 	TValuePtr at(TKey key) const
 	{
-		assert(key != no_value && key != update_value);
+		assert(key != no_value && key != update_value && key != erased_value);
 
-		// If the table is really big, reduce search time by using hash as start index
-		size_t start_index = 0;
-		if constexpr (MAX_ENTRIES > 512)
-			start_index = std::hash<TKey>()(key) % (MAX_ENTRIES / 2);
+		const uint64_t hash = hash_key(key);
 
-		for (size_t i = start_index; i < MAX_ENTRIES; ++i)
+		for (const table *t = &_first; t != nullptr; t = t->next.load(std::memory_order_acquire))
 		{
-			if (_data[i].first.load(std::memory_order_acquire) == key)
+			for (uint32_t probe = 0, index = start_index(hash, *t); probe < t->max_probes; ++probe, index = (index + 1) & t->index_mask)
 			{
-				// The pointer is guaranteed to be value at this point, or else key would have been in update mode
-				return _data[i].second;
+				const TKey test_key = t->entries[index].first.load(std::memory_order_acquire);
+				if (test_key == key)
+				{
+					// The pointer is guaranteed to be value at this point, or else key would have been in update mode
+					return t->entries[index].second;
+				}
+
+				// Entries never go back to being empty once used (only to erased), so a key cannot be found after an empty entry, neither in this table nor in the following ones (since those are only used when all entries in the probe range were taken)
+				if (test_key == no_value)
+					return nullptr;
 			}
 		}
 
@@ -177,26 +202,28 @@ public:
 	/// </summary>
 	/// <param name="key">The key to add.</param>
 	/// <param name="value">The pointer to add.</param>
-	/// <returns>The <c>true</c> if the key-pointer pair was added successfully or <c>false</c> if the table is full.</returns>
+	/// <returns>The <c>true</c> if the key-pointer pair was added successfully or <c>false</c> if the table could not grow.</returns>
 	bool emplace(TKey key, TValuePtr value)
 	{
-		assert(key != no_value && key != update_value);
+		assert(key != no_value && key != update_value && key != erased_value);
 
-		size_t start_index = 0;
-		if constexpr (MAX_ENTRIES > 512)
-			start_index = std::hash<TKey>()(key) % (MAX_ENTRIES / 2);
+		const uint64_t hash = hash_key(key);
 
-		for (size_t i = start_index; i < MAX_ENTRIES; ++i)
+		for (table *t = &_first; t != nullptr; t = next_table(*t))
 		{
-			if (TKey test_key = _data[i].first.load(std::memory_order_relaxed);
-				test_key == no_value &&
-				_data[i].first.compare_exchange_strong(test_key, update_value, std::memory_order_relaxed))
+			for (uint32_t probe = 0, index = start_index(hash, *t); probe < t->max_probes; ++probe, index = (index + 1) & t->index_mask)
 			{
-				_data[i].second = value;
+				// Load and check before doing an expensive CAS
+				if (TKey test_key = t->entries[index].first.load(std::memory_order_relaxed);
+					(test_key == no_value || test_key == erased_value) &&
+					t->entries[index].first.compare_exchange_strong(test_key, update_value, std::memory_order_acquire))
+				{
+					t->entries[index].second = value;
 
-				_data[i].first.store(key, std::memory_order_release);
+					t->entries[index].first.store(key, std::memory_order_release);
 
-				return true;
+					return true;
+				}
 			}
 		}
 
@@ -210,25 +237,33 @@ public:
 	/// <returns>The removed pointer if the key existed, <c>nullptr</c> otherwise.</returns>
 	TValuePtr erase(TKey key)
 	{
-		if (key == no_value || key == update_value) // Cannot remove special keys
+		if (key == no_value || key == update_value || key == erased_value) // Cannot remove special keys
 			return nullptr;
 
-		size_t start_index = 0;
-		if constexpr (MAX_ENTRIES > 512)
-			start_index = std::hash<TKey>()(key) % (MAX_ENTRIES / 2);
+		const uint64_t hash = hash_key(key);
 
-		for (size_t i = start_index; i < MAX_ENTRIES; ++i)
+		for (table *t = &_first; t != nullptr; t = t->next.load(std::memory_order_acquire))
 		{
-			// Load and check before doing an expensive CAS
-			if (TKey test_key = _data[i].first.load(std::memory_order_relaxed);
-				test_key == key)
+			for (uint32_t probe = 0, index = start_index(hash, *t); probe < t->max_probes; ++probe, index = (index + 1) & t->index_mask)
 			{
-				// Get the value before freeing the entry up for other threads to fill again
-				const TValuePtr old_value = _data[i].second;
+				// Load and check before doing an expensive CAS
+				if (TKey test_key = t->entries[index].first.load(std::memory_order_relaxed);
+					test_key == key)
+				{
+					// Lock the entry while getting the value, so that it cannot be erased and filled again with a different value in between
+					if (t->entries[index].first.compare_exchange_strong(test_key, update_value, std::memory_order_acquire))
+					{
+						const TValuePtr old_value = t->entries[index].second;
+
+						// Free the entry up for other threads to fill again, but keep probe sequences going through it intact
+						t->entries[index].first.store(erased_value, std::memory_order_release);
 
-				if (_data[i].first.compare_exchange_strong(test_key, no_value, std::memory_order_relaxed))
+						return old_value;
+					}
+				}
+				else if (test_key == no_value)
 				{
-					return old_value;
+					return nullptr;
 				}
 			}
 		}
@@ -241,12 +276,63 @@ public:
 	/// </summary>
 	void clear()
 	{
-		for (size_t i = 0; i < MAX_ENTRIES; ++i)
+		clear([](TValuePtr) {});
+	}
+
+protected:
+	template <typename F>
+	void clear(F &&delete_value)
+	{
+		for (table *t = &_first; t != nullptr; t = t->next.load(std::memory_order_acquire))
 		{
-			_data[i].first.exchange(no_value);
+			for (uint32_t index = 0; index <= t->index_mask; ++index)
+			{
+				const TValuePtr old_value = t->entries[index].second;
+
+				// Clear this entry so it can be used again
+				if (TKey current_key = t->entries[index].first.exchange(no_value);
+					current_key != no_value && current_key != update_value && current_key != erased_value) // If this in update mode, we can assume the thread updating will reset the key to its intended value
+				{
+					delete_value(old_value);
+				}
+			}
 		}
 	}
 
-protected:
-	std::pair<std::atomic<TKey>, TValuePtr> _data[MAX_ENTRIES];
+private:
+	static inline uint64_t hash_key(TKey key)
+	{
+		// Scramble the hash with a Fibonacci multiplication, since handles and pointers tend to be aligned and only differ in a few bits (the standard hash for those may be the identity)
+		return static_cast<uint64_t>(std::hash<TKey>()(key)) * 0x9E3779B97F4A7C15ull;
+	}
+	static inline uint32_t start_index(uint64_t hash, const table &t)
+	{
+		// Use the topmost bits, which are the best mixed after the multiplication
+		return static_cast<uint32_t>(hash >> t.index_shift);
+	}
+
+	/// <summary>
+	/// Gets the table following the specified one, creating it if it does not exist yet.
+	/// </summary>
+	table *next_table(table &t)
+	{
+		if (table *const next = t.next.load(std::memory_order_acquire); next != nullptr)
+			return next;
+
+		const uint32_t capacity = (t.index_mask + 1) * 2;
+		table *const new_table = new table { new std::pair<std::atomic<TKey>, TValuePtr>[capacity](), capacity - 1, t.index_shift - 1, std::min(capacity, MAX_PROBES), nullptr };
+
+		// Another thread may have grown the table at the same time, in which case use the one it created
+		if (table *expected = nullptr; !t.next.compare_exchange_strong(expected, new_table, std::memory_order_acq_rel))
+		{
+			delete[] new_table->entries;
+			delete new_table;
+			return expected;
+		}
+
+		return new_table;
+	}
+
+	std::pair<std::atomic<TKey>, TValuePtr> _data[CAPACITY] = {};
+	table _first = { _data, CAPACITY - 1, 64 - CAPACITY_BITS, std::min(CAPACITY, MAX_PROBES), nullptr };
 };
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+namespace reshade::log
+{
+	/// <summary>
+	/// Ring of the most recent log lines, so that the overlay can show them without reading the log file again.
+	/// Lines are numbered continuously, so that readers can tell which ones they already got and which ones were overwritten in the meantime.
+	/// Only one thread at a time may append lines, but any number of threads can read them simultaneously without locking.
+	/// </summary>
+	class history
+	{
+	public:
+		/// <summary>
+		/// Number of most recent lines that are kept.
+		/// </summary>
+		static constexpr size_t max_lines = 4096;
+		/// <summary>
+		/// Number of bytes kept for the text of those lines, so lines are dropped earlier than after <see cref="max_lines"/> if they are very long on average.
+		/// </summary>
+		static constexpr size_t max_bytes = 1024 * 1024;
+
+		/// <summary>
+		/// Appends every line in the specified <paramref name="text"/> that is terminated by a LF or CRLF. This must not be called from multiple threads simultaneously.
+		/// </summary>
+		void append(std::string_view text)
+		{
+			for (size_t offset = 0, next; (next = text.find('\n', offset)) != std::string_view::npos; offset = next + 1)
+			{
+				size_t length = next - offset;
+				if (length != 0 && text[offset + length - 1] == '\r')
+					length--;
+
+				append_line(text.substr(offset, length));
+			}
+		}
+
+		/// <summary>
+		/// Gets the lines that were appended since the line with the specified sequence number, as far as they are still kept.
+		/// </summary>
+		/// <param name="next_sequence">The sequence number of the first line to get, which is updated to the sequence number of the line after the last one that was returned.</param>
+		/// <param name="lines">Vector to append the lines to.</param>
+		/// <returns>The number of requested lines that are no longer kept and were therefore skipped.</returns>
+		uint64_t read(uint64_t &next_sequence, std::vector<std::string> &lines) const
+		{
+			const uint64_t end_sequence = _next_sequence.load(std::memory_order_acquire);
+			const uint64_t start_sequence = std::max<uint64_t>(next_sequence, _first_sequence.load(std::memory_order_relaxed));
+
+			const size_t num_lines_before = lines.size();
+			for (uint64_t sequence = start_sequence; sequence < end_sequence; ++sequence)
+			{
+				const line_info &info = _lines[sequence % max_lines];
+				const uint64_t offset = info.offset.load(std::memory_order_relaxed);
+				// Offset and length may be from different lines if the slot was reused meanwhile, so clamp the length to not read past the end of the data
+				const size_t length = static_cast<size_t>(std::min<uint64_t>(info.length.load(std::memory_order_relaxed), max_bytes));
+
+				std::string &line = lines.emplace_back(length, '\0');
+				for (size_t i = 0; i < length; i += sizeof(uint64_t))
+				{
+					const uint64_t word = _data[(offset + i) / sizeof(uint64_t) % num_words].load(std::memory_order_relaxed);
+					std::memcpy(line.data() + i, &word, std::min<size_t>(sizeof(uint64_t), length - i));
+				}
+			}
+
+			// The writer announces which lines it is about to overwrite before it does so, so any line that may have been overwritten while it was copied is before the first line it reports afterwards
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t first_sequence = std::max<uint64_t>(start_sequence, _first_sequence.load(std::memory_order_relaxed));
+
+			// Drop those again and report them as skipped instead, since they may be torn
+			const size_t num_overwritten = static_cast<size_t>(std::min<uint64_t>(first_sequence, end_sequence) - start_sequence);
+			lines.erase(lines.begin() + num_lines_before, lines.begin() + num_lines_before + num_overwritten);
+
+			const uint64_t skipped = first_sequence - std::min<uint64_t>(next_sequence, first_sequence);
+			next_sequence = std::max<uint64_t>({ next_sequence, first_sequence, end_sequence });
+			return skipped;
+		}
+
+	private:
+		static constexpr size_t num_words = max_bytes / sizeof(uint64_t);
+
+		struct line_info
+		{
+			std::atomic<uint64_t> offset;
+			std::atomic<uint64_t> length;
+		};
+
+		void append_line(std::string_view line)
+		{
+			const uint64_t sequence = _next_sequence.load(std::memory_order_relaxed);
+			const size_t length = std::min<size_t>(line.size(), max_bytes);
+			const uint64_t offset = _next_offset;
+			// Start every line at a word boundary, so that words never have to be read back to merge in a partial line
+			const uint64_t end_offset = offset + (length + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+
+			// Move the first line that is kept past all lines whose slot or text is about to be overwritten
+			uint64_t first_sequence = _first_sequence.load(std::memory_order_relaxed);
+			while (first_sequence < sequence && (sequence - first_sequence >= max_lines || _lines[first_sequence % max_lines].offset.load(std::memory_order_relaxed) + max_bytes < end_offset))
+				first_sequence++;
+			_first_sequence.store(first_sequence, std::memory_order_relaxed);
+
+			// Order the store above before all stores below, so that a reader that sees any of the new data also sees which lines it overwrote (see 'read')
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (size_t i = 0; i < length; i += sizeof(uint64_t))
+			{
+				uint64_t word = 0;
+				std::memcpy(&word, line.data() + i, std::min<size_t>(sizeof(uint64_t), length - i));
+				_data[(offset + i) / sizeof(uint64_t) % num_words].store(word, std::memory_order_relaxed);
+			}
+
+			line_info &info = _lines[sequence % max_lines];
+			info.offset.store(offset, std::memory_order_relaxed);
+			info.length.store(length, std::memory_order_relaxed);
+
+			_next_offset = end_offset;
+			_next_sequence.store(sequence + 1, std::memory_order_release);
+		}
+
+		// Text is stored in atomic words, so that readers copying it while it is overwritten get torn lines they detect and drop, rather than a data race
+		std::atomic<uint64_t> _data[num_words] = {};
+		line_info _lines[max_lines] = {};
+		std::atomic<uint64_t> _first_sequence = 0;
+		std::atomic<uint64_t> _next_sequence = 0;
+		// Only accessed by the thread appending lines
+		uint64_t _next_offset = 0;
+	};
+
+	/// <summary>
+	/// Copy of the most recent lines of a <see cref="history"/>, which is only extended with the lines appended since the last update, together with the list of those that match a filter text.
+	/// </summary>
+	class history_view
+	{
+	public:
+		/// <summary>
+		/// Gets the lines appended since the last update and updates the list of lines that match the specified <paramref name="filter"/>.
+		/// </summary>
+		/// <param name="read">Function with the same signature as <see cref="history::read"/> to get new lines with.</param>
+		/// <param name="matches">Function that checks whether a text contains a filter text.</param>
+		/// <param name="filter">The filter text.</param>
+		/// <returns>The number of new lines.</returns>
+		template <typename R, typename F>
+		size_t update(R &&read, F &&matches, std::string_view filter)
+		{
+			std::vector<std::string> new_lines;
+			if (const uint64_t skipped = read(_next_sequence, new_lines); skipped != 0)
+			{
+				// More lines were appended than are kept since the last update, so start over with those that are left
+				_lines.clear();
+				_filtered_lines.clear();
+				_skipped += skipped;
+			}
+			if (_lines.empty())
+				_first_sequence = _next_sequence - new_lines.size();
+
+			if (_filtered_text != filter)
+			{
+				// Typing more characters can only ever remove lines from the filtered list, so only need to test those still in it in that case
+				if (matches(filter, _filtered_text))
+				{
+					_filtered_lines.erase(std::remove_if(_filtered_lines.begin(), _filtered_lines.end(),
+						[this, &matches, filter](uint64_t sequence) { return !matches(_lines[static_cast<size_t>(sequence - _first_sequence)], filter); }), _filtered_lines.end());
+				}
+				else
+				{
+					_filtered_lines.clear();
+					for (size_t i = 0; i < _lines.size(); ++i)
+						if (matches(_lines[i], filter))
+							_filtered_lines.push_back(_first_sequence + i);
+				}
+
+				_filtered_text = filter;
+			}
+
+			for (std::string &line : new_lines)
+			{
+				if (matches(line, filter))
+					_filtered_lines.push_back(_first_sequence + _lines.size());
+				_lines.push_back(std::move(line));
+			}
+
+			// Keep as many lines as the history, but only remove the oldest ones once twice that many accumulated, to avoid moving all lines every update
+			if (_lines.size() >= 2 * history::max_lines)
+			{
+				const size_t num_removed = _lines.size() - history::max_lines;
+				_lines.erase(_lines.begin(), _lines.begin() + num_removed);
+				_first_sequence += num_removed;
+				_filtered_lines.erase(_filtered_lines.begin(),
+					std::lower_bound(_filtered_lines.begin(), _filtered_lines.end(), _first_sequence));
+			}
+
+			return new_lines.size();
+		}
+
+		/// <summary>
+		/// Removes all lines, but keeps track of the position in the history, so that only lines appended afterwards are added again.
+		/// </summary>
+		void clear()
+		{
+			_lines.clear();
+			_filtered_lines.clear();
+			_skipped = 0;
+		}
+
+		/// <summary>
+		/// Gets the number of lines that match the filter text.
+		/// </summary>
+		size_t num_filtered_lines() const { return _filtered_lines.size(); }
+		/// <summary>
+		/// Gets the line at the specified <paramref name="index"/> in the list of lines that match the filter text.
+		/// </summary>
+		const std::string &filtered_line(size_t index) const { return _lines[static_cast<size_t>(_filtered_lines[index] - _first_sequence)]; }
+
+		/// <summary>
+		/// Gets the number of lines that were no longer kept in the history when they would have been added.
+		/// </summary>
+		uint64_t num_skipped_lines() const { return _skipped; }
+
+		const std::vector<std::string> &lines() const { return _lines; }
+		uint64_t first_sequence() const { return _first_sequence; }
+		uint64_t next_sequence() const { return _next_sequence; }
+		const std::vector<uint64_t> &filtered_sequences() const { return _filtered_lines; }
+		const std::string &filtered_text() const { return _filtered_text; }
+
+	private:
+		std::vector<std::string> _lines;
+		uint64_t _first_sequence = 0;
+		uint64_t _skipped = 0;
+		uint64_t _next_sequence = 0;
+		// Sequence numbers of the lines that match the filter text the list was last updated with
+		std::vector<uint64_t> _filtered_lines;
+		std::string _filtered_text;
+	};
+}
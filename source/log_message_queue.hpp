@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+
+namespace reshade::log
+{
+	/// <summary>
+	/// Bounded lock-free queue of finished log lines, which any number of threads can push to, but only one thread at a time can pop from.
+	/// </summary>
+	class message_queue
+	{
+	public:
+		static constexpr size_t CAPACITY = 1024; // Must be a power of two
+
+		message_queue()
+		{
+			for (size_t i = 0; i < CAPACITY; ++i)
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// Moves the specified <paramref name="line"/> into the queue, unless it is full.
+		/// </summary>
+		bool try_push(std::string &line)
+		{
+			size_t index = _push_index.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				slot &s = _slots[index & (CAPACITY - 1)];
+
+				// The sequence of a slot equals the index it can be pushed at when it is free, and is one larger once it was filled
+				const size_t sequence = s.sequence.load(std::memory_order_acquire);
+				const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(index);
+				if (difference == 0)
+				{
+					if (_push_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+					{
+						s.line = std::move(line);
+						s.sequence.store(index + 1, std::memory_order_seq_cst);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false; // Slot was not popped yet, so the queue is full
+				}
+				else
+				{
+					index = _push_index.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Moves the oldest line out of the queue, unless it is empty. This must not be called from multiple threads simultaneously.
+		/// </summary>
+		bool try_pop(std::string &line)
+		{
+			const size_t index = _pop_index.load(std::memory_order_relaxed);
+			slot &s = _slots[index & (CAPACITY - 1)];
+
+			if (s.sequence.load(std::memory_order_acquire) != index + 1)
+				return false;
+
+			line = std::move(s.line);
+			s.sequence.store(index + CAPACITY, std::memory_order_release);
+			_pop_index.store(index + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		bool empty() const
+		{
+			const size_t index = _pop_index.load(std::memory_order_relaxed);
+			return _slots[index & (CAPACITY - 1)].sequence.load(std::memory_order_seq_cst) != index + 1;
+		}
+
+	private:
+		struct slot
+		{
+			std::atomic<size_t> sequence;
+			std::string line;
+		};
+
+		slot _slots[CAPACITY];
+		std::atomic<size_t> _push_index = 0;
+		std::atomic<size_t> _pop_index = 0;
+	};
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "readback_ring.hpp"
+#include "format_conversion.hpp"
+#include <cassert>
+#include <algorithm>
+
+reshade::readback_ring::status reshade::readback_ring::queue(api::resource resource, api::resource_usage state, size_t &slot_index)
+{
+	slot_index = invalid_slot;
+
+	const api::resource_desc desc = _device->get_resource_desc(resource);
+	const api::format view_format = api::format_to_default_typed(desc.texture.format, 0);
+
+	if (!is_convertible_to_rgba8(view_format))
+		return status::unsupported_format;
+
+	uint32_t row_pitch = api::format_row_pitch(view_format, desc.texture.width);
+	if (_device->get_api() == api::device_api::d3d12) // See D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+		row_pitch = (row_pitch + 255) & ~255;
+	const uint32_t slice_pitch = api::format_slice_pitch(view_format, row_pitch, desc.texture.height);
+
+	// Try to reuse an intermediate resource of a previous readback that has the same dimensions, before falling back to any other unused one
+	for (size_t i = 0; i < _slots.size(); ++i)
+	{
+		const slot &slot = _slots[i];
+		if (slot.pending)
+			continue;
+
+		if (slot.format == view_format && slot.width == desc.texture.width && slot.height == desc.texture.height)
+		{
+			slot_index = i;
+			break;
+		}
+
+		if (slot_index == invalid_slot)
+			slot_index = i;
+	}
+
+	if (slot_index == invalid_slot)
+	{
+		if (_slots.size() >= max_slots)
+			return status::too_many_pending;
+
+		// Completion of copies is detected with a timestamp query written after each one
+		// If the query pool cannot be created, readbacks are finished after waiting for the GPU to become idle instead
+		if (_slots.empty() && _query_pool == 0 && !_device->create_query_pool(api::query_type::timestamp, static_cast<uint32_t>(max_slots), &_query_pool))
+			_query_pool = {};
+
+		slot_index = _slots.size();
+		_slots.emplace_back();
+	}
+
+	slot &slot = _slots[slot_index];
+
+	if (slot.intermediate == 0 || slot.format != view_format || slot.width != desc.texture.width || slot.height != desc.texture.height)
+	{
+		_device->destroy_resource(slot.intermediate);
+		slot.intermediate = {};
+
+		// Copy texture data into system memory buffer
+		if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
+		{
+			if (!_device->create_resource(api::resource_desc(slice_pitch, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest), nullptr, api::resource_usage::copy_dest, &slot.intermediate))
+			{
+				slot_index = invalid_slot;
+				return status::out_of_memory;
+			}
+
+			_device->set_resource_name(slot.intermediate, "ReShade screenshot buffer");
+		}
+		else
+		{
+			if (!_device->create_resource(api::resource_desc(desc.texture.width, desc.texture.height, 1, 1, view_format, 1, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest), nullptr, api::resource_usage::copy_dest, &slot.intermediate))
+			{
+				slot_index = invalid_slot;
+				return status::out_of_memory;
+			}
+
+			_device->set_resource_name(slot.intermediate, "ReShade screenshot texture");
+		}
+
+		slot.format = view_format;
+		slot.width = desc.texture.width;
+		slot.height = desc.texture.height;
+		slot.row_pitch = row_pitch;
+		slot.slice_pitch = slice_pitch;
+	}
+
+	api::command_list *const cmd_list = _queue->get_immediate_command_list();
+	cmd_list->barrier(resource, state, api::resource_usage::copy_source);
+	if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
+		cmd_list->copy_texture_to_buffer(resource, 0, nullptr, slot.intermediate, 0, desc.texture.width, desc.texture.height);
+	else
+		cmd_list->copy_texture_region(resource, 0, nullptr, slot.intermediate, 0, nullptr);
+	cmd_list->barrier(resource, api::resource_usage::copy_source, state);
+
+	if (_query_pool != 0)
+		cmd_list->end_query(_query_pool, api::query_type::timestamp, static_cast<uint32_t>(slot_index));
+
+	slot.pending = true;
+	slot.frames_pending = 0;
+	slot.sequence = _next_sequence++;
+
+	return status::success;
+}
+reshade::readback_ring::status reshade::readback_ring::queue(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels)> &&callback)
+{
+	size_t slot_index = invalid_slot;
+	if (const status result = queue(resource, state, slot_index); result != status::success)
+		return result;
+
+	_slots[slot_index].callback = std::move(callback);
+
+	return status::success;
+}
+
+bool reshade::readback_ring::is_complete(size_t slot_index)
+{
+	slot &slot = _slots[slot_index];
+	assert(slot.pending);
+
+	if (_query_pool == 0)
+		return false;
+
+	// Results of D3D12 and Vulkan queries may still be those of the previous copy into this slot until the new timestamp was written, so only count a different value as completion
+	// Timestamps increase monotonically, so the new value can never be the same as the previous one
+	uint64_t timestamp = 0;
+	if (!_device->get_query_pool_results(_query_pool, static_cast<uint32_t>(slot_index), 1, &timestamp, sizeof(timestamp)) || timestamp == slot.last_timestamp)
+		return false;
+
+	slot.last_timestamp = timestamp;
+	return true;
+}
+
+bool reshade::readback_ring::finish(size_t slot_index, uint8_t *pixels)
+{
+	slot &slot = _slots[slot_index];
+	assert(slot.pending);
+
+	// Update the last timestamp in case this was finished after waiting for the queue to become idle, without checking for completion before
+	is_complete(slot_index);
+
+	// Copy data from intermediate image into output buffer
+	api::subresource_data mapped_data = {};
+	if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
+	{
+		_device->map_buffer_region(slot.intermediate, 0, std::numeric_limits<uint64_t>::max(), api::map_access::read_only, &mapped_data.data);
+
+		mapped_data.row_pitch = slot.row_pitch;
+		mapped_data.slice_pitch = slot.slice_pitch;
+	}
+	else
+	{
+		_device->map_texture_region(slot.intermediate, 0, nullptr, api::map_access::read_only, &mapped_data);
+	}
+
+	if (mapped_data.data != nullptr)
+	{
+		convert_to_rgba8(slot.format, slot.width, slot.height, mapped_data.data, mapped_data.row_pitch, pixels);
+
+		if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
+			_device->unmap_buffer_region(slot.intermediate);
+		else
+			_device->unmap_texture_region(slot.intermediate, 0);
+	}
+
+	// Keep the intermediate resource around, so that it can be reused by the next readback
+	slot.pending = false;
+
+	return mapped_data.data != nullptr;
+}
+
+void reshade::readback_ring::process(bool wait_for_completion)
+{
+	if (num_pending() == 0)
+		return;
+
+	if (wait_for_completion)
+	{
+		_queue->flush_immediate_command_list();
+		_queue->wait_idle();
+	}
+
+	// Deliver readbacks in the order they were queued, so that e.g. frames of a capture arrive in sequence
+	// Commands on the queue complete in order too, so there is no need to check any readback after the first one that is not complete yet
+	size_t order[max_slots];
+	size_t num_ordered = 0;
+	for (size_t slot_index = 0; slot_index < _slots.size(); ++slot_index)
+		if (_slots[slot_index].pending && (wait_for_completion || _slots[slot_index].callback))
+			order[num_ordered++] = slot_index;
+	std::sort(order, order + num_ordered,
+		[this](size_t lhs, size_t rhs) { return _slots[lhs].sequence < _slots[rhs].sequence; });
+
+	for (size_t i = 0; i < num_ordered; ++i)
+	{
+		const size_t slot_index = order[i];
+		slot &slot = _slots[slot_index];
+
+		if (!wait_for_completion && !is_complete(slot_index))
+		{
+			// Give the GPU a few frames to finish the copy, before falling back to waiting for it (e.g. in case the query is never written because the device was lost)
+			if (_query_pool != 0 && ++slot.frames_pending < max_pending_frames)
+				break;
+
+			_queue->flush_immediate_command_list();
+			_queue->wait_idle();
+			wait_for_completion = true; // Every other pending readback is complete now too
+		}
+
+		// Move callback out of the slot before finishing the readback, since that makes the slot available again
+		const std::function<void(std::vector<uint8_t> &&pixels)> callback = std::move(slot.callback);
+		slot.callback = nullptr;
+
+		std::vector<uint8_t> pixels(static_cast<size_t>(slot.width) * static_cast<size_t>(slot.height) * 4);
+		if (!finish(slot_index, pixels.data()))
+			pixels.clear();
+
+		if (callback)
+			callback(std::move(pixels));
+	}
+}
+
+void reshade::readback_ring::destroy()
+{
+	for (slot &slot : _slots)
+	{
+		assert(!slot.pending);
+		_device->destroy_resource(slot.intermediate);
+	}
+	_slots.clear();
+
+	if (_query_pool != 0)
+		_device->destroy_query_pool(_query_pool);
+	_query_pool = {};
+}
+
+size_t reshade::readback_ring::num_pending() const
+{
+	return std::count_if(_slots.begin(), _slots.end(), [](const slot &slot) { return slot.pending; });
+}
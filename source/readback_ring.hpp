@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <functional>
+#include "reshade_api_device.hpp"
+
+namespace reshade
+{
+	/// <summary>
+	/// Copies textures into a ring of reusable intermediate resources, so that their data can be read back once the GPU finished the copy, without waiting for it to become idle.
+	/// </summary>
+	class readback_ring
+	{
+	public:
+		/// <summary>
+		/// Maximum number of intermediate resources that can be in use by pending readbacks at the same time.
+		/// </summary>
+		static constexpr size_t max_slots = 16;
+		/// <summary>
+		/// Number of times <see cref="process"/> checks a pending readback for completion, before waiting for the GPU to become idle instead.
+		/// </summary>
+		static constexpr uint32_t max_pending_frames = 64;
+		static constexpr size_t invalid_slot = std::numeric_limits<size_t>::max();
+
+		enum class status
+		{
+			success,
+			unsupported_format,
+			too_many_pending,
+			out_of_memory,
+		};
+
+		readback_ring(api::device *device, api::command_queue *queue) : _device(device), _queue(queue) {}
+
+		/// <summary>
+		/// Records a copy of the specified texture into an intermediate resource on the immediate command list of the queue.
+		/// </summary>
+		/// <param name="resource">Texture to read back.</param>
+		/// <param name="state">Current state of the texture, which it is transitioned back to after the copy.</param>
+		/// <param name="slot_index">Set to the index of the slot that holds the readback until it is finished.</param>
+		status queue(api::resource resource, api::resource_usage state, size_t &slot_index);
+		/// <summary>
+		/// Records a copy of the specified texture into an intermediate resource, which <see cref="process"/> passes to the <paramref name="callback"/> once the copy completed.
+		/// The callback receives an empty vector if reading back the data failed.
+		/// </summary>
+		status queue(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels)> &&callback);
+
+		/// <summary>
+		/// Checks whether the GPU finished the copy of the specified pending readback, without waiting for it.
+		/// </summary>
+		bool is_complete(size_t slot_index);
+
+		/// <summary>
+		/// Converts the data of the specified pending readback to 32 bits-per-pixel RGBA and makes its slot available again.
+		/// The copy has to be complete, either according to <see cref="is_complete"/> or after waiting for the queue to become idle.
+		/// </summary>
+		/// <param name="slot_index">Index of the slot that was returned by <see cref="queue"/>.</param>
+		/// <param name="pixels">Pointer to a buffer that is large enough to hold the converted data.</param>
+		bool finish(size_t slot_index, uint8_t *pixels);
+
+		/// <summary>
+		/// Finishes all pending readbacks with a callback whose copy completed and calls that callback.
+		/// </summary>
+		/// <param name="wait_for_completion"><see langword="true"/> to wait for all pending readbacks to complete first.</param>
+		void process(bool wait_for_completion = false);
+
+		/// <summary>
+		/// Destroys all intermediate resources, after all pending readbacks were finished.
+		/// </summary>
+		void destroy();
+
+		size_t num_pending() const;
+
+	private:
+		struct slot
+		{
+			api::resource intermediate = {};
+			api::format format = api::format::unknown;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t row_pitch = 0;
+			uint32_t slice_pitch = 0;
+			bool pending = false;
+			uint32_t frames_pending = 0;
+			uint64_t sequence = 0;
+			// Timestamp the query of this slot reported for the previous copy, since that is what it may still report until the timestamp of the current copy was written
+			uint64_t last_timestamp = 0;
+			std::function<void(std::vector<uint8_t> &&pixels)> callback;
+		};
+
+		api::device *const _device;
+		api::command_queue *const _queue;
+		api::query_pool _query_pool = {};
+		std::vector<slot> _slots;
+		uint64_t _next_sequence = 0;
+	};
+}
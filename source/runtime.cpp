@@ -17,6 +17,12 @@
 #include "input_freepie.hpp"
 #include "com_ptr.hpp"
 #include "process_utils.hpp"
+#include "image_encoder.hpp"
+#include "frame_capture.hpp"
+#include "readback_ring.hpp"
+#include "texture_cache.hpp"
+#include "uniform_values.hpp"
+#include "format_conversion.hpp"
 #include <set>
 #include <thread>
 #include <cstring>
@@ -121,7 +127,8 @@ reshade::runtime::runtime(api::device *device, api::command_queue *graphics_queu
 	_screenshot_path(g_reshade_base_path),
 	_screenshot_name("%AppName% %Date% %Time%"),
 	_screenshot_post_save_command_arguments("\"%TargetPath%\""),
-	_screenshot_post_save_command_working_directory(g_reshade_base_path)
+	_screenshot_post_save_command_working_directory(g_reshade_base_path),
+	_readbacks(std::make_unique<readback_ring>(device, graphics_queue))
 {
 	assert(device != nullptr && graphics_queue != nullptr);
 
@@ -455,6 +462,16 @@ void reshade::runtime::on_reset()
 	else
 		return; // Nothing to do if the runtime was already destroyed or not successfully initialized in the first place
 
+	// Write any modifications that are still waiting to be saved in the background, in case the runtime is about to go away
+	ini_file::flush_cache();
+
+	// Complete any pending screenshot captures before the resources they reference go away
+	process_readbacks(true);
+	destroy_readbacks();
+
+	// Frame dimensions may change after a reset, so finish any running capture session
+	stop_frame_capture();
+
 #if RESHADE_FX
 	// Already performs a wait for idle, so no need to do it again before destroying resources below
 	destroy_effects();
@@ -521,6 +538,9 @@ void reshade::runtime::on_present()
 
 	api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
 
+	// Complete screenshot captures from previous frames, which the GPU should have finished copying by now
+	process_readbacks();
+
 	uint32_t back_buffer_index = get_current_back_buffer_index();
 	const api::resource back_buffer_resource = get_back_buffer(back_buffer_index);
 
@@ -566,16 +586,27 @@ void reshade::runtime::on_present()
 	if (_should_save_screenshot)
 		save_screenshot();
 
+	if (_frame_capture != nullptr && _frame_capture->is_active() && (_framecount - _capture_start_frame) % std::max(1u, _capture_frame_interval) == 0)
+	{
+		frame_capture *const capture = _frame_capture.get();
+		// Readbacks may still complete after the capture was stopped and a new one started, so tag them with the session they belong to
+		const uint64_t session = capture->session();
+
+		if (!queue_readback(_back_buffer_resolved != 0 ? _back_buffer_resolved : back_buffer_resource, _back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present,
+			[capture, session](std::vector<uint8_t> &&data) {
+				if (data.empty())
+					capture->skip_frame(session);
+				else
+					capture->submit_frame(session, std::move(data));
+			}))
+			capture->skip_frame(session);
+	}
+
 	_framecount++;
 	const auto current_time = std::chrono::high_resolution_clock::now();
 	_last_frame_duration = current_time - _last_present_time; _last_present_time = current_time;
 	_effects_rendered_this_frame = false;
 
-#ifdef NDEBUG
-	// Lock input so it cannot be modified by other threads while we are reading it here
-	const std::unique_lock<std::shared_mutex> input_lock = _input->lock();
-#endif
-
 #if RESHADE_GUI
 	// Draw overlay
 	if (_is_vr)
@@ -599,6 +630,14 @@ void reshade::runtime::on_present()
 		if (_input->is_key_pressed(_screenshot_key_data, _force_shortcut_modifiers))
 			_should_save_screenshot = true; // Remember that we want to save a screenshot next frame
 
+		if (_input->is_key_pressed(_capture_key_data, _force_shortcut_modifiers))
+		{
+			if (_frame_capture != nullptr && _frame_capture->is_active())
+				stop_frame_capture();
+			else
+				start_frame_capture();
+		}
+
 #if RESHADE_FX
 		// Do not allow the following shortcuts while effects are being loaded or initialized (since they affect that state)
 		if (!is_loading() && _reload_create_queue.empty())
@@ -676,8 +715,8 @@ void reshade::runtime::on_present()
 	// Reset input status
 	_input->next_frame();
 
-	// Save modified INI files
-	if (!ini_file::flush_cache())
+	// Modified INI files are saved in the background, so only check whether that failed
+	if (ini_file::background_save_failed())
 		_preset_save_successfull = false;
 
 #if RESHADE_ADDON_LITE
@@ -720,6 +759,7 @@ void reshade::runtime::load_config()
 
 	config.get("INPUT", "ForceShortcutModifiers", _force_shortcut_modifiers);
 	config.get("INPUT", "KeyScreenshot", _screenshot_key_data);
+	config.get("INPUT", "KeyCapture", _capture_key_data);
 #if RESHADE_FX
 	config.get("INPUT", "KeyEffects", _effects_key_data);
 	config.get("INPUT", "KeyNextPreset", _next_preset_key_data);
@@ -737,6 +777,7 @@ void reshade::runtime::load_config()
 	config.get("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
 	config.get("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
 	config.get("GENERAL", "TextureSearchPaths", _texture_search_paths);
+	config.get("GENERAL", "TextureUploadBudget", _texture_upload_budget);
 	config.get("GENERAL", "IntermediateCachePath", _intermediate_cache_path);
 
 	config.get("GENERAL", "PresetPath", _current_preset_path);
@@ -774,6 +815,14 @@ void reshade::runtime::load_config()
 	config.get("SCREENSHOT", "PostSaveCommandWorkingDirectory", _screenshot_post_save_command_working_directory);
 	config.get("SCREENSHOT", "PostSaveCommandNoWindow", _screenshot_post_save_command_no_window);
 
+	config.get("CAPTURE", "DropFramesWhenFull", _capture_drop_frames_when_full);
+	config.get("CAPTURE", "EncoderThreads", _capture_encoder_threads);
+	config.get("CAPTURE", "FileFormat", _capture_format);
+	config.get("CAPTURE", "FrameInterval", _capture_frame_interval);
+	config.get("CAPTURE", "FrameRate", _capture_frame_rate);
+	config.get("CAPTURE", "MaxQueuedFrames", _capture_max_queued_frames);
+	config.get("CAPTURE", "StreamPath", _capture_stream_path);
+
 #if RESHADE_GUI
 	load_config_gui(config);
 #endif
@@ -784,6 +833,7 @@ void reshade::runtime::save_config() const
 
 	config.set("INPUT", "ForceShortcutModifiers", _force_shortcut_modifiers);
 	config.set("INPUT", "KeyScreenshot", _screenshot_key_data);
+	config.set("INPUT", "KeyCapture", _capture_key_data);
 #if RESHADE_FX
 	config.set("INPUT", "KeyEffects", _effects_key_data);
 	config.set("INPUT", "KeyNextPreset", _next_preset_key_data);
@@ -801,6 +851,7 @@ void reshade::runtime::save_config() const
 	config.set("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
 	config.set("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
 	config.set("GENERAL", "TextureSearchPaths", _texture_search_paths);
+	config.set("GENERAL", "TextureUploadBudget", _texture_upload_budget);
 	config.set("GENERAL", "IntermediateCachePath", _intermediate_cache_path);
 
 	// Use ReShade DLL directory as base for relative preset paths (see 'resolve_preset_path')
@@ -832,6 +883,14 @@ void reshade::runtime::save_config() const
 	config.set("SCREENSHOT", "PostSaveCommandWorkingDirectory", _screenshot_post_save_command_working_directory);
 	config.set("SCREENSHOT", "PostSaveCommandNoWindow", _screenshot_post_save_command_no_window);
 
+	config.set("CAPTURE", "DropFramesWhenFull", _capture_drop_frames_when_full);
+	config.set("CAPTURE", "EncoderThreads", _capture_encoder_threads);
+	config.set("CAPTURE", "FileFormat", _capture_format);
+	config.set("CAPTURE", "FrameInterval", _capture_frame_interval);
+	config.set("CAPTURE", "FrameRate", _capture_frame_rate);
+	config.set("CAPTURE", "MaxQueuedFrames", _capture_max_queued_frames);
+	config.set("CAPTURE", "StreamPath", _capture_stream_path);
+
 #if RESHADE_GUI
 	save_config_gui(config);
 #endif
@@ -894,6 +953,11 @@ void reshade::runtime::load_current_preset()
 				rhs_it = std::find(sorted_technique_list.begin(), sorted_technique_list.end(), rhs.name);
 			return lhs_it < rhs_it;
 		});
+	// Sorting moves techniques in memory, which invalidates technique handles and the name index
+	_effects_generation++;
+#if RESHADE_GUI
+	_technique_list_dirty = true;
+#endif
 
 	// Compute times since the transition has started and how much is left till it should end
 	auto transition_time = std::chrono::duration_cast<std::chrono::microseconds>(_last_present_time - _last_preset_switching_time).count();
@@ -1803,6 +1867,9 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 			_techniques.push_back(std::move(new_technique));
 		}
+
+		// Invalidate handles to variables and techniques of this effect
+		_effects_generation++;
 	}
 
 	if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
@@ -2506,6 +2573,8 @@ void reshade::runtime::destroy_effect(size_t effect_index)
 			return tech.effect_index == effect_index;
 		}), _techniques.end());
 
+	_effects_generation++;
+
 	// Do not clear effect here, since it is common to be re-used immediately
 }
 
@@ -2756,6 +2825,7 @@ void reshade::runtime::load_effects()
 	// Allocate space for effects which are placed in this array during the 'load_effect' call
 	const size_t offset = _effects.size();
 	_effects.resize(offset + effect_files.size());
+	_effects_generation++; // Resizing may have moved existing effects and their variables
 	_reload_remaining_effects = effect_files.size();
 
 	// Now that we have a list of files, load them in parallel
@@ -2772,62 +2842,204 @@ void reshade::runtime::load_effects()
 					load_effect(effect_files[i], preset, offset + i);
 		});
 }
-void reshade::runtime::load_textures()
+static bool convert_texture_data(reshade::api::format format, uint32_t width, uint32_t height, uint32_t levels, uint32_t source_width, uint32_t source_height, const uint8_t *pixels, std::vector<uint8_t> &data)
 {
-	_last_texture_reload_successfull = true;
+	const size_t data_size = reshade::texture_data_size(format, width, height, levels);
+	if (data_size == 0)
+		return false;
 
-	LOG(INFO) << "Loading image files for textures ...";
+	data.resize(data_size);
+	uint8_t *level_data = data.data();
 
-	for (texture &texture : _textures)
+	std::vector<uint8_t> resized[2];
+	for (uint32_t level = 0; level < levels; ++level)
 	{
-		if (texture.resource == 0 || !texture.semantic.empty())
-			continue; // Ignore textures that are not created yet and those that are handled in the runtime implementation
-
-		std::filesystem::path source_path = std::filesystem::u8path(texture.annotation_as_string("source"));
-		// Ignore textures that have no image file attached to them (e.g. plain render targets)
-		if (source_path.empty())
-			continue;
+		const uint32_t level_width = std::max(width >> level, 1u);
+		const uint32_t level_height = std::max(height >> level, 1u);
 
-		// Search for image file using the provided search paths unless the path provided is already absolute
-		if (!find_file(_texture_search_paths, source_path))
+		// Need to potentially resize image data to the texture dimensions, and then successively downsample it for every mipmap level
+		if (level_width != source_width || level_height != source_height)
 		{
-			LOG(ERROR) << "Source " << source_path << " for texture '" << texture.unique_name << "' could not be found in any of the texture search paths!";
-			_last_texture_reload_successfull = false;
-			continue;
+			std::vector<uint8_t> &target = resized[level % 2];
+			target.resize(static_cast<size_t>(level_width) * level_height * 4);
+			stbir_resize_uint8(pixels, source_width, source_height, 0, target.data(), level_width, level_height, 0, 4);
+
+			pixels = target.data();
+			source_width = level_width;
+			source_height = level_height;
 		}
 
-		stbi_uc *filedata = nullptr;
-		int width = 0, height = 0, channels = 0;
+		// Convert data to the actual format of the texture resource (which may differ from the effect texture format in some APIs)
+		const uint32_t row_pitch = reshade::api::format_row_pitch(format, level_width);
+		if (!reshade::convert_from_rgba8(format, level_width, level_height, pixels, 0, level_data, row_pitch))
+			return false;
+
+		level_data += reshade::api::format_slice_pitch(format, row_pitch, level_height);
+	}
+
+	return true;
+}
 
-		if (FILE *file; _wfopen_s(&file, source_path.c_str(), L"rb") == 0)
+void reshade::runtime::load_textures()
+{
+	if (!_texture_loads.is_running())
+	{
+		_texture_load_jobs.clear();
+
+		_last_texture_reload_successfull = true;
+
+		LOG(INFO) << "Loading image files for textures ...";
+
+		for (texture &texture : _textures)
 		{
-			// Read texture data into memory in one go since that is faster than reading chunk by chunk
-			std::vector<uint8_t> mem(static_cast<size_t>(std::filesystem::file_size(source_path)));
-			fread(mem.data(), 1, mem.size(), file);
-			fclose(file);
+			if (texture.resource == 0 || !texture.semantic.empty())
+				continue; // Ignore textures that are not created yet and those that are handled in the runtime implementation
 
-			if (stbi_dds_test_memory(mem.data(), static_cast<int>(mem.size())))
-				filedata = stbi_dds_load_from_memory(mem.data(), static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
-			else
-				filedata = stbi_load_from_memory(mem.data(), static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
+			std::filesystem::path source_path = std::filesystem::u8path(texture.annotation_as_string("source"));
+			// Ignore textures that have no image file attached to them (e.g. plain render targets)
+			if (source_path.empty())
+				continue;
+
+			// Search for image file using the provided search paths unless the path provided is already absolute
+			if (!find_file(_texture_search_paths, source_path))
+			{
+				LOG(ERROR) << "Source " << source_path << " for texture '" << texture.unique_name << "' could not be found in any of the texture search paths!";
+				_last_texture_reload_successfull = false;
+				continue;
+			}
+
+			const api::format format = api::format_to_default_typed(_device->get_resource_desc(texture.resource).texture.format);
+
+			// Multiple textures often reference the same image file, so only decode it once for all of them
+			const auto job_it = std::find_if(_texture_load_jobs.begin(), _texture_load_jobs.end(),
+				[&](const texture_load_job &job) { return job.source_path == source_path && job.format == format && job.width == texture.width && job.height == texture.height && job.levels == texture.levels; });
+			if (job_it != _texture_load_jobs.end())
+			{
+				job_it->texture_names.push_back(texture.unique_name);
+				continue;
+			}
+
+			texture_load_job &job = _texture_load_jobs.emplace_back();
+			job.source_path = std::move(source_path);
+			job.format = format;
+			job.width = texture.width;
+			job.height = texture.height;
+			job.levels = texture.levels;
+			job.texture_names.push_back(texture.unique_name);
 		}
 
-		if (filedata == nullptr)
+		if (_texture_load_jobs.empty())
 		{
-			LOG(ERROR) << "Source " << source_path << " for texture '" << texture.unique_name << "' could not be loaded! Make sure it is of a compatible file format.";
-			_last_texture_reload_successfull = false;
-			continue;
+			_textures_loaded = true;
+			return;
 		}
 
-		update_texture(texture, width, height, filedata);
+		// Keep the texture cache from growing without bound as image files are edited or replaced over time
+		if (!_no_effect_cache)
+			prune_texture_cache(g_reshade_base_path / _intermediate_cache_path);
+
+		// Decode and convert image files on worker threads, so that only the upload itself happens on the render thread
+		_texture_loads.start(_texture_load_jobs.size(), std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1, [this](size_t job_index) {
+			texture_load_job &job = _texture_load_jobs[job_index];
+
+			if (FILE *file; _wfopen_s(&file, job.source_path.c_str(), L"rb") == 0)
+			{
+				// Use the non-throwing overload, since an exception here on a worker thread would terminate the application
+				std::error_code ec;
+				const uintmax_t file_size = std::filesystem::file_size(job.source_path, ec);
+
+				// Read texture data into memory in one go since that is faster than reading chunk by chunk
+				std::string mem(ec ? 0 : static_cast<size_t>(file_size), '\0');
+				mem.resize(fread(mem.data(), 1, mem.size(), file));
+				fclose(file);
+
+				// Decoded, converted and mipmapped data is cached, keyed by the file contents and the target texture description
+				const std::string cache_id = texture_cache_id(job.source_path, mem.data(), mem.size(), job.format, job.width, job.height, job.levels);
+
+				if (std::string cached_data; load_effect_cache(cache_id, "tex", cached_data) &&
+					!parse_texture_cache_data(cached_data, job.format, job.width, job.height, job.levels, job.data))
+				{
+					// Delete invalid cache file, so that it is written again below ('save_effect_cache' does not overwrite existing files)
+					std::filesystem::remove(g_reshade_base_path / _intermediate_cache_path / std::filesystem::u8path("reshade-" + cache_id + ".tex"), ec);
+				}
+
+				if (job.data.empty())
+				{
+					stbi_uc *filedata = nullptr;
+					int width = 0, height = 0, channels = 0;
+
+					const auto mem_data = reinterpret_cast<const stbi_uc *>(mem.data());
+					if (stbi_dds_test_memory(mem_data, static_cast<int>(mem.size())))
+						filedata = stbi_dds_load_from_memory(mem_data, static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
+					else
+						filedata = stbi_load_from_memory(mem_data, static_cast<int>(mem.size()), &width, &height, &channels, STBI_rgb_alpha);
 
-		stbi_image_free(filedata);
+					if (filedata != nullptr)
+					{
+						if (!convert_texture_data(job.format, job.width, job.height, job.levels, width, height, filedata, job.data))
+						{
+							job.data.clear();
+						}
+						else if (!_no_effect_cache)
+						{
+							save_effect_cache(cache_id, "tex", build_texture_cache_data(job.format, job.width, job.height, job.levels, job.data));
+						}
 
-		texture.loaded = true;
+						stbi_image_free(filedata);
+					}
+				}
+			}
+		});
 	}
 
+	// Upload finished jobs until the per-frame budget is exhausted, to avoid stalling a single frame for too long
+	const size_t upload_budget = static_cast<size_t>(_texture_upload_budget) * 1024 * 1024;
+	if (!_texture_loads.upload(upload_budget, [this](size_t job_index) {
+		texture_load_job &job = _texture_load_jobs[job_index];
+
+		for (const std::string &texture_name : job.texture_names)
+		{
+			const auto texture_it = std::find_if(_textures.begin(), _textures.end(),
+				[&texture_name](const texture &texture) { return texture.unique_name == texture_name; });
+			// Texture may have been recreated with different dimensions since the job was queued
+			if (texture_it == _textures.end() || texture_it->resource == 0 || texture_it->width != job.width || texture_it->height != job.height || texture_it->levels != job.levels)
+				continue;
+
+			if (job.data.empty())
+			{
+				LOG(ERROR) << "Source " << job.source_path << " for texture '" << texture_name << "' could not be loaded! Make sure it is of a compatible file format.";
+				_last_texture_reload_successfull = false;
+				continue;
+			}
+
+			upload_texture_data(*texture_it, job.data.data(), job.levels);
+
+			texture_it->loaded = true;
+		}
+
+		const size_t uploaded_bytes = job.data.size();
+
+		// Free the converted data right away, since it is no longer needed after the upload
+		job.data = {};
+
+		return uploaded_bytes;
+	}))
+		return;
+
+	LOG(INFO) << "Finished loading " << _texture_load_jobs.size() << " image files for textures in " <<
+		std::chrono::duration_cast<std::chrono::milliseconds>(_texture_loads.total_time()).count() << " ms (spent at most " <<
+		std::chrono::duration_cast<std::chrono::microseconds>(_texture_loads.max_upload_time()).count() / 1000.0 << " ms uploading in a single frame).";
+
+	_texture_load_jobs.clear();
+
 	_textures_loaded = true;
 }
+void reshade::runtime::cancel_texture_loading()
+{
+	_texture_loads.cancel();
+
+	_texture_load_jobs.clear();
+}
 bool reshade::runtime::reload_effect(size_t effect_index, bool preprocess_required)
 {
 #if RESHADE_GUI
@@ -2859,6 +3071,8 @@ void reshade::runtime::destroy_effects()
 			thread.join();
 	_worker_threads.clear();
 
+	cancel_texture_loading();
+
 	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
 		destroy_effect(effect_index);
 
@@ -2931,10 +3145,10 @@ void reshade::runtime::clear_effect_cache()
 
 		const std::filesystem::path filename = entry.path().filename();
 		const std::filesystem::path extension = entry.path().extension();
-		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".cso" && extension != L".asm"))
+		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".cso" && extension != L".asm" && extension != L".tex"))
 			continue;
 
-		std::filesystem::remove(entry.path());
+		std::filesystem::remove(entry.path(), ec);
 	}
 }
 
@@ -3007,7 +3221,8 @@ void reshade::runtime::update_effects()
 			_last_reload_successfull = false;
 		}
 
-		// An effect has changed, need to reload textures
+		// An effect has changed, need to reload textures (restarting any load that is already in progress)
+		cancel_texture_loading();
 		_textures_loaded = false;
 
 #if RESHADE_GUI
@@ -3051,12 +3266,6 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 	if (!_effects_enabled || _techniques.empty())
 		return;
 
-#ifdef NDEBUG
-	// Lock input so it cannot be modified by other threads while we are reading it here
-	// TODO: This does not catch input happening between now and 'on_present'
-	const std::unique_lock<std::shared_mutex> input_lock = _input->lock();
-#endif
-
 	// Update special uniform variables
 	for (effect &effect : _effects)
 	{
@@ -3522,10 +3731,14 @@ void reshade::runtime::save_texture(const texture &tex)
 
 	_last_screenshot_save_successfull = true;
 
-	if (std::vector<uint8_t> data(static_cast<size_t>(tex.width) * static_cast<size_t>(tex.height * 4));
-		get_texture_data(tex.resource, api::resource_usage::shader_resource, data.data()))
-	{
-		_worker_threads.emplace_back([this, screenshot_path, data = std::move(data), width = tex.width, height = tex.height]() mutable {
+	queue_readback(tex.resource, api::resource_usage::shader_resource, [this, screenshot_path, width = tex.width, height = tex.height](std::vector<uint8_t> &&data) {
+		if (data.empty())
+		{
+			_last_screenshot_save_successfull = false;
+			return;
+		}
+
+		_worker_threads.emplace_back([this, screenshot_path, data = std::move(data), width, height]() mutable {
 			// Default to a save failure unless it is reported to succeed below
 			bool save_success = false;
 
@@ -3542,19 +3755,17 @@ void reshade::runtime::save_texture(const texture &tex)
 					break;
 				case 1:
 				{
-#if 1
 					std::vector<uint8_t> encoded_data;
-					save_success = fpng::fpng_encode_image_to_memory(data.data(), width, height, 4, encoded_data);
-					fwrite(encoded_data.data(), 1, encoded_data.size(), file);
-#else
-					save_success = stbi_write_png_to_func(write_callback, file, width, height, 4, data.data(), 0) != 0;
-#endif
+					save_success = encode_png(data.data(), width, height, 4, encoded_data) && fwrite(encoded_data.data(), 1, encoded_data.size(), file) == encoded_data.size();
 					break;
 				}
 				case 2:
-					save_success = stbi_write_jpg_to_func(write_callback, file, width, height, 4, data.data(), _screenshot_jpeg_quality) != 0;
+				{
+					std::vector<uint8_t> encoded_data;
+					save_success = encode_jpeg(data.data(), width, height, 4, _screenshot_jpeg_quality, encoded_data) && fwrite(encoded_data.data(), 1, encoded_data.size(), file) == encoded_data.size();
 					break;
 				}
+				}
 
 				fclose(file);
 			}
@@ -3566,51 +3777,44 @@ void reshade::runtime::save_texture(const texture &tex)
 				_last_screenshot_save_successfull = save_success;
 			}
 		});
-	}
+	});
 }
 void reshade::runtime::update_texture(texture &tex, const uint32_t width, const uint32_t height, const uint8_t *pixels)
 {
-	std::vector<uint8_t> resized(tex.width * tex.height * 4);
-	// Need to potentially resize image data to the texture dimensions
 	if (tex.width != width || tex.height != height)
-	{
 		LOG(INFO) << "Resizing image data for texture '" << tex.unique_name << "' from " << width << "x" << height << " to " << tex.width << "x" << tex.height << " ...";
 
-		stbir_resize_uint8(pixels, width, height, 0, resized.data(), tex.width, tex.height, 0, 4);
-	}
-	else
-	{
-		std::memcpy(resized.data(), pixels, resized.size());
-	}
-
-	// Collapse data to the correct number of components per pixel based on the texture format
-	uint32_t row_pitch = tex.width;
-	switch (tex.format)
+	// Only convert the base level and generate the other mipmap levels on the GPU
+	std::vector<uint8_t> data;
+	if (!convert_texture_data(api::format_to_default_typed(_device->get_resource_desc(tex.resource).texture.format), tex.width, tex.height, 1, width, height, pixels, data))
 	{
-	case reshadefx::texture_format::r8:
-		for (size_t i = 4, k = 1; i < resized.size(); i += 4, k += 1)
-			resized[k] = resized[i];
-		break;
-	case reshadefx::texture_format::rg8:
-		for (size_t i = 4, k = 2; i < resized.size(); i += 4, k += 2)
-			resized[k + 0] = resized[i + 0],
-			resized[k + 1] = resized[i + 1];
-		row_pitch *= 2;
-		break;
-	case reshadefx::texture_format::rgba8:
-		row_pitch *= 4;
-		break;
-	default:
 		LOG(ERROR) << "Texture upload is not supported for format " << static_cast<int>(tex.format) << " of texture '" << tex.unique_name << "'!";
 		return;
 	}
 
+	upload_texture_data(tex, data.data(), 1);
+}
+void reshade::runtime::upload_texture_data(texture &tex, const uint8_t *data, uint32_t levels)
+{
+	const api::format format = api::format_to_default_typed(_device->get_resource_desc(tex.resource).texture.format);
+
 	api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
 	cmd_list->barrier(tex.resource, api::resource_usage::shader_resource, api::resource_usage::copy_dest);
-	_device->update_texture_region({ resized.data(), row_pitch, row_pitch * tex.height }, tex.resource, 0);
+
+	for (uint32_t level = 0; level < levels; ++level)
+	{
+		const uint32_t row_pitch = api::format_row_pitch(format, std::max(tex.width >> level, 1u));
+		const uint32_t slice_pitch = api::format_slice_pitch(format, row_pitch, std::max(tex.height >> level, 1u));
+
+		_device->update_texture_region({ const_cast<uint8_t *>(data), row_pitch, slice_pitch }, tex.resource, level);
+
+		data += slice_pitch;
+	}
+
 	cmd_list->barrier(tex.resource, api::resource_usage::copy_dest, api::resource_usage::shader_resource);
 
-	if (tex.levels > 1)
+	// Generate any mipmap levels that were not provided
+	if (tex.levels > levels)
 		cmd_list->generate_mipmaps(tex.srv[0]);
 }
 
@@ -3644,50 +3848,9 @@ void reshade::runtime::reset_uniform_value(uniform &variable)
 	}
 }
 
-static inline bool force_floating_point_value(const reshadefx::type &type, uint32_t renderer_id)
-{
-	if (renderer_id == 0x9000)
-		return true; // All uniform variables are floating-point in D3D9
-	if (type.is_matrix() && (renderer_id & 0x10000))
-		return true; // All matrices are floating-point in GLSL
-	return false;
-}
-
 void reshade::runtime::get_uniform_value_data(const uniform &variable, uint8_t *data, size_t size, size_t base_index) const
 {
-	size = std::min(size, static_cast<size_t>(variable.size));
-	assert(data != nullptr && (size % 4) == 0);
-
-	auto &data_storage = _effects[variable.effect_index].uniform_data_storage;
-	assert(variable.offset + size <= data_storage.size());
-
-	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1);
-	if (assert(base_index < array_length); base_index >= array_length)
-		return;
-
-	if (variable.type.is_matrix())
-	{
-		for (size_t a = base_index, i = 0; a < array_length; ++a)
-			// Each row of a matrix is 16-byte aligned, so needs special handling
-			for (size_t row = 0; row < variable.type.rows; ++row)
-				for (size_t col = 0; i < (size / 4) && col < variable.type.cols; ++col, ++i)
-					std::memcpy(
-						data + ((a - base_index) * variable.type.components() + (row * variable.type.cols + col)) * 4,
-						data_storage.data() + variable.offset + (a * (variable.type.rows * 4) + (row * 4 + col)) * 4, 4);
-	}
-	else if (array_length > 1)
-	{
-		for (size_t a = base_index, i = 0; a < array_length; ++a)
-			// Each element in the array is 16-byte aligned, so needs special handling
-			for (size_t row = 0; i < (size / 4) && row < variable.type.rows; ++row, ++i)
-				std::memcpy(
-					data + ((a - base_index) * variable.type.components() + row) * 4,
-					data_storage.data() + variable.offset + (a * 4 + row) * 4, 4);
-	}
-	else
-	{
-		std::memcpy(data, data_storage.data() + variable.offset, size);
-	}
+	copy_uniform_value_data(variable, _effects[variable.effect_index].uniform_data_storage, base_index, data, size);
 }
 
 template <> void reshade::runtime::get_uniform_value<bool>(const uniform &variable, bool *values, size_t count, size_t array_index) const
@@ -3756,39 +3919,7 @@ void reshade::runtime::set_uniform_value_data(uniform &variable, const uint8_t *
 	}
 #endif
 
-	size = std::min(size, static_cast<size_t>(variable.size));
-	assert(data != nullptr && (size % 4) == 0);
-
-	auto &data_storage = _effects[variable.effect_index].uniform_data_storage;
-	assert(variable.offset + size <= data_storage.size());
-
-	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1);
-	if (assert(base_index < array_length); base_index >= array_length)
-		return;
-
-	if (variable.type.is_matrix())
-	{
-		for (size_t a = base_index, i = 0; a < array_length; ++a)
-			// Each row of a matrix is 16-byte aligned, so needs special handling
-			for (size_t row = 0; row < variable.type.rows; ++row)
-				for (size_t col = 0; i < (size / 4) && col < variable.type.cols; ++col, ++i)
-					std::memcpy(
-						data_storage.data() + variable.offset + (a * variable.type.rows * 4 + (row * 4 + col)) * 4,
-						data + ((a - base_index) * variable.type.components() + (row * variable.type.cols + col)) * 4, 4);
-	}
-	else if (array_length > 1)
-	{
-		for (size_t a = base_index, i = 0; a < array_length; ++a)
-			// Each element in the array is 16-byte aligned, so needs special handling
-			for (size_t row = 0; i < (size / 4) && row < variable.type.rows; ++row, ++i)
-				std::memcpy(
-					data_storage.data() + variable.offset + (a * 4 + row) * 4,
-					data + ((a - base_index) * variable.type.components() + row) * 4, 4);
-	}
-	else
-	{
-		std::memcpy(data_storage.data() + variable.offset, data, size);
-	}
+	copy_uniform_value_data(variable, data, size, base_index, _effects[variable.effect_index].uniform_data_storage);
 }
 
 template <> void reshade::runtime::set_uniform_value<bool>(uniform &variable, const bool *values, size_t count, size_t array_index)
@@ -3958,23 +4089,27 @@ void reshade::runtime::save_screenshot(const std::string &postfix)
 
 	_last_screenshot_save_successfull = true;
 
-	if (std::vector<uint8_t> data(static_cast<size_t>(_width) * static_cast<size_t>(_height) * 4);
-		capture_screenshot(data.data()))
-	{
 #if RESHADE_FX
-		const bool include_preset = _screenshot_include_preset && postfix.empty() && ini_file::flush_cache(_current_preset_path);
+	const bool include_preset = _screenshot_include_preset && postfix.empty() && ini_file::flush_cache(_current_preset_path);
 #else
-		const bool include_preset = false;
+	const bool include_preset = false;
 #endif
 
-		_worker_threads.emplace_back([this, screenshot_path, data = std::move(data), include_preset]() mutable {
+	const auto callback = [this, screenshot_path, include_preset, width = _width, height = _height](std::vector<uint8_t> &&data) {
+		if (data.empty())
+		{
+			LOG(ERROR) << "Failed to read back screenshot data for " << screenshot_path << '!';
+			_last_screenshot_save_successfull = false;
+			return;
+		}
+
+		_worker_threads.emplace_back([this, screenshot_path, data = std::move(data), include_preset, width, height]() mutable {
 			// Remove alpha channel
 			int comp = 4;
 			if (_screenshot_clear_alpha)
 			{
 				comp = 3;
-				for (size_t i = 0; i < _width * _height; ++i)
-					*reinterpret_cast<uint32_t *>(data.data() + 3 * i) = *reinterpret_cast<const uint32_t *>(data.data() + 4 * i);
+				strip_alpha_channel(data.data(), static_cast<size_t>(width) * static_cast<size_t>(height));
 			}
 
 			// Create screenshot directory if it does not exist
@@ -3995,23 +4130,21 @@ void reshade::runtime::save_screenshot(const std::string &postfix)
 				switch (_screenshot_format)
 				{
 				case 0:
-					save_success = stbi_write_bmp_to_func(write_callback, file, _width, _height, comp, data.data()) != 0;
+					save_success = stbi_write_bmp_to_func(write_callback, file, width, height, comp, data.data()) != 0;
 					break;
 				case 1:
 				{
-#if 1
 					std::vector<uint8_t> encoded_data;
-					save_success = fpng::fpng_encode_image_to_memory(data.data(), _width, _height, comp, encoded_data);
-					fwrite(encoded_data.data(), 1, encoded_data.size(), file);
-#else
-					save_success = stbi_write_png_to_func(write_callback, file, _width, _height, comp, data.data(), 0) != 0;
-#endif
+					save_success = encode_png(data.data(), width, height, comp, encoded_data) && fwrite(encoded_data.data(), 1, encoded_data.size(), file) == encoded_data.size();
 					break;
 				}
 				case 2:
-					save_success = stbi_write_jpg_to_func(write_callback, file, _width, _height, comp, data.data(), _screenshot_jpeg_quality) != 0;
+				{
+					std::vector<uint8_t> encoded_data;
+					save_success = encode_jpeg(data.data(), width, height, comp, _screenshot_jpeg_quality, encoded_data) && fwrite(encoded_data.data(), 1, encoded_data.size(), file) == encoded_data.size();
 					break;
 				}
+				}
 
 				fclose(file);
 			}
@@ -4043,7 +4176,16 @@ void reshade::runtime::save_screenshot(const std::string &postfix)
 				_last_screenshot_save_successfull = save_success;
 			}
 		});
-	}
+	};
+
+	queue_readback(_back_buffer_resolved != 0 ? _back_buffer_resolved : get_current_back_buffer(), _back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present, callback);
+}
+bool reshade::runtime::capture_screenshot_async(void(*callback)(effect_runtime *runtime, const uint8_t *pixels, uint32_t width, uint32_t height, void *user_data), void *user_data)
+{
+	return queue_readback(_back_buffer_resolved != 0 ? _back_buffer_resolved : get_current_back_buffer(), _back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present,
+		[this, callback, user_data, width = _width, height = _height](std::vector<uint8_t> &&pixels) {
+			callback(this, pixels.empty() ? nullptr : pixels.data(), width, height, user_data);
+		});
 }
 bool reshade::runtime::execute_screenshot_post_save_command(const std::filesystem::path &screenshot_path)
 {
@@ -4096,148 +4238,113 @@ bool reshade::runtime::execute_screenshot_post_save_command(const std::filesyste
 	}
 }
 
-bool reshade::runtime::get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels)
+void reshade::runtime::start_frame_capture()
 {
-	const api::resource_desc desc = _device->get_resource_desc(resource);
-	const api::format view_format = api::format_to_default_typed(desc.texture.format, 0);
-
-	if (view_format != api::format::r8_unorm &&
-		view_format != api::format::r8g8_unorm &&
-		view_format != api::format::r8g8b8a8_unorm &&
-		view_format != api::format::b8g8r8a8_unorm &&
-		view_format != api::format::r8g8b8x8_unorm &&
-		view_format != api::format::b8g8r8x8_unorm &&
-		view_format != api::format::r10g10b10a2_unorm &&
-		view_format != api::format::b10g10r10a2_unorm)
-	{
-		LOG(ERROR) << "Screenshots are not supported for format " << static_cast<uint32_t>(desc.texture.format) << '!';
-		return false;
-	}
+	if (_frame_capture == nullptr)
+		_frame_capture = std::make_unique<frame_capture>();
 
-	uint32_t row_pitch = api::format_row_pitch(view_format, desc.texture.width);
-	if (_device->get_api() == api::device_api::d3d12) // See D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
-		row_pitch = (row_pitch + 255) & ~255;
-	const uint32_t slice_pitch = api::format_slice_pitch(view_format, row_pitch, desc.texture.height);
-	const uint32_t pixels_row_pitch = desc.texture.width * 4;
+	const auto format = static_cast<frame_capture::output_format>(std::min(_capture_format, 2u));
 
-	// Copy back buffer data into system memory buffer
-	api::resource intermediate;
-	if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
+	std::filesystem::path capture_path;
+	if (format != frame_capture::output_format::png_sequence && !_capture_stream_path.empty())
 	{
-		if (!_device->create_resource(api::resource_desc(slice_pitch, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest), nullptr, api::resource_usage::copy_dest, &intermediate))
-		{
-			LOG(ERROR) << "Failed to create system memory buffer for screenshot capture!";
-			return false;
-		}
-
-		_device->set_resource_name(intermediate, "ReShade screenshot buffer");
-
-		api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
-		cmd_list->barrier(resource, state, api::resource_usage::copy_source);
-		cmd_list->copy_texture_to_buffer(resource, 0, nullptr, intermediate, 0, desc.texture.width, desc.texture.height);
-		cmd_list->barrier(resource, api::resource_usage::copy_source, state);
+		// Allow writing to a named pipe (e.g. "\\.\pipe\reshade"), so that an external encoder can consume the frames directly
+		capture_path = _capture_stream_path;
+		if (capture_path.is_relative())
+			capture_path = g_reshade_base_path / capture_path;
 	}
 	else
 	{
-		if (!_device->create_resource(api::resource_desc(desc.texture.width, desc.texture.height, 1, 1, view_format, 1, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest), nullptr, api::resource_usage::copy_dest, &intermediate))
-		{
-			LOG(ERROR) << "Failed to create system memory texture for screenshot capture!";
-			return false;
-		}
-
-		_device->set_resource_name(intermediate, "ReShade screenshot texture");
-
-		api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
-		cmd_list->barrier(resource, state, api::resource_usage::copy_source);
-		cmd_list->copy_texture_region(resource, 0, nullptr, intermediate, 0, nullptr);
-		cmd_list->barrier(resource, api::resource_usage::copy_source, state);
-	}
+		std::string capture_name = expand_macro_string(_screenshot_name, {
+			{ "AppName", g_target_executable_path.stem().u8string() },
+#if RESHADE_FX
+			{ "PresetName",  _current_preset_path.stem().u8string() },
+#endif
+		});
 
-	// Wait for any rendering by the application finish before submitting
-	// It may have submitted that to a different queue, so simply wait for all to idle here
-	_graphics_queue->wait_idle();
+		if (format == frame_capture::output_format::y4m)
+			capture_name += ".y4m";
+		else if (format == frame_capture::output_format::raw)
+			capture_name += ".rgba";
 
-	// Copy data from intermediate image into output buffer
-	api::subresource_data mapped_data = {};
-	if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
-	{
-		_device->map_buffer_region(intermediate, 0, std::numeric_limits<uint64_t>::max(), api::map_access::read_only, &mapped_data.data);
+		capture_path = g_reshade_base_path / _screenshot_path / std::filesystem::u8path(capture_name);
 
-		mapped_data.row_pitch = row_pitch;
-		mapped_data.slice_pitch = slice_pitch;
+		if (std::error_code ec; !std::filesystem::exists(capture_path.parent_path(), ec))
+			std::filesystem::create_directories(capture_path.parent_path(), ec);
 	}
-	else
+
+	if (!_frame_capture->start(capture_path, format, _width, _height, _capture_frame_rate, _capture_max_queued_frames, _capture_encoder_threads, !_capture_drop_frames_when_full))
 	{
-		_device->map_texture_region(intermediate, 0, nullptr, api::map_access::read_only, &mapped_data);
+		LOG(ERROR) << "Failed to open " << capture_path << " for frame capture!";
+		return;
 	}
 
-	if (mapped_data.data != nullptr)
-	{
-		auto mapped_pixels = static_cast<const uint8_t *>(mapped_data.data);
+	_capture_start_frame = _framecount;
 
-		for (uint32_t y = 0; y < desc.texture.height; ++y, pixels += pixels_row_pitch, mapped_pixels += mapped_data.row_pitch)
-		{
-			switch (view_format)
-			{
-			case api::format::r8_unorm:
-				for (uint32_t x = 0; x < desc.texture.width; ++x)
-				{
-					pixels[x * 4 + 0] = mapped_pixels[x];
-					pixels[x * 4 + 1] = 0;
-					pixels[x * 4 + 2] = 0;
-					pixels[x * 4 + 3] = 0xFF;
-				}
-				break;
-			case api::format::r8g8_unorm:
-				for (uint32_t x = 0; x < desc.texture.width; ++x)
-				{
-					pixels[x * 4 + 0] = mapped_pixels[x * 2 + 0];
-					pixels[x * 4 + 1] = mapped_pixels[x * 2 + 1];
-					pixels[x * 4 + 2] = 0;
-					pixels[x * 4 + 3] = 0xFF;
-				}
-				break;
-			case api::format::r8g8b8a8_unorm:
-			case api::format::r8g8b8x8_unorm:
-				std::memcpy(pixels, mapped_pixels, pixels_row_pitch);
-				if (view_format == api::format::r8g8b8x8_unorm)
-					for (uint32_t x = 0; x < pixels_row_pitch; x += 4)
-						pixels[x + 3] = 0xFF;
-				break;
-			case api::format::b8g8r8a8_unorm:
-			case api::format::b8g8r8x8_unorm:
-				std::memcpy(pixels, mapped_pixels, pixels_row_pitch);
-				// Format is BGRA, but output should be RGBA, so flip channels
-				for (uint32_t x = 0; x < pixels_row_pitch; x += 4)
-					std::swap(pixels[x + 0], pixels[x + 2]);
-				if (view_format == api::format::b8g8r8x8_unorm)
-					for (uint32_t x = 0; x < pixels_row_pitch; x += 4)
-						pixels[x + 3] = 0xFF;
-				break;
-			case api::format::r10g10b10a2_unorm:
-			case api::format::b10g10r10a2_unorm:
-				for (uint32_t x = 0; x < pixels_row_pitch; x += 4)
-				{
-					const uint32_t rgba = *reinterpret_cast<const uint32_t *>(mapped_pixels + x);
-					// Divide by 4 to get 10-bit range (0-1023) into 8-bit range (0-255)
-					pixels[x + 0] = (( rgba & 0x000003FF)        /  4) & 0xFF;
-					pixels[x + 1] = (((rgba & 0x000FFC00) >> 10) /  4) & 0xFF;
-					pixels[x + 2] = (((rgba & 0x3FF00000) >> 20) /  4) & 0xFF;
-					pixels[x + 3] = (((rgba & 0xC0000000) >> 30) * 85) & 0xFF;
-					if (view_format == api::format::b10g10r10a2_unorm)
-						std::swap(pixels[x + 0], pixels[x + 2]);
-				}
-				break;
-			}
-		}
+	LOG(INFO) << "Starting frame capture to " << capture_path << " ...";
+}
+void reshade::runtime::stop_frame_capture()
+{
+	if (_frame_capture == nullptr || !_frame_capture->is_active())
+		return;
 
-		if (_device->check_capability(api::device_caps::copy_buffer_to_texture))
-			_device->unmap_buffer_region(intermediate);
-		else
-			_device->unmap_texture_region(intermediate, 0);
+	_frame_capture->stop();
+
+	const frame_capture::statistics stats = _frame_capture->get_statistics();
+
+	LOG(INFO) << "Finished frame capture to " << _frame_capture->path() << " with " << stats.frames_written << " frames written (" << stats.frames_dropped << " dropped, " << stats.bytes_written / (1024 * 1024) << " MiB, " << stats.frames_per_second << " FPS).";
+}
+
+static bool log_readback_status(reshade::api::device *device, reshade::readback_ring::status status, reshade::api::resource resource)
+{
+	switch (status)
+	{
+	case reshade::readback_ring::status::success:
+		return true;
+	case reshade::readback_ring::status::unsupported_format:
+		LOG(ERROR) << "Screenshots are not supported for format " << static_cast<uint32_t>(device->get_resource_desc(resource).texture.format) << '!';
+		return false;
+	case reshade::readback_ring::status::too_many_pending:
+		LOG(ERROR) << "Failed to capture screenshot, since there are too many captures pending!";
+		return false;
+	default:
+		LOG(ERROR) << "Failed to create system memory " << (device->check_capability(reshade::api::device_caps::copy_buffer_to_texture) ? "buffer" : "texture") << " for screenshot capture!";
+		return false;
 	}
+}
 
-	_device->destroy_resource(intermediate);
+bool reshade::runtime::get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels)
+{
+	const size_t slot_index = queue_readback(resource, state);
+	if (slot_index == readback_ring::invalid_slot)
+		return false;
 
-	return mapped_data.data != nullptr;
+	// Wait for any rendering by the application finish before submitting
+	// It may have submitted that to a different queue, so simply wait for all to idle here
+	_graphics_queue->wait_idle();
+
+	return finish_readback(slot_index, pixels);
+}
+
+size_t reshade::runtime::queue_readback(api::resource resource, api::resource_usage state)
+{
+	size_t slot_index = readback_ring::invalid_slot;
+	log_readback_status(_device, _readbacks->queue(resource, state, slot_index), resource);
+	return slot_index;
+}
+bool reshade::runtime::queue_readback(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels)> &&callback)
+{
+	return log_readback_status(_device, _readbacks->queue(resource, state, std::move(callback)), resource);
+}
+bool reshade::runtime::finish_readback(size_t slot_index, uint8_t *pixels)
+{
+	return _readbacks->finish(slot_index, pixels);
+}
+void reshade::runtime::process_readbacks(bool wait_for_completion)
+{
+	_readbacks->process(wait_for_completion);
+}
+void reshade::runtime::destroy_readbacks()
+{
+	_readbacks->destroy();
 }
@@ -7,15 +7,21 @@
 
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <filesystem>
 #include <atomic>
+#include <functional>
 #include <shared_mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include "reshade_api.hpp"
+#include "texture_load_queue.hpp"
+#include "effect_name_index.hpp"
 #if RESHADE_GUI
 #include "imgui_code_editor.hpp"
+#include "imgui_draw_data_cache.hpp"
+#include "log_history.hpp"
 #endif
 
 class ini_file;
@@ -27,6 +33,8 @@ namespace reshade
 	struct uniform;
 	struct texture;
 	struct technique;
+	class frame_capture;
+	class readback_ring;
 
 	/// <summary>
 	/// The main ReShade post-processing effect runtime.
@@ -84,6 +92,10 @@ namespace reshade
 		/// Captures a screenshot of the current back buffer resource and returns its image data in 32 bits-per-pixel RGBA format.
 		/// </summary>
 		bool capture_screenshot(uint8_t *pixels) final { return get_texture_data(_back_buffer_resolved != 0 ? _back_buffer_resolved : get_current_back_buffer(), _back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present, pixels); }
+		/// <summary>
+		/// Captures a screenshot of the current back buffer resource without stalling and calls the specified <paramref name="callback"/> function with its image data a few frames later.
+		/// </summary>
+		bool capture_screenshot_async(void(*callback)(effect_runtime *runtime, const uint8_t *pixels, uint32_t width, uint32_t height, void *user_data), void *user_data = nullptr) final;
 
 		/// <summary>
 		/// Gets the current buffer dimensions of the swap chain as used with effect rendering.
@@ -165,6 +177,17 @@ namespace reshade
 		void set_uniform_value_int(api::effect_uniform_variable variable, const int32_t *values, size_t count, size_t array_index) final;
 		void set_uniform_value_uint(api::effect_uniform_variable variable, const uint32_t *values, size_t count, size_t array_index) final;
 
+		/// <summary>
+		/// Gets or sets the values of multiple uniform variables at once.
+		/// </summary>
+		void get_uniform_values(const api::effect_uniform_value_query *queries, size_t count) const final;
+		void set_uniform_values(const api::effect_uniform_value_update *updates, size_t count) final;
+
+		/// <summary>
+		/// Gets a counter that changes every time effects are loaded or unloaded.
+		/// </summary>
+		uint32_t get_effects_generation() const final;
+
 		/// <summary>
 		/// Enumerates all texture variables of loaded effects and calls the specified <paramref name="callback"/> function with a handle for each one.
 		/// </summary>
@@ -289,6 +312,7 @@ namespace reshade
 
 		void load_effects();
 		void load_textures();
+		void cancel_texture_loading();
 		bool reload_effect(size_t effect_index, bool preprocess_required = false);
 		void reload_effects();
 		void destroy_effects();
@@ -302,6 +326,7 @@ namespace reshade
 
 		void save_texture(const texture &texture);
 		void update_texture(texture &texture, const uint32_t width, const uint32_t height, const uint8_t *pixels);
+		void upload_texture_data(texture &texture, const uint8_t *data, uint32_t levels);
 
 		void reset_uniform_value(uniform &variable);
 
@@ -325,6 +350,12 @@ namespace reshade
 
 		bool get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels);
 
+		size_t queue_readback(api::resource resource, api::resource_usage state);
+		bool queue_readback(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels)> &&callback);
+		bool finish_readback(size_t slot_index, uint8_t *pixels);
+		void process_readbacks(bool wait_for_completion = false);
+		void destroy_readbacks();
+
 		bool execute_screenshot_post_save_command(const std::filesystem::path &screenshot_path);
 
 		#pragma region Status
@@ -372,6 +403,7 @@ namespace reshade
 		std::atomic<bool> _last_reload_successfull = true;
 		bool _textures_loaded = false;
 		bool _last_texture_reload_successfull = true;
+		unsigned int _texture_upload_budget = 16; // In megabytes per frame
 		std::shared_mutex _reload_mutex;
 		std::vector<size_t> _reload_create_queue;
 		std::atomic<size_t> _reload_remaining_effects = 0;
@@ -380,6 +412,26 @@ namespace reshade
 		std::vector<effect> _effects;
 		std::vector<texture> _textures;
 		std::vector<technique> _techniques;
+
+		// Changes every time effects, textures or techniques are added, removed or reordered, which rebuilds the name index on the next lookup
+		std::atomic<uint32_t> _effects_generation = 1;
+		mutable effect_name_index _name_index;
+
+		struct texture_load_job
+		{
+			std::filesystem::path source_path;
+			api::format format = api::format::unknown;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t levels = 0;
+			// Unique names of all textures that reference the same image file with the same dimensions and format
+			std::vector<std::string> texture_names;
+			// Image data of all mipmap levels, tightly packed and converted to the texture format
+			std::vector<uint8_t> data;
+		};
+
+		std::vector<texture_load_job> _texture_load_jobs;
+		texture_load_queue _texture_loads;
 #endif
 		std::vector<std::thread> _worker_threads;
 		std::chrono::high_resolution_clock::time_point _last_reload_time;
@@ -432,6 +484,25 @@ namespace reshade
 		bool _screenshot_directory_creation_successfull = true;
 		std::filesystem::path _last_screenshot_file;
 		std::chrono::high_resolution_clock::time_point _last_screenshot_time;
+
+		std::unique_ptr<readback_ring> _readbacks;
+		#pragma endregion
+
+		#pragma region Frame Capture
+		void start_frame_capture();
+		void stop_frame_capture();
+
+		unsigned int _capture_key_data[4] = {};
+		unsigned int _capture_format = 0;
+		unsigned int _capture_frame_interval = 1;
+		unsigned int _capture_frame_rate = 60;
+		unsigned int _capture_max_queued_frames = 8;
+		unsigned int _capture_encoder_threads = 0;
+		bool _capture_drop_frames_when_full = true;
+		std::filesystem::path _capture_stream_path;
+
+		std::unique_ptr<frame_capture> _frame_capture;
+		uint64_t _capture_start_frame = 0;
 		#pragma endregion
 
 		#pragma region Preset Switching
@@ -475,9 +546,11 @@ namespace reshade
 #if RESHADE_FX
 		void draw_variable_editor();
 		void draw_technique_editor();
+		void update_technique_list();
 #endif
 
 		bool init_imgui_resources();
+		bool upload_imgui_draw_data(ImDrawData *draw_data);
 		void render_imgui_draw_data(api::command_list *cmd_list, ImDrawData *draw_data, api::resource_view rtv);
 		void destroy_imgui_resources();
 
@@ -503,6 +576,8 @@ namespace reshade
 		unsigned int _fps_pos = 1;
 		unsigned int _clock_format = 0;
 		unsigned int _input_processing_mode = 2;
+		// Maximum number of times per second the overlay is updated while the user is not interacting with it, or zero to update it every frame
+		unsigned int _overlay_idle_update_rate = 0;
 
 		api::resource _font_atlas_tex = {};
 		api::resource_view _font_atlas_srv = {};
@@ -511,10 +586,11 @@ namespace reshade
 		api::pipeline_layout _imgui_pipeline_layout = {};
 		api::sampler  _imgui_sampler_state = {};
 
-		int _imgui_num_indices[4] = {};
-		api::resource _imgui_indices[4] = {};
-		int _imgui_num_vertices[4] = {};
-		api::resource _imgui_vertices[4] = {};
+		int _imgui_num_indices[imgui_draw_data_cache::num_buffers] = {};
+		api::resource _imgui_indices[imgui_draw_data_cache::num_buffers] = {};
+		int _imgui_num_vertices[imgui_draw_data_cache::num_buffers] = {};
+		api::resource _imgui_vertices[imgui_draw_data_cache::num_buffers] = {};
+		imgui_draw_data_cache _imgui_draw_data;
 
 		api::resource _vr_overlay_tex = {};
 		api::resource_view _vr_overlay_target = {};
@@ -531,6 +607,17 @@ namespace reshade
 		unsigned int _tutorial_index = 0;
 		unsigned int _effects_expanded_state = 2;
 		float _variable_editor_height = 300.0f;
+		// Indices of the techniques shown in the technique list, in display order
+		// This is only updated when the filter or the list of techniques changes (see 'update_technique_list'), instead of every frame
+		std::vector<size_t> _technique_list;
+		std::string _technique_list_filter;
+		uint32_t _technique_list_generation = 0;
+		bool _technique_list_dirty = true;
+		// Height each effect took up in the variable list the last time it was drawn, so that effects scrolled out of view can be skipped
+		std::vector<float> _variable_editor_section_heights;
+		uint32_t _variable_editor_section_generation = 0;
+		float _variable_editor_section_width = 0.0f;
+		float _variable_editor_section_line_height = 0.0f;
 #endif
 		#pragma endregion
 
@@ -562,8 +649,8 @@ namespace reshade
 		#pragma region Overlay Log
 		char _log_filter[64] = {};
 		bool _log_wordwrap = false;
-		uintmax_t _last_log_size;
-		std::vector<std::string> _log_lines;
+		// Copy of the most recent log lines, which is only extended with the lines logged since the last frame
+		log::history_view _log_view;
 		#pragma endregion
 
 		#pragma region Overlay Code Editor
@@ -5,6 +5,7 @@
 
 #include "runtime.hpp"
 #include "runtime_objects.hpp"
+#include "uniform_values.hpp"
 #include "input.hpp"
 #include <cassert>
 
@@ -15,37 +16,75 @@ reshade::input::window_handle reshade::runtime::get_hwnd() const
 
 bool reshade::runtime::is_key_down(uint32_t keycode) const
 {
-	return _input != nullptr && _input->is_key_down(keycode);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_key_down(keycode);
 }
 bool reshade::runtime::is_key_pressed(uint32_t keycode) const
 {
-	return _input != nullptr && _input->is_key_pressed(keycode);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_key_pressed(keycode);
 }
 bool reshade::runtime::is_key_released(uint32_t keycode) const
 {
-	return _input != nullptr && _input->is_key_released(keycode);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_key_released(keycode);
 }
 bool reshade::runtime::is_mouse_button_down(uint32_t button) const
 {
-	return _input != nullptr && _input->is_mouse_button_down(button);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_mouse_button_down(button);
 }
 bool reshade::runtime::is_mouse_button_pressed(uint32_t button) const
 {
-	return _input != nullptr && _input->is_mouse_button_pressed(button);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_mouse_button_pressed(button);
 }
 bool reshade::runtime::is_mouse_button_released(uint32_t button) const
 {
-	return _input != nullptr && _input->is_mouse_button_released(button);
+	if (_input == nullptr)
+		return false;
+
+	const auto lock = _input->lock_frame_state();
+	return _input->is_mouse_button_released(button);
 }
 
 void reshade::runtime::get_mouse_cursor_position(uint32_t *out_x, uint32_t *out_y, int16_t *out_wheel_delta) const
 {
+	if (_input == nullptr)
+	{
+		if (out_x != nullptr)
+			*out_x = 0;
+		if (out_y != nullptr)
+			*out_y = 0;
+		if (out_wheel_delta != nullptr)
+			*out_wheel_delta = 0;
+		return;
+	}
+
+	// Add-ons may call this from any thread, so prevent the snapshot from being replaced in the middle of reading it
+	const auto lock = _input->lock_frame_state();
+
 	if (out_x != nullptr)
-		*out_x = (_input != nullptr) ? _input->mouse_position_x() : 0;
+		*out_x = _input->mouse_position_x();
 	if (out_y != nullptr)
-		*out_y = (_input != nullptr) ? _input->mouse_position_y() : 0;
+		*out_y = _input->mouse_position_y();
 	if (out_wheel_delta != nullptr)
-		*out_wheel_delta = (_input != nullptr) ? _input->mouse_wheel_delta() : 0;
+		*out_wheel_delta = _input->mouse_wheel_delta();
 }
 
 void reshade::runtime::enumerate_uniform_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, api::effect_uniform_variable variable, void *user_data), void *user_data)
@@ -71,23 +110,13 @@ void reshade::runtime::enumerate_uniform_variables(const char *effect_name, void
 reshade::api::effect_uniform_variable reshade::runtime::find_uniform_variable(const char *effect_name, const char *variable_name) const
 {
 #if RESHADE_FX
-	if (is_loading())
+	if (is_loading() || variable_name == nullptr)
 		return { 0 };
 
-	for (const effect &effect : _effects)
-	{
-		if (effect_name != nullptr && effect.source_file.filename() != effect_name)
-			continue;
-
-		for (const uniform &variable : effect.uniforms)
-		{
-			if (variable.name == variable_name)
-				return { reinterpret_cast<uintptr_t>(&variable) };
-		}
+	const std::shared_lock<std::shared_mutex> lock = _name_index.lock(_effects_generation, _effects, _textures, _techniques);
 
-		if (effect_name != nullptr)
-			break;
-	}
+	if (const auto object = _name_index.find_uniform(effect_name, variable_name))
+		return { reinterpret_cast<uintptr_t>(object) };
 #endif
 
 	return { 0 };
@@ -165,12 +194,10 @@ bool reshade::runtime::get_annotation_bool_from_uniform_variable(api::effect_uni
 	const auto variable = reinterpret_cast<const uniform *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_uint(name, i + array_index);
+				values[i] = get_annotation_uint(*annotation, i + array_index);
 			return true;
 		}
 	}
@@ -186,12 +213,10 @@ bool reshade::runtime::get_annotation_float_from_uniform_variable(api::effect_un
 	const auto variable = reinterpret_cast<const uniform *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_float(name, i + array_index);
+				values[i] = get_annotation_float(*annotation, i + array_index);
 			return true;
 		}
 	}
@@ -207,12 +232,10 @@ bool reshade::runtime::get_annotation_int_from_uniform_variable(api::effect_unif
 	const auto variable = reinterpret_cast<const uniform *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_int(name, array_index + i);
+				values[i] = get_annotation_int(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -228,12 +251,10 @@ bool reshade::runtime::get_annotation_uint_from_uniform_variable(api::effect_uni
 	const auto variable = reinterpret_cast<const uniform *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_uint(name, array_index + i);
+				values[i] = get_annotation_uint(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -249,11 +270,9 @@ bool reshade::runtime::get_annotation_string_from_uniform_variable(api::effect_u
 	const auto variable = reinterpret_cast<const uniform *>(handle.handle);
 	if (variable != nullptr && length != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const info = find_annotation(variable->annotations, name))
 		{
-			const std::string_view annotation = variable->annotation_as_string(name);
+			const std::string_view annotation = info->value.string_data;
 
 			if (value != nullptr && *length != 0)
 				value[annotation.copy(value, *length - 1)] = '\0';
@@ -399,6 +418,78 @@ void reshade::runtime::set_uniform_value_uint(api::effect_uniform_variable handl
 #endif
 }
 
+void reshade::runtime::get_uniform_values(const api::effect_uniform_value_query *queries, size_t count) const
+{
+#if RESHADE_FX
+	for (size_t i = 0; i < count; ++i)
+	{
+		const api::effect_uniform_value_query &query = queries[i];
+
+		const auto variable = reinterpret_cast<const uniform *>(query.variable.handle);
+		if (variable == nullptr || query.values == nullptr)
+			continue;
+
+		switch (query.type)
+		{
+		case api::effect_uniform_value_type::boolean:
+			get_uniform_value(*variable, static_cast<bool *>(query.values), query.count, query.array_index);
+			break;
+		case api::effect_uniform_value_type::floating_point:
+			get_uniform_value(*variable, static_cast<float *>(query.values), query.count, query.array_index);
+			break;
+		case api::effect_uniform_value_type::signed_int:
+			get_uniform_value(*variable, static_cast<int32_t *>(query.values), query.count, query.array_index);
+			break;
+		case api::effect_uniform_value_type::unsigned_int:
+			get_uniform_value(*variable, static_cast<uint32_t *>(query.values), query.count, query.array_index);
+			break;
+		}
+	}
+#endif
+}
+void reshade::runtime::set_uniform_values(const api::effect_uniform_value_update *updates, size_t count)
+{
+#if RESHADE_FX
+#if RESHADE_ADDON
+	const bool was_is_in_api_call = _is_in_api_call;
+	_is_in_api_call = true;
+#endif
+
+	// Check all updates and convert their values up front, so that only plain copies into uniform storage remain
+	std::vector<uniform_value_write> writes;
+	std::vector<uint32_t> converted;
+	prepare_uniform_value_updates(updates, count, _renderer_id, writes, converted);
+
+	bool preset_modified = false;
+
+	for (const uniform_value_write &write : writes)
+	{
+		copy_uniform_value_data(write, _effects[write.effect_index].uniform_data_storage);
+
+		if (write.special == special_uniform::none)
+			preset_modified = true;
+	}
+
+	// Saving the preset serializes all uniform variables of active effects, so only do that once for the entire batch instead of once per variable
+	if (preset_modified)
+		save_current_preset();
+
+#if RESHADE_ADDON
+	_is_in_api_call = was_is_in_api_call;
+#endif
+#endif
+}
+
+uint32_t reshade::runtime::get_effects_generation() const
+{
+#if RESHADE_FX
+	return _effects_generation.load();
+#else
+	return 0;
+#endif
+}
+
+
 void reshade::runtime::enumerate_texture_variables(const char *effect_name, void(*callback)(effect_runtime *runtime, api::effect_texture_variable variable, void *user_data), void *user_data)
 {
 #if RESHADE_FX
@@ -420,19 +511,13 @@ void reshade::runtime::enumerate_texture_variables(const char *effect_name, void
 reshade::api::effect_texture_variable reshade::runtime::find_texture_variable(const char *effect_name, const char *variable_name) const
 {
 #if RESHADE_FX
-	if (is_loading() || !_reload_create_queue.empty())
+	if (is_loading() || !_reload_create_queue.empty() || variable_name == nullptr)
 		return { 0 };
 
-	for (const texture &variable : _textures)
-	{
-		if (effect_name != nullptr &&
-			std::find_if(variable.shared.begin(), variable.shared.end(),
-				[this, effect_name](size_t effect_index) { return _effects[effect_index].source_file.filename() == effect_name; }) == variable.shared.end())
-			continue;
+	const std::shared_lock<std::shared_mutex> lock = _name_index.lock(_effects_generation, _effects, _textures, _techniques);
 
-		if (variable.name == variable_name || variable.unique_name == variable_name)
-			return { reinterpret_cast<uintptr_t>(&variable) };
-	}
+	if (const auto object = _name_index.find_texture(effect_name, variable_name))
+		return { reinterpret_cast<uintptr_t>(object) };
 #endif
 
 	return { 0 };
@@ -463,12 +548,10 @@ bool reshade::runtime::get_annotation_bool_from_texture_variable(api::effect_tex
 	const auto variable = reinterpret_cast<const texture *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_uint(name, array_index + i) != 0;
+				values[i] = get_annotation_uint(*annotation, array_index + i) != 0;
 			return true;
 		}
 	}
@@ -484,12 +567,10 @@ bool reshade::runtime::get_annotation_float_from_texture_variable(api::effect_te
 	const auto variable = reinterpret_cast<const texture *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_float(name, array_index + i);
+				values[i] = get_annotation_float(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -505,12 +586,10 @@ bool reshade::runtime::get_annotation_int_from_texture_variable(api::effect_text
 	const auto variable = reinterpret_cast<const texture *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_int(name, array_index + i);
+				values[i] = get_annotation_int(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -526,12 +605,10 @@ bool reshade::runtime::get_annotation_uint_from_texture_variable(api::effect_tex
 	const auto variable = reinterpret_cast<const texture *>(handle.handle);
 	if (variable != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(variable->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = variable->annotation_as_uint(name, array_index + i);
+				values[i] = get_annotation_uint(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -547,11 +624,9 @@ bool reshade::runtime::get_annotation_string_from_texture_variable(api::effect_t
 	const auto variable = reinterpret_cast<const texture *>(handle.handle);
 	if (variable != nullptr && length != nullptr)
 	{
-		const auto it = std::find_if(variable->annotations.begin(), variable->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != variable->annotations.end())
+		if (const reshadefx::annotation *const info = find_annotation(variable->annotations, name))
 		{
-			const std::string_view annotation = variable->annotation_as_string(name);
+			const std::string_view annotation = info->value.string_data;
 
 			if (value != nullptr && *length != 0)
 				value[annotation.copy(value, *length - 1)] = '\0';
@@ -675,17 +750,13 @@ void reshade::runtime::enumerate_techniques(const char *effect_name, void(*callb
 reshade::api::effect_technique reshade::runtime::find_technique(const char *effect_name, const char *technique_name)
 {
 #if RESHADE_FX
-	if (is_loading())
+	if (is_loading() || technique_name == nullptr)
 		return { 0 };
 
-	for (const technique &technique : _techniques)
-	{
-		if (effect_name != nullptr && _effects[technique.effect_index].source_file.filename() != effect_name)
-			continue;
+	const std::shared_lock<std::shared_mutex> lock = _name_index.lock(_effects_generation, _effects, _textures, _techniques);
 
-		if (technique.name == technique_name)
-			return { reinterpret_cast<uintptr_t>(&technique) };
-	}
+	if (const auto object = _name_index.find_technique(effect_name, technique_name))
+		return { reinterpret_cast<uintptr_t>(object) };
 #endif
 
 	return { 0 };
@@ -716,12 +787,10 @@ bool reshade::runtime::get_annotation_bool_from_technique(api::effect_technique
 	const auto tech = reinterpret_cast<const technique *>(handle.handle);
 	if (tech != nullptr)
 	{
-		const auto it = std::find_if(tech->annotations.begin(), tech->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != tech->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(tech->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = tech->annotation_as_uint(name, array_index + i) != 0;
+				values[i] = get_annotation_uint(*annotation, array_index + i) != 0;
 			return true;
 		}
 	}
@@ -737,12 +806,10 @@ bool reshade::runtime::get_annotation_float_from_technique(api::effect_technique
 	const auto tech = reinterpret_cast<const technique *>(handle.handle);
 	if (tech != nullptr)
 	{
-		const auto it = std::find_if(tech->annotations.begin(), tech->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != tech->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(tech->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = tech->annotation_as_float(name, array_index + i);
+				values[i] = get_annotation_float(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -758,12 +825,10 @@ bool reshade::runtime::get_annotation_int_from_technique(api::effect_technique h
 	const auto tech = reinterpret_cast<const technique *>(handle.handle);
 	if (tech != nullptr)
 	{
-		const auto it = std::find_if(tech->annotations.begin(), tech->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != tech->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(tech->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = tech->annotation_as_int(name, array_index + i);
+				values[i] = get_annotation_int(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -779,12 +844,10 @@ bool reshade::runtime::get_annotation_uint_from_technique(api::effect_technique
 	const auto tech = reinterpret_cast<const technique *>(handle.handle);
 	if (tech != nullptr)
 	{
-		const auto it = std::find_if(tech->annotations.begin(), tech->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != tech->annotations.end())
+		if (const reshadefx::annotation *const annotation = find_annotation(tech->annotations, name))
 		{
 			for (size_t i = 0; i < count; ++i)
-				values[i] = tech->annotation_as_uint(name, array_index + i);
+				values[i] = get_annotation_uint(*annotation, array_index + i);
 			return true;
 		}
 	}
@@ -800,11 +863,9 @@ bool reshade::runtime::get_annotation_string_from_technique(api::effect_techniqu
 	const auto tech = reinterpret_cast<const technique *>(handle.handle);
 	if (tech != nullptr && length != nullptr)
 	{
-		const auto it = std::find_if(tech->annotations.begin(), tech->annotations.end(),
-			[name](const auto &annotation) { return annotation.name == name; });
-		if (it != tech->annotations.end())
+		if (const reshadefx::annotation *const info = find_annotation(tech->annotations, name))
 		{
-			const std::string_view annotation = tech->annotation_as_string(name);
+			const std::string_view annotation = info->value.string_data;
 
 			if (value != nullptr && *length != 0)
 				value[annotation.copy(value, *length - 1)] = '\0';
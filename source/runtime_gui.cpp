@@ -15,6 +15,7 @@
 #include "input.hpp"
 #include "imgui_widgets.hpp"
 #include "process_utils.hpp"
+#include "frame_capture.hpp"
 #include "fonts/forkawesome.inl"
 #include <fstream>
 #include <algorithm>
@@ -170,6 +171,7 @@ void reshade::runtime::load_config_gui(const ini_file &config)
 
 	config.get("OVERLAY", "ClockFormat", _clock_format);
 	config.get("OVERLAY", "FPSPosition", _fps_pos);
+	config.get("OVERLAY", "IdleUpdateRate", _overlay_idle_update_rate);
 	config.get("OVERLAY", "NoFontScaling", _no_font_scaling);
 	config.get("OVERLAY", "SaveWindowState", _save_imgui_window_state);
 	config.get("OVERLAY", "ShowClock", _show_clock);
@@ -224,6 +226,7 @@ void reshade::runtime::save_config_gui(ini_file &config) const
 
 	config.set("OVERLAY", "ClockFormat", _clock_format);
 	config.set("OVERLAY", "FPSPosition", _fps_pos);
+	config.set("OVERLAY", "IdleUpdateRate", _overlay_idle_update_rate);
 	config.set("OVERLAY", "NoFontScaling", _no_font_scaling);
 	config.set("OVERLAY", "SaveWindowState", _save_imgui_window_state);
 	config.set("OVERLAY", "ShowClock", _show_clock);
@@ -569,7 +572,8 @@ void reshade::runtime::draw_gui()
 	const bool show_stats_window = _show_clock || _show_fps || _show_frametime;
 	// Do not show this message in the same frame the screenshot is taken (so that it won't show up on the GUI screenshot)
 	const bool show_screenshot_message = (_show_screenshot_message || !_last_screenshot_save_successfull) && !_should_save_screenshot && (_last_present_time - _last_screenshot_time) < std::chrono::seconds(_last_screenshot_save_successfull ? 3 : 5);
-	if (show_screenshot_message || !_preset_save_successfull)
+	const bool show_capture_message = _frame_capture != nullptr && _frame_capture->is_active();
+	if (show_screenshot_message || show_capture_message || !_preset_save_successfull)
 		show_splash = true;
 
 	if (_show_overlay && !_ignore_shortcuts && !_imgui_context->IO.NavVisible && _input->is_key_pressed(0x1B /* VK_ESCAPE */))
@@ -577,6 +581,53 @@ void reshade::runtime::draw_gui()
 	else if (!_ignore_shortcuts && _input->is_key_pressed(_overlay_key_data, _force_shortcut_modifiers) && _imgui_context->ActiveId == 0)
 		_show_overlay = !_show_overlay;
 
+	const auto render_draw_data = [this](ImDrawData *draw_data) {
+		if (draw_data == nullptr || draw_data->CmdListsCount == 0 || draw_data->TotalVtxCount == 0)
+			return;
+
+		api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
+
+		if (_back_buffer_resolved != 0)
+		{
+			render_imgui_draw_data(cmd_list, draw_data, _back_buffer_targets[0]);
+		}
+		else
+		{
+			uint32_t back_buffer_index = get_current_back_buffer_index();
+			const api::resource back_buffer_resource = get_back_buffer(back_buffer_index);
+
+			cmd_list->barrier(back_buffer_resource, api::resource_usage::present, api::resource_usage::render_target);
+			render_imgui_draw_data(cmd_list, draw_data, _back_buffer_targets[back_buffer_index * 2]);
+			cmd_list->barrier(back_buffer_resource, api::resource_usage::render_target, api::resource_usage::present);
+		}
+	};
+
+	const unsigned int overlay_state = (show_splash ? 1 : 0) | (show_stats_window ? 2 : 0) | (_show_overlay ? 4 : 0);
+
+	// Render the result of the last update again instead of building a new frame while the user is not interacting with the overlay and the update rate limit was not reached yet
+	// The statistics and other changing values in the overlay are then only refreshed at that rate
+	if (_imgui_draw_data.can_render_last_update(overlay_state, _overlay_idle_update_rate, _last_present_time) &&
+		_imgui_context->IO.DisplaySize.x == static_cast<float>(_width) &&
+		_imgui_context->IO.DisplaySize.y == static_cast<float>(_height) &&
+		_imgui_context->ActiveId == 0 &&
+		!_rebuild_font_atlas &&
+		!_should_save_screenshot &&
+		!_input->is_any_key_down() && !_input->is_any_key_released() &&
+		!_input->is_any_mouse_button_down() && !_input->is_any_mouse_button_released() &&
+		_input->mouse_wheel_delta() == 0 && _input->mouse_movement_delta_x() == 0 && _input->mouse_movement_delta_y() == 0 &&
+		_input->text_input().empty())
+	{
+		ImGuiContext *const backup_context = ImGui::GetCurrentContext();
+		ImGui::SetCurrentContext(_imgui_context);
+
+		render_draw_data(ImGui::GetDrawData());
+
+		ImGui::SetCurrentContext(backup_context);
+		return;
+	}
+
+	_imgui_draw_data.begin_update(overlay_state, _last_present_time);
+
 	_ignore_shortcuts = false;
 	_gather_gpu_statistics = false;
 #if RESHADE_FX
@@ -671,6 +722,13 @@ void reshade::runtime::draw_gui()
 			else
 				ImGui::Text("Screenshot successfully saved to %s", _last_screenshot_file.u8string().c_str());
 		}
+		else if (show_capture_message)
+		{
+			const frame_capture::statistics stats = _frame_capture->get_statistics();
+
+			ImGui::Text("Capturing frames to %s", _frame_capture->path().u8string().c_str());
+			ImGui::Text("%llu frames written, %llu frames dropped, %zu frames queued (%.1f FPS)", stats.frames_written, stats.frames_dropped, stats.frames_queued, stats.frames_per_second);
+		}
 		else
 		{
 			ImGui::TextUnformatted("ReShade " VERSION_STRING_PRODUCT);
@@ -698,6 +756,12 @@ void reshade::runtime::draw_gui()
 					"This might take a while. The application could become unresponsive for some time.",
 					_reload_remaining_effects.load());
 			}
+			else if (_texture_loads.is_running())
+			{
+				ImGui::ProgressBar((_texture_loads.num_jobs() - _texture_loads.num_remaining_jobs()) / float(_texture_loads.num_jobs()), ImVec2(-1, 0), "");
+				ImGui::SameLine(15);
+				ImGui::Text("Loading textures (%zu image files remaining) ...", _texture_loads.num_remaining_jobs());
+			}
 			else if (_tutorial_index == 0)
 			{
 				ImGui::ProgressBar(0.0f, ImVec2(-1, 0), "");
@@ -995,25 +1059,12 @@ void reshade::runtime::draw_gui()
 		ClipCursor(nullptr);
 	}
 
-	if (ImDrawData *const draw_data = ImGui::GetDrawData();
-		draw_data != nullptr && draw_data->CmdListsCount != 0 && draw_data->TotalVtxCount != 0)
-	{
-		api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
+	ImDrawData *const draw_data = ImGui::GetDrawData();
 
-		if (_back_buffer_resolved != 0)
-		{
-			render_imgui_draw_data(cmd_list, draw_data, _back_buffer_targets[0]);
-		}
-		else
-		{
-			uint32_t back_buffer_index = get_current_back_buffer_index();
-			const api::resource back_buffer_resource = get_back_buffer(back_buffer_index);
+	// Only allow rendering the draw data again in later frames if it does not reference any textures other than the font atlas
+	_imgui_draw_data.end_update(draw_data, _font_atlas_srv.handle);
 
-			cmd_list->barrier(back_buffer_resource, api::resource_usage::present, api::resource_usage::render_target);
-			render_imgui_draw_data(cmd_list, draw_data, _back_buffer_targets[back_buffer_index * 2]);
-			cmd_list->barrier(back_buffer_resource, api::resource_usage::render_target, api::resource_usage::present);
-		}
-	}
+	render_draw_data(draw_data);
 
 	ImGui::SetCurrentContext(backup_context);
 }
@@ -1227,20 +1278,10 @@ void reshade::runtime::draw_gui_home()
 
 	if (_tutorial_index > 1)
 	{
+		// The technique list is updated with the new filter in 'draw_technique_editor'
 		if (imgui::search_input_box(_effect_filter, sizeof(_effect_filter), -((_variable_editor_tabs ? 10.0f : 20.0f) * _font_size + (_variable_editor_tabs ? 1.0f : 2.0f) * _imgui_context->Style.ItemSpacing.x)))
-		{
 			_effects_expanded_state = 3;
 
-			for (technique &tech : _techniques)
-			{
-				std::string_view label = tech.annotation_as_string("ui_label");
-				if (label.empty())
-					label = tech.name;
-
-				tech.hidden = tech.annotation_as_int("hidden") != 0 || !filter_text(label, _effect_filter);
-			}
-		}
-
 		ImGui::SameLine();
 
 		if (ImGui::Button("Active to top", ImVec2(10.0f * _font_size, 0)))
@@ -1275,6 +1316,8 @@ void reshade::runtime::draw_gui_home()
 					});
 			}
 
+			_effects_generation++; // Reordering moves techniques in memory, which invalidates technique handles and the name index
+			_technique_list_dirty = true;
 			save_current_preset();
 		}
 
@@ -1465,6 +1508,9 @@ void reshade::runtime::draw_gui_settings()
 
 		modified |= imgui::path_list("Effect search paths", _effect_search_paths, _file_selection_path, g_reshade_base_path);
 		modified |= imgui::path_list("Texture search paths", _texture_search_paths, _file_selection_path, g_reshade_base_path);
+		modified |= ImGui::SliderInt("Texture upload budget", reinterpret_cast<int *>(&_texture_upload_budget), 0, 256, _texture_upload_budget == 0 ? "Unlimited" : "%d MB per frame");
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Maximum amount of image data that is uploaded per frame while loading textures, to avoid long stalls after a reload.");
 
 		if (ImGui::Checkbox("Load only enabled effects", &_effect_load_skipping))
 		{
@@ -1573,6 +1619,33 @@ void reshade::runtime::draw_gui_settings()
 		modified |= ImGui::Checkbox("Hide post-save command window", &_screenshot_post_save_command_no_window);
 	}
 
+	if (ImGui::CollapsingHeader("Frame capture", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		modified |= imgui::key_input_box("Frame capture key", _capture_key_data, *_input);
+
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Starts or stops capturing a continuous sequence of frames to the screenshot path (using the screenshot name as base name).");
+
+		modified |= ImGui::Combo("Frame capture format", reinterpret_cast<int *>(&_capture_format), "Portable Network Graphics sequence (*.png)\0YUV4MPEG2 stream (*.y4m)\0Raw RGBA stream (*.rgba)\0");
+
+		if (_capture_format != 0)
+		{
+			modified |= imgui::file_input_box("Frame capture stream path", _capture_stream_path, _file_selection_path, {});
+
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Optional file or named pipe to write the stream to, instead of a file in the screenshot path.");
+		}
+
+		modified |= ImGui::SliderInt("Capture every Nth frame", reinterpret_cast<int *>(&_capture_frame_interval), 1, 60);
+		modified |= ImGui::SliderInt("Frame rate in stream header", reinterpret_cast<int *>(&_capture_frame_rate), 1, 240);
+		modified |= ImGui::SliderInt("Maximum queued frames", reinterpret_cast<int *>(&_capture_max_queued_frames), 1, 64);
+		modified |= ImGui::SliderInt("Encoder threads", reinterpret_cast<int *>(&_capture_encoder_threads), 0, 32, _capture_encoder_threads == 0 ? "Automatic" : "%d");
+		modified |= ImGui::Checkbox("Drop frames when queue is full", &_capture_drop_frames_when_full);
+
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("When disabled, the application is stalled until the encoder threads catch up instead, so that no frames are lost.");
+	}
+
 	if (ImGui::CollapsingHeader("Overlay & Styling", ImGuiTreeNodeFlags_DefaultOpen))
 	{
 #if RESHADE_FX
@@ -1588,6 +1661,9 @@ void reshade::runtime::draw_gui_settings()
 #endif
 
 		modified |= ImGui::Checkbox("Save window state (ReShadeGUI.ini)", &_save_imgui_window_state);
+		modified |= ImGui::SliderInt("Idle update rate", reinterpret_cast<int *>(&_overlay_idle_update_rate), 0, 60, _overlay_idle_update_rate == 0 ? "Every frame" : "%d per second");
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("Limits how often the overlay is updated while there is no keyboard or mouse input, which reduces its CPU cost while it is open but not in use.");
 #if RESHADE_FX
 		modified |= ImGui::Checkbox("Group effect files with tabs instead of a tree", &_variable_editor_tabs);
 #endif
@@ -2143,7 +2219,7 @@ void reshade::runtime::draw_gui_log()
 {
 	const std::filesystem::path log_path = g_reshade_base_path / L"ReShade.log";
 
-	const bool filter_changed = imgui::search_input_box(_log_filter, sizeof(_log_filter), -(16.0f * _font_size + 2 * _imgui_context->Style.ItemSpacing.x));
+	imgui::search_input_box(_log_filter, sizeof(_log_filter), -(16.0f * _font_size + 2 * _imgui_context->Style.ItemSpacing.x));
 
 	ImGui::SameLine();
 
@@ -2152,55 +2228,55 @@ void reshade::runtime::draw_gui_log()
 	ImGui::SameLine();
 
 	if (ImGui::Button("Clear Log", ImVec2(8.0f * _font_size, 0.0f)))
+	{
 		// Close and open the stream again, which will clear the file too
 		log::open_log_file(log_path);
 
+		_log_view.clear();
+	}
+
 	ImGui::Spacing();
 
 	if (ImGui::BeginChild("log", ImVec2(0, 0), true, _log_wordwrap ? 0 : ImGuiWindowFlags_AlwaysHorizontalScrollbar))
 	{
-		// Limit number of log lines to read, to avoid stalling when log gets too big
-		constexpr size_t LINE_LIMIT = 1000;
+		// Only get the lines that were logged since the last frame, instead of reading the whole log file again
+		const size_t num_new_lines = _log_view.update(log::read_history, filter_text, _log_filter);
 
-		std::error_code ec;
-		const auto last_log_size = std::filesystem::file_size(log_path, ec);
-		if (filter_changed || _last_log_size != last_log_size)
-		{
-			_log_lines.clear();
-			std::ifstream log_file(log_path);
-			for (std::string line; std::getline(log_file, line) && _log_lines.size() < LINE_LIMIT;)
-				if (filter_text(line, _log_filter))
-					_log_lines.push_back(line);
-			_last_log_size = last_log_size;
+		if (_log_view.num_skipped_lines() != 0)
+			ImGui::TextColored(COLOR_YELLOW, "%llu earlier lines are only available in the log file.", static_cast<unsigned long long>(_log_view.num_skipped_lines()));
 
-			if (_log_lines.size() == LINE_LIMIT)
-				_log_lines.push_back("Log was truncated to reduce memory footprint!");
-		}
+		// Keep following the end of the log while scrolled all the way down
+		const bool scroll_to_bottom = num_new_lines != 0 && ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
 
 		ImGuiListClipper clipper;
-		clipper.Begin(static_cast<int>(_log_lines.size()), ImGui::GetTextLineHeightWithSpacing());
+		clipper.Begin(static_cast<int>(_log_view.num_filtered_lines()), ImGui::GetTextLineHeightWithSpacing());
 		while (clipper.Step())
 		{
 			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
 			{
+				const std::string &line = _log_view.filtered_line(i);
+
 				ImVec4 textcol = ImGui::GetStyleColorVec4(ImGuiCol_Text);
 
-				if (_log_lines[i].find("ERROR |") != std::string::npos || _log_lines[i].find("error") != std::string::npos)
+				if (line.find("ERROR |") != std::string::npos || line.find("error") != std::string::npos)
 					textcol = COLOR_RED;
-				else if (_log_lines[i].find("WARN  |") != std::string::npos || _log_lines[i].find("warning") != std::string::npos || i == LINE_LIMIT)
+				else if (line.find("WARN  |") != std::string::npos || line.find("warning") != std::string::npos)
 					textcol = COLOR_YELLOW;
-				else if (_log_lines[i].find("DEBUG |") != std::string::npos)
+				else if (line.find("DEBUG |") != std::string::npos)
 					textcol = ImColor(100, 100, 255);
 
 				ImGui::PushStyleColor(ImGuiCol_Text, textcol);
 				if (_log_wordwrap) ImGui::PushTextWrapPos();
 
-				ImGui::TextUnformatted(_log_lines[i].c_str());
+				ImGui::TextUnformatted(line.c_str(), line.c_str() + line.size());
 
 				if (_log_wordwrap) ImGui::PopTextWrapPos();
 				ImGui::PopStyleColor();
 			}
 		}
+
+		if (scroll_to_bottom)
+			ImGui::SetScrollHereY(1.0f);
 	}
 	ImGui::EndChild();
 }
@@ -2323,7 +2399,19 @@ void reshade::runtime::draw_gui_addons()
 	ImGui::Separator();
 	ImGui::Spacing();
 
-	imgui::search_input_box(_addons_filter, sizeof(_addons_filter));
+	imgui::search_input_box(_addons_filter, sizeof(_addons_filter), -(16.0f * _font_size + _imgui_context->Style.ItemSpacing.x));
+
+	ImGui::SameLine();
+
+	// Time every 8th invocation of an event, which is enough to get meaningful numbers without slowing down the application much
+	bool profiling = addon_profiling_interval.load() != 0;
+	if (imgui::toggle_button("Profile", profiling, 8.0f * _font_size))
+		addon_profiling_interval.store(profiling ? 8 : 0);
+
+	ImGui::SameLine();
+
+	if (ImGui::Button("Reset statistics", ImVec2(8.0f * _font_size, 0.0f)))
+		reset_addon_event_stats();
 
 	ImGui::Spacing();
 
@@ -2396,6 +2484,40 @@ void reshade::runtime::draw_gui_addons()
 			}
 			ImGui::EndGroup();
 
+			if (profiling && info.event_stats != nullptr &&
+				ImGui::BeginTable("##event_stats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp))
+			{
+				ImGui::TableSetupColumn("Event");
+				ImGui::TableSetupColumn("Calls");
+				ImGui::TableSetupColumn("Median");
+				ImGui::TableSetupColumn("99th percentile");
+				ImGui::TableSetupColumn("Total (sampled)");
+				ImGui::TableHeadersRow();
+
+				for (size_t ev = 0; ev < static_cast<size_t>(addon_event::max); ++ev)
+				{
+					const addon_event_stats &stats = info.event_stats[ev];
+
+					const uint64_t call_count = stats.call_count.load(std::memory_order_relaxed);
+					if (call_count == 0)
+						continue;
+
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(addon_event_to_string(static_cast<addon_event>(ev)));
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", call_count);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f us", get_addon_event_percentile(stats, 0.5) * 1e-3);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f us", get_addon_event_percentile(stats, 0.99) * 1e-3);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f ms", stats.sample_time.load(std::memory_order_relaxed) * 1e-6);
+				}
+
+				ImGui::EndTable();
+			}
+
 			if (info.settings_overlay_callback != nullptr)
 			{
 				ImGui::Spacing();
@@ -2574,7 +2696,19 @@ void reshade::runtime::draw_variable_editor()
 	if (_variable_editor_tabs)
 		ImGui::BeginTabBar("##variables");
 
-	for (size_t effect_index = 0, id = 0; effect_index < _effects.size(); ++effect_index)
+	// The measured heights are no longer valid when effects were reloaded or the layout changed
+	if (const uint32_t generation = _effects_generation.load();
+		generation != _variable_editor_section_generation ||
+		ImGui::GetContentRegionAvail().x != _variable_editor_section_width ||
+		ImGui::GetFrameHeight() != _variable_editor_section_line_height)
+	{
+		_variable_editor_section_heights.assign(_effects.size(), 0.0f);
+		_variable_editor_section_generation = generation;
+		_variable_editor_section_width = ImGui::GetContentRegionAvail().x;
+		_variable_editor_section_line_height = ImGui::GetFrameHeight();
+	}
+
+	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
 	{
 		reshade::effect &effect = _effects[effect_index];
 
@@ -2584,8 +2718,24 @@ void reshade::runtime::draw_variable_editor()
 			continue;
 		assert(effect.compiled);
 
-		bool force_reload_effect = false;
 		const bool is_focused = _focused_effect == effect_index;
+
+		// Skip effects that are scrolled out of view and only reserve the space they took up when last drawn (tabs only ever show a single effect, so are not affected)
+		if (const float section_height = _variable_editor_section_heights[effect_index];
+			!_variable_editor_tabs && !is_focused && (_effects_expanded_state & 1) == 0 &&
+			section_height > 0.0f && !ImGui::IsRectVisible(ImVec2(ImGui::GetContentRegionAvail().x, section_height)))
+		{
+			ImGui::Dummy(ImVec2(0.0f, section_height - _imgui_context->Style.ItemSpacing.y));
+
+			// None of the variables can be active or hovered while they are not visible
+			for (uniform &variable : effect.uniforms)
+				if (variable.special == special_uniform::overlay_active || variable.special == special_uniform::overlay_hovered)
+					set_uniform_value(variable, 0u);
+			continue;
+		}
+
+		bool force_reload_effect = false;
+		const float section_start = ImGui::GetCursorPosY();
 		const std::string effect_name = effect.source_file.filename().u8string();
 
 		// Create separate tab for every effect file
@@ -2606,7 +2756,10 @@ void reshade::runtime::draw_variable_editor()
 				ImGui::SetNextItemOpen(is_focused || (_effects_expanded_state >> 1) != 0);
 
 			if (!ImGui::TreeNodeEx(effect_name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				_variable_editor_section_heights[effect_index] = ImGui::GetCursorPosY() - section_start;
 				continue; // Skip rendering invisible items
+			}
 		}
 
 		if (is_focused)
@@ -2733,7 +2886,8 @@ void reshade::runtime::draw_variable_editor()
 				label = variable.name;
 			const std::string_view ui_type = variable.annotation_as_string("ui_type");
 
-			ImGui::PushID(static_cast<int>(id++));
+			// Use the index rather than counting visible variables, so that the identifier does not change when other effects are skipped
+			ImGui::PushID(static_cast<int>(variable_index));
 
 			switch (variable.type.base)
 			{
@@ -2953,6 +3107,8 @@ void reshade::runtime::draw_variable_editor()
 		else
 		{
 			ImGui::TreePop();
+
+			_variable_editor_section_heights[effect_index] = ImGui::GetCursorPosY() - section_start;
 		}
 
 		if (force_reload_effect)
@@ -3088,175 +3244,183 @@ void reshade::runtime::draw_technique_editor()
 	size_t force_reload_effect = std::numeric_limits<size_t>::max();
 	size_t hovered_technique_index = std::numeric_limits<size_t>::max();
 
-	for (size_t index = 0; index < _techniques.size(); ++index)
-	{
-		reshade::technique &tech = _techniques[index];
-
-		// Skip hidden techniques
-		if (tech.hidden || !_effects[tech.effect_index].compiled)
-			continue;
-
-		ImGui::PushID(static_cast<int>(index));
-
-		// Look up effect that contains this technique
-		const reshade::effect &effect = _effects[tech.effect_index];
-
-		// Draw border around the item if it is selected
-		const bool draw_border = _selected_technique == index;
-		if (draw_border)
-			ImGui::Separator();
-
-		// Prevent user from disabling the technique when it is set to always be enabled via annotation
-		ImGui::PushItemFlag(ImGuiItemFlags_Disabled, tech.annotation_as_int("enabled"));
-		// Gray out disabled techniques and mark those with warnings yellow
-		ImGui::PushStyleColor(ImGuiCol_Text,
-			effect.errors.empty() || tech.enabled ?
-				_imgui_context->Style.Colors[tech.enabled ? ImGuiCol_Text : ImGuiCol_TextDisabled] : COLOR_YELLOW);
-
-		std::string label(tech.annotation_as_string("ui_label"));
-		if (label.empty())
-			label = tech.name;
-		label += " [" + effect.source_file.filename().u8string() + ']';
+	update_technique_list();
 
-		if (bool status = tech.enabled;
-			ImGui::Checkbox(label.c_str(), &status))
+	// Only draw the techniques that are currently scrolled into view, since there may be thousands of them
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(_technique_list.size()), ImGui::GetFrameHeightWithSpacing());
+	while (clipper.Step())
+	{
+		for (int list_index = clipper.DisplayStart; list_index < clipper.DisplayEnd; ++list_index)
 		{
-			if (status)
-				enable_technique(tech);
-			else
-				disable_technique(tech);
-			save_current_preset();
-		}
+			const size_t index = _technique_list[list_index];
+			reshade::technique &tech = _techniques[index];
 
-		ImGui::PopStyleColor();
-		ImGui::PopItemFlag();
+			ImGui::PushID(static_cast<int>(index));
 
-		if (ImGui::IsItemActive())
-			_selected_technique = index;
-		if (ImGui::IsItemClicked())
-			_focused_effect = tech.effect_index;
-		if (ImGui::IsItemHovered(ImGuiHoveredFlags_RectOnly | ImGuiHoveredFlags_AllowWhenDisabled))
-			hovered_technique_index = index;
-
-		// Display tooltip
-		if (const std::string_view tooltip = tech.annotation_as_string("ui_tooltip");
-			ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled) && (!tooltip.empty() || !effect.errors.empty()))
-		{
-			ImGui::BeginTooltip();
-			if (!tooltip.empty())
-			{
-				ImGui::TextUnformatted(tooltip.data());
-				ImGui::Spacing();
-			}
-			if (!effect.errors.empty())
+			// Look up effect that contains this technique
+			const reshade::effect &effect = _effects[tech.effect_index];
+
+			// Draw border around the item if it is selected, without changing its height, since the clipper expects all items to be of the same height
+			if (_selected_technique == index)
 			{
-				ImGui::PushStyleColor(ImGuiCol_Text, COLOR_YELLOW);
-				ImGui::TextUnformatted(effect.errors.c_str());
-				ImGui::PopStyleColor();
+				const ImVec2 border_min = ImGui::GetCursorScreenPos() - ImVec2(0, _imgui_context->Style.ItemSpacing.y * 0.5f);
+				ImGui::GetWindowDrawList()->AddRect(border_min, border_min + ImVec2(ImGui::GetContentRegionAvail().x, ImGui::GetFrameHeightWithSpacing()), ImGui::GetColorU32(ImGuiCol_Separator));
 			}
-			ImGui::EndTooltip();
-		}
-
-		// Create context menu
-		if (ImGui::BeginPopupContextItem("##context"))
-		{
-			ImGui::TextUnformatted(tech.name.c_str());
-			ImGui::Separator();
 
-			ImGui::SetNextItemWidth(230.0f);
-			if (imgui::key_input_box("##toggle_key", tech.toggle_key_data, *_input))
-				save_current_preset();
+			// Prevent user from disabling the technique when it is set to always be enabled via annotation
+			ImGui::PushItemFlag(ImGuiItemFlags_Disabled, tech.annotation_as_int("enabled"));
+			// Gray out disabled techniques and mark those with warnings yellow
+			ImGui::PushStyleColor(ImGuiCol_Text,
+				effect.errors.empty() || tech.enabled ?
+					_imgui_context->Style.Colors[tech.enabled ? ImGuiCol_Text : ImGuiCol_TextDisabled] : COLOR_YELLOW);
 
-			const bool is_not_top = index > 0;
-			const bool is_not_bottom = index < _techniques.size() - 1;
+			std::string label(tech.annotation_as_string("ui_label"));
+			if (label.empty())
+				label = tech.name;
+			label += " [" + effect.source_file.filename().u8string() + ']';
 
-			if (is_not_top && ImGui::Button("Move to top", ImVec2(230.0f, 0)))
-			{
-				_techniques.insert(_techniques.begin(), std::move(_techniques[index]));
-				_techniques.erase(_techniques.begin() + 1 + index);
-				save_current_preset();
-				ImGui::CloseCurrentPopup();
-			}
-			if (is_not_bottom && ImGui::Button("Move to bottom", ImVec2(230.0f, 0)))
+			if (bool status = tech.enabled;
+				ImGui::Checkbox(label.c_str(), &status))
 			{
-				_techniques.push_back(std::move(_techniques[index]));
-				_techniques.erase(_techniques.begin() + index);
+				if (status)
+					enable_technique(tech);
+				else
+					disable_technique(tech);
 				save_current_preset();
-				ImGui::CloseCurrentPopup();
 			}
 
-			ImGui::Separator();
-
-			if (ImGui::Button("Open folder in explorer", ImVec2(230.0f, 0)))
-				open_explorer(effect.source_file);
+			ImGui::PopStyleColor();
+			ImGui::PopItemFlag();
 
-			ImGui::Separator();
+			if (ImGui::IsItemActive())
+				_selected_technique = index;
+			if (ImGui::IsItemClicked())
+				_focused_effect = tech.effect_index;
+			if (ImGui::IsItemHovered(ImGuiHoveredFlags_RectOnly | ImGuiHoveredFlags_AllowWhenDisabled))
+				hovered_technique_index = index;
 
-			if (imgui::popup_button(ICON_FK_PENCIL " Edit source code", 230.0f))
+			// Display tooltip
+			if (const std::string_view tooltip = tech.annotation_as_string("ui_tooltip");
+				ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled) && (!tooltip.empty() || !effect.errors.empty()))
 			{
-				std::filesystem::path source_file;
-				if (ImGui::MenuItem(effect.source_file.filename().u8string().c_str()))
-					source_file = effect.source_file;
-
-				if (!effect.preprocessed)
+				ImGui::BeginTooltip();
+				if (!tooltip.empty())
 				{
-					// Force preprocessor to run to update included files
-					force_reload_effect = tech.effect_index;
+					ImGui::TextUnformatted(tooltip.data());
+					ImGui::Spacing();
 				}
-				else if (!effect.included_files.empty())
+				if (!effect.errors.empty())
 				{
-					ImGui::Separator();
-
-					for (const std::filesystem::path &included_file : effect.included_files)
-						if (ImGui::MenuItem(included_file.filename().u8string().c_str()))
-							source_file = included_file;
+					ImGui::PushStyleColor(ImGuiCol_Text, COLOR_YELLOW);
+					ImGui::TextUnformatted(effect.errors.c_str());
+					ImGui::PopStyleColor();
 				}
+				ImGui::EndTooltip();
+			}
 
-				ImGui::EndPopup();
+			// Create context menu
+			if (ImGui::BeginPopupContextItem("##context"))
+			{
+				ImGui::TextUnformatted(tech.name.c_str());
+				ImGui::Separator();
+
+				ImGui::SetNextItemWidth(230.0f);
+				if (imgui::key_input_box("##toggle_key", tech.toggle_key_data, *_input))
+					save_current_preset();
 
-				if (!source_file.empty())
+				const bool is_not_top = index > 0;
+				const bool is_not_bottom = index < _techniques.size() - 1;
+
+				if (is_not_top && ImGui::Button("Move to top", ImVec2(230.0f, 0)))
 				{
-					open_code_editor(tech.effect_index, source_file);
+					_techniques.insert(_techniques.begin(), std::move(_techniques[index]));
+					_techniques.erase(_techniques.begin() + 1 + index);
+					_effects_generation++;
+					_technique_list_dirty = true;
+					save_current_preset();
+					ImGui::CloseCurrentPopup();
+				}
+				if (is_not_bottom && ImGui::Button("Move to bottom", ImVec2(230.0f, 0)))
+				{
+					_techniques.push_back(std::move(_techniques[index]));
+					_techniques.erase(_techniques.begin() + index);
+					_effects_generation++;
+					_technique_list_dirty = true;
+					save_current_preset();
 					ImGui::CloseCurrentPopup();
 				}
-			}
 
-			if (!effect.module.hlsl.empty() && // Hide if using SPIR-V, since that cannot easily be shown here
-				imgui::popup_button("Show compiled results", 230.0f))
-			{
-				std::string entry_point_name;
-				if (ImGui::MenuItem("Generated code"))
-					entry_point_name = "Generated code";
+				ImGui::Separator();
+
+				if (ImGui::Button("Open folder in explorer", ImVec2(230.0f, 0)))
+					open_explorer(effect.source_file);
 
 				ImGui::Separator();
 
-				for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
-					if (const auto assembly_it = effect.assembly.find(entry_point.name);
-						assembly_it != effect.assembly.end() && ImGui::MenuItem(entry_point.name.c_str()))
-						entry_point_name = entry_point.name;
+				if (imgui::popup_button(ICON_FK_PENCIL " Edit source code", 230.0f))
+				{
+					std::filesystem::path source_file;
+					if (ImGui::MenuItem(effect.source_file.filename().u8string().c_str()))
+						source_file = effect.source_file;
+
+					if (!effect.preprocessed)
+					{
+						// Force preprocessor to run to update included files
+						force_reload_effect = tech.effect_index;
+					}
+					else if (!effect.included_files.empty())
+					{
+						ImGui::Separator();
 
-				ImGui::EndPopup();
+						for (const std::filesystem::path &included_file : effect.included_files)
+							if (ImGui::MenuItem(included_file.filename().u8string().c_str()))
+								source_file = included_file;
+					}
+
+					ImGui::EndPopup();
+
+					if (!source_file.empty())
+					{
+						open_code_editor(tech.effect_index, source_file);
+						ImGui::CloseCurrentPopup();
+					}
+				}
 
-				if (!entry_point_name.empty())
+				if (!effect.module.hlsl.empty() && // Hide if using SPIR-V, since that cannot easily be shown here
+					imgui::popup_button("Show compiled results", 230.0f))
 				{
-					open_code_editor(tech.effect_index, entry_point_name);
-					ImGui::CloseCurrentPopup();
+					std::string entry_point_name;
+					if (ImGui::MenuItem("Generated code"))
+						entry_point_name = "Generated code";
+
+					ImGui::Separator();
+
+					for (const reshadefx::entry_point &entry_point : effect.module.entry_points)
+						if (const auto assembly_it = effect.assembly.find(entry_point.name);
+							assembly_it != effect.assembly.end() && ImGui::MenuItem(entry_point.name.c_str()))
+							entry_point_name = entry_point.name;
+
+					ImGui::EndPopup();
+
+					if (!entry_point_name.empty())
+					{
+						open_code_editor(tech.effect_index, entry_point_name);
+						ImGui::CloseCurrentPopup();
+					}
 				}
+
+				ImGui::EndPopup();
 			}
 
-			ImGui::EndPopup();
-		}
+			if (tech.toggle_key_data[0] != 0)
+			{
+				ImGui::SameLine(ImGui::GetContentRegionAvail().x - 120);
+				ImGui::TextDisabled("%s", input::key_name(tech.toggle_key_data).c_str());
+			}
 
-		if (tech.toggle_key_data[0] != 0)
-		{
-			ImGui::SameLine(ImGui::GetContentRegionAvail().x - 120);
-			ImGui::TextDisabled("%s", input::key_name(tech.toggle_key_data).c_str());
+			ImGui::PopID();
 		}
-
-		if (draw_border)
-			ImGui::Separator();
-
-		ImGui::PopID();
 	}
 
 	// Move the selected technique to the position of the mouse in the list
@@ -3299,6 +3463,8 @@ void reshade::runtime::draw_technique_editor()
 			}
 
 			_selected_technique = hovered_technique_index;
+			_effects_generation++; // Reordering moves techniques in memory, which invalidates technique handles and the name index
+			_technique_list_dirty = true;
 			save_current_preset();
 			return;
 		}
@@ -3318,6 +3484,54 @@ void reshade::runtime::draw_technique_editor()
 	}
 }
 
+void reshade::runtime::update_technique_list()
+{
+	const uint32_t generation = _effects_generation.load();
+
+	if (generation != _technique_list_generation || _technique_list_filter != _effect_filter)
+	{
+		// Typing more characters can only ever remove techniques from the list, so only need to test those still in it in that case
+		if (generation == _technique_list_generation && !_technique_list_dirty && filter_text(_effect_filter, _technique_list_filter))
+		{
+			_technique_list.erase(std::remove_if(_technique_list.begin(), _technique_list.end(),
+				[this](size_t index) {
+					technique &tech = _techniques[index];
+					std::string_view label = tech.annotation_as_string("ui_label");
+					if (label.empty())
+						label = tech.name;
+					return tech.hidden = !filter_text(label, _effect_filter);
+				}), _technique_list.end());
+
+			_technique_list_filter = _effect_filter;
+			return;
+		}
+
+		for (technique &tech : _techniques)
+		{
+			std::string_view label = tech.annotation_as_string("ui_label");
+			if (label.empty())
+				label = tech.name;
+
+			tech.hidden = tech.annotation_as_int("hidden") != 0 || !filter_text(label, _effect_filter);
+		}
+
+		_technique_list_filter = _effect_filter;
+		_technique_list_generation = generation;
+	}
+	else if (!_technique_list_dirty)
+	{
+		return;
+	}
+
+	// The filter result is stored with each technique, so reordering techniques only requires collecting the indices again
+	_technique_list.clear();
+	for (size_t index = 0; index < _techniques.size(); ++index)
+		if (!_techniques[index].hidden && _effects[_techniques[index].effect_index].compiled)
+			_technique_list.push_back(index);
+
+	_technique_list_dirty = false;
+}
+
 void reshade::runtime::open_code_editor(size_t effect_index, const std::string &entry_point)
 {
 	assert(effect_index < _effects.size());
@@ -3577,10 +3791,10 @@ bool reshade::runtime::init_imgui_resources()
 		return false;
 	}
 }
-void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDrawData *draw_data, api::resource_view rtv)
+bool reshade::runtime::upload_imgui_draw_data(ImDrawData *draw_data)
 {
 	// Need to multi-buffer vertex data so not to modify data below when the previous frame is still in flight
-	const size_t buffer_index = _framecount % std::size(_imgui_vertices);
+	const size_t buffer_index = _imgui_draw_data.next_buffer_index();
 
 	// Create and grow vertex/index buffers if needed
 	if (_imgui_num_indices[buffer_index] < draw_data->TotalIdxCount)
@@ -3594,7 +3808,7 @@ void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDra
 		if (!_device->create_resource(api::resource_desc(new_size * sizeof(ImDrawIdx), api::memory_heap::cpu_to_gpu, api::resource_usage::index_buffer), nullptr, api::resource_usage::cpu_access, &_imgui_indices[buffer_index]))
 		{
 			LOG(ERROR) << "Failed to create ImGui index buffer!";
-			return;
+			return false;
 		}
 
 		_device->set_resource_name(_imgui_indices[buffer_index], "ImGui index buffer");
@@ -3612,7 +3826,7 @@ void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDra
 		if (!_device->create_resource(api::resource_desc(new_size * sizeof(ImDrawVert), api::memory_heap::cpu_to_gpu, api::resource_usage::vertex_buffer), nullptr, api::resource_usage::cpu_access, &_imgui_vertices[buffer_index]))
 		{
 			LOG(ERROR) << "Failed to create ImGui vertex buffer!";
-			return;
+			return false;
 		}
 
 		_device->set_resource_name(_imgui_vertices[buffer_index], "ImGui vertex buffer");
@@ -3632,6 +3846,10 @@ void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDra
 
 		_device->unmap_buffer_region(_imgui_indices[buffer_index]);
 	}
+	else
+	{
+		return false;
+	}
 	if (ImDrawVert *vtx_dst;
 		_device->map_buffer_region(_imgui_vertices[buffer_index], 0, UINT64_MAX, api::map_access::write_only, reinterpret_cast<void **>(&vtx_dst)))
 	{
@@ -3644,6 +3862,22 @@ void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDra
 
 		_device->unmap_buffer_region(_imgui_vertices[buffer_index]);
 	}
+	else
+	{
+		return false;
+	}
+
+	_imgui_draw_data.uploaded(ImGui::GetFrameCount(), buffer_index);
+
+	return true;
+}
+void reshade::runtime::render_imgui_draw_data(api::command_list *cmd_list, ImDrawData *draw_data, api::resource_view rtv)
+{
+	// Only upload vertex and index data for new draw data, not when rendering the result of a previous overlay update again (see 'draw_gui')
+	if (_imgui_draw_data.needs_upload(ImGui::GetFrameCount()) && !upload_imgui_draw_data(draw_data))
+		return;
+
+	const size_t buffer_index = _imgui_draw_data.buffer_index();
 
 	api::render_pass_render_target_desc render_target = {};
 	render_target.view = rtv;
@@ -3734,6 +3968,8 @@ void reshade::runtime::destroy_imgui_resources()
 		_imgui_num_vertices[i] = 0;
 	}
 
+	_imgui_draw_data.reset();
+
 	_device->destroy_sampler(_imgui_sampler_state);
 	_imgui_sampler_state = {};
 	_device->destroy_pipeline(_imgui_pipeline);
@@ -61,47 +61,60 @@ namespace reshade
 	};
 
 #if RESHADE_FX
+	/// <summary>
+	/// Finds the annotation with the specified <paramref name="name"/>, or returns <see langword="nullptr"/> if there is none.
+	/// The name length is only computed once and compared before the characters, which is all that is needed for the few annotations objects usually have.
+	/// </summary>
+	inline const reshadefx::annotation *find_annotation(const std::vector<reshadefx::annotation> &annotations, const std::string_view name)
+	{
+		for (const reshadefx::annotation &annotation : annotations)
+			if (annotation.name == name)
+				return &annotation;
+		return nullptr;
+	}
+
+	inline int get_annotation_int(const reshadefx::annotation &annotation, size_t i, int default_value = 0)
+	{
+		if (i >= 16)
+			return default_value;
+		return annotation.type.is_integral() ? annotation.value.as_int[i] : static_cast<int>(annotation.value.as_float[i]);
+	}
+	inline unsigned int get_annotation_uint(const reshadefx::annotation &annotation, size_t i, unsigned int default_value = 0)
+	{
+		if (i >= 16)
+			return default_value;
+		return annotation.type.is_integral() ? annotation.value.as_uint[i] : static_cast<unsigned int>(annotation.value.as_float[i]);
+	}
+	inline float get_annotation_float(const reshadefx::annotation &annotation, size_t i, float default_value = 0.0f)
+	{
+		if (i >= 16)
+			return default_value;
+		return annotation.type.is_floating_point() ? annotation.value.as_float[i] : static_cast<float>(annotation.value.as_int[i]);
+	}
+
 	struct texture final : reshadefx::texture_info
 	{
 		texture(const reshadefx::texture_info &init) : texture_info(init) {}
 
 		auto annotation_as_int(const char *ann_name, size_t i = 0, int default_value = 0) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_int[i] : static_cast<int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_int(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_uint(const char *ann_name, size_t i = 0, unsigned int default_value = 0) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_uint[i] : static_cast<unsigned int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_uint(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_float(const char *ann_name, size_t i = 0, float default_value = 0.0f) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_floating_point() ? it->value.as_float[i] : static_cast<float>(it->value.as_int[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_float(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_string(const char *ann_name, const std::string_view &default_value = std::string_view()) const
 		{
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return std::string_view(it->value.string_data);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? std::string_view(annotation->value.string_data) : default_value;
 		}
 
 		bool matches_description(const reshadefx::texture_info &desc) const
@@ -125,41 +138,23 @@ namespace reshade
 
 		auto annotation_as_int(const char *ann_name, size_t i = 0, int default_value = 0) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_int[i] : static_cast<int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_int(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_uint(const char *ann_name, size_t i = 0, unsigned int default_value = 0) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_uint[i] : static_cast<unsigned int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_uint(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_float(const char *ann_name, size_t i = 0, float default_value = 0.0f) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_floating_point() ? it->value.as_float[i] : static_cast<float>(it->value.as_int[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_float(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_string(const char *ann_name, const std::string_view &default_value = std::string_view()) const
 		{
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return std::string_view(it->value.string_data);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? std::string_view(annotation->value.string_data) : default_value;
 		}
 
 		bool supports_toggle_key() const
@@ -183,41 +178,23 @@ namespace reshade
 
 		auto annotation_as_int(const char *ann_name, size_t i = 0, int default_value = 0) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_int[i] : static_cast<int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_int(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_uint(const char *ann_name, size_t i = 0, unsigned int default_value = 0) const
 		{
-			if (i <= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_integral() ? it->value.as_uint[i] : static_cast<unsigned int>(it->value.as_float[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_uint(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_float(const char *ann_name, size_t i = 0, float default_value = 0.0f) const
 		{
-			if (i >= 16)
-				return default_value;
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return it->type.is_floating_point() ? it->value.as_float[i] : static_cast<float>(it->value.as_int[i]);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? get_annotation_float(*annotation, i, default_value) : default_value;
 		}
 		auto annotation_as_string(const char *ann_name, const std::string_view &default_value = std::string_view()) const
 		{
-			const auto it = std::find_if(annotations.begin(), annotations.end(),
-				[ann_name](const auto &annotation) { return annotation.name == ann_name; });
-			if (it == annotations.end())
-				return default_value;
-			return std::string_view(it->value.string_data);
+			const reshadefx::annotation *const annotation = find_annotation(annotations, ann_name);
+			return annotation != nullptr ? std::string_view(annotation->value.string_data) : default_value;
 		}
 
 		size_t effect_index = std::numeric_limits<size_t>::max();
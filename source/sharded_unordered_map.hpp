@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <mutex>
+#include <cstdint>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+
+/// <summary>
+/// A thread-safe hash map with integer keys (e.g. handles), which is split into a number of independently locked shards, so that threads accessing different keys rarely contend on the same lock.
+/// Keys that only differ in the lowest <typeparamref name="KEY_GROUP_BITS"/> bits are put into the same shard, so that a thread working on a contiguous range of keys (like descriptors in a heap) keeps using the same shard, while different ranges are spread out.
+/// </summary>
+/// <typeparam name="TMutex">Type of the lock of each shard, which has to satisfy the requirements of a shared mutex.</typeparam>
+template <typename TKey, typename TValue, uint32_t NUM_SHARDS = 64, uint32_t KEY_GROUP_BITS = 12, typename TMutex = std::shared_mutex>
+class sharded_unordered_map
+{
+	static_assert(std::is_integral_v<TKey>, "Key type must be an integer");
+	static_assert((NUM_SHARDS & (NUM_SHARDS - 1)) == 0, "Number of shards must be a power of two");
+
+public:
+	/// <summary>
+	/// Adds the specified key-value pair, or replaces the value if the key already exists.
+	/// </summary>
+	void insert_or_assign(TKey key, const TValue &value)
+	{
+		shard &s = shard_for_key(key);
+		const std::unique_lock<TMutex> lock(s.mutex);
+		s.map.insert_or_assign(key, value);
+	}
+
+	/// <summary>
+	/// Removes the value associated with the specified <paramref name="key"/>.
+	/// </summary>
+	/// <returns><c>true</c> if the key existed and was removed, <c>false</c> otherwise.</returns>
+	bool erase(TKey key)
+	{
+		shard &s = shard_for_key(key);
+		const std::unique_lock<TMutex> lock(s.mutex);
+		return s.map.erase(key) != 0;
+	}
+	/// <summary>
+	/// Removes all key-value pairs for which the specified <paramref name="predicate"/> returns <c>true</c>.
+	/// This locks one shard at a time, so it is not atomic with respect to the map as a whole.
+	/// </summary>
+	template <typename F>
+	void erase_if(F predicate)
+	{
+		for (shard &s : _shards)
+		{
+			const std::unique_lock<TMutex> lock(s.mutex);
+
+			for (auto it = s.map.begin(); it != s.map.end();)
+			{
+				if (predicate(it->first, it->second))
+					it = s.map.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Gets a copy of the value associated with the specified <paramref name="key"/>.
+	/// </summary>
+	/// <param name="key">The key to look up.</param>
+	/// <param name="value">Set to the associated value if the key was found.</param>
+	/// <returns><c>true</c> if the key was found, <c>false</c> otherwise.</returns>
+	bool find(TKey key, TValue &value) const
+	{
+		const shard &s = shard_for_key(key);
+		const std::shared_lock<TMutex> lock(s.mutex);
+
+		if (const auto it = s.map.find(key); it != s.map.end())
+		{
+			value = it->second;
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	// Align each shard to a cache line, so that locking one does not invalidate the cache line of another on a different core
+	struct alignas(64) shard
+	{
+		mutable TMutex mutex;
+		std::unordered_map<TKey, TValue> map;
+	};
+
+	static inline size_t shard_index(TKey key)
+	{
+		// Scramble the key group with a Fibonacci multiplication and use the topmost bits, which are the best mixed
+		const uint64_t hash = (static_cast<uint64_t>(key) >> KEY_GROUP_BITS) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(((hash >> 32) * NUM_SHARDS) >> 32);
+	}
+
+	shard &shard_for_key(TKey key) { return _shards[shard_index(key)]; }
+	const shard &shard_for_key(TKey key) const { return _shards[shard_index(key)]; }
+
+	shard _shards[NUM_SHARDS];
+};
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "texture_cache.hpp"
+#include "hash_utils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+struct texture_cache_header
+{
+	static constexpr uint32_t magic_value = 0x58545352; // "RSTX"
+	static constexpr uint32_t version_value = 2;
+
+	uint32_t magic;
+	uint32_t version;
+	reshade::api::format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+};
+
+size_t reshade::texture_data_size(api::format format, uint32_t width, uint32_t height, uint32_t levels)
+{
+	size_t data_size = 0;
+	for (uint32_t level = 0; level < levels; ++level)
+		data_size += api::format_slice_pitch(format, api::format_row_pitch(format, std::max(width >> level, 1u)), std::max(height >> level, 1u));
+	return data_size;
+}
+
+std::string reshade::texture_cache_id(const std::filesystem::path &source_path, const void *file_data, size_t file_size, api::format format, uint32_t width, uint32_t height, uint32_t levels)
+{
+	// Use a hash that is stable across builds, since the key is persisted in the cache file name
+	char hash_string[17];
+	std::snprintf(hash_string, sizeof(hash_string), "%016llx", static_cast<unsigned long long>(compute_hash64(file_data, file_size)));
+
+	return source_path.stem().u8string() + '-' + hash_string + '-' +
+		std::to_string(width) + 'x' + std::to_string(height) + 'x' + std::to_string(levels) + '-' + std::to_string(static_cast<uint32_t>(format));
+}
+
+std::string reshade::build_texture_cache_data(api::format format, uint32_t width, uint32_t height, uint32_t levels, const std::vector<uint8_t> &data)
+{
+	const texture_cache_header header = { texture_cache_header::magic_value, texture_cache_header::version_value, format, width, height, levels };
+
+	std::string cached_data(sizeof(header) + data.size(), '\0');
+	std::memcpy(cached_data.data(), &header, sizeof(header));
+	std::memcpy(cached_data.data() + sizeof(header), data.data(), data.size());
+	return cached_data;
+}
+
+bool reshade::parse_texture_cache_data(const std::string &cached_data, api::format format, uint32_t width, uint32_t height, uint32_t levels, std::vector<uint8_t> &data)
+{
+	texture_cache_header header = {};
+	if (cached_data.size() >= sizeof(header))
+		std::memcpy(&header, cached_data.data(), sizeof(header));
+
+	// Only accept cache files that are complete, a truncated one (e.g. from a crash during write) would otherwise upload garbage
+	if (header.magic != texture_cache_header::magic_value || header.version != texture_cache_header::version_value ||
+		header.format != format || header.width != width || header.height != height || header.levels != levels ||
+		cached_data.size() != sizeof(header) + texture_data_size(format, width, height, levels))
+		return false;
+
+	data.assign(cached_data.begin() + sizeof(header), cached_data.end());
+	return true;
+}
+
+void reshade::prune_texture_cache(const std::filesystem::path &cache_path, uintmax_t max_total_size)
+{
+	struct cache_file
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type last_write_time;
+		uintmax_t size;
+	};
+
+	std::error_code ec;
+	uintmax_t total_size = 0;
+	std::vector<cache_file> files;
+
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(cache_path, std::filesystem::directory_options::skip_permission_denied, ec))
+	{
+		if (entry.path().filename().u8string().compare(0, 8, "reshade-") != 0 || entry.path().extension() != ".tex" || !entry.is_regular_file(ec))
+			continue;
+
+		cache_file &file = files.emplace_back();
+		file.path = entry.path();
+		file.last_write_time = entry.last_write_time(ec);
+		file.size = entry.file_size(ec);
+		if (ec)
+			file.size = 0;
+		total_size += file.size;
+	}
+
+	if (total_size <= max_total_size)
+		return;
+
+	// Cache files are rewritten whenever the source image changes, so the last write time is a good indicator of which ones are stale
+	std::sort(files.begin(), files.end(),
+		[](const cache_file &lhs, const cache_file &rhs) { return lhs.last_write_time < rhs.last_write_time; });
+
+	for (const cache_file &file : files)
+	{
+		if (total_size <= max_total_size)
+			break;
+		if (std::filesystem::remove(file.path, ec))
+			total_size -= file.size;
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "reshade_api_format.hpp"
+
+namespace reshade
+{
+	/// <summary>
+	/// Total size the texture cache files in the cache directory are pruned to before textures are loaded.
+	/// </summary>
+	constexpr uintmax_t texture_cache_max_size = 512 * 1024 * 1024;
+
+	/// <summary>
+	/// Gets the size of the image data of all mipmap levels of a texture, tightly packed.
+	/// </summary>
+	size_t texture_data_size(api::format format, uint32_t width, uint32_t height, uint32_t levels);
+
+	/// <summary>
+	/// Builds the identifier that decoded data of an image file is cached under.
+	/// It contains a hash of the file contents and the texture description, so that editing the file or changing the texture results in a different cache file.
+	/// </summary>
+	/// <param name="source_path">Path to the image file.</param>
+	/// <param name="file_data">Contents of the image file.</param>
+	/// <param name="file_size">Size of the image file in bytes.</param>
+	std::string texture_cache_id(const std::filesystem::path &source_path, const void *file_data, size_t file_size, api::format format, uint32_t width, uint32_t height, uint32_t levels);
+
+	/// <summary>
+	/// Builds the contents of a texture cache file from the converted image data of all mipmap levels.
+	/// </summary>
+	std::string build_texture_cache_data(api::format format, uint32_t width, uint32_t height, uint32_t levels, const std::vector<uint8_t> &data);
+	/// <summary>
+	/// Extracts the image data of all mipmap levels from the contents of a texture cache file.
+	/// </summary>
+	/// <returns><see langword="true"/> if the file is complete and matches the texture description, <see langword="false"/> if it is truncated or was written for a different texture or cache version.</returns>
+	bool parse_texture_cache_data(const std::string &cached_data, api::format format, uint32_t width, uint32_t height, uint32_t levels, std::vector<uint8_t> &data);
+
+	/// <summary>
+	/// Deletes the least recently written texture cache files in the specified directory until their total size is at most <paramref name="max_total_size"/>.
+	/// </summary>
+	void prune_texture_cache(const std::filesystem::path &cache_path, uintmax_t max_total_size = texture_cache_max_size);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "texture_load_queue.hpp"
+#include <cassert>
+#include <algorithm>
+
+void reshade::texture_load_queue::start(size_t num_jobs, size_t num_threads, std::function<void(size_t job_index)> &&load_job)
+{
+	assert(_threads.empty());
+
+	_load_job = std::move(load_job);
+	_num_jobs = num_jobs;
+	_next_job = 0;
+	_cancelled = false;
+	_finished_jobs.clear();
+	// Reserve space for all jobs, so that worker threads never reallocate while holding the lock
+	_finished_jobs.reserve(num_jobs);
+	_num_uploaded = 0;
+	_start_time = std::chrono::high_resolution_clock::now();
+	_end_time = {};
+	_max_upload_time = {};
+
+	num_threads = std::min(std::max<size_t>(num_threads, 1), num_jobs);
+	for (size_t i = 0; i < num_threads; ++i)
+	{
+		_threads.emplace_back([this]() {
+			for (size_t job_index; !_cancelled && (job_index = _next_job++) < _num_jobs;)
+			{
+				_load_job(job_index);
+
+				const std::unique_lock<std::mutex> lock(_finished_mutex);
+				_finished_jobs.push_back(job_index);
+			}
+		});
+	}
+}
+
+bool reshade::texture_load_queue::upload(size_t upload_budget, const std::function<size_t(size_t job_index)> &upload_job)
+{
+	const auto upload_start_time = std::chrono::high_resolution_clock::now();
+
+	// Upload jobs in the order they finished, so that no job waits for more than the jobs that finished before it (taking the most recent one first would let a steady stream of new jobs starve old ones)
+	for (size_t uploaded_bytes = 0; upload_budget == 0 || uploaded_bytes < upload_budget;)
+	{
+		size_t job_index;
+		{
+			const std::unique_lock<std::mutex> lock(_finished_mutex);
+			if (_num_uploaded == _finished_jobs.size())
+				break;
+			job_index = _finished_jobs[_num_uploaded];
+		}
+
+		uploaded_bytes += upload_job(job_index);
+
+		_num_uploaded++;
+	}
+
+	const auto upload_end_time = std::chrono::high_resolution_clock::now();
+	_max_upload_time = std::max(_max_upload_time, upload_end_time - upload_start_time);
+
+	if (_num_uploaded != _num_jobs)
+		return false;
+
+	for (std::thread &thread : _threads)
+		if (thread.joinable())
+			thread.join();
+	_threads.clear();
+
+	_load_job = nullptr;
+	_end_time = upload_end_time;
+
+	return true;
+}
+
+void reshade::texture_load_queue::cancel()
+{
+	_cancelled = true;
+
+	for (std::thread &thread : _threads)
+		if (thread.joinable())
+			thread.join();
+	_threads.clear();
+
+	_load_job = nullptr;
+	_num_jobs = 0;
+	_finished_jobs.clear();
+	_num_uploaded = 0;
+}
+
+std::chrono::high_resolution_clock::duration reshade::texture_load_queue::total_time() const
+{
+	return (_threads.empty() ? _end_time : std::chrono::high_resolution_clock::now()) - _start_time;
+}
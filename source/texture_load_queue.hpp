@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+
+namespace reshade
+{
+	/// <summary>
+	/// Runs texture load jobs on a pool of worker threads and hands finished ones to the render thread, which uploads them in the order they finished within a per-frame budget.
+	/// </summary>
+	class texture_load_queue
+	{
+	public:
+		~texture_load_queue() { cancel(); }
+
+		/// <summary>
+		/// Starts running the specified number of jobs on worker threads.
+		/// </summary>
+		/// <param name="num_jobs">Number of jobs to run.</param>
+		/// <param name="num_threads">Number of worker threads to start (at most one per job).</param>
+		/// <param name="load_job">Callback that is called on a worker thread with the index of every job. Jobs are handed to <see cref="upload"/> after it returns, even if they failed.</param>
+		void start(size_t num_jobs, size_t num_threads, std::function<void(size_t job_index)> &&load_job);
+
+		/// <summary>
+		/// Passes finished jobs to the <paramref name="upload_job"/> callback in the order they finished, until the uploaded bytes reach the budget.
+		/// At least one finished job is uploaded per call, even if it alone exceeds the budget, so that loading always makes progress.
+		/// </summary>
+		/// <param name="upload_budget">Number of bytes to upload at most in this call, or zero to upload all finished jobs.</param>
+		/// <param name="upload_job">Callback that is called with the index of a finished job and returns the number of bytes it uploaded.</param>
+		/// <returns><see langword="true"/> once all jobs were uploaded and the worker threads were stopped, <see langword="false"/> otherwise.</returns>
+		bool upload(size_t upload_budget, const std::function<size_t(size_t job_index)> &upload_job);
+
+		/// <summary>
+		/// Stops all worker threads after their current job and drops all jobs that were not uploaded yet.
+		/// </summary>
+		void cancel();
+
+		bool is_running() const { return !_threads.empty(); }
+
+		size_t num_jobs() const { return _num_jobs; }
+		size_t num_remaining_jobs() const { return _num_jobs - _num_uploaded; }
+
+		/// <summary>
+		/// Gets the time from the call to <see cref="start"/> until the last job was uploaded (or until now if loading is still in progress).
+		/// </summary>
+		std::chrono::high_resolution_clock::duration total_time() const;
+		/// <summary>
+		/// Gets the longest time a single call to <see cref="upload"/> took.
+		/// </summary>
+		std::chrono::high_resolution_clock::duration max_upload_time() const { return _max_upload_time; }
+
+	private:
+		std::vector<std::thread> _threads;
+		std::function<void(size_t job_index)> _load_job;
+		size_t _num_jobs = 0;
+		std::atomic<size_t> _next_job = 0;
+		std::atomic<bool> _cancelled = false;
+		std::mutex _finished_mutex;
+		// Indices of finished jobs in the order they finished, the first '_num_uploaded' of which were uploaded already
+		std::vector<size_t> _finished_jobs;
+		size_t _num_uploaded = 0;
+		std::chrono::high_resolution_clock::time_point _start_time;
+		std::chrono::high_resolution_clock::time_point _end_time;
+		std::chrono::high_resolution_clock::duration _max_upload_time = {};
+	};
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "uniform_values.hpp"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#if RESHADE_FX
+
+// Each array element and each row of a matrix is 16-byte aligned, so values are copied in runs of the element or row size, unless the variable is a single vector or scalar
+static void get_uniform_value_layout(const reshade::uniform &variable, size_t base_index, uint32_t &offset, uint32_t &run_length)
+{
+	offset = variable.offset;
+	run_length = 0;
+
+	if (variable.type.is_matrix())
+	{
+		offset += static_cast<uint32_t>(base_index * variable.type.rows * 16);
+		run_length = variable.type.cols;
+	}
+	else if (variable.type.is_array() && variable.type.array_length > 1)
+	{
+		offset += static_cast<uint32_t>(base_index * 16);
+		run_length = variable.type.rows;
+	}
+}
+
+void reshade::copy_uniform_value_data(const uniform &variable, const uint8_t *data, size_t size, size_t base_index, std::vector<uint8_t> &storage)
+{
+	assert(data != nullptr && (size % 4) == 0);
+
+	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1);
+	if (assert(base_index < array_length); base_index >= array_length)
+		return;
+
+	uniform_value_write write;
+	write.effect_index = variable.effect_index;
+	write.special = variable.special;
+	get_uniform_value_layout(variable, base_index, write.offset, write.run_length);
+	write.data = data;
+	write.size = std::min(size, (array_length - base_index) * variable.type.components() * 4);
+
+	copy_uniform_value_data(write, storage);
+}
+void reshade::copy_uniform_value_data(const uniform_value_write &write, std::vector<uint8_t> &storage)
+{
+	const size_t num_values = write.size / 4;
+
+	if (write.run_length == 0)
+	{
+		assert(write.offset + write.size <= storage.size());
+		std::memcpy(storage.data() + write.offset, write.data, write.size);
+		return;
+	}
+
+	uint8_t *dst = storage.data() + write.offset;
+	for (size_t i = 0; i < num_values; i += write.run_length, dst += 16)
+	{
+		assert(dst + 16 <= storage.data() + storage.size());
+		std::memcpy(dst, write.data + i * 4, std::min<size_t>(write.run_length, num_values - i) * 4);
+	}
+}
+void reshade::copy_uniform_value_data(const uniform &variable, const std::vector<uint8_t> &storage, size_t base_index, uint8_t *data, size_t size)
+{
+	size = std::min(size, static_cast<size_t>(variable.size));
+	assert(data != nullptr && (size % 4) == 0);
+	assert(variable.offset + size <= storage.size());
+
+	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1);
+	if (assert(base_index < array_length); base_index >= array_length)
+		return;
+
+	if (variable.type.is_matrix())
+	{
+		for (size_t a = base_index, i = 0; a < array_length; ++a)
+			// Each row of a matrix is 16-byte aligned, so needs special handling
+			for (size_t row = 0; row < variable.type.rows; ++row)
+				for (size_t col = 0; i < (size / 4) && col < variable.type.cols; ++col, ++i)
+					std::memcpy(
+						data + ((a - base_index) * variable.type.components() + (row * variable.type.cols + col)) * 4,
+						storage.data() + variable.offset + (a * (variable.type.rows * 4) + (row * 4 + col)) * 4, 4);
+	}
+	else if (array_length > 1)
+	{
+		for (size_t a = base_index, i = 0; a < array_length; ++a)
+			// Each element in the array is 16-byte aligned, so needs special handling
+			for (size_t row = 0; i < (size / 4) && row < variable.type.rows; ++row, ++i)
+				std::memcpy(
+					data + ((a - base_index) * variable.type.components() + row) * 4,
+					storage.data() + variable.offset + (a * 4 + row) * 4, 4);
+	}
+	else
+	{
+		std::memcpy(data, storage.data() + variable.offset, size);
+	}
+}
+
+void reshade::prepare_uniform_value_updates(const api::effect_uniform_value_update *updates, size_t count, uint32_t renderer_id, std::vector<uniform_value_write> &writes, std::vector<uint32_t> &converted)
+{
+	writes.clear();
+	writes.reserve(count);
+
+	// Keep the elements of the buffer from the last batch around, so that they do not have to be initialized again
+	converted.resize(converted.capacity());
+	size_t converted_size = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const api::effect_uniform_value_update &update = updates[i];
+
+		const auto variable = reinterpret_cast<uniform *>(update.variable.handle);
+		if (variable == nullptr || update.values == nullptr || update.count == 0 || update.type > api::effect_uniform_value_type::unsigned_int)
+			continue;
+
+		const size_t array_length = (variable->type.is_array() ? variable->type.array_length : 1);
+		if (update.array_index >= array_length)
+			continue;
+
+		const size_t value_count = std::min(update.count, (array_length - update.array_index) * variable->type.components());
+
+		const bool stored_as_float = variable->type.is_floating_point() || force_floating_point_value(variable->type, renderer_id);
+
+		uniform_value_write &write = writes.emplace_back();
+		write.effect_index = variable->effect_index;
+		write.special = variable->special;
+		get_uniform_value_layout(*variable, update.array_index, write.offset, write.run_length);
+		write.size = value_count * 4;
+
+		// Values that are already in the type the variable is stored as are copied straight from the update
+		if ((update.type == api::effect_uniform_value_type::floating_point) == stored_as_float && update.type != api::effect_uniform_value_type::boolean)
+		{
+			write.data = static_cast<const uint8_t *>(update.values);
+			continue;
+		}
+
+		// Everything else is converted into the end of the buffer, which may still move while it grows, so the pointer is only filled in after all updates were checked
+		// The buffer is grown in large steps and only trimmed to the converted values at the end, to avoid resizing it for every single update
+		if (converted_size + value_count > converted.size())
+			converted.resize(std::max(converted.size() * 2, converted_size + value_count + 1024));
+		uint32_t *const dst = converted.data() + converted_size;
+		converted_size += value_count;
+
+		switch (update.type)
+		{
+		case api::effect_uniform_value_type::boolean:
+			for (size_t k = 0; k < value_count; ++k)
+			{
+				const float value = static_cast<const bool *>(update.values)[k] ? 1.0f : 0.0f;
+				if (stored_as_float)
+					std::memcpy(dst + k, &value, 4);
+				else
+					dst[k] = static_cast<uint32_t>(value);
+			}
+			break;
+		case api::effect_uniform_value_type::floating_point:
+			for (size_t k = 0; k < value_count; ++k)
+				dst[k] = static_cast<uint32_t>(static_cast<int32_t>(static_cast<const float *>(update.values)[k]));
+			break;
+		case api::effect_uniform_value_type::signed_int:
+			for (size_t k = 0; k < value_count; ++k)
+			{
+				const float value = static_cast<float>(static_cast<const int32_t *>(update.values)[k]);
+				std::memcpy(dst + k, &value, 4);
+			}
+			break;
+		case api::effect_uniform_value_type::unsigned_int:
+			for (size_t k = 0; k < value_count; ++k)
+			{
+				const float value = static_cast<float>(static_cast<const uint32_t *>(update.values)[k]);
+				std::memcpy(dst + k, &value, 4);
+			}
+			break;
+		}
+
+		write.data = nullptr;
+	}
+
+	converted.resize(converted_size);
+
+	// Converted values were appended in the order of the writes, so their positions in the buffer follow from the sizes
+	size_t offset = 0;
+	for (uniform_value_write &write : writes)
+	{
+		if (write.data != nullptr)
+			continue;
+
+		write.data = reinterpret_cast<const uint8_t *>(converted.data() + offset);
+		offset += write.size / 4;
+	}
+}
+
+#endif
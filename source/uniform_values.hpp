@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2022 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vector>
+#include "reshade_api.hpp"
+#include "runtime_objects.hpp"
+
+#if RESHADE_FX
+
+namespace reshade
+{
+	/// <summary>
+	/// Checks whether values of a uniform variable of the specified <paramref name="type"/> are stored as floating-point values, even if it was declared with an integral type.
+	/// </summary>
+	inline bool force_floating_point_value(const reshadefx::type &type, uint32_t renderer_id)
+	{
+		if (renderer_id == 0x9000)
+			return true; // All uniform variables are floating-point in D3D9
+		if (type.is_matrix() && (renderer_id & 0x10000))
+			return true; // All matrices are floating-point in GLSL
+		return false;
+	}
+
+	/// <summary>
+	/// Copies tightly packed 32-bit values into the uniform storage of an effect, which aligns every array element and matrix row to 16 bytes.
+	/// </summary>
+	/// <param name="variable">Uniform variable to write.</param>
+	/// <param name="data">Pointer to the values to write.</param>
+	/// <param name="size">Size of the values in bytes.</param>
+	/// <param name="base_index">Array element to start writing at.</param>
+	/// <param name="storage">Uniform storage of the effect the variable is declared in.</param>
+	void copy_uniform_value_data(const uniform &variable, const uint8_t *data, size_t size, size_t base_index, std::vector<uint8_t> &storage);
+	/// <summary>
+	/// Copies values of a uniform variable out of the uniform storage of an effect into tightly packed 32-bit values.
+	/// </summary>
+	void copy_uniform_value_data(const uniform &variable, const std::vector<uint8_t> &storage, size_t base_index, uint8_t *data, size_t size);
+
+	/// <summary>
+	/// An update of a uniform variable that was checked by <see cref="prepare_uniform_value_updates"/>, with everything needed to copy its values, so that the variable does not have to be looked at again.
+	/// </summary>
+	struct uniform_value_write
+	{
+		size_t effect_index;
+		special_uniform special;
+		/// <summary>
+		/// Offset in the uniform storage of the effect to start writing at, which already includes the array index.
+		/// </summary>
+		uint32_t offset;
+		/// <summary>
+		/// Number of values that go into every 16-byte aligned array element or matrix row, or zero if the values are copied as one block.
+		/// </summary>
+		uint32_t run_length;
+		/// <summary>
+		/// Pointer to the values in the type the variable is stored as, either the values of the update itself or the converted values.
+		/// </summary>
+		const uint8_t *data;
+		/// <summary>
+		/// Size of the values in bytes, limited to the array elements that follow the array index.
+		/// </summary>
+		size_t size;
+	};
+
+	/// <summary>
+	/// Copies the values of a checked update into the uniform storage of the effect the variable is declared in.
+	/// </summary>
+	void copy_uniform_value_data(const uniform_value_write &write, std::vector<uint8_t> &storage);
+
+	/// <summary>
+	/// Checks all updates of a batch in a single pass and then converts every value that is not in the type its variable is stored as, into one buffer.
+	/// Updates with no variable or values, an unknown value type or an array index that is out of bounds are skipped.
+	/// </summary>
+	/// <param name="updates">Pointer to an array of updates.</param>
+	/// <param name="count">Number of updates in the array.</param>
+	/// <param name="renderer_id">Renderer the effects were compiled for, which determines whether integral variables are stored as floating-point values.</param>
+	/// <param name="writes">Filled with the writes to perform, in the order of the updates.</param>
+	/// <param name="converted">Buffer that is filled with the converted values the writes point to.</param>
+	void prepare_uniform_value_updates(const api::effect_uniform_value_update *updates, size_t count, uint32_t renderer_id, std::vector<uniform_value_write> &writes, std::vector<uint32_t> &converted);
+}
+
+#endif